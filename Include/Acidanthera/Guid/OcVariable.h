@@ -25,6 +25,11 @@ WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
 //
 #define OC_LOG_VARIABLE_PATH                 L"boot-path"
 
+//
+// Variable used for OpenCore boot profile summary (if enabled).
+//
+#define OC_LOG_VARIABLE_PROFILE              L"boot-profile"
+
 //
 // Variable used for OpenCore request to redirect NVRAM Boot variable write.
 // Boot Services only.
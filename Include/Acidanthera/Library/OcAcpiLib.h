@@ -20,6 +20,21 @@
 
 #define OC_ACPI_NAME_SIZE 4
 
+//
+// Maximum number of NameSegs in indexed AML paths.
+//
+#define OC_ACPI_NAME_MAX_DEPTH  32
+
+//
+// Number of hash buckets in AML name index.
+//
+#define OC_ACPI_NAME_BUCKETS    1024
+
+//
+// Terminator of AML name index hash bucket chains.
+//
+#define OC_ACPI_NAME_INVALID    MAX_UINT32
+
 //
 // RSDP and XSDT table definitions not provided by EDK2 due to no
 // flexible array support.
@@ -53,6 +68,78 @@ typedef struct {
   CHAR8   Name[OC_ACPI_NAME_SIZE+1];
 } OC_ACPI_REGION;
 
+//
+// AML named object definition.
+//
+typedef struct {
+  //
+  // Table containing the object definition.
+  //
+  EFI_ACPI_COMMON_HEADER  *Table;
+  //
+  // Offset of the defining opcode from table start.
+  //
+  UINT32                  Offset;
+  //
+  // Definition length including the opcode.
+  //
+  UINT32                  Length;
+  //
+  // Defining opcode, extended opcodes are prefixed with AML_EXT_OP.
+  //
+  UINT16                  Opcode;
+  //
+  // Number of NameSegs in absolute object path.
+  //
+  UINT16                  Depth;
+  //
+  // Index of the first path NameSeg in name index segment list.
+  //
+  UINT32                  Path;
+  //
+  // Object path hash.
+  //
+  UINT32                  Hash;
+  //
+  // Next object in the same hash bucket or OC_ACPI_NAME_INVALID.
+  //
+  UINT32                  Next;
+} OC_ACPI_NAME;
+
+//
+// AML name index mapping absolute object paths to their definitions.
+//
+typedef struct {
+  //
+  // Indexed objects in table order.
+  //
+  OC_ACPI_NAME  *Names;
+  //
+  // Number of objects.
+  //
+  UINT32        NumberOfNames;
+  //
+  // Number of allocated object slots.
+  //
+  UINT32        AllocatedNames;
+  //
+  // NameSegs of all object paths.
+  //
+  UINT32        *Segments;
+  //
+  // Number of NameSegs.
+  //
+  UINT32        NumberOfSegments;
+  //
+  // Number of allocated NameSeg slots.
+  //
+  UINT32        AllocatedSegments;
+  //
+  // First object in every hash bucket or OC_ACPI_NAME_INVALID.
+  //
+  UINT32        Buckets[OC_ACPI_NAME_BUCKETS];
+} OC_ACPI_NAME_INDEX;
+
 //
 // Main ACPI context describing current tableset worked on.
 //
@@ -101,6 +188,10 @@ typedef struct {
   // Number of allocated region slots.
   //
   UINT32                                         AllocatedRegions;
+  //
+  // AML name index, built on demand, refreshed on patching and dropped on table changes.
+  //
+  OC_ACPI_NAME_INDEX                             *NameIndex;
 } OC_ACPI_CONTEXT;
 
 //
@@ -140,6 +231,14 @@ typedef struct {
   //
   UINT32       Limit;
   //
+  // Absolute AML path of the object to look up the patch in or NULL.
+  //
+  CONST CHAR8  *Base;
+  //
+  // Number of Base object definitions to skip.
+  //
+  UINT32       BaseSkip;
+  //
   // ACPI Table signature or 0.
   //
   UINT32       TableSignature;
@@ -239,6 +338,81 @@ AcpiApplyPatch (
   IN     OC_ACPI_PATCH    *Patch
   );
 
+/**
+  Patch ACPI tables with multiple patches at once.
+  Patches are applied to every table in their original order, patches
+  not matching the table are skipped after a single table scan, and
+  the checksum is refreshed once per modified table.
+
+  @param[in,out] Context     ACPI library context.
+  @param[in]     Patches     ACPI patches.
+  @param[in]     PatchCount  Number of ACPI patches.
+**/
+EFI_STATUS
+AcpiApplyPatches (
+  IN OUT OC_ACPI_CONTEXT  *Context,
+  IN     OC_ACPI_PATCH    *Patches,
+  IN     UINT32           PatchCount
+  );
+
+/**
+  Build AML name index for DSDT and SSDT tables.
+  Only objects defined outside of methods and conditional blocks are indexed.
+
+  @param[in,out] Context     ACPI library context.
+
+  @return EFI_SUCCESS on success.
+**/
+EFI_STATUS
+AcpiLoadNameIndex (
+  IN OUT OC_ACPI_CONTEXT  *Context
+  );
+
+/**
+  Index AML table again after its contents changed without changing
+  its length, e.g. after patching. Objects of other tables are kept.
+  This costs a single scan of the table instead of rebuilding the whole
+  index. On failure the index is freed and rebuilt on next demand.
+
+  @param[in,out] Context     ACPI library context.
+  @param[in]     Table       Changed table.
+**/
+VOID
+AcpiRefreshNameIndex (
+  IN OUT OC_ACPI_CONTEXT         *Context,
+  IN     EFI_ACPI_COMMON_HEADER  *Table
+  );
+
+/**
+  Free AML name index if any.
+
+  @param[in,out] Context     ACPI library context.
+**/
+VOID
+AcpiFreeNameIndex (
+  IN OUT OC_ACPI_CONTEXT  *Context
+  );
+
+/**
+  Find AML object definition by absolute path, e.g. \_SB.PCI0.LPCB.
+  NameSegs shorter than 4 characters are padded with underscores.
+  AML name index must be loaded.
+
+  @param[in] Context     ACPI library context.
+  @param[in] Table       Table to look in or NULL for any table.
+  @param[in] Path        Object path.
+  @param[in] Skip        Number of matching definitions to skip.
+
+  @return object definition or NULL.
+**/
+CONST OC_ACPI_NAME *
+AcpiFindNamePath (
+  IN CONST OC_ACPI_CONTEXT         *Context,
+  IN CONST EFI_ACPI_COMMON_HEADER  *Table  OPTIONAL,
+  IN CONST CHAR8                   *Path,
+  IN UINT32                        Skip
+  );
+
 /**
   Try to load ACPI regions.
 
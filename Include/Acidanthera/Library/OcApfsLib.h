@@ -83,12 +83,14 @@ OcApfsConnectDevice (
   Connect APFS driver to all present devices.
 
   @param[in] Monitor   Setup monitoring for newly connected devices.
+  @param[in] Parallel  Read all containers in parallel and load the newest driver once.
 
   @retval EFI_SUCCESS if at least one device was connected.
 **/
 EFI_STATUS
 OcApfsConnectDevices (
-  IN BOOLEAN      Monitor
+  IN BOOLEAN      Monitor,
+  IN BOOLEAN      Parallel
   );
 
 #endif // OC_APFS_LIB_H
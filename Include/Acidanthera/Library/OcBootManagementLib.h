@@ -696,7 +696,7 @@ struct OC_PICKER_CONTEXT_ {
   Get '.disk_label' or '.disk_label_2x' file contents, if exists.
 
   @param[in]   BootEntry      Located boot entry.
-  @param[in]   Scale          User interface scale.
+  @param[in]   Scale          Label scale, 2 selects '.disk_label_2x'.
   @param[out]  ImageData      File contents.
   @param[out]  DataLength     File length.
 
@@ -27,6 +27,30 @@
 **/
 // #define OC_INFLATE_VERIFY_DATA
 
+/**
+  Streaming decompression reads source data in chunks of this size.
+**/
+#define OC_DECOMPRESS_STREAM_CHUNK_SIZE BASE_1MB
+
+/**
+  Read source data for streaming decompression.
+
+  @param[in]   Context     Caller context.
+  @param[in]   Offset      Source data offset.
+  @param[in]   Size        Source data size to read.
+  @param[out]  Buffer      Buffer to read source data to.
+
+  @return  TRUE on success.
+**/
+typedef
+BOOLEAN
+(*OC_DECOMPRESS_READ) (
+  IN  VOID    *Context,
+  IN  UINT32  Offset,
+  IN  UINT32  Size,
+  OUT UINT8   *Buffer
+  );
+
 /**
   Compress buffer with LZSS algorithm.
 
@@ -63,6 +87,26 @@ DecompressLZSS (
   IN  UINT32  SrcLen
   );
 
+/**
+  Decompress LZSS stream read in chunks, avoiding to buffer the whole source.
+
+  @param[out]  Dst         Destination buffer.
+  @param[in]   DstLen      Destination buffer size.
+  @param[in]   SrcLen      Source data size.
+  @param[in]   Read        Source data reader.
+  @param[in]   Context     Source data reader context.
+
+  @return  DecompressedLen on success otherwise 0.
+**/
+UINT32
+DecompressLZSSStream (
+  OUT UINT8               *Dst,
+  IN  UINT32              DstLen,
+  IN  UINT32              SrcLen,
+  IN  OC_DECOMPRESS_READ  Read,
+  IN  VOID                *Context
+  );
+
 /**
   Decompress buffer with LZVN algorithm.
 
@@ -81,6 +125,26 @@ DecompressLZVN (
   IN  UINTN        SrcLen
   );
 
+/**
+  Decompress LZVN stream read in chunks, avoiding to buffer the whole source.
+
+  @param[out]  Dst         Destination buffer.
+  @param[in]   DstLen      Destination buffer size.
+  @param[in]   SrcLen      Source data size.
+  @param[in]   Read        Source data reader.
+  @param[in]   Context     Source data reader context.
+
+  @return  DecompressedLen on success otherwise 0.
+**/
+UINTN
+DecompressLZVNStream (
+  OUT UINT8               *Dst,
+  IN  UINTN               DstLen,
+  IN  UINT32              SrcLen,
+  IN  OC_DECOMPRESS_READ  Read,
+  IN  VOID                *Context
+  );
+
 /**
   Compress buffer with ZLIB algorithm.
 
@@ -117,6 +181,36 @@ DecompressZLIB (
   IN  UINTN        SrcLen
   );
 
+/**
+  Scratch buffer size required by DecompressZLIBWithScratch.
+**/
+#define OC_ZLIB_DECOMPRESS_SCRATCH_SIZE  (BASE_32KB + BASE_16KB)
+
+/**
+  Decompress buffer with ZLIB algorithm without allocating memory.
+  Decoder state is kept in the caller provided scratch buffer, so this
+  may be used where UEFI services are unavailable, e.g. on application
+  processors.
+
+  @param[out]  Dst          Destination buffer.
+  @param[in]   DstLen       Destination buffer size.
+  @param[in]   Src          Source buffer.
+  @param[in]   SrcLen       Source buffer size.
+  @param[in]   Scratch      Scratch buffer, 64-bit aligned.
+  @param[in]   ScratchSize  Scratch buffer size, at least OC_ZLIB_DECOMPRESS_SCRATCH_SIZE.
+
+  @return  DecompressedLen on success otherwise 0.
+**/
+UINTN
+DecompressZLIBWithScratch (
+  OUT UINT8        *Dst,
+  IN  UINTN        DstLen,
+  IN  CONST UINT8  *Src,
+  IN  UINTN        SrcLen,
+  IN  VOID         *Scratch,
+  IN  UINTN        ScratchSize
+  );
+
 /**
   Decompress buffer with RLE24 algorithm and 8-bit alpha.
   This algorithm is used for encoding IT32/T8MK images in ICNS.
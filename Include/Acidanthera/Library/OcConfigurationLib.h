@@ -56,6 +56,8 @@
 /// ACPI patches.
 ///
 #define OC_ACPI_PATCH_ENTRY_FIELDS(_, __) \
+  _(OC_STRING                   , Base             ,     , OC_STRING_CONSTR ("", _, __), OC_DESTR (OC_STRING) ) \
+  _(UINT32                      , BaseSkip         ,     , 0                           , ()                   ) \
   _(UINT32                      , Count            ,     , 0                           , ()                   ) \
   _(BOOLEAN                     , Enabled          ,     , FALSE                       , ()                   ) \
   _(OC_STRING                   , Comment          ,     , OC_STRING_CONSTR ("", _, __), OC_DESTR (OC_STRING) ) \
@@ -241,6 +243,7 @@
   _(BOOLEAN                     , AppleXcpmCfgLock            ,     , FALSE  , ()) \
   _(BOOLEAN                     , AppleXcpmExtraMsrs          ,     , FALSE  , ()) \
   _(BOOLEAN                     , AppleXcpmForceBoost         ,     , FALSE  , ()) \
+  _(BOOLEAN                     , CachePrelinked              ,     , FALSE  , ()) \
   _(BOOLEAN                     , CustomSmbiosGuid            ,     , FALSE  , ()) \
   _(BOOLEAN                     , DisableIoMapper             ,     , FALSE  , ()) \
   _(BOOLEAN                     , DisableRtcChecksum          ,     , FALSE  , ()) \
@@ -480,7 +483,8 @@ typedef enum {
   _(UINT32                      , MinDate            ,     , 0                             , ()) \
   _(BOOLEAN                     , EnableJumpstart    ,     , FALSE                         , ()) \
   _(BOOLEAN                     , HideVerbose        ,     , FALSE                         , ()) \
-  _(BOOLEAN                     , JumpstartHotPlug   ,     , FALSE                         , ())
+  _(BOOLEAN                     , JumpstartHotPlug   ,     , FALSE                         , ()) \
+  _(BOOLEAN                     , JumpstartParallel  ,     , FALSE                         , ())
   OC_DECLARE (OC_UEFI_APFS)
 
 ///
@@ -73,6 +73,51 @@ OcConfigureLogProtocol (
   IN EFI_SIMPLE_FILE_SYSTEM_PROTOCOL  *LogFileSystem  OPTIONAL
   );
 
+/**
+  Stop or restart periodic log file flushing. Pending entries are flushed
+  when stopping. The log is flushed for the last time at ExitBootServices.
+
+  @param[in] Enable  Restart periodic flushing when TRUE, stop it otherwise.
+**/
+VOID
+OcLogSetFileFlushTimer (
+  IN BOOLEAN  Enable
+  );
+
+/**
+  Begin boot profiling span. Spans begun before the previous span ends
+  are nested into it. Profiling must be enabled in log options.
+
+  @param[in] Name  Span name, truncated to 47 characters.
+
+  @return  Span identifier or OC_LOG_PROFILE_SPAN_INVALID.
+**/
+UINT32
+OcProfileBegin (
+  IN CONST CHAR8  *Name
+  );
+
+/**
+  End boot profiling span. Nested spans still running are ended as well.
+
+  @param[in] Span  Span identifier from OcProfileBegin.
+**/
+VOID
+OcProfileEnd (
+  IN UINT32  Span
+  );
+
+/**
+  Save boot profiling report as folded stacks next to the log file,
+  and top level span summary to boot-profile NVRAM variable.
+  Only the first call saves the report, so it should be made at the last
+  profiled point of the boot.
+**/
+VOID
+OcProfileReport (
+  VOID
+  );
+
 /**
   Install and initialise the Apple Debug Log protocol.
 
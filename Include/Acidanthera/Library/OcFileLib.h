@@ -186,6 +186,86 @@ SetFileData (
   IN UINT32             Size
   );
 
+/**
+  Default read-ahead window of buffered files.
+**/
+#define OC_BUFFERED_FILE_READ_AHEAD_SIZE   BASE_64KB
+
+/**
+  Default write-behind buffer size of buffered files.
+**/
+#define OC_BUFFERED_FILE_WRITE_BEHIND_SIZE BASE_64KB
+
+/**
+  Buffered file I/O statistics.
+**/
+typedef struct {
+  ///
+  /// Read requests and the part of them served from read-ahead buffer.
+  ///
+  UINT32  Reads;
+  UINT32  ReadHits;
+  ///
+  /// Write requests.
+  ///
+  UINT32  Writes;
+  ///
+  /// Requests passed to the original file.
+  ///
+  UINT32  DeviceReads;
+  UINT32  DeviceWrites;
+  ///
+  /// Bytes requested by the caller and transferred by the original file.
+  ///
+  UINT64  ReadBytes;
+  UINT64  WriteBytes;
+  UINT64  DeviceReadBytes;
+  UINT64  DeviceWriteBytes;
+} OC_BUFFERED_FILE_STATS;
+
+/**
+  Create buffered file wrapping the original file. Small sequential reads are
+  served from a read-ahead window, and adjacent small writes are coalesced
+  and written on flush, close, before any read, or when the buffer is full.
+  Write errors may therefore only be reported by Flush or Close.
+  Whole-file reads, like ReadFile or GetFileData with the file size, are
+  already a single transfer and gain nothing from buffering.
+  Original file must not be a directory, and must not be used directly
+  while the buffered file is open. Closing the buffered file closes it.
+
+  @param[in]  OriginalFile     Original file to wrap.
+  @param[in]  ReadAheadSize    Read-ahead window size, 0 to disable.
+  @param[in]  WriteBehindSize  Write-behind buffer size, 0 to disable.
+  @param[in]  CloseOnFailure   Close original file on failure.
+  @param[out] File             Resulting buffered file.
+
+  @retval EFI_SUCCESS on success.
+**/
+EFI_STATUS
+CreateBufferedFile (
+  IN  EFI_FILE_PROTOCOL  *OriginalFile,
+  IN  UINT32             ReadAheadSize,
+  IN  UINT32             WriteBehindSize,
+  IN  BOOLEAN            CloseOnFailure,
+  OUT EFI_FILE_PROTOCOL  **File
+  );
+
+/**
+  Get I/O statistics of a buffered file. Statistics are also printed
+  to the debug log when the file is closed.
+
+  @param[in]  File   Buffered file.
+  @param[out] Stats  I/O statistics.
+
+  @retval EFI_SUCCESS on success.
+  @retval EFI_UNSUPPORTED when File is not a buffered file.
+**/
+EFI_STATUS
+GetBufferedFileStats (
+  IN  EFI_FILE_PROTOCOL       *File,
+  OUT OC_BUFFERED_FILE_STATS  *Stats
+  );
+
 /**
   Get file information of specified type.
 
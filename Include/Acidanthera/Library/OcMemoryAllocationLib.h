@@ -0,0 +1,137 @@
+/** @file
+  Copyright (C) 2020, vit9696. All rights reserved.
+
+  All rights reserved.
+
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+**/
+
+#ifndef OC_MEMORY_ALLOCATION_LIB_H
+#define OC_MEMORY_ALLOCATION_LIB_H
+
+#include <Library/MemoryAllocationLib.h>
+
+//
+// OcMemoryAllocationLib is a MemoryAllocationLib instance serving small
+// boot services pool allocations from size-class slabs. Slabs are carved
+// from arenas allocated from the top of memory below 4 GB, so that they
+// do not fragment the lower memory used by the kernel.
+//
+// Boot services FreePool is overridden once the first arena is allocated,
+// so that slab blocks passed to other modules can be freed with gBS->FreePool.
+// Firmware pool is freed by the original FreePool in either case.
+// The library must only be used by modules staying resident until
+// ExitBootServices, as the override is never removed.
+//
+
+//
+// Smallest slab block size shift, 16 bytes.
+//
+#define OC_SLAB_MIN_BLOCK_SHIFT  4U
+
+//
+// Number of slab size classes, 16 to 2048 bytes.
+// Larger allocations are served by firmware pool.
+//
+#define OC_SLAB_CLASS_COUNT      8U
+
+//
+// Largest slab block size.
+//
+#define OC_SLAB_MAX_BLOCK_SIZE   (1U << (OC_SLAB_MIN_BLOCK_SHIFT + OC_SLAB_CLASS_COUNT - 1))
+
+//
+// Arena size in pages, 256 KB.
+//
+#define OC_SLAB_ARENA_PAGES      64U
+
+//
+// Maximum number of arenas, 16 MB in total.
+// Allocations are served by firmware pool afterwards.
+//
+#define OC_SLAB_MAX_ARENAS       64U
+
+/**
+  Slab allocator statistics.
+**/
+typedef struct OC_MEMORY_ALLOCATION_STATS_ {
+  //
+  // Number of allocations served by slabs.
+  //
+  UINT64  Allocations;
+  //
+  // Number of frees returned to slabs.
+  //
+  UINT64  Frees;
+  //
+  // Number of reallocations done in place.
+  //
+  UINT64  InPlaceReallocations;
+  //
+  // Number of pool allocations served by firmware.
+  //
+  UINT64  FirmwareAllocations;
+  //
+  // Total bytes requested from slabs, including in place growth.
+  //
+  UINT64  RequestedBytes;
+  //
+  // Total block bytes handed out by slabs, exceeds RequestedBytes
+  // by internal fragmentation.
+  //
+  UINT64  BlockBytes;
+  //
+  // Block bytes currently in use.
+  //
+  UINTN   UsedBytes;
+  //
+  // Peak block bytes in use.
+  //
+  UINTN   PeakUsedBytes;
+  //
+  // Arena bytes carved into slabs, exceeds UsedBytes by free blocks.
+  //
+  UINTN   SlabBytes;
+  //
+  // Arena bytes allocated from firmware.
+  //
+  UINTN   ArenaBytes;
+  //
+  // Number of allocated arenas.
+  //
+  UINT32  Arenas;
+  //
+  // Blocks currently in use per size class.
+  //
+  UINT32  UsedBlocks[OC_SLAB_CLASS_COUNT];
+  //
+  // Blocks currently free per size class.
+  //
+  UINT32  FreeBlocks[OC_SLAB_CLASS_COUNT];
+} OC_MEMORY_ALLOCATION_STATS;
+
+/**
+  Obtain slab allocator statistics.
+
+  @param[out]  Stats  Current statistics.
+**/
+VOID
+OcGetMemoryAllocationStats (
+  OUT OC_MEMORY_ALLOCATION_STATS  *Stats
+  );
+
+/**
+  Print slab allocator statistics to the debug log.
+**/
+VOID
+OcLogMemoryAllocationStats (
+  VOID
+  );
+
+#endif // OC_MEMORY_ALLOCATION_LIB_H
@@ -157,6 +157,25 @@ OcShrinkMemoryMap (
   IN     UINTN                  DescriptorSize
   );
 
+/**
+  Sort memory map entries based upon PhysicalStart and shrink memory map
+  by joining records in the same pass. Produces the same result as
+  OcSortMemoryMap followed by OcShrinkMemoryMap.
+
+  @param[in,out]  MemoryMapSize      Memory map size in bytes, updated on shrink.
+  @param[in,out]  MemoryMap          Memory map to sort and shrink.
+  @param[in]      DescriptorSize     Memory map descriptor size in bytes.
+
+  @retval EFI_SUCCESS on success.
+  @retval EFI_NOT_FOUND when cannot join anything.
+**/
+EFI_STATUS
+OcSortAndShrinkMemoryMap (
+  IN OUT UINTN                  *MemoryMapSize,
+  IN OUT EFI_MEMORY_DESCRIPTOR  *MemoryMap,
+  IN     UINTN                  DescriptorSize
+  );
+
 /**
   Deduplicate memory descriptors. Requires sorted entry list.
 
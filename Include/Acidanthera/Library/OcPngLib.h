@@ -64,6 +64,114 @@ DecodePng (
   OUT  BOOLEAN  *HasAlphaType OPTIONAL
   );
 
+/**
+  Decodes PNG image into raw BGRA pixel buffer compatible with
+  EFI_GRAPHICS_OUTPUT_BLT_PIXEL, optionally premultiplying colour
+  channels by alpha. 8-bit non-interlaced images are decoded directly
+  without intermediate RGBA conversion.
+
+  @param  Buffer                 Buffer with desired png image
+  @param  Size                   Size of input image
+  @param  Premultiply            Premultiply colour channels by alpha
+  @param  RawData                Output buffer with raw data
+  @param  Width                  Image width at output
+  @param  Height                 Image height at output
+  @param  HasAlphaType           Returns 1 if alpha layer present, optional param
+                                 Set NULL, if not used
+
+  @return EFI_SUCCESS            The function completed successfully.
+  @return EFI_OUT_OF_RESOURCES   There are not enough resources to init state.
+  @return EFI_INVALID_PARAMETER  Passed wrong parameter
+**/
+EFI_STATUS
+DecodePngBgra (
+  IN   VOID     *Buffer,
+  IN   UINTN    Size,
+  IN   BOOLEAN  Premultiply,
+  OUT  VOID     **RawData,
+  OUT  UINT32   *Width,
+  OUT  UINT32   *Height,
+  OUT  BOOLEAN  *HasAlphaType OPTIONAL
+  );
+
+/**
+  PNG image prepared for decoding by DecodePngBgraPrepare.
+  All fields are private to OcPngLib.
+**/
+typedef struct {
+  CONST UINT8  *Data;
+  UINTN        DataSize;
+  UINT8        *Scratch;
+  UINTN        ScratchSize;
+  UINT32       *Pixels;
+  UINT32       Width;
+  UINT32       Height;
+  UINTN        LineBytes;
+  UINTN        Bpp;
+  UINT32       ColorType;
+  BOOLEAN      Premultiply;
+  BOOLEAN      DataAllocated;
+  BOOLEAN      HasAlphaType;
+  EFI_STATUS   Status;
+} OC_PNG_BGRA_DECODE;
+
+/**
+  Prepares PNG image for decoding into raw BGRA pixel buffer by allocating
+  all memory the decoding needs. The decoding itself is performed by
+  DecodePngBgraRun, and must be completed by DecodePngBgraComplete.
+  Only 8-bit non-interlaced non-palette images can be prepared.
+
+  @param  Buffer                 Buffer with desired png image
+  @param  Size                   Size of input image
+  @param  Premultiply            Premultiply colour channels by alpha
+  @param  Decode                 Prepared decoding context
+
+  @return EFI_SUCCESS            The function completed successfully.
+  @return EFI_UNSUPPORTED        The image must be decoded by DecodePngBgra.
+  @return EFI_OUT_OF_RESOURCES   There are not enough resources to init state.
+  @return EFI_INVALID_PARAMETER  Passed wrong parameter
+**/
+EFI_STATUS
+DecodePngBgraPrepare (
+  IN   VOID                *Buffer,
+  IN   UINTN               Size,
+  IN   BOOLEAN             Premultiply,
+  OUT  OC_PNG_BGRA_DECODE  *Decode
+  );
+
+/**
+  Decodes prepared PNG image. This function does not allocate memory or use
+  any UEFI services, and may be called on application processors.
+  Buffer passed to DecodePngBgraPrepare must remain valid.
+
+  @param  Decode                 Prepared decoding context
+**/
+VOID
+DecodePngBgraRun (
+  IN OUT  OC_PNG_BGRA_DECODE  *Decode
+  );
+
+/**
+  Completes prepared PNG image decoding and frees its temporary memory.
+  Must be called for every prepared image, even when it was not run.
+
+  @param  Decode                 Prepared decoding context
+  @param  RawData                Output buffer with raw data
+  @param  Width                  Image width at output
+  @param  Height                 Image height at output
+
+  @return EFI_SUCCESS            The function completed successfully.
+  @return EFI_NOT_READY          The image was not run.
+  @return EFI_INVALID_PARAMETER  Image data is malformed.
+**/
+EFI_STATUS
+DecodePngBgraComplete (
+  IN OUT  OC_PNG_BGRA_DECODE  *Decode,
+  OUT     VOID                **RawData,
+  OUT     UINT32              *Width,
+  OUT     UINT32              *Height
+  );
+
 /**
   Encodes raw pixel buffer into PNG image data
 
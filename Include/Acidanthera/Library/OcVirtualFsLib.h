@@ -19,6 +19,87 @@
 
 #include <Protocol/SimpleFileSystem.h>
 
+/**
+  File open callback of virtual file systems. Same as EFI_FILE_OPEN,
+  but also receives the device handle of the volume This belongs to.
+
+  @param[in]   DeviceHandle  Volume device handle, NULL when unknown.
+  @param[in]   This          Original file the new file is opened from.
+  @param[out]  NewHandle     Resulting file.
+  @param[in]   FileName      File name relative to This.
+  @param[in]   OpenMode      File open mode.
+  @param[in]   Attributes    File attributes for newly created files.
+
+  @return  EFI_FILE_OPEN-compatible return code.
+**/
+typedef
+EFI_STATUS
+(EFIAPI *OC_VIRTUAL_FS_OPEN) (
+  IN  EFI_HANDLE         DeviceHandle  OPTIONAL,
+  IN  EFI_FILE_PROTOCOL  *This,
+  OUT EFI_FILE_PROTOCOL  **NewHandle,
+  IN  CHAR16             *FileName,
+  IN  UINT64             OpenMode,
+  IN  UINT64             Attributes
+  );
+
+/**
+  Reference-counted backing buffer, which may be shared by multiple
+  virtual files serving the same data.
+**/
+typedef struct OC_VIRTUAL_FILE_BUFFER_ OC_VIRTUAL_FILE_BUFFER;
+
+/**
+  Creates shared backing buffer for virtual files. On success FileBuffer
+  ownership is transferred to the resulting buffer, which frees it once
+  the last reference is released. The caller holds the first reference.
+
+  @param[in]   FileBuffer       Pointer to the file's data allocated from pool.
+  @param[in]   FileSize         File size of FileData.
+  @param[out]  SharedBuffer     Resulting shared buffer.
+
+  @return  EFI_SUCCESS if buffer was successfully created.
+**/
+EFI_STATUS
+CreateVirtualFileBuffer (
+  IN  VOID                    *FileBuffer,
+  IN  UINT64                  FileSize,
+  OUT OC_VIRTUAL_FILE_BUFFER  **SharedBuffer
+  );
+
+/**
+  Releases a reference to shared backing buffer, freeing it
+  once no virtual files use it.
+
+  @param[in]  SharedBuffer     Shared buffer.
+**/
+VOID
+ReleaseVirtualFileBuffer (
+  IN OC_VIRTUAL_FILE_BUFFER  *SharedBuffer
+  );
+
+/**
+  Creates read-only EFI_FILE_PROTOCOL instance over shared backing buffer.
+  On success FileName ownership is transferred to the resulting
+  EFI_FILE_PROTOCOL, which also holds a reference to SharedBuffer
+  until closing EFI_FILE_PROTOCOL. File data is not copied, so one
+  buffer may back any amount of opened files.
+
+  @param[in]      FileName         Pointer to the file's name.
+  @param[in]      SharedBuffer     Shared buffer with the file's data.
+  @param[in]      ModificationTime File modification date, optional.
+  @param[in,out]  File             Resulting file protocol.
+
+  @return  EFI_SUCCESS if instance was successfully created.
+**/
+EFI_STATUS
+CreateVirtualFileFromBuffer (
+  IN     CHAR16                  *FileName,
+  IN     OC_VIRTUAL_FILE_BUFFER  *SharedBuffer,
+  IN     EFI_TIME                *ModificationTime OPTIONAL,
+  IN OUT EFI_FILE_PROTOCOL       **File
+  );
+
 /**
   Creates read-only EFI_FILE_PROTOCOL instance over a buffer allocated
   from pool. On success FileName and FileData ownership is transferred
@@ -51,6 +132,7 @@ CreateVirtualFile (
   any registered OpenCallback.
 
   @param[in]      OriginalFile     Pointer to the original file.
+  @param[in]      DeviceHandle     Volume device handle, optional.
   @param[in]      OpenCallback     File open callback.
   @param[in]      CloseOnFailure   Close the original file on failure.
   @param[in,out]  File             Resulting file protocol.
@@ -60,10 +142,11 @@ CreateVirtualFile (
 **/
 EFI_STATUS
 CreateRealFile (
-  IN     EFI_FILE_PROTOCOL  *OriginalFile OPTIONAL,
-  IN     EFI_FILE_OPEN      OpenCallback OPTIONAL,
-  IN     BOOLEAN            CloseOnFailure,
-  IN OUT EFI_FILE_PROTOCOL  **File
+  IN     EFI_FILE_PROTOCOL   *OriginalFile OPTIONAL,
+  IN     EFI_HANDLE          DeviceHandle OPTIONAL,
+  IN     OC_VIRTUAL_FS_OPEN  OpenCallback OPTIONAL,
+  IN     BOOLEAN             CloseOnFailure,
+  IN OUT EFI_FILE_PROTOCOL   **File
   );
 
 /**
@@ -71,6 +154,7 @@ CreateRealFile (
   into NewFileSystem with specified callback. Cacheable.
 
   @param[in]       OriginalFileSystem  Source file system.
+  @param[in]       DeviceHandle        Source file system handle, optional.
   @param[in]       OpenCallback        File open callback.
   @param[in,out]   NewFileSystem       Wrapped file system.
 
@@ -79,7 +163,8 @@ CreateRealFile (
 EFI_STATUS
 CreateVirtualFs (
   IN     EFI_SIMPLE_FILE_SYSTEM_PROTOCOL  *OriginalFileSystem,
-  IN     EFI_FILE_OPEN                    OpenCallback,
+  IN     EFI_HANDLE                       DeviceHandle OPTIONAL,
+  IN     OC_VIRTUAL_FS_OPEN               OpenCallback,
   IN OUT EFI_SIMPLE_FILE_SYSTEM_PROTOCOL  **NewFileSystem
   );
 
@@ -95,7 +180,7 @@ CreateVirtualFs (
 EFI_STATUS
 EnableVirtualFs (
   IN OUT EFI_BOOT_SERVICES       *BootServices,
-  IN     EFI_FILE_OPEN           OpenCallback
+  IN     OC_VIRTUAL_FS_OPEN      OpenCallback
   );
 
 /**
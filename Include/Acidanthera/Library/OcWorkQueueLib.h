@@ -0,0 +1,125 @@
+/** @file
+  Copyright (C) 2020, vit9696. All rights reserved.
+
+  All rights reserved.
+
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+**/
+
+#ifndef OC_WORK_QUEUE_LIB_H
+#define OC_WORK_QUEUE_LIB_H
+
+#include <Uefi.h>
+
+/**
+  Work queue job procedure.
+
+  Jobs may be executed on application processors. They must not call any
+  UEFI services including memory allocation, print debug messages, or rely
+  on any shared state other than their context. All allocations must be done
+  by the caller before adding the job.
+
+  @param[in,out]  Context  Job context passed to OcWorkQueueAdd.
+**/
+typedef
+VOID
+(EFIAPI *OC_WORK_QUEUE_PROCEDURE) (
+  IN OUT VOID  *Context
+  );
+
+/**
+  Work queue job.
+**/
+typedef struct OC_WORK_QUEUE_JOB_ {
+  OC_WORK_QUEUE_PROCEDURE  Procedure;
+  VOID                     *Context;
+} OC_WORK_QUEUE_JOB;
+
+/**
+  Work queue.
+**/
+typedef struct OC_WORK_QUEUE_ {
+  //
+  // Jobs to run.
+  //
+  OC_WORK_QUEUE_JOB  *Jobs;
+  //
+  // Number of jobs added.
+  //
+  UINT32             JobCount;
+  //
+  // Maximum number of jobs.
+  //
+  UINT32             MaxJobs;
+  //
+  // Index of the next job to claim, shared between processors.
+  //
+  volatile UINT32    NextJob;
+  //
+  // Number of jobs completed by application processors during last run.
+  //
+  volatile UINT32    ApJobs;
+} OC_WORK_QUEUE;
+
+/**
+  Initialise work queue.
+
+  @param[out]  Queue    Work queue to initialise.
+  @param[in]   MaxJobs  Maximum number of jobs to be added.
+
+  @retval EFI_SUCCESS on success.
+**/
+EFI_STATUS
+OcWorkQueueInit (
+  OUT OC_WORK_QUEUE  *Queue,
+  IN  UINT32         MaxJobs
+  );
+
+/**
+  Add job to work queue.
+
+  @param[in,out]  Queue      Work queue.
+  @param[in]      Procedure  Job procedure, see OC_WORK_QUEUE_PROCEDURE restrictions.
+  @param[in]      Context    Job context.
+
+  @retval EFI_SUCCESS on success.
+  @retval EFI_OUT_OF_RESOURCES when the queue is full.
+**/
+EFI_STATUS
+OcWorkQueueAdd (
+  IN OUT OC_WORK_QUEUE            *Queue,
+  IN     OC_WORK_QUEUE_PROCEDURE  Procedure,
+  IN     VOID                     *Context
+  );
+
+/**
+  Run all added jobs and wait for their completion.
+  Jobs are distributed over all enabled processors including the BSP
+  when EFI_MP_SERVICES_PROTOCOL is available, and are run serially
+  on the BSP otherwise. The queue can be run again after adding more jobs,
+  previously completed jobs are not repeated.
+
+  @param[in,out]  Queue  Work queue.
+**/
+VOID
+OcWorkQueueRun (
+  IN OUT OC_WORK_QUEUE  *Queue
+  );
+
+/**
+  Free work queue resources.
+
+  @param[in,out]  Queue  Work queue.
+**/
+VOID
+OcWorkQueueFree (
+  IN OUT OC_WORK_QUEUE  *Queue
+  );
+
+#endif // OC_WORK_QUEUE_LIB_H
@@ -65,6 +65,8 @@
 
 #define OPEN_CORE_TOOL_PATH        L"Tools\\"
 
+#define OPEN_CORE_KERNEL_CACHE_PATH L"PrelinkedCache.bin"
+
 #define OPEN_CORE_NVRAM_ATTR       (EFI_VARIABLE_BOOTSERVICE_ACCESS | EFI_VARIABLE_RUNTIME_ACCESS)
 
 #define OPEN_CORE_NVRAM_NV_ATTR    (EFI_VARIABLE_BOOTSERVICE_ACCESS | EFI_VARIABLE_RUNTIME_ACCESS | EFI_VARIABLE_NON_VOLATILE)
@@ -127,6 +129,15 @@ OcUnloadKernelSupport (
   VOID
   );
 
+/**
+  Release patched kernel retained for repeated opens by the booter.
+  Opened kernel files remain valid until closed.
+**/
+VOID
+OcReleaseKernelSupportCache (
+  VOID
+  );
+
 /**
   Load NVRAM compatibility support.
 
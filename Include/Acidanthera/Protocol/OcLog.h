@@ -21,7 +21,7 @@
 ///
 /// Current supported log protocol revision.
 ///
-#define OC_LOG_REVISION  0x01000A
+#define OC_LOG_REVISION  0x01000B
 
 ///
 /// The defines for the log flags.
@@ -33,6 +33,9 @@
 #define OC_LOG_VARIABLE     BIT4
 #define OC_LOG_NONVOLATILE  BIT5
 #define OC_LOG_FILE         BIT6
+#define OC_LOG_FILE_REWRITE BIT7
+#define OC_LOG_TRACE        BIT8
+#define OC_LOG_PROFILE      BIT9
 
 typedef UINT32 OC_LOG_OPTIONS;
 
@@ -112,6 +115,56 @@ EFI_STATUS
   IN EFI_DEVICE_PATH_PROTOCOL  *FilePath OPTIONAL
   );
 
+/**
+  Begin profiling span. Spans started before the previous span is ended
+  are nested into it.
+
+  @param[in] This  This protocol.
+  @param[in] Name  Span name, copied.
+
+  @return  Span identifier or OC_LOG_PROFILE_SPAN_INVALID.
+**/
+typedef
+UINT32
+(EFIAPI *OC_LOG_PROFILE_BEGIN) (
+  IN OC_LOG_PROTOCOL  *This,
+  IN CONST CHAR8      *Name
+  );
+
+/**
+  End profiling span.
+
+  @param[in] This  This protocol.
+  @param[in] Span  Span identifier from ProfileBegin.
+**/
+typedef
+VOID
+(EFIAPI *OC_LOG_PROFILE_END) (
+  IN OC_LOG_PROTOCOL  *This,
+  IN UINT32           Span
+  );
+
+/**
+  Save profiling report to the log file system and NVRAM.
+  Spans that are not ended yet are reported up to the current time.
+  The report is saved only once per boot.
+
+  @param[in] This  This protocol.
+
+  @retval EFI_SUCCESS          The report was saved successfully.
+  @retval EFI_ALREADY_STARTED  The report was already saved.
+**/
+typedef
+EFI_STATUS
+(EFIAPI *OC_LOG_PROFILE_REPORT) (
+  IN OC_LOG_PROTOCOL  *This
+  );
+
+///
+/// Invalid profiling span identifier.
+///
+#define OC_LOG_PROFILE_SPAN_INVALID  MAX_UINT32
+
 /**
   The structure exposed by the OC_LOG_PROTOCOL.
 **/
@@ -128,6 +181,9 @@ struct OC_LOG_PROTOCOL_ {
   UINTN                   HaltLevel;    ///< The error level causing CPU dead loop.
   EFI_FILE_PROTOCOL       *FileSystem;  ///< Log file system root, not owned.
   CHAR16                  *FilePath;    ///< Log file path.
+  OC_LOG_PROFILE_BEGIN    ProfileBegin;  ///< A pointer to the ProfileBegin function.
+  OC_LOG_PROFILE_END      ProfileEnd;    ///< A pointer to the ProfileEnd function.
+  OC_LOG_PROFILE_REPORT   ProfileReport; ///< A pointer to the ProfileReport function.
 };
 
 /// A global variable storing the GUID of the OC_LOG_PROTOCOL.
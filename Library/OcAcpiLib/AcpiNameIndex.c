@@ -0,0 +1,1003 @@
+/** @file
+  Copyright (C) 2020, vit9696. All rights reserved.
+
+  All rights reserved.
+
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+**/
+
+#include <Uefi.h>
+
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/OcDebugLogLib.h>
+#include <Library/MemoryAllocationLib.h>
+
+#include <IndustryStandard/AcpiAml.h>
+#include <IndustryStandard/Acpi.h>
+
+#include <Library/OcAcpiLib.h>
+
+//
+// Not provided by older EDK2 versions.
+//
+#ifndef AML_EXTERNAL_OP
+#define AML_EXTERNAL_OP  0x15
+#endif
+
+#ifndef AML_NULL_NAME
+#define AML_NULL_NAME    0x00
+#endif
+
+//
+// Extended opcodes are stored with AML_EXT_OP prefix.
+//
+#define ACPI_EXT_OPCODE(Opcode)  ((UINT16) ((AML_EXT_OP << 8U) | (Opcode)))
+
+//
+// Initial number of name index slots.
+//
+#define ACPI_NAME_INITIAL_COUNT  256
+
+//
+// Maximum nesting of indexed scopes to bound stack usage.
+//
+#define ACPI_NAME_MAX_NESTING    64
+
+//
+// AML scanning state for a single table.
+//
+typedef struct {
+  OC_ACPI_NAME_INDEX      *Index;
+  EFI_ACPI_COMMON_HEADER  *Table;
+  CONST UINT8             *Data;
+  UINT32                  Nesting;
+} ACPI_NAME_PARSER;
+
+/**
+  Calculate AML path hash.
+
+  @param[in] Path   Path NameSegs.
+  @param[in] Depth  Number of NameSegs.
+
+  @return path hash.
+**/
+STATIC
+UINT32
+AcpiHashNamePath (
+  IN CONST UINT32  *Path,
+  IN UINT32        Depth
+  )
+{
+  UINT32  Index;
+  UINT32  Hash;
+  UINT32  Segment;
+  UINT32  Byte;
+
+  //
+  // FNV-1a over NameSeg characters.
+  //
+  Hash = 2166136261U;
+  for (Index = 0; Index < Depth; ++Index) {
+    Segment = Path[Index];
+    for (Byte = 0; Byte < OC_ACPI_NAME_SIZE; ++Byte) {
+      Hash ^= Segment & 0xFFU;
+      Hash *= 16777619U;
+      Segment >>= 8U;
+    }
+  }
+
+  return Hash;
+}
+
+/**
+  Read AML PkgLength.
+
+  @param[in]     Data    Table data.
+  @param[in,out] Offset  PkgLength offset, updated to point after it.
+  @param[in]     End     Enclosing object end.
+  @param[out]    PkgEnd  Package end.
+
+  @retval TRUE on success.
+**/
+STATIC
+BOOLEAN
+AcpiParsePkgLength (
+  IN     CONST UINT8  *Data,
+  IN OUT UINT32       *Offset,
+  IN     UINT32       End,
+  OUT    UINT32       *PkgEnd
+  )
+{
+  UINT32  Start;
+  UINT32  ByteCount;
+  UINT32  Length;
+  UINT32  Index;
+
+  Start = *Offset;
+  if (Start >= End) {
+    return FALSE;
+  }
+
+  ByteCount = Data[Start] >> 6U;
+  if (ByteCount == 0) {
+    Length = Data[Start] & 0x3FU;
+  } else {
+    if (End - Start <= ByteCount) {
+      return FALSE;
+    }
+
+    Length = Data[Start] & 0x0FU;
+    for (Index = 0; Index < ByteCount; ++Index) {
+      Length |= (UINT32) Data[Start + Index + 1] << (4U + Index * 8U);
+    }
+  }
+
+  //
+  // PkgLength includes its own encoding.
+  //
+  if (Length <= ByteCount || Length > End - Start) {
+    return FALSE;
+  }
+
+  *Offset = Start + ByteCount + 1;
+  *PkgEnd = Start + Length;
+  return TRUE;
+}
+
+/**
+  Check whether data starts with a valid NameSeg.
+
+  @param[in] Data  NameSeg of OC_ACPI_NAME_SIZE bytes.
+
+  @retval TRUE for valid NameSeg.
+**/
+STATIC
+BOOLEAN
+AcpiIsNameSeg (
+  IN CONST UINT8  *Data
+  )
+{
+  UINT32  Index;
+
+  if ((Data[0] < 'A' || Data[0] > 'Z') && Data[0] != '_') {
+    return FALSE;
+  }
+
+  for (Index = 1; Index < OC_ACPI_NAME_SIZE; ++Index) {
+    if ((Data[Index] < 'A' || Data[Index] > 'Z')
+      && (Data[Index] < '0' || Data[Index] > '9')
+      && Data[Index] != '_') {
+      return FALSE;
+    }
+  }
+
+  return TRUE;
+}
+
+/**
+  Read AML NameString and resolve it to an absolute path.
+
+  @param[in]     Data        Table data.
+  @param[in,out] Offset      NameString offset, updated to point after it.
+  @param[in]     End         Enclosing object end.
+  @param[in]     Scope       Current scope path.
+  @param[in]     ScopeDepth  Current scope path depth.
+  @param[out]    Path        Resolved path of OC_ACPI_NAME_MAX_DEPTH NameSegs.
+  @param[out]    Depth       Resolved path depth, 0 for root.
+
+  @retval TRUE on success.
+**/
+STATIC
+BOOLEAN
+AcpiParseNameString (
+  IN     CONST UINT8   *Data,
+  IN OUT UINT32        *Offset,
+  IN     UINT32        End,
+  IN     CONST UINT32  *Scope,
+  IN     UINT32        ScopeDepth,
+  OUT    UINT32        *Path,
+  OUT    UINT32        *Depth
+  )
+{
+  UINT32  Current;
+  UINT32  Prefix;
+  UINT32  Count;
+  UINT32  Index;
+
+  Current = *Offset;
+  if (Current >= End) {
+    return FALSE;
+  }
+
+  //
+  // Handle \ and ^ prefixes.
+  //
+  Prefix = ScopeDepth;
+  if (Data[Current] == AML_ROOT_CHAR) {
+    Prefix = 0;
+    ++Current;
+  } else {
+    while (Current < End && Data[Current] == AML_PARENT_PREFIX_CHAR) {
+      if (Prefix == 0) {
+        return FALSE;
+      }
+
+      --Prefix;
+      ++Current;
+    }
+  }
+
+  if (Current >= End) {
+    return FALSE;
+  }
+
+  if (Data[Current] == AML_NULL_NAME) {
+    Count = 0;
+    ++Current;
+  } else if (Data[Current] == AML_DUAL_NAME_PREFIX) {
+    Count = 2;
+    ++Current;
+  } else if (Data[Current] == AML_MULTI_NAME_PREFIX) {
+    if (End - Current < 2) {
+      return FALSE;
+    }
+
+    Count = Data[Current + 1];
+    Current += 2;
+  } else {
+    Count = 1;
+  }
+
+  if (Prefix + Count > OC_ACPI_NAME_MAX_DEPTH
+    || (End - Current) / OC_ACPI_NAME_SIZE < Count) {
+    return FALSE;
+  }
+
+  CopyMem (Path, Scope, Prefix * sizeof (Path[0]));
+
+  for (Index = 0; Index < Count; ++Index) {
+    if (!AcpiIsNameSeg (&Data[Current])) {
+      return FALSE;
+    }
+
+    Path[Prefix + Index] = ReadUnaligned32 ((CONST UINT32 *) &Data[Current]);
+    Current += OC_ACPI_NAME_SIZE;
+  }
+
+  *Offset = Current;
+  *Depth  = Prefix + Count;
+  return TRUE;
+}
+
+/**
+  Skip AML data object or object reference used as a definition argument.
+
+  @param[in]     Data    Table data.
+  @param[in,out] Offset  Object offset, updated to point after it.
+  @param[in]     End     Enclosing object end.
+
+  @retval TRUE on success.
+**/
+STATIC
+BOOLEAN
+AcpiSkipDataObject (
+  IN     CONST UINT8  *Data,
+  IN OUT UINT32       *Offset,
+  IN     UINT32       End
+  )
+{
+  UINT32  Current;
+  UINT32  Size;
+  UINT32  PkgEnd;
+  UINT32  Root;
+  UINT32  Path[OC_ACPI_NAME_MAX_DEPTH];
+  UINT32  Depth;
+
+  Current = *Offset;
+  if (Current >= End) {
+    return FALSE;
+  }
+
+  switch (Data[Current]) {
+    case AML_ZERO_OP:
+    case AML_ONE_OP:
+    case AML_ONES_OP:
+      Size = 1;
+      break;
+    case AML_BYTE_PREFIX:
+      Size = 1 + sizeof (UINT8);
+      break;
+    case AML_WORD_PREFIX:
+      Size = 1 + sizeof (UINT16);
+      break;
+    case AML_DWORD_PREFIX:
+      Size = 1 + sizeof (UINT32);
+      break;
+    case AML_QWORD_PREFIX:
+      Size = 1 + sizeof (UINT64);
+      break;
+    case AML_STRING_PREFIX:
+      for (Size = 1; Current + Size < End && Data[Current + Size] != '\0'; ++Size) {
+      }
+      ++Size;
+      break;
+    case AML_BUFFER_OP:
+    case AML_PACKAGE_OP:
+    case AML_VAR_PACKAGE_OP:
+      ++Current;
+      if (!AcpiParsePkgLength (Data, &Current, End, &PkgEnd)) {
+        return FALSE;
+      }
+
+      *Offset = PkgEnd;
+      return TRUE;
+    case AML_EXT_OP:
+      if (End - Current < 2 || Data[Current + 1] != AML_EXT_REVISION_OP) {
+        return FALSE;
+      }
+
+      Size = 2;
+      break;
+    default:
+      //
+      // Object references, e.g. OperationRegion (GNVS, SystemMemory, NVSA, 0x0200).
+      //
+      Root = 0;
+      return AcpiParseNameString (Data, Offset, End, &Root, 0, Path, &Depth);
+  }
+
+  if (Size > End - Current) {
+    return FALSE;
+  }
+
+  *Offset = Current + Size;
+  return TRUE;
+}
+
+/**
+  Append object definition to name index.
+
+  @param[in,out] Parser  AML parser.
+  @param[in]     Opcode  Defining opcode.
+  @param[in]     Start   Definition offset.
+  @param[in]     End     Definition end.
+  @param[in]     Path    Absolute object path.
+  @param[in]     Depth   Absolute object path depth.
+
+  @retval EFI_SUCCESS on success.
+**/
+STATIC
+EFI_STATUS
+AcpiAddName (
+  IN OUT ACPI_NAME_PARSER  *Parser,
+  IN     UINT16            Opcode,
+  IN     UINT32            Start,
+  IN     UINT32            End,
+  IN     CONST UINT32      *Path,
+  IN     UINT32            Depth
+  )
+{
+  OC_ACPI_NAME_INDEX  *Index;
+  OC_ACPI_NAME        *NewNames;
+  UINT32              *NewSegments;
+  OC_ACPI_NAME        *Name;
+
+  Index = Parser->Index;
+
+  if (Depth == 0) {
+    return EFI_SUCCESS;
+  }
+
+  if (Index->NumberOfNames == Index->AllocatedNames) {
+    NewNames = AllocatePool (Index->AllocatedNames * 2 * sizeof (Index->Names[0]));
+    if (NewNames == NULL) {
+      return EFI_OUT_OF_RESOURCES;
+    }
+
+    CopyMem (NewNames, Index->Names, Index->NumberOfNames * sizeof (Index->Names[0]));
+    FreePool (Index->Names);
+
+    Index->Names           = NewNames;
+    Index->AllocatedNames *= 2;
+  }
+
+  while (Index->AllocatedSegments - Index->NumberOfSegments < Depth) {
+    NewSegments = AllocatePool (Index->AllocatedSegments * 2 * sizeof (Index->Segments[0]));
+    if (NewSegments == NULL) {
+      return EFI_OUT_OF_RESOURCES;
+    }
+
+    CopyMem (NewSegments, Index->Segments, Index->NumberOfSegments * sizeof (Index->Segments[0]));
+    FreePool (Index->Segments);
+
+    Index->Segments           = NewSegments;
+    Index->AllocatedSegments *= 2;
+  }
+
+  Name         = &Index->Names[Index->NumberOfNames];
+  Name->Table  = Parser->Table;
+  Name->Offset = Start;
+  Name->Length = End - Start;
+  Name->Opcode = Opcode;
+  Name->Depth  = (UINT16) Depth;
+  Name->Path   = Index->NumberOfSegments;
+  Name->Hash   = AcpiHashNamePath (Path, Depth);
+  Name->Next   = OC_ACPI_NAME_INVALID;
+
+  CopyMem (&Index->Segments[Index->NumberOfSegments], Path, Depth * sizeof (Path[0]));
+  Index->NumberOfSegments += Depth;
+  ++Index->NumberOfNames;
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Index object definitions in AML TermList.
+  Scanning stops at the first term, which cannot be parsed without
+  interpreting AML, as its length is unknown.
+
+  @param[in,out] Parser      AML parser.
+  @param[in]     Offset      TermList offset.
+  @param[in]     End         TermList end.
+  @param[in]     Scope       Current scope path.
+  @param[in]     ScopeDepth  Current scope path depth.
+
+  @retval EFI_SUCCESS unless memory allocation failure.
+**/
+STATIC
+EFI_STATUS
+AcpiParseTermList (
+  IN OUT ACPI_NAME_PARSER  *Parser,
+  IN     UINT32            Offset,
+  IN     UINT32            End,
+  IN     CONST UINT32      *Scope,
+  IN     UINT32            ScopeDepth
+  )
+{
+  EFI_STATUS   Status;
+  CONST UINT8  *Data;
+  UINT32       Start;
+  UINT16       Opcode;
+  UINT32       PkgEnd;
+  UINT32       ArgSize;
+  UINT32       Path[OC_ACPI_NAME_MAX_DEPTH];
+  UINT32       Depth;
+  UINT32       Alias[OC_ACPI_NAME_MAX_DEPTH];
+  UINT32       AliasDepth;
+
+  Data = Parser->Data;
+
+  while (Offset < End) {
+    Start  = Offset;
+    Opcode = Data[Offset++];
+    if (Opcode == AML_EXT_OP && Offset < End) {
+      Opcode = ACPI_EXT_OPCODE (Data[Offset++]);
+    }
+
+    switch (Opcode) {
+      case AML_SCOPE_OP:
+      case ACPI_EXT_OPCODE (AML_EXT_DEVICE_OP):
+      case ACPI_EXT_OPCODE (AML_EXT_THERMAL_ZONE_OP):
+      case ACPI_EXT_OPCODE (AML_EXT_PROCESSOR_OP):
+      case ACPI_EXT_OPCODE (AML_EXT_POWER_RES_OP):
+      case AML_METHOD_OP:
+        if (!AcpiParsePkgLength (Data, &Offset, End, &PkgEnd)
+          || !AcpiParseNameString (Data, &Offset, PkgEnd, Scope, ScopeDepth, Path, &Depth)) {
+          break;
+        }
+
+        //
+        // ProcID, PblkAddr, and PblkLen for Processor.
+        // SystemLevel and ResourceOrder for PowerResource.
+        //
+        if (Opcode == ACPI_EXT_OPCODE (AML_EXT_PROCESSOR_OP)) {
+          ArgSize = sizeof (UINT8) + sizeof (UINT32) + sizeof (UINT8);
+        } else if (Opcode == ACPI_EXT_OPCODE (AML_EXT_POWER_RES_OP)) {
+          ArgSize = sizeof (UINT8) + sizeof (UINT16);
+        } else {
+          ArgSize = 0;
+        }
+
+        if (ArgSize > PkgEnd - Offset) {
+          break;
+        }
+
+        Status = AcpiAddName (Parser, Opcode, Start, PkgEnd, Path, Depth);
+        if (EFI_ERROR (Status)) {
+          return Status;
+        }
+
+        //
+        // Method bodies define objects dynamically and are not indexed.
+        //
+        if (Opcode != AML_METHOD_OP && Parser->Nesting < ACPI_NAME_MAX_NESTING) {
+          ++Parser->Nesting;
+          Status = AcpiParseTermList (Parser, Offset + ArgSize, PkgEnd, Path, Depth);
+          --Parser->Nesting;
+          if (EFI_ERROR (Status)) {
+            return Status;
+          }
+        }
+
+        Offset = PkgEnd;
+        continue;
+
+      case AML_NAME_OP:
+      case ACPI_EXT_OPCODE (AML_EXT_REGION_OP):
+      case ACPI_EXT_OPCODE (AML_EXT_MUTEX_OP):
+      case ACPI_EXT_OPCODE (AML_EXT_EVENT_OP):
+        if (!AcpiParseNameString (Data, &Offset, End, Scope, ScopeDepth, Path, &Depth)) {
+          break;
+        }
+
+        //
+        // Name has DataRefObject, OperationRegion has RegionSpace and two TermArgs
+        // normally encoded as data objects, Mutex has SyncFlags, Event has nothing.
+        //
+        if (Opcode == AML_NAME_OP) {
+          if (!AcpiSkipDataObject (Data, &Offset, End)) {
+            break;
+          }
+        } else if (Opcode == ACPI_EXT_OPCODE (AML_EXT_REGION_OP)) {
+          if (Offset >= End) {
+            break;
+          }
+
+          ++Offset;
+          if (!AcpiSkipDataObject (Data, &Offset, End)
+            || !AcpiSkipDataObject (Data, &Offset, End)) {
+            break;
+          }
+        } else if (Opcode == ACPI_EXT_OPCODE (AML_EXT_MUTEX_OP)) {
+          if (Offset >= End) {
+            break;
+          }
+
+          ++Offset;
+        }
+
+        Status = AcpiAddName (Parser, Opcode, Start, Offset, Path, Depth);
+        if (EFI_ERROR (Status)) {
+          return Status;
+        }
+
+        continue;
+
+      case AML_ALIAS_OP:
+        if (!AcpiParseNameString (Data, &Offset, End, Scope, ScopeDepth, Path, &Depth)
+          || !AcpiParseNameString (Data, &Offset, End, Scope, ScopeDepth, Alias, &AliasDepth)) {
+          break;
+        }
+
+        Status = AcpiAddName (Parser, Opcode, Start, Offset, Alias, AliasDepth);
+        if (EFI_ERROR (Status)) {
+          return Status;
+        }
+
+        continue;
+
+      case AML_EXTERNAL_OP:
+        //
+        // External declarations have ObjectType and ArgumentCount.
+        //
+        if (!AcpiParseNameString (Data, &Offset, End, Scope, ScopeDepth, Path, &Depth)
+          || End - Offset < 2) {
+          break;
+        }
+
+        Offset += 2;
+        continue;
+
+      case ACPI_EXT_OPCODE (AML_EXT_FIELD_OP):
+      case ACPI_EXT_OPCODE (AML_EXT_INDEX_FIELD_OP):
+      case ACPI_EXT_OPCODE (AML_EXT_BANK_FIELD_OP):
+      case AML_IF_OP:
+      case AML_ELSE_OP:
+      case AML_WHILE_OP:
+        //
+        // Field units and conditional definitions are not indexed.
+        //
+        if (!AcpiParsePkgLength (Data, &Offset, End, &PkgEnd)) {
+          break;
+        }
+
+        Offset = PkgEnd;
+        continue;
+
+      default:
+        break;
+    }
+
+    DEBUG ((
+      DEBUG_VERBOSE,
+      "OCA: Stopped AML indexing of %08x at %u on opcode %04x\n",
+      Parser->Table->Signature,
+      Start,
+      Opcode
+      ));
+    break;
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Index object definitions in AML table.
+
+  @param[in,out] Index  AML name index.
+  @param[in]     Table  DSDT or SSDT table.
+
+  @retval EFI_SUCCESS unless memory allocation failure.
+**/
+STATIC
+EFI_STATUS
+AcpiLoadTableNames (
+  IN OUT OC_ACPI_NAME_INDEX      *Index,
+  IN     EFI_ACPI_COMMON_HEADER  *Table
+  )
+{
+  ACPI_NAME_PARSER  Parser;
+  UINT32            Root;
+
+  if (Table->Length < sizeof (EFI_ACPI_DESCRIPTION_HEADER)) {
+    return EFI_SUCCESS;
+  }
+
+  Parser.Index   = Index;
+  Parser.Table   = Table;
+  Parser.Data    = (CONST UINT8 *) Table;
+  Parser.Nesting = 0;
+
+  Root = 0;
+  return AcpiParseTermList (
+    &Parser,
+    sizeof (EFI_ACPI_DESCRIPTION_HEADER),
+    Table->Length,
+    &Root,
+    0
+    );
+}
+
+/**
+  Link indexed objects into hash buckets.
+
+  @param[in,out] Index  AML name index.
+**/
+STATIC
+VOID
+AcpiLinkNameIndex (
+  IN OUT OC_ACPI_NAME_INDEX  *Index
+  )
+{
+  UINT32  Name;
+  UINT32  Bucket;
+
+  //
+  // Insert in reverse order to keep bucket chains in table order.
+  //
+  SetMem32 (Index->Buckets, sizeof (Index->Buckets), OC_ACPI_NAME_INVALID);
+  for (Name = Index->NumberOfNames; Name > 0; --Name) {
+    Bucket = Index->Names[Name - 1].Hash & (OC_ACPI_NAME_BUCKETS - 1);
+    Index->Names[Name - 1].Next = Index->Buckets[Bucket];
+    Index->Buckets[Bucket]      = Name - 1;
+  }
+}
+
+/**
+  Get table position in name index, DSDT goes first followed by SSDTs.
+
+  @param[in] Context  ACPI library context.
+  @param[in] Table    Indexed table.
+
+  @return table position.
+**/
+STATIC
+UINT32
+AcpiGetNameTableOrder (
+  IN CONST OC_ACPI_CONTEXT         *Context,
+  IN CONST EFI_ACPI_COMMON_HEADER  *Table
+  )
+{
+  UINT32  Index;
+
+  if (Table == (EFI_ACPI_COMMON_HEADER *) Context->Dsdt) {
+    return 0;
+  }
+
+  for (Index = 0; Index < Context->NumberOfTables; ++Index) {
+    if (Context->Tables[Index] == Table) {
+      return Index + 1;
+    }
+  }
+
+  return MAX_UINT32;
+}
+
+EFI_STATUS
+AcpiLoadNameIndex (
+  IN OUT OC_ACPI_CONTEXT  *Context
+  )
+{
+  EFI_STATUS          Status;
+  OC_ACPI_NAME_INDEX  *Index;
+  UINT32              Table;
+
+  AcpiFreeNameIndex (Context);
+
+  Index = AllocateZeroPool (sizeof (*Index));
+  if (Index == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Index->AllocatedNames    = ACPI_NAME_INITIAL_COUNT;
+  Index->Names             = AllocatePool (Index->AllocatedNames * sizeof (Index->Names[0]));
+  Index->AllocatedSegments = ACPI_NAME_INITIAL_COUNT * 4;
+  Index->Segments          = AllocatePool (Index->AllocatedSegments * sizeof (Index->Segments[0]));
+  Context->NameIndex       = Index;
+
+  if (Index->Names == NULL || Index->Segments == NULL) {
+    AcpiFreeNameIndex (Context);
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Status = EFI_SUCCESS;
+
+  if (Context->Dsdt != NULL) {
+    Status = AcpiLoadTableNames (Index, (EFI_ACPI_COMMON_HEADER *) Context->Dsdt);
+  }
+
+  for (Table = 0; Table < Context->NumberOfTables && !EFI_ERROR (Status); ++Table) {
+    if (Context->Tables[Table]->Signature == EFI_ACPI_6_2_SECONDARY_SYSTEM_DESCRIPTION_TABLE_SIGNATURE) {
+      Status = AcpiLoadTableNames (Index, Context->Tables[Table]);
+    }
+  }
+
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_WARN, "OCA: Failed to index AML names - %r\n", Status));
+    AcpiFreeNameIndex (Context);
+    return Status;
+  }
+
+  AcpiLinkNameIndex (Index);
+
+  DEBUG ((
+    DEBUG_INFO,
+    "OCA: Indexed %u AML names with %u segments\n",
+    Index->NumberOfNames,
+    Index->NumberOfSegments
+    ));
+
+  return EFI_SUCCESS;
+}
+
+VOID
+AcpiRefreshNameIndex (
+  IN OUT OC_ACPI_CONTEXT         *Context,
+  IN     EFI_ACPI_COMMON_HEADER  *Table
+  )
+{
+  EFI_STATUS          Status;
+  OC_ACPI_NAME_INDEX  *Index;
+  OC_ACPI_NAME        *NewNames;
+  UINT32              *NewSegments;
+  UINT32              Order;
+  UINT32              First;
+  UINT32              Last;
+  UINT32              SegmentFirst;
+  UINT32              SegmentLast;
+  UINT32              OldNames;
+  UINT32              OldSegments;
+  UINT32              NameCount;
+  UINT32              SegmentCount;
+  UINT32              Name;
+
+  Index = Context->NameIndex;
+  if (Index == NULL
+    || (Table != (EFI_ACPI_COMMON_HEADER *) Context->Dsdt
+      && Table->Signature != EFI_ACPI_6_2_SECONDARY_SYSTEM_DESCRIPTION_TABLE_SIGNATURE)) {
+    return;
+  }
+
+  //
+  // Objects of every table are contiguous, find the table range or the place
+  // where it would be when the table has no objects.
+  //
+  Order = AcpiGetNameTableOrder (Context, Table);
+  for (First = 0; First < Index->NumberOfNames; ++First) {
+    if (Index->Names[First].Table == Table
+      || ((First == 0 || Index->Names[First].Table != Index->Names[First - 1].Table)
+        && AcpiGetNameTableOrder (Context, Index->Names[First].Table) > Order)) {
+      break;
+    }
+  }
+
+  for (Last = First; Last < Index->NumberOfNames && Index->Names[Last].Table == Table; ++Last) {
+  }
+
+  SegmentFirst = First < Index->NumberOfNames ? Index->Names[First].Path : Index->NumberOfSegments;
+  SegmentLast  = Last < Index->NumberOfNames ? Index->Names[Last].Path : Index->NumberOfSegments;
+  OldNames     = Index->NumberOfNames;
+  OldSegments  = Index->NumberOfSegments;
+
+  //
+  // Index the table again at the end and move its objects in place.
+  //
+  Status = AcpiLoadTableNames (Index, Table);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_WARN, "OCA: Failed to refresh AML names of %08x - %r\n", Table->Signature, Status));
+    AcpiFreeNameIndex (Context);
+    return;
+  }
+
+  NameCount    = Index->NumberOfNames - OldNames;
+  SegmentCount = Index->NumberOfSegments - OldSegments;
+  NewNames     = NULL;
+  NewSegments  = NULL;
+
+  if (NameCount > 0) {
+    NewNames    = AllocateCopyPool (NameCount * sizeof (Index->Names[0]), &Index->Names[OldNames]);
+    NewSegments = AllocateCopyPool (SegmentCount * sizeof (Index->Segments[0]), &Index->Segments[OldSegments]);
+    if (NewNames == NULL || NewSegments == NULL) {
+      if (NewNames != NULL) {
+        FreePool (NewNames);
+      }
+      if (NewSegments != NULL) {
+        FreePool (NewSegments);
+      }
+      AcpiFreeNameIndex (Context);
+      return;
+    }
+  }
+
+  CopyMem (
+    &Index->Names[First + NameCount],
+    &Index->Names[Last],
+    (OldNames - Last) * sizeof (Index->Names[0])
+    );
+  CopyMem (
+    &Index->Segments[SegmentFirst + SegmentCount],
+    &Index->Segments[SegmentLast],
+    (OldSegments - SegmentLast) * sizeof (Index->Segments[0])
+    );
+
+  for (Name = First + NameCount; Name < First + NameCount + OldNames - Last; ++Name) {
+    Index->Names[Name].Path = Index->Names[Name].Path - SegmentLast + SegmentFirst + SegmentCount;
+  }
+
+  if (NameCount > 0) {
+    for (Name = 0; Name < NameCount; ++Name) {
+      NewNames[Name].Path = NewNames[Name].Path - OldSegments + SegmentFirst;
+    }
+
+    CopyMem (&Index->Names[First], NewNames, NameCount * sizeof (Index->Names[0]));
+    CopyMem (&Index->Segments[SegmentFirst], NewSegments, SegmentCount * sizeof (Index->Segments[0]));
+    FreePool (NewNames);
+    FreePool (NewSegments);
+  }
+
+  Index->NumberOfNames    = First + NameCount + OldNames - Last;
+  Index->NumberOfSegments = SegmentFirst + SegmentCount + OldSegments - SegmentLast;
+
+  AcpiLinkNameIndex (Index);
+
+  DEBUG ((
+    DEBUG_VERBOSE,
+    "OCA: Refreshed %u AML names of %08x, %u were indexed\n",
+    NameCount,
+    Table->Signature,
+    Last - First
+    ));
+}
+
+VOID
+AcpiFreeNameIndex (
+  IN OUT OC_ACPI_CONTEXT  *Context
+  )
+{
+  if (Context->NameIndex == NULL) {
+    return;
+  }
+
+  if (Context->NameIndex->Names != NULL) {
+    FreePool (Context->NameIndex->Names);
+  }
+
+  if (Context->NameIndex->Segments != NULL) {
+    FreePool (Context->NameIndex->Segments);
+  }
+
+  FreePool (Context->NameIndex);
+  Context->NameIndex = NULL;
+}
+
+CONST OC_ACPI_NAME *
+AcpiFindNamePath (
+  IN CONST OC_ACPI_CONTEXT         *Context,
+  IN CONST EFI_ACPI_COMMON_HEADER  *Table  OPTIONAL,
+  IN CONST CHAR8                   *Path,
+  IN UINT32                        Skip
+  )
+{
+  CONST OC_ACPI_NAME_INDEX  *Index;
+  CONST OC_ACPI_NAME        *Name;
+  UINT32                    Segments[OC_ACPI_NAME_MAX_DEPTH];
+  UINT32                    Depth;
+  UINT32                    Length;
+  UINT32                    Hash;
+  UINT32                    Current;
+  CHAR8                     Segment[OC_ACPI_NAME_SIZE];
+
+  Index = Context->NameIndex;
+  if (Index == NULL) {
+    return NULL;
+  }
+
+  //
+  // Paths are always absolute, leading \ is optional.
+  //
+  if (*Path == '\\') {
+    ++Path;
+  }
+
+  Depth = 0;
+  while (*Path != '\0') {
+    if (Depth == OC_ACPI_NAME_MAX_DEPTH) {
+      return NULL;
+    }
+
+    SetMem (Segment, sizeof (Segment), '_');
+    for (Length = 0; Path[Length] != '\0' && Path[Length] != '.'; ++Length) {
+      if (Length == OC_ACPI_NAME_SIZE) {
+        return NULL;
+      }
+
+      Segment[Length] = Path[Length];
+    }
+
+    if (Length == 0) {
+      return NULL;
+    }
+
+    Segments[Depth++] = ReadUnaligned32 ((CONST UINT32 *) Segment);
+
+    Path += Length;
+    if (*Path == '.') {
+      ++Path;
+      if (*Path == '\0') {
+        return NULL;
+      }
+    }
+  }
+
+  if (Depth == 0) {
+    return NULL;
+  }
+
+  Hash    = AcpiHashNamePath (Segments, Depth);
+  Current = Index->Buckets[Hash & (OC_ACPI_NAME_BUCKETS - 1)];
+
+  while (Current != OC_ACPI_NAME_INVALID) {
+    Name = &Index->Names[Current];
+    if (Name->Hash == Hash
+      && Name->Depth == Depth
+      && (Table == NULL || Name->Table == Table)
+      && CompareMem (&Index->Segments[Name->Path], Segments, Depth * sizeof (Segments[0])) == 0) {
+      if (Skip == 0) {
+        return Name;
+      }
+
+      --Skip;
+    }
+
+    Current = Name->Next;
+  }
+
+  return NULL;
+}
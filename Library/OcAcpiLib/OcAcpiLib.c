@@ -28,6 +28,10 @@
 
 #include <Library/OcAcpiLib.h>
 
+//
+// Bitmap size covering all adjacent byte pairs, used for patch lookup.
+//
+#define ACPI_PAIR_MAP_SIZE  (BIT16 / 8)
 
 /**
   Find RSD_PTR Table In Legacy Area
@@ -604,6 +608,8 @@ AcpiFreeContext (
     FreePool (Context->Regions);
     Context->Regions = NULL;
   }
+
+  AcpiFreeNameIndex (Context);
 }
 
 EFI_STATUS
@@ -745,6 +751,7 @@ AcpiDeleteTable (
           (Context->NumberOfTables - Index - 1) * sizeof (Context->Tables[0])
           );
         --Context->NumberOfTables;
+        AcpiFreeNameIndex (Context);
 
         if (All) {
           Found = TRUE;
@@ -826,6 +833,8 @@ AcpiInsertTable (
   CopyMem ((UINT8 *)(UINTN)Table, Data, Length);
   ZeroMem ((UINT8 *)(UINTN)Table + Length, EFI_PAGES_TO_SIZE (EFI_SIZE_TO_PAGES (Length)) - Length);
 
+  AcpiFreeNameIndex (Context);
+
   if (ReplaceDsdt) {
     DEBUG ((
       DEBUG_INFO,
@@ -888,6 +897,85 @@ AcpiNormalizeHeaders (
   }
 }
 
+/**
+  Obtain patch lookup area in the table.
+  With Base set the lookup is done in the matching object definition.
+
+  @param[in,out] Context  ACPI library context.
+  @param[in]     Table    ACPI table.
+  @param[in]     Patch    ACPI patch.
+  @param[out]    Data     Lookup area.
+  @param[out]    Size     Lookup area size.
+
+  @retval FALSE when Base object is not defined in the table.
+**/
+STATIC
+BOOLEAN
+AcpiGetPatchArea (
+  IN OUT OC_ACPI_CONTEXT         *Context,
+  IN     EFI_ACPI_COMMON_HEADER  *Table,
+  IN     CONST OC_ACPI_PATCH     *Patch,
+  OUT    UINT8                   **Data,
+  OUT    UINT32                  *Size
+  )
+{
+  EFI_STATUS          Status;
+  CONST OC_ACPI_NAME  *Name;
+
+  if (Patch->Base == NULL || Patch->Base[0] == '\0') {
+    *Data = (UINT8 *) Table;
+    *Size = Patch->Limit;
+    if (*Size == 0) {
+      *Size = Table->Length;
+    }
+
+    return TRUE;
+  }
+
+  //
+  // Name index is dropped when tables are added or removed and rebuilt on demand.
+  //
+  if (Context->NameIndex == NULL) {
+    Status = AcpiLoadNameIndex (Context);
+    if (EFI_ERROR (Status)) {
+      return FALSE;
+    }
+  }
+
+  Name = AcpiFindNamePath (Context, Table, Patch->Base, Patch->BaseSkip);
+  if (Name == NULL) {
+    DEBUG ((
+      DEBUG_BULK_INFO,
+      "OCA: Patch base %a is not found in %08x (%016Lx)\n",
+      Patch->Base,
+      Table->Signature,
+      AcpiReadOemTableId (Table)
+      ));
+    return FALSE;
+  }
+
+  //
+  // Limit counts from the object start and may exceed its definition.
+  //
+  *Data = (UINT8 *) Table + Name->Offset;
+  *Size = Name->Length;
+  if (Patch->Limit != 0) {
+    *Size = MIN (Patch->Limit, Table->Length - Name->Offset);
+  }
+
+  DEBUG ((
+    DEBUG_INFO,
+    "OCA: Patch base %a is at %u of %08x (%016Lx) with %u bytes\n",
+    Patch->Base,
+    Name->Offset,
+    Table->Signature,
+    AcpiReadOemTableId (Table),
+    *Size
+    ));
+
+  return TRUE;
+}
+
 EFI_STATUS
 AcpiApplyPatch (
   IN OUT OC_ACPI_CONTEXT  *Context,
@@ -898,25 +986,22 @@ AcpiApplyPatch (
   UINT64  CurrOemTableId;
   UINT32  ReplaceCount;
   UINT32  ReplaceLimit;
+  UINT8   *ReplaceData;
 
   DEBUG ((DEBUG_INFO, "OCA: Applying %u byte ACPI patch skip %u, count %u\n", Patch->Size, Patch->Skip, Patch->Count));
 
   if (Context->Dsdt != NULL
     && (Patch->TableSignature == 0 || Patch->TableSignature == EFI_ACPI_6_2_DIFFERENTIATED_SYSTEM_DESCRIPTION_TABLE_SIGNATURE)
     && (Patch->TableLength == 0 || Context->Dsdt->Length == Patch->TableLength)
-    && (Patch->OemTableId == 0 || Context->Dsdt->OemTableId == Patch->OemTableId)) {
-    ReplaceLimit = Patch->Limit;
-    if (ReplaceLimit == 0) {
-      ReplaceLimit = Context->Dsdt->Length;
-    }
-
+    && (Patch->OemTableId == 0 || Context->Dsdt->OemTableId == Patch->OemTableId)
+    && AcpiGetPatchArea (Context, (EFI_ACPI_COMMON_HEADER *) Context->Dsdt, Patch, &ReplaceData, &ReplaceLimit)) {
     ReplaceCount = ApplyPatch (
       Patch->Find,
       Patch->Mask,
       Patch->Size,
       Patch->Replace,
       Patch->ReplaceMask,
-      (UINT8 *) Context->Dsdt,
+      ReplaceData,
       ReplaceLimit,
       Patch->Count,
       Patch->Skip
@@ -932,6 +1017,8 @@ AcpiApplyPatch (
       ));
 
     if (ReplaceCount > 0) {
+      AcpiRefreshNameIndex (Context, (EFI_ACPI_COMMON_HEADER *) Context->Dsdt);
+
       Context->Dsdt->Checksum = 0;
       Context->Dsdt->Checksum = CalculateCheckSum8 (
         (UINT8 *) Context->Dsdt,
@@ -960,9 +1047,8 @@ AcpiApplyPatch (
         continue;
       }
 
-      ReplaceLimit = Patch->Limit;
-      if (ReplaceLimit == 0) {
-        ReplaceLimit = Context->Tables[Index]->Length;
+      if (!AcpiGetPatchArea (Context, Context->Tables[Index], Patch, &ReplaceData, &ReplaceLimit)) {
+        continue;
       }
 
       ReplaceCount = ApplyPatch (
@@ -971,7 +1057,7 @@ AcpiApplyPatch (
         Patch->Size,
         Patch->Replace,
         Patch->ReplaceMask,
-        (UINT8 *) Context->Tables[Index],
+        ReplaceData,
         ReplaceLimit,
         Patch->Count,
         Patch->Skip
@@ -989,6 +1075,10 @@ AcpiApplyPatch (
         Patch->Count
         ));
 
+      if (ReplaceCount > 0) {
+        AcpiRefreshNameIndex (Context, Context->Tables[Index]);
+      }
+
       if (ReplaceCount > 0 && Context->Tables[Index]->Length >= sizeof (EFI_ACPI_DESCRIPTION_HEADER)) {
         ((EFI_ACPI_DESCRIPTION_HEADER *)Context->Tables[Index])->Checksum = 0;
         ((EFI_ACPI_DESCRIPTION_HEADER *)Context->Tables[Index])->Checksum = CalculateCheckSum8 (
@@ -1008,6 +1098,261 @@ AcpiApplyPatch (
   return EFI_SUCCESS;
 }
 
+/**
+  Build a bitmap of all adjacent byte pairs present in the table.
+
+  @param[in]  Data     Table data.
+  @param[in]  Size     Table size.
+  @param[out] PairMap  Pair bitmap of ACPI_PAIR_MAP_SIZE bytes.
+**/
+STATIC
+VOID
+AcpiBuildPairMap (
+  IN  CONST UINT8  *Data,
+  IN  UINT32       Size,
+  OUT UINT8        *PairMap
+  )
+{
+  UINT32  Index;
+  UINT32  Pair;
+
+  ZeroMem (PairMap, ACPI_PAIR_MAP_SIZE);
+
+  for (Index = 1; Index < Size; ++Index) {
+    Pair = ((UINT32) Data[Index - 1] << 8U) | Data[Index];
+    PairMap[Pair >> 3U] |= (UINT8) (1U << (Pair & 7U));
+  }
+}
+
+/**
+  Check whether the patch may match the table with the given pair bitmap.
+  Only byte pairs not affected by the mask are considered.
+
+  @param[in] PairMap  Pair bitmap from AcpiBuildPairMap.
+  @param[in] Patch    ACPI patch.
+
+  @retval FALSE when the patch definitely does not match.
+**/
+STATIC
+BOOLEAN
+AcpiMayMatchPatch (
+  IN CONST UINT8          *PairMap,
+  IN CONST OC_ACPI_PATCH  *Patch
+  )
+{
+  UINT32  Index;
+  UINT32  Pair;
+
+  for (Index = 1; Index < Patch->Size; ++Index) {
+    if (Patch->Mask != NULL
+      && (Patch->Mask[Index - 1] != 0xFF || Patch->Mask[Index] != 0xFF)) {
+      continue;
+    }
+
+    Pair = ((UINT32) Patch->Find[Index - 1] << 8U) | Patch->Find[Index];
+    if ((PairMap[Pair >> 3U] & (1U << (Pair & 7U))) == 0) {
+      return FALSE;
+    }
+  }
+
+  return TRUE;
+}
+
+/**
+  Apply all matching patches to one table in their original order.
+
+  @param[in,out] Context     ACPI library context.
+  @param[in,out] Table       ACPI table.
+  @param[in]     OemTableId  ACPI table OEM ID or 0.
+  @param[in]     Patches     ACPI patches.
+  @param[in]     PatchCount  Number of ACPI patches.
+  @param[in,out] PairMap     Scratch buffer of ACPI_PAIR_MAP_SIZE bytes.
+
+  @retval total number of replacements.
+**/
+STATIC
+UINT32
+AcpiApplyPatchesToTable (
+  IN OUT OC_ACPI_CONTEXT         *Context,
+  IN OUT EFI_ACPI_COMMON_HEADER  *Table,
+  IN     UINT64                  OemTableId,
+  IN     CONST OC_ACPI_PATCH     *Patches,
+  IN     UINT32                  PatchCount,
+  IN OUT UINT8                   *PairMap
+  )
+{
+  UINT32               Index;
+  CONST OC_ACPI_PATCH  *Patch;
+  UINT32               ReplaceCount;
+  UINT32               ReplaceLimit;
+  UINT8                *ReplaceData;
+  UINT32               TotalCount;
+  BOOLEAN              PairMapValid;
+  BOOLEAN              NamesValid;
+
+  TotalCount   = 0;
+  PairMapValid = FALSE;
+  NamesValid   = TRUE;
+
+  for (Index = 0; Index < PatchCount; ++Index) {
+    Patch = &Patches[Index];
+
+    if ((Patch->TableSignature != 0 && Table->Signature != Patch->TableSignature)
+      || (Patch->TableLength != 0 && Table->Length != Patch->TableLength)
+      || (Patch->OemTableId != 0 && OemTableId != Patch->OemTableId)) {
+      continue;
+    }
+
+    //
+    // Filter out patches not matching the table with a single scan shared by all
+    // patches. The bitmap is rebuilt after a replacement as the table changed.
+    //
+    if (!PairMapValid) {
+      AcpiBuildPairMap ((CONST UINT8 *) Table, Table->Length, PairMap);
+      PairMapValid = TRUE;
+    }
+
+    if (!AcpiMayMatchPatch (PairMap, Patch)) {
+      continue;
+    }
+
+    //
+    // Names of the table are refreshed only when a patch needs them,
+    // so consecutive replacements cost a single table scan.
+    //
+    if (!NamesValid && Patch->Base != NULL && Patch->Base[0] != '\0') {
+      AcpiRefreshNameIndex (Context, Table);
+      NamesValid = TRUE;
+    }
+
+    if (!AcpiGetPatchArea (Context, Table, Patch, &ReplaceData, &ReplaceLimit)) {
+      continue;
+    }
+
+    ReplaceCount = ApplyPatch (
+      Patch->Find,
+      Patch->Mask,
+      Patch->Size,
+      Patch->Replace,
+      Patch->ReplaceMask,
+      ReplaceData,
+      ReplaceLimit,
+      Patch->Count,
+      Patch->Skip
+      );
+
+    DEBUG ((
+      ReplaceCount > 0 ? DEBUG_INFO : DEBUG_BULK_INFO,
+      "OCA: Patching %08x (%016Lx, %u) with patch %u replaced %u of %u\n",
+      Table->Signature,
+      OemTableId,
+      Table->Length,
+      Index,
+      ReplaceCount,
+      Patch->Count
+      ));
+
+    if (ReplaceCount > 0) {
+      TotalCount  += ReplaceCount;
+      PairMapValid = FALSE;
+      NamesValid   = FALSE;
+    }
+  }
+
+  if (!NamesValid) {
+    AcpiRefreshNameIndex (Context, Table);
+  }
+
+  return TotalCount;
+}
+
+EFI_STATUS
+AcpiApplyPatches (
+  IN OUT OC_ACPI_CONTEXT  *Context,
+  IN     OC_ACPI_PATCH    *Patches,
+  IN     UINT32           PatchCount
+  )
+{
+  UINT32                       Index;
+  UINT8                        *PairMap;
+  UINT32                       ReplaceCount;
+  EFI_ACPI_DESCRIPTION_HEADER  *Header;
+
+  DEBUG ((DEBUG_INFO, "OCA: Applying %u ACPI patches\n", PatchCount));
+
+  if (PatchCount == 0) {
+    return EFI_SUCCESS;
+  }
+
+  PairMap = AllocatePool (ACPI_PAIR_MAP_SIZE);
+  if (PairMap == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  if (Context->Dsdt != NULL) {
+    ReplaceCount = AcpiApplyPatchesToTable (
+      Context,
+      (EFI_ACPI_COMMON_HEADER *) Context->Dsdt,
+      Context->Dsdt->OemTableId,
+      Patches,
+      PatchCount,
+      PairMap
+      );
+
+    if (ReplaceCount > 0) {
+      Context->Dsdt->Checksum = 0;
+      Context->Dsdt->Checksum = CalculateCheckSum8 (
+        (UINT8 *) Context->Dsdt,
+        Context->Dsdt->Length
+        );
+
+      DEBUG ((
+        DEBUG_INFO,
+        "OCA: Refreshed DSDT checksum to %02x after %u replacements\n",
+        Context->Dsdt->Checksum,
+        ReplaceCount
+        ));
+    }
+  }
+
+  for (Index = 0; Index < Context->NumberOfTables; ++Index) {
+    if (Context->Tables[Index]->Length >= sizeof (EFI_ACPI_DESCRIPTION_HEADER)) {
+      Header = (EFI_ACPI_DESCRIPTION_HEADER *) Context->Tables[Index];
+    } else {
+      Header = NULL;
+    }
+
+    ReplaceCount = AcpiApplyPatchesToTable (
+      Context,
+      Context->Tables[Index],
+      Header != NULL ? Header->OemTableId : 0,
+      Patches,
+      PatchCount,
+      PairMap
+      );
+
+    if (ReplaceCount > 0 && Header != NULL) {
+      Header->Checksum = 0;
+      Header->Checksum = CalculateCheckSum8 (
+        (UINT8 *) Header,
+        Header->Length
+        );
+
+      DEBUG ((
+        DEBUG_INFO,
+        "OCA: Refreshed %08x checksum to %02x after %u replacements\n",
+        Header->Signature,
+        Header->Checksum,
+        ReplaceCount
+        ));
+    }
+  }
+
+  FreePool (PairMap);
+
+  return EFI_SUCCESS;
+}
+
 EFI_STATUS
 AcpiLoadRegions (
   IN OUT OC_ACPI_CONTEXT  *Context
@@ -503,7 +503,11 @@ OcGetMemoryMap (
     }
 
     if (BootCompat->Settings.RebuildAppleMemoryMap) {
-      OcSortMemoryMap (*MemoryMapSize, MemoryMap, *DescriptorSize);
+      //
+      // Joining before the split leaves fewer descriptors to split,
+      // runtime descriptors joined after the split stay the same.
+      //
+      OcSortAndShrinkMemoryMap (MemoryMapSize, MemoryMap, *DescriptorSize);
 
       Status2 = OcSplitMemoryMapByAttributes (
         OriginalSize,
@@ -0,0 +1,114 @@
+/** @file
+  Copyright (C) 2020, vit9696. All rights reserved.
+
+  All rights reserved.
+
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+**/
+
+#include "OcApfsInternal.h"
+#include <Library/BaseLib.h>
+#include <Library/DebugLib.h>
+
+//
+// Number of independent lanes summed in parallel.
+//
+#define APFS_FLETCHER_LANES  4U
+
+UINT64
+InternalApfsFletcher64 (
+  IN CONST VOID  *Data,
+  IN UINTN       DataSize
+  )
+{
+  CONST UINT32  *Walker;
+  CONST UINT32  *WalkerEnd;
+  CONST UINT32  *LanesEnd;
+  UINT64        Sum1;
+  UINT64        Sum2;
+  UINT64        Lane1[APFS_FLETCHER_LANES];
+  UINT64        Lane2[APFS_FLETCHER_LANES];
+  UINT32        Index;
+  UINT32        Rem;
+
+  //
+  // For APFS we have the following guarantees (checked outside).
+  // - DataSize is always divisible by 4 (UINT32), the only potential exceptions
+  //   are multiples of block sizes of 1 and 2, which we do not support and filter out.
+  // - DataSize is always between 0x1000-8 and 0x10000-8, i.e. within UINT16.
+  //
+  ASSERT (DataSize >= APFS_NX_MINIMUM_BLOCK_SIZE - sizeof (UINT64));
+  ASSERT (DataSize <= APFS_NX_MAXIMUM_BLOCK_SIZE - sizeof (UINT64));
+  ASSERT (DataSize % sizeof (UINT32) == 0);
+
+  Walker     = Data;
+  WalkerEnd  = Walker + DataSize / sizeof (UINT32);
+  LanesEnd   = Walker + (DataSize / sizeof (UINT32)) / APFS_FLETCHER_LANES * APFS_FLETCHER_LANES;
+
+  for (Index = 0; Index < APFS_FLETCHER_LANES; ++Index) {
+    Lane1[Index] = 0;
+    Lane2[Index] = 0;
+  }
+
+  //
+  // The usual Fletcher-64 round (Sum1 += Value; Sum2 += Sum1) forms a serial
+  // dependency chain on Sum2. Instead run independent rounds over every lane,
+  // i.e. values with index I modulo APFS_FLETCHER_LANES. For N = M * LANES values
+  // the value at index I = T * LANES + K contributes N - I times to Sum2, while
+  // in its lane it contributes M - T times, so Sum2 = SUM (LANES * Lane2[K] - K * Lane1[K]).
+  //
+  // No overflows are possible, because each lane accumulates at most 0x1000
+  // values: Lane1 < 0xFFFFFFFF * 0x1000 and Lane2 < 0xFFFFFFFF * 0x1000 * 0x801.
+  //
+  while (Walker < LanesEnd) {
+    Lane1[0] += Walker[0];
+    Lane1[1] += Walker[1];
+    Lane1[2] += Walker[2];
+    Lane1[3] += Walker[3];
+    Lane2[0] += Lane1[0];
+    Lane2[1] += Lane1[1];
+    Lane2[2] += Lane1[2];
+    Lane2[3] += Lane1[3];
+    Walker   += APFS_FLETCHER_LANES;
+  }
+
+  Sum1 = 0;
+  Sum2 = 0;
+  for (Index = 0; Index < APFS_FLETCHER_LANES; ++Index) {
+    Sum1 += Lane1[Index];
+    Sum2 += APFS_FLETCHER_LANES * Lane2[Index] - Index * Lane1[Index];
+  }
+
+  //
+  // Do usual Fletcher-64 rounds without modulo for the remaining values.
+  // Sum1 never overflows, because 0xFFFFFFFF * (0x4000-2) < MAX_UINT64.
+  // Sum2 never overflows, because 0xFFFFFFFF * (0x4000-1) * 0x1FFF < MAX_UINT64.
+  //
+  while (Walker < WalkerEnd) {
+    Sum1 += *Walker;
+    Sum2 += Sum1;
+    ++Walker;
+  }
+
+  //
+  // Split Fletcher-64 halves.
+  // As per Chinese remainder theorem, perform the modulo now.
+  // No overflows also possible as seen from Sum1/Sum2 upper bounds above.
+  //
+
+  Sum2 += Sum1;
+  APFS_MOD_MAX_UINT32 (Sum2, &Rem);
+  Sum2  = ~Rem;
+
+  Sum1 += Sum2;
+  APFS_MOD_MAX_UINT32 (Sum1, &Rem);
+  Sum1  = ~Rem;
+
+  return (Sum1 << 32U) | Sum2;
+}
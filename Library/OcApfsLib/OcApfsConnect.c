@@ -29,6 +29,48 @@
 #include <Protocol/LoadedImage.h>
 #include <Protocol/SimpleFileSystem.h>
 
+/**
+  Device state during parallel connection.
+**/
+typedef struct {
+  //
+  // Block I/O handle.
+  //
+  EFI_HANDLE             Handle;
+  //
+  // Block I/O protocol.
+  //
+  EFI_BLOCK_IO_PROTOCOL  *BlockIo;
+  //
+  // Registered container or NULL.
+  //
+  APFS_PRIVATE_DATA      *PrivateData;
+  //
+  // Driver read from this container, NULL for duplicate versions.
+  //
+  VOID                   *DriverBuffer;
+  //
+  // Driver size.
+  //
+  UINTN                  DriverSize;
+  //
+  // Driver version.
+  //
+  UINT64                 DriverVersion;
+  //
+  // Driver date.
+  //
+  UINT32                 DriverDate;
+  //
+  // Container should be connected to the started driver.
+  //
+  BOOLEAN                CanConnect;
+  //
+  // Device could not be read in parallel and needs normal connection.
+  //
+  BOOLEAN                Synchronous;
+} APFS_PARALLEL_DEVICE;
+
 LIST_ENTRY               mApfsPrivateDataList = INITIALIZE_LIST_HEAD_VARIABLE (mApfsPrivateDataList);
 STATIC UINT64            mApfsMinimalVersion = OC_APFS_VERSION_DEFAULT;
 STATIC UINT32            mApfsMinimalDate    = OC_APFS_DATE_DEFAULT;
@@ -76,11 +118,13 @@ ApfsCheckOpenCoreScanPolicy (
 }
 
 STATIC
-EFI_STATUS
-ApfsVerifyDriverVersion (
-  IN APFS_PRIVATE_DATA  *PrivateData,
-  IN VOID               *DriverBuffer,
-  IN UINTN              DriverSize
+VOID
+ApfsGetDriverVersion (
+  IN  APFS_PRIVATE_DATA  *PrivateData,
+  IN  VOID               *DriverBuffer,
+  IN  UINTN              DriverSize,
+  OUT UINT64             *Version,
+  OUT UINT32             *Date
   )
 {
   EFI_STATUS            Status;
@@ -88,7 +132,6 @@ ApfsVerifyDriverVersion (
   UINT64                RealVersion;
   UINT32                RealDate;
   UINTN                 Index;
-  BOOLEAN               HasLegitVersion;
 
   Status = InternalApfsGetDriverVersion (
     DriverBuffer,
@@ -152,6 +195,30 @@ ApfsVerifyDriverVersion (
     }
   }
 
+  *Version = RealVersion;
+  *Date    = RealDate;
+}
+
+STATIC
+EFI_STATUS
+ApfsVerifyDriverVersion (
+  IN APFS_PRIVATE_DATA  *PrivateData,
+  IN VOID               *DriverBuffer,
+  IN UINTN              DriverSize
+  )
+{
+  UINT64                RealVersion;
+  UINT32                RealDate;
+  BOOLEAN               HasLegitVersion;
+
+  ApfsGetDriverVersion (
+    PrivateData,
+    DriverBuffer,
+    DriverSize,
+    &RealVersion,
+    &RealDate
+    );
+
   HasLegitVersion = (mApfsMinimalVersion == 0 || mApfsMinimalVersion <= RealVersion)
     && (mApfsMinimalDate == 0 || mApfsMinimalDate <= RealDate);
 
@@ -202,6 +269,18 @@ ApfsRegisterPartition (
   PrivateData->EfiJumpStart  = SuperBlock->EfiJumpStart;
   InternalApfsInitFusionData (SuperBlock, PrivateData);
 
+  //
+  // Block I/O 2 is only used for parallel reads and is optional.
+  //
+  Status = gBS->HandleProtocol (
+    Handle,
+    &gEfiBlockIo2ProtocolGuid,
+    (VOID **) &PrivateData->BlockIo2
+    );
+  if (EFI_ERROR (Status)) {
+    PrivateData->BlockIo2 = NULL;
+  }
+
   //
   // Install boot record information.
   // This guarantees us that we never register twice.
@@ -340,7 +419,8 @@ STATIC
 EFI_STATUS
 ApfsConnectDevice (
   IN EFI_HANDLE             Handle,
-  IN EFI_BLOCK_IO_PROTOCOL  *BlockIo
+  IN EFI_BLOCK_IO_PROTOCOL  *BlockIo,
+  IN BOOLEAN                DriverStarted
   )
 {
   EFI_STATUS           Status;
@@ -376,6 +456,14 @@ ApfsConnectDevice (
     return EFI_NOT_READY;
   }
 
+  //
+  // Reuse the driver already started for other containers.
+  //
+  if (DriverStarted) {
+    gBS->ConnectController (Handle, NULL, NULL, TRUE);
+    return EFI_SUCCESS;
+  }
+
   Status = InternalApfsReadDriver (PrivateData, &DriverSize, &DriverBuffer);
   if (EFI_ERROR (Status)) {
     return Status;
@@ -417,9 +505,11 @@ OcApfsConfigure (
   mIgnoreVerbose      = IgnoreVerbose;
 }
 
+STATIC
 EFI_STATUS
-OcApfsConnectDevice (
-  IN EFI_HANDLE  Handle
+ApfsCheckDevice (
+  IN  EFI_HANDLE             Handle,
+  OUT EFI_BLOCK_IO_PROTOCOL  **BlockIoPtr
   )
 {
   EFI_STATUS             Status;
@@ -500,8 +590,334 @@ OcApfsConnectDevice (
     return EFI_UNSUPPORTED;
   }
 
+  *BlockIoPtr = BlockIo;
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+OcApfsConnectDevice (
+  IN EFI_HANDLE  Handle
+  )
+{
+  EFI_STATUS             Status;
+  EFI_BLOCK_IO_PROTOCOL  *BlockIo;
+
+  Status = ApfsCheckDevice (Handle, &BlockIo);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
   //
   // This is possibly APFS, try connecting.
   //
-  return ApfsConnectDevice (Handle, BlockIo);
+  return ApfsConnectDevice (Handle, BlockIo, FALSE);
+}
+
+EFI_STATUS
+InternalApfsConnectDevicesParallel (
+  IN EFI_HANDLE  *Handles,
+  IN UINTN       HandleCount
+  )
+{
+  EFI_STATUS             Status;
+  EFI_STATUS             Status2;
+  APFS_PARALLEL_DEVICE   *Devices;
+  APFS_PARALLEL_DEVICE   *Device;
+  APFS_PARALLEL_DEVICE   *Newest;
+  APFS_READ_REQUEST      *SuperBlockRequests;
+  APFS_READ_REQUEST      *JumpStartRequests;
+  APFS_READ_REQUEST      *Request;
+  EFI_BLOCK_IO_PROTOCOL  *BlockIo;
+  APFS_PRIVATE_DATA      *PrivateData;
+  BOOLEAN                SuperBlocksRead;
+  BOOLEAN                JumpStartsRead;
+  UINTN                  DeviceCount;
+  UINTN                  Index;
+  UINTN                  Index2;
+
+  Devices            = AllocateZeroPool (HandleCount * sizeof (*Devices));
+  SuperBlockRequests = AllocateZeroPool (HandleCount * sizeof (*SuperBlockRequests));
+  JumpStartRequests  = AllocateZeroPool (HandleCount * sizeof (*JumpStartRequests));
+  if (Devices == NULL || SuperBlockRequests == NULL || JumpStartRequests == NULL) {
+    if (Devices != NULL) {
+      FreePool (Devices);
+    }
+    if (SuperBlockRequests != NULL) {
+      FreePool (SuperBlockRequests);
+    }
+    if (JumpStartRequests != NULL) {
+      FreePool (JumpStartRequests);
+    }
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  //
+  // Issue super block reads for all candidate devices at once.
+  //
+  DeviceCount = 0;
+  for (Index = 0; Index < HandleCount; ++Index) {
+    Status = ApfsCheckDevice (Handles[Index], &BlockIo);
+    if (EFI_ERROR (Status)) {
+      continue;
+    }
+
+    Device  = &Devices[DeviceCount];
+    Request = &SuperBlockRequests[DeviceCount];
+    ++DeviceCount;
+
+    Device->Handle  = Handles[Index];
+    Device->BlockIo = BlockIo;
+
+    Request->BlockIo = BlockIo;
+    Request->Size    = ALIGN_VALUE (APFS_NX_MINIMUM_BLOCK_SIZE, BlockIo->Media->BlockSize);
+    Request->Buffer  = AllocateZeroPool (Request->Size);
+    if (Request->Buffer == NULL) {
+      Device->Synchronous = TRUE;
+      continue;
+    }
+
+    Status = gBS->HandleProtocol (
+      Device->Handle,
+      &gEfiBlockIo2ProtocolGuid,
+      (VOID **) &Request->BlockIo2
+      );
+    if (EFI_ERROR (Status)) {
+      Request->BlockIo2 = NULL;
+    }
+
+    InternalApfsStartRead (Request);
+  }
+
+  SuperBlocksRead = InternalApfsWaitReads (SuperBlockRequests, DeviceCount);
+
+  //
+  // Register all containers before loading any driver,
+  // so that Fusion pairs are matched regardless of handle order.
+  //
+  for (Index = 0; Index < DeviceCount; ++Index) {
+    Device  = &Devices[Index];
+    Request = &SuperBlockRequests[Index];
+
+    if (Request->Buffer == NULL) {
+      continue;
+    }
+
+    //
+    // Reads in progress own their buffers, retry them synchronously.
+    //
+    if (Request->Status == EFI_NOT_READY) {
+      Device->Synchronous = TRUE;
+      continue;
+    }
+
+    Status = Request->Status;
+    if (!EFI_ERROR (Status)) {
+      Status = InternalApfsVerifySuperBlock (Device->BlockIo, Request->Buffer, Request->Size);
+    }
+
+    if (!EFI_ERROR (Status)) {
+      DEBUG ((
+        DEBUG_INFO,
+        "OCJS: Got APFS super block for %g\n",
+        &((APFS_NX_SUPERBLOCK *) Request->Buffer)->Uuid
+        ));
+
+      Status = ApfsRegisterPartition (
+        Device->Handle,
+        Device->BlockIo,
+        Request->Buffer,
+        &Device->PrivateData
+        );
+      if (EFI_ERROR (Status)) {
+        Device->PrivateData = NULL;
+      }
+    } else if (Status == EFI_BUFFER_TOO_SMALL
+      || (Request->BlockIo2 != NULL && Status != EFI_UNSUPPORTED)) {
+      //
+      // Retry synchronously with larger APFS block size or on Block I/O 2 failure.
+      //
+      Device->Synchronous = TRUE;
+    }
+
+    FreePool (Request->Buffer);
+    Request->Buffer = NULL;
+  }
+
+  //
+  // Issue JumpStart reads for all containers able to load drivers.
+  // Fusion pairs share their driver, so only the master partition reads it.
+  //
+  for (Index = 0; Index < DeviceCount; ++Index) {
+    PrivateData = Devices[Index].PrivateData;
+    Request     = &JumpStartRequests[Index];
+
+    if (PrivateData == NULL
+      || !PrivateData->CanLoadDriver
+      || (PrivateData->IsFusion && !PrivateData->IsFusionMaster)) {
+      continue;
+    }
+
+    Devices[Index].CanConnect = TRUE;
+
+    if (PrivateData->EfiJumpStart == 0) {
+      DEBUG ((DEBUG_INFO, "OCJS: Missing JumpStart for %g\n", &PrivateData->LocationInfo.ContainerUuid));
+      continue;
+    }
+
+    Request->Buffer = AllocateZeroPool (PrivateData->ApfsBlockSize);
+    if (Request->Buffer == NULL) {
+      continue;
+    }
+
+    InternalApfsInitBlockRead (PrivateData, PrivateData->EfiJumpStart, Request->Buffer, Request);
+    InternalApfsStartRead (Request);
+  }
+
+  JumpStartsRead = InternalApfsWaitReads (JumpStartRequests, DeviceCount);
+
+  //
+  // Read the drivers, keeping only one instance of every version.
+  //
+  for (Index = 0; Index < DeviceCount; ++Index) {
+    Device      = &Devices[Index];
+    PrivateData = Device->PrivateData;
+    Request     = &JumpStartRequests[Index];
+
+    if (Request->Buffer == NULL) {
+      continue;
+    }
+
+    if (Request->Status == EFI_NOT_READY || EFI_ERROR (Request->Status)) {
+      DEBUG ((
+        DEBUG_INFO,
+        "OCJS: Retrying JumpStart read for %g - %r\n",
+        &PrivateData->LocationInfo.ContainerUuid,
+        Request->Status
+        ));
+
+      if (Request->Status != EFI_NOT_READY) {
+        FreePool (Request->Buffer);
+      }
+      Request->Buffer = NULL;
+
+      Status = InternalApfsReadDriver (PrivateData, &Device->DriverSize, &Device->DriverBuffer);
+    } else {
+      Status = InternalApfsVerifyJumpStart (PrivateData, Request->Buffer);
+      if (!EFI_ERROR (Status)) {
+        Status = InternalApfsReadJumpStartDriver (
+          PrivateData,
+          Request->Buffer,
+          &Device->DriverSize,
+          &Device->DriverBuffer
+          );
+      }
+
+      FreePool (Request->Buffer);
+      Request->Buffer = NULL;
+    }
+
+    if (EFI_ERROR (Status)) {
+      Device->DriverBuffer = NULL;
+      continue;
+    }
+
+    ApfsGetDriverVersion (
+      PrivateData,
+      Device->DriverBuffer,
+      Device->DriverSize,
+      &Device->DriverVersion,
+      &Device->DriverDate
+      );
+
+    for (Index2 = 0; Index2 < Index; ++Index2) {
+      if (Devices[Index2].DriverBuffer != NULL
+        && Devices[Index2].DriverVersion == Device->DriverVersion
+        && Devices[Index2].DriverDate == Device->DriverDate) {
+        DEBUG ((
+          DEBUG_INFO,
+          "OCJS: APFS driver %Lu/%u for %g is a duplicate\n",
+          Device->DriverVersion,
+          Device->DriverDate,
+          &PrivateData->LocationInfo.ContainerUuid
+          ));
+        FreePool (Device->DriverBuffer);
+        Device->DriverBuffer = NULL;
+        break;
+      }
+    }
+  }
+
+  //
+  // Start the newest driver, falling back to older versions when it cannot
+  // be verified. The started driver is then connected to all containers.
+  //
+  while (TRUE) {
+    Newest = NULL;
+    for (Index = 0; Index < DeviceCount; ++Index) {
+      Device = &Devices[Index];
+      if (Device->DriverBuffer != NULL
+        && (Newest == NULL
+          || Device->DriverVersion > Newest->DriverVersion
+          || (Device->DriverVersion == Newest->DriverVersion && Device->DriverDate > Newest->DriverDate))) {
+        Newest = Device;
+      }
+    }
+
+    if (Newest == NULL) {
+      break;
+    }
+
+    Status = ApfsStartDriver (Newest->PrivateData, Newest->DriverBuffer, Newest->DriverSize);
+    FreePool (Newest->DriverBuffer);
+    Newest->DriverBuffer = NULL;
+
+    if (!EFI_ERROR (Status)) {
+      break;
+    }
+  }
+
+  Status = EFI_NOT_FOUND;
+
+  for (Index = 0; Index < DeviceCount; ++Index) {
+    Device = &Devices[Index];
+
+    if (Device->DriverBuffer != NULL) {
+      FreePool (Device->DriverBuffer);
+    }
+
+    if (Newest != NULL && Device->CanConnect) {
+      if (Device != Newest) {
+        gBS->ConnectController (Device->Handle, NULL, NULL, TRUE);
+      }
+      Status = EFI_SUCCESS;
+    }
+
+    if (Device->Synchronous) {
+      Status2 = ApfsConnectDevice (Device->Handle, Device->BlockIo, Newest != NULL);
+      if (!EFI_ERROR (Status2)) {
+        Status = Status2;
+      }
+    }
+  }
+
+  DEBUG ((
+    DEBUG_INFO,
+    "OCJS: Parallel connection of %u devices done - %r\n",
+    (UINT32) DeviceCount,
+    Status
+    ));
+
+  //
+  // Requests still in progress may write to their tokens at any time,
+  // so they are intentionally not released.
+  //
+  if (SuperBlocksRead) {
+    FreePool (SuperBlockRequests);
+  }
+  if (JumpStartsRead) {
+    FreePool (JumpStartRequests);
+  }
+  FreePool (Devices);
+
+  return Status;
 }
@@ -17,6 +17,7 @@
 
 #include <IndustryStandard/Apfs.h>
 #include <Protocol/BlockIo.h>
+#include <Protocol/BlockIo2.h>
 #include <Protocol/ApfsEfiBootRecordInfo.h>
 
 #define APFS_PRIVATE_DATA_SIGNATURE  SIGNATURE_32 ('A', 'F', 'J', 'S')
@@ -55,6 +56,10 @@ typedef struct APFS_PRIVATE_DATA_ {
   //
   EFI_BLOCK_IO_PROTOCOL               *BlockIo;
   //
+  // Block I/O 2 protocol, optional.
+  //
+  EFI_BLOCK_IO2_PROTOCOL              *BlockIo2;
+  //
   // APFS block size, a multiple of Block I/O block size.
   //
   UINT32                              ApfsBlockSize;
@@ -97,6 +102,64 @@ typedef struct APFS_PRIVATE_DATA_ {
 **/
 extern LIST_ENTRY  mApfsPrivateDataList;
 
+/**
+  Block read, performed asynchronously when Block I/O 2 is available.
+**/
+typedef struct {
+  //
+  // Block I/O 2 token, event is set while the read is in progress.
+  //
+  EFI_BLOCK_IO2_TOKEN                 Token;
+  //
+  // Block I/O protocol.
+  //
+  EFI_BLOCK_IO_PROTOCOL               *BlockIo;
+  //
+  // Block I/O 2 protocol, optional.
+  //
+  EFI_BLOCK_IO2_PROTOCOL              *BlockIo2;
+  //
+  // Starting LBA.
+  //
+  EFI_LBA                             Lba;
+  //
+  // Read size in bytes.
+  //
+  UINTN                               Size;
+  //
+  // Destination buffer.
+  //
+  VOID                                *Buffer;
+  //
+  // Read status, EFI_NOT_READY while in progress.
+  //
+  EFI_STATUS                          Status;
+} APFS_READ_REQUEST;
+
+UINT64
+InternalApfsFletcher64 (
+  IN CONST VOID            *Data,
+  IN UINTN                 DataSize
+  );
+
+/**
+  Verify APFS container super block.
+
+  @param[in]  BlockIo     Block I/O protocol the super block was read from.
+  @param[in]  SuperBlock  Super block data.
+  @param[in]  ReadSize    Amount of super block data read.
+
+  @retval EFI_SUCCESS           Super block is valid.
+  @retval EFI_BUFFER_TOO_SMALL  Super block must be read with its own block size.
+  @retval EFI_UNSUPPORTED       This is not an APFS container.
+**/
+EFI_STATUS
+InternalApfsVerifySuperBlock (
+  IN EFI_BLOCK_IO_PROTOCOL  *BlockIo,
+  IN APFS_NX_SUPERBLOCK     *SuperBlock,
+  IN UINTN                  ReadSize
+  );
+
 EFI_STATUS
 InternalApfsReadSuperBlock (
   IN  EFI_BLOCK_IO_PROTOCOL  *BlockIo,
@@ -110,6 +173,71 @@ InternalApfsReadDriver (
   OUT VOID                 **DriverBuffer
   );
 
+/**
+  Verify JumpStart block read for the container.
+
+  @param[in]  PrivateData  Container private data.
+  @param[in]  JumpStart    JumpStart of ApfsBlockSize bytes.
+
+  @retval EFI_SUCCESS when JumpStart can be used for driver reading.
+**/
+EFI_STATUS
+InternalApfsVerifyJumpStart (
+  IN APFS_PRIVATE_DATA      *PrivateData,
+  IN APFS_NX_EFI_JUMPSTART  *JumpStart
+  );
+
+EFI_STATUS
+InternalApfsReadJumpStartDriver (
+  IN  APFS_PRIVATE_DATA      *PrivateData,
+  IN  APFS_NX_EFI_JUMPSTART  *JumpStart,
+  OUT UINTN                  *DriverSize,
+  OUT VOID                   **DriverBuffer
+  );
+
+/**
+  Prepare read of one APFS block of the container.
+
+  @param[in]  PrivateData  Container private data.
+  @param[in]  Block        APFS block number.
+  @param[in]  Buffer       Buffer of ApfsBlockSize bytes.
+  @param[out] Request      Read request.
+**/
+VOID
+InternalApfsInitBlockRead (
+  IN  APFS_PRIVATE_DATA  *PrivateData,
+  IN  UINT64             Block,
+  IN  VOID               *Buffer,
+  OUT APFS_READ_REQUEST  *Request
+  );
+
+/**
+  Start the read, falling back to synchronous Block I/O when
+  Block I/O 2 is unavailable or refuses the request.
+
+  @param[in,out]  Request  Read request.
+**/
+VOID
+InternalApfsStartRead (
+  IN OUT APFS_READ_REQUEST  *Request
+  );
+
+/**
+  Wait for started reads to complete.
+  Reads still in progress after the timeout keep EFI_NOT_READY status,
+  and their buffers must not be freed as they may be written at any time.
+
+  @param[in,out]  Requests      Read requests.
+  @param[in]      RequestCount  Number of read requests.
+
+  @retval TRUE when all reads completed.
+**/
+BOOLEAN
+InternalApfsWaitReads (
+  IN OUT APFS_READ_REQUEST  *Requests,
+  IN     UINTN              RequestCount
+  );
+
 EFI_STATUS
 InternalApfsGetDriverVersion (
   IN  VOID                 *DriverBuffer,
@@ -130,4 +258,19 @@ InternalApfsTranslateBlock (
   OUT EFI_LBA              *Lba
   );
 
+/**
+  Connect APFS driver to all present devices reading their containers
+  in parallel and loading the newest driver once.
+
+  @param[in] Handles      Block I/O handles.
+  @param[in] HandleCount  Number of handles.
+
+  @retval EFI_SUCCESS if at least one device was connected.
+**/
+EFI_STATUS
+InternalApfsConnectDevicesParallel (
+  IN EFI_HANDLE  *Handles,
+  IN UINTN       HandleCount
+  );
+
 #endif // OC_APFS_INTERNAL_H
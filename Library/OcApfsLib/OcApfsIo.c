@@ -20,69 +20,17 @@
 #include <Library/MemoryAllocationLib.h>
 #include <Library/OcApfsLib.h>
 #include <Library/OcGuardLib.h>
+#include <Library/UefiBootServicesTableLib.h>
 
-STATIC
-UINT64
-ApfsFletcher64 (
-  VOID    *Data,
-  UINTN   DataSize
-  )
-{
-  UINT32        *Walker;
-  UINT32        *WalkerEnd;
-  UINT64        Sum1;
-  UINT64        Sum2;
-  UINT32        Rem;
-
-  //
-  // For APFS we have the following guarantees (checked outside).
-  // - DataSize is always divisible by 4 (UINT32), the only potential exceptions
-  //   are multiples of block sizes of 1 and 2, which we do not support and filter out.
-  // - DataSize is always between 0x1000-8 and 0x10000-8, i.e. within UINT16.
-  //
-  ASSERT (DataSize >= APFS_NX_MINIMUM_BLOCK_SIZE - sizeof (UINT64));
-  ASSERT (DataSize <= APFS_NX_MAXIMUM_BLOCK_SIZE - sizeof (UINT64));
-  ASSERT (DataSize % sizeof (UINT32) == 0);
-
-  Sum1 = 0;
-  Sum2 = 0;
+//
+// Interval between read completion checks in microseconds.
+//
+#define APFS_READ_POLL_INTERVAL  100U
 
-  Walker     = Data;
-  WalkerEnd  = Walker + DataSize / sizeof (UINT32);
-
-  //
-  // Do usual Fletcher-64 rounds without modulo due to impossible overflow.
-  //
-  while (Walker < WalkerEnd) {
-    //
-    // Sum1 never overflows, because 0xFFFFFFFF * (0x10000-8) < MAX_UINT64.
-    // This is just a normal sum of data values.
-    //
-    Sum1 += *Walker;
-    //
-    // Sum2 never overflows, because 0xFFFFFFFF * (0x4000-1) * 0x1FFF < MAX_UINT64.
-    // This is just a normal arithmetical progression of sums.
-    //
-    Sum2 += Sum1;
-    ++Walker;
-  }
-
-  //
-  // Split Fletcher-64 halves.
-  // As per Chinese remainder theorem, perform the modulo now.
-  // No overflows also possible as seen from Sum1/Sum2 upper bounds above.
-  //
-
-  Sum2 += Sum1;
-  APFS_MOD_MAX_UINT32 (Sum2, &Rem);
-  Sum2  = ~Rem;
-
-  Sum1 += Sum2;
-  APFS_MOD_MAX_UINT32 (Sum1, &Rem);
-  Sum1  = ~Rem;
-
-  return (Sum1 << 32U) | Sum2;
-}
+//
+// Maximum time to wait for asynchronous reads in microseconds.
+//
+#define APFS_READ_TIMEOUT        5000000U
 
 STATIC
 BOOLEAN
@@ -95,7 +43,7 @@ ApfsBlockChecksumVerify (
 
   ASSERT (DataSize > sizeof (*Block));
 
-  NewChecksum = ApfsFletcher64 (
+  NewChecksum = InternalApfsFletcher64 (
     &Block->ObjectOid,
     DataSize - sizeof (Block->Checksum)
     );
@@ -108,6 +56,42 @@ ApfsBlockChecksumVerify (
   return FALSE;
 }
 
+EFI_STATUS
+InternalApfsVerifyJumpStart (
+  IN APFS_PRIVATE_DATA      *PrivateData,
+  IN APFS_NX_EFI_JUMPSTART  *JumpStart
+  )
+{
+  UINT32  MaxExtents;
+
+  //
+  // Jump start is expected to have JSDR magic.
+  // Version is not checked by ApfsJumpStart driver.
+  //
+  if (JumpStart->Magic != APFS_NX_EFI_JUMPSTART_MAGIC) {
+    DEBUG ((DEBUG_INFO, "OCJS: Unknown JSDR magic %08x, expected %08x\n", JumpStart->Magic, APFS_NX_EFI_JUMPSTART_MAGIC));
+    return EFI_UNSUPPORTED;
+  }
+
+  //
+  // Calculate and verify checksum.
+  //
+  if (!ApfsBlockChecksumVerify (&JumpStart->BlockHeader, PrivateData->ApfsBlockSize)) {
+    return EFI_UNSUPPORTED;
+  }
+
+  //
+  // Ensure that extent count does not overflow.
+  //
+  MaxExtents = (PrivateData->ApfsBlockSize - sizeof (*JumpStart)) / sizeof (JumpStart->RecordExtents[0]);
+  if (MaxExtents < JumpStart->NumExtents) {
+    DEBUG ((DEBUG_INFO, "OCJS: Invalid extent count %u / %u\n", JumpStart->NumExtents, MaxExtents));
+    return EFI_UNSUPPORTED;
+  }
+
+  return EFI_SUCCESS;
+}
+
 STATIC
 EFI_STATUS
 ApfsReadJumpStart (
@@ -119,7 +103,6 @@ ApfsReadJumpStart (
   APFS_NX_EFI_JUMPSTART  *JumpStart;
   EFI_BLOCK_IO_PROTOCOL  *BlockIo;
   EFI_LBA                Lba;
-  UINT32                 MaxExtents;
 
   //
   // No jump start driver, ignore.
@@ -168,32 +151,10 @@ ApfsReadJumpStart (
     return Status;
   }
 
-  //
-  // Jump start is expected to have JSDR magic.
-  // Version is not checked by ApfsJumpStart driver.
-  //
-  if (JumpStart->Magic != APFS_NX_EFI_JUMPSTART_MAGIC) {
-    DEBUG ((DEBUG_INFO, "OCJS: Unknown JSDR magic %08x, expected %08x\n", JumpStart->Magic, APFS_NX_EFI_JUMPSTART_MAGIC));
-    FreePool (JumpStart);
-    return EFI_UNSUPPORTED;
-  }
-
-  //
-  // Calculate and verify checksum.
-  //
-  if (!ApfsBlockChecksumVerify (&JumpStart->BlockHeader, PrivateData->ApfsBlockSize)) {
-    FreePool (JumpStart);
-    return EFI_UNSUPPORTED;
-  }
-
-  //
-  // Ensure that extent count does not overflow.
-  //
-  MaxExtents = (PrivateData->ApfsBlockSize - sizeof (*JumpStart)) / sizeof (JumpStart->RecordExtents[0]);
-  if (MaxExtents < JumpStart->NumExtents) {
-    DEBUG ((DEBUG_INFO, "OCJS: Invalid extent count %u / %u\n", JumpStart->NumExtents, MaxExtents));
+  Status = InternalApfsVerifyJumpStart (PrivateData, JumpStart);
+  if (EFI_ERROR (Status)) {
     FreePool (JumpStart);
-    return EFI_UNSUPPORTED;
+    return Status;
   }
 
   *JumpStartPtr = JumpStart;
@@ -279,6 +240,72 @@ ApfsReadDriver (
   return EFI_SUCCESS;
 }
 
+EFI_STATUS
+InternalApfsVerifySuperBlock (
+  IN EFI_BLOCK_IO_PROTOCOL  *BlockIo,
+  IN APFS_NX_SUPERBLOCK     *SuperBlock,
+  IN UINTN                  ReadSize
+  )
+{
+  DEBUG ((
+    DEBUG_VERBOSE,
+    "OCJS: Testing disk with %8X magic %u block\n",
+    SuperBlock->Magic,
+    SuperBlock->BlockSize
+    ));
+
+  //
+  // Super block is expected to have NXSB magic.
+  //
+  if (SuperBlock->Magic != APFS_NX_SIGNATURE) {
+    return EFI_UNSUPPORTED;
+  }
+
+  //
+  // Ensure APFS block size is:
+  // - A multiple of disk block size.
+  // - Divisible by UINT32 for fletcher checksum to work (e.g. when block size is 1 or 2).
+  // - Within minimum and maximum edges.
+  //
+  if (SuperBlock->BlockSize < BlockIo->Media->BlockSize
+    || (SuperBlock->BlockSize & (BlockIo->Media->BlockSize - 1)) != 0
+    || (SuperBlock->BlockSize & (sizeof (UINT32) - 1)) != 0
+    || SuperBlock->BlockSize < APFS_NX_MINIMUM_BLOCK_SIZE
+    || SuperBlock->BlockSize > APFS_NX_MAXIMUM_BLOCK_SIZE) {
+    return EFI_UNSUPPORTED;
+  }
+
+  //
+  // Check if we can calculate the checksum.
+  //
+  if (SuperBlock->BlockSize > ReadSize) {
+    return EFI_BUFFER_TOO_SMALL;
+  }
+
+  //
+  // Calculate and verify checksum.
+  //
+  if (!ApfsBlockChecksumVerify (&SuperBlock->BlockHeader, SuperBlock->BlockSize)) {
+    return EFI_UNSUPPORTED;
+  }
+
+  //
+  // Verify object type and flags.
+  // SubType being 0 comes from ApfsJumpStart and is not documented.
+  // ObjectOid being 1 comes from ApfsJumpStart and is not documented.
+  //
+  if (SuperBlock->BlockHeader.ObjectType != (APFS_OBJ_EPHEMERAL | APFS_OBJECT_TYPE_NX_SUPERBLOCK)
+    || SuperBlock->BlockHeader.ObjectSubType != 0
+    || SuperBlock->BlockHeader.ObjectOid != 1) {
+    return EFI_UNSUPPORTED;
+  }
+
+  //
+  // Super block is assumed to be legit.
+  //
+  return EFI_SUCCESS;
+}
+
 EFI_STATUS
 InternalApfsReadSuperBlock (
   IN  EFI_BLOCK_IO_PROTOCOL  *BlockIo,
@@ -324,65 +351,22 @@ InternalApfsReadSuperBlock (
       break;
     }
 
-    DEBUG ((
-      DEBUG_VERBOSE,
-      "OCJS: Testing disk with %8X magic %u block\n",
-      SuperBlock->Magic,
-      SuperBlock->BlockSize
-      ));
-
-    //
-    // Super block is expected to have NXSB magic.
-    //
-    if (SuperBlock->Magic != APFS_NX_SIGNATURE) {
-      break;
-    }
-
-    //
-    // Ensure APFS block size is:
-    // - A multiple of disk block size.
-    // - Divisible by UINT32 for fletcher checksum to work (e.g. when block size is 1 or 2).
-    // - Within minimum and maximum edges.
-    //
-    if (SuperBlock->BlockSize < BlockIo->Media->BlockSize
-      || (SuperBlock->BlockSize & (BlockIo->Media->BlockSize - 1)) != 0
-      || (SuperBlock->BlockSize & (sizeof (UINT32) - 1)) != 0
-      || SuperBlock->BlockSize < APFS_NX_MINIMUM_BLOCK_SIZE
-      || SuperBlock->BlockSize > APFS_NX_MAXIMUM_BLOCK_SIZE) {
-      break;
-    }
+    Status = InternalApfsVerifySuperBlock (BlockIo, SuperBlock, ReadSize);
 
     //
-    // Check if we can calculate the checksum and try again on failure.
+    // Try again with the real block size.
     //
-    if (SuperBlock->BlockSize > ReadSize) {
+    if (Status == EFI_BUFFER_TOO_SMALL) {
       ReadSize = SuperBlock->BlockSize;
       FreePool (SuperBlock);
       SuperBlock = NULL;
       continue;
     }
 
-    //
-    // Calculate and verify checksum.
-    //
-    if (!ApfsBlockChecksumVerify (&SuperBlock->BlockHeader, SuperBlock->BlockSize)) {
-      break;
-    }
-
-    //
-    // Verify object type and flags.
-    // SubType being 0 comes from ApfsJumpStart and is not documented.
-    // ObjectOid being 1 comes from ApfsJumpStart and is not documented.
-    //
-    if (SuperBlock->BlockHeader.ObjectType != (APFS_OBJ_EPHEMERAL | APFS_OBJECT_TYPE_NX_SUPERBLOCK)
-      || SuperBlock->BlockHeader.ObjectSubType != 0
-      || SuperBlock->BlockHeader.ObjectOid != 1) {
+    if (EFI_ERROR (Status)) {
       break;
     }
 
-    //
-    // Super block is assumed to be legit.
-    //
     *SuperBlockPtr = SuperBlock;
     return EFI_SUCCESS;
   }
@@ -420,7 +404,7 @@ InternalApfsReadDriver (
     return Status;
   }
 
-  Status = ApfsReadDriver (
+  Status = InternalApfsReadJumpStartDriver (
     PrivateData,
     JumpStart,
     DriverSize,
@@ -429,6 +413,26 @@ InternalApfsReadDriver (
 
   FreePool (JumpStart);
 
+  return Status;
+}
+
+EFI_STATUS
+InternalApfsReadJumpStartDriver (
+  IN  APFS_PRIVATE_DATA      *PrivateData,
+  IN  APFS_NX_EFI_JUMPSTART  *JumpStart,
+  OUT UINTN                  *DriverSize,
+  OUT VOID                   **DriverBuffer
+  )
+{
+  EFI_STATUS  Status;
+
+  Status = ApfsReadDriver (
+    PrivateData,
+    JumpStart,
+    DriverSize,
+    DriverBuffer
+    );
+
   if (EFI_ERROR (Status)) {
     DEBUG ((
       DEBUG_INFO,
@@ -442,6 +446,116 @@ InternalApfsReadDriver (
   return EFI_SUCCESS;
 }
 
+VOID
+InternalApfsInitBlockRead (
+  IN  APFS_PRIVATE_DATA  *PrivateData,
+  IN  UINT64             Block,
+  IN  VOID               *Buffer,
+  OUT APFS_READ_REQUEST  *Request
+  )
+{
+  ZeroMem (Request, sizeof (*Request));
+
+  Request->BlockIo  = InternalApfsTranslateBlock (PrivateData, Block, &Request->Lba);
+  Request->BlockIo2 = PrivateData->BlockIo2;
+  if (Request->BlockIo != PrivateData->BlockIo) {
+    Request->BlockIo2 = PrivateData->FusionSibling->BlockIo2;
+  }
+
+  Request->Size   = PrivateData->ApfsBlockSize;
+  Request->Buffer = Buffer;
+}
+
+VOID
+InternalApfsStartRead (
+  IN OUT APFS_READ_REQUEST  *Request
+  )
+{
+  EFI_STATUS  Status;
+
+  Request->Token.Event = NULL;
+
+  //
+  // Block I/O 2 may still complete the request before returning,
+  // this is handled by the event being already signaled.
+  //
+  if (Request->BlockIo2 != NULL) {
+    Status = gBS->CreateEvent (0, 0, NULL, NULL, &Request->Token.Event);
+    if (!EFI_ERROR (Status)) {
+      Status = Request->BlockIo2->ReadBlocksEx (
+        Request->BlockIo2,
+        Request->BlockIo2->Media->MediaId,
+        Request->Lba,
+        &Request->Token,
+        Request->Size,
+        Request->Buffer
+        );
+      if (!EFI_ERROR (Status)) {
+        Request->Status = EFI_NOT_READY;
+        return;
+      }
+
+      gBS->CloseEvent (Request->Token.Event);
+      Request->Token.Event = NULL;
+    }
+  }
+
+  Request->Status = Request->BlockIo->ReadBlocks (
+    Request->BlockIo,
+    Request->BlockIo->Media->MediaId,
+    Request->Lba,
+    Request->Size,
+    Request->Buffer
+    );
+}
+
+BOOLEAN
+InternalApfsWaitReads (
+  IN OUT APFS_READ_REQUEST  *Requests,
+  IN     UINTN              RequestCount
+  )
+{
+  UINTN   Index;
+  UINTN   Remaining;
+  UINT32  Elapsed;
+
+  Elapsed = 0;
+
+  while (TRUE) {
+    Remaining = 0;
+
+    for (Index = 0; Index < RequestCount; ++Index) {
+      if (Requests[Index].Token.Event == NULL) {
+        continue;
+      }
+
+      if (gBS->CheckEvent (Requests[Index].Token.Event) == EFI_SUCCESS) {
+        Requests[Index].Status = Requests[Index].Token.TransactionStatus;
+        gBS->CloseEvent (Requests[Index].Token.Event);
+        Requests[Index].Token.Event = NULL;
+      } else {
+        ++Remaining;
+      }
+    }
+
+    if (Remaining == 0 || Elapsed >= APFS_READ_TIMEOUT) {
+      break;
+    }
+
+    gBS->Stall (APFS_READ_POLL_INTERVAL);
+    Elapsed += APFS_READ_POLL_INTERVAL;
+  }
+
+  DEBUG ((
+    DEBUG_INFO,
+    "OCJS: Parallel reads done in %u us, %u pending\n",
+    Elapsed,
+    (UINT32) Remaining
+    ));
+
+  return Remaining == 0;
+}
+
 EFI_STATUS
 InternalApfsGetDriverVersion (
   IN  VOID                 *DriverBuffer,
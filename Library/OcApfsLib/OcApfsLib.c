@@ -15,6 +15,7 @@
 #include "OcApfsInternal.h"
 #include <Library/OcApfsLib.h>
 #include <Library/DebugLib.h>
+#include <Library/MemoryAllocationLib.h>
 #include <Library/UefiBootServicesTableLib.h>
 #include <Protocol/BlockIo.h>
 
@@ -83,7 +84,8 @@ ApfsMonitorNewPartitions (
 
 EFI_STATUS
 OcApfsConnectDevices (
-  IN BOOLEAN  Monitor
+  IN BOOLEAN  Monitor,
+  IN BOOLEAN  Parallel
   )
 {
   EFI_STATUS  Status;
@@ -109,6 +111,14 @@ OcApfsConnectDevices (
     );
 
   if (!EFI_ERROR (Status)) {
+    if (Parallel) {
+      Status = InternalApfsConnectDevicesParallel (HandleBuffer, HandleCount);
+      if (Status != EFI_OUT_OF_RESOURCES) {
+        FreePool (HandleBuffer);
+        return Status;
+      }
+    }
+
     Status = EFI_NOT_FOUND;
 
     for (Index = 0; Index < HandleCount; ++Index) {
@@ -119,6 +129,8 @@ OcApfsConnectDevices (
         Status = Status2;
       }
     }
+
+    FreePool (HandleBuffer);
   }
 
   return Status;
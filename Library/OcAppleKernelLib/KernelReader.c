@@ -123,6 +123,39 @@ ParseFatArchitecture (
   return 0;
 }
 
+typedef struct {
+  EFI_FILE_PROTOCOL  *File;
+  UINT32             Offset;
+} KERNEL_STREAM_CONTEXT;
+
+STATIC
+BOOLEAN
+ReadCompressedKernel (
+  IN  VOID    *Context,
+  IN  UINT32  Offset,
+  IN  UINT32  Size,
+  OUT UINT8   *Buffer
+  )
+{
+  EFI_STATUS             Status;
+  KERNEL_STREAM_CONTEXT  *Stream;
+  UINT32                 Position;
+
+  Stream = Context;
+
+  if (OcOverflowAddU32 (Stream->Offset, Offset, &Position)) {
+    return FALSE;
+  }
+
+  Status = GetFileData (Stream->File, Position, Size, Buffer);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_INFO, "OCAK: Comp kernel (%u bytes) cannot be read at %08X - %r\n", Size, Position, Status));
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
 STATIC
 UINT32
 ParseCompressedHeader (
@@ -133,15 +166,15 @@ ParseCompressedHeader (
   IN     UINT32             ReservedSize
   )
 {
-  EFI_STATUS        Status;
+  EFI_STATUS             Status;
 
-  UINT32            KernelSize;
-  MACH_COMP_HEADER  *CompHeader;
-  UINT8             *CompressedBuffer;
-  UINT32            CompressionType;
-  UINT32            CompressedSize;
-  UINT32            DecompressedSize;
-  UINT32            DecompressedHash;
+  UINT32                 KernelSize;
+  MACH_COMP_HEADER       *CompHeader;
+  KERNEL_STREAM_CONTEXT  Stream;
+  UINT32                 CompressionType;
+  UINT32                 CompressedSize;
+  UINT32                 DecompressedSize;
+  UINT32                 DecompressedHash;
 
   CompHeader       = (MACH_COMP_HEADER *)*Buffer;
   CompressionType  = CompHeader->Compression;
@@ -165,23 +198,16 @@ ParseCompressedHeader (
     return KernelSize;
   }
 
-  CompressedBuffer = AllocatePool (CompressedSize);
-  if (CompressedBuffer == NULL) {
-    DEBUG ((DEBUG_INFO, "OCAK: Comp kernel (%u bytes) cannot be allocated at %08X\n", CompressedSize, Offset));
-    return KernelSize;
-  }
-
-  Status = GetFileData (File, Offset + sizeof (MACH_COMP_HEADER), CompressedSize, CompressedBuffer);
-  if (EFI_ERROR (Status)) {
-    DEBUG ((DEBUG_INFO, "OCAK: Comp kernel (%u bytes) cannot be read at %08X\n", CompressedSize, Offset));
-    FreePool (CompressedBuffer);
-    return KernelSize;
-  }
+  //
+  // Decompress while reading, so that only a chunk of compressed data is in memory at a time.
+  //
+  Stream.File   = File;
+  Stream.Offset = Offset + sizeof (MACH_COMP_HEADER);
 
   if (CompressionType == MACH_COMPRESSED_BINARY_INVERT_LZVN) {
-    KernelSize = (UINT32)DecompressLZVN (*Buffer, DecompressedSize, CompressedBuffer, CompressedSize);
+    KernelSize = (UINT32)DecompressLZVNStream (*Buffer, DecompressedSize, CompressedSize, ReadCompressedKernel, &Stream);
   } else if (CompressionType == MACH_COMPRESSED_BINARY_INVERT_LZSS) {
-    KernelSize = (UINT32)DecompressLZSS (*Buffer, DecompressedSize, CompressedBuffer, CompressedSize);
+    KernelSize = (UINT32)DecompressLZSSStream (*Buffer, DecompressedSize, CompressedSize, ReadCompressedKernel, &Stream);
   }
 
   if (KernelSize != DecompressedSize) {
@@ -193,8 +219,6 @@ ParseCompressedHeader (
   //
   (VOID) DecompressedHash;
 
-  FreePool (CompressedBuffer);
-
   return KernelSize;
 }
 
@@ -0,0 +1,367 @@
+/** @file
+  Copyright (C) 2020, vit9696. All rights reserved.
+
+  All rights reserved.
+
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+**/
+
+#include "BootManagementInternal.h"
+
+#include <Guid/AppleApfsInfo.h>
+
+#include <Protocol/DevicePath.h>
+#include <Protocol/SimpleFileSystem.h>
+
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/DevicePathLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/OcDevicePathLib.h>
+#include <Library/OcFileLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+
+//
+// Boot entries discovered during previous scans (INTERNAL_BOOT_ENTRY_CACHE).
+// The cache lives as long as the picker and allows skipping bless and
+// recovery lookup when showing the picker again.
+//
+STATIC
+LIST_ENTRY
+mBootEntryCache = INITIALIZE_LIST_HEAD_VARIABLE (mBootEntryCache);
+
+/**
+  Obtain filesystem identity.
+
+  @param[in]  Handle    Filesystem handle.
+  @param[out] Identity  Filesystem identity.
+
+  @retval EFI_SUCCESS on success.
+**/
+STATIC
+EFI_STATUS
+GetFileSystemIdentity (
+  IN  EFI_HANDLE            Handle,
+  OUT INTERNAL_FS_IDENTITY  *Identity
+  )
+{
+  EFI_STATUS                       Status;
+  EFI_SIMPLE_FILE_SYSTEM_PROTOCOL  *SimpleFs;
+  EFI_FILE_PROTOCOL                *Root;
+  EFI_DEVICE_PATH_PROTOCOL         *DevicePath;
+  HARDDRIVE_DEVICE_PATH            *HardDrive;
+  APPLE_APFS_VOLUME_INFO           *VolumeInfo;
+
+  ZeroMem (Identity, sizeof (*Identity));
+
+  Status = gBS->HandleProtocol (
+    Handle,
+    &gEfiSimpleFileSystemProtocolGuid,
+    (VOID **) &SimpleFs
+    );
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Status = SimpleFs->OpenVolume (SimpleFs, &Root);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Status = GetFileModifcationTime (Root, &Identity->ModificationTime);
+  if (EFI_ERROR (Status)) {
+    Root->Close (Root);
+    return Status;
+  }
+
+  //
+  // Padding may contain garbage, and we compare the whole structure.
+  //
+  Identity->ModificationTime.Pad1 = 0;
+  Identity->ModificationTime.Pad2 = 0;
+
+  //
+  // Prefer APFS volume UUID as all volumes in the container share the partition.
+  //
+  VolumeInfo = GetFileInfo (
+    Root,
+    &gAppleApfsVolumeInfoGuid,
+    sizeof (*VolumeInfo),
+    NULL
+    );
+
+  Root->Close (Root);
+
+  if (VolumeInfo != NULL) {
+    CopyGuid (&Identity->Uuid, &VolumeInfo->Uuid);
+    FreePool (VolumeInfo);
+  } else {
+    Status = gBS->HandleProtocol (
+      Handle,
+      &gEfiDevicePathProtocolGuid,
+      (VOID **) &DevicePath
+      );
+    if (!EFI_ERROR (Status)) {
+      HardDrive = (HARDDRIVE_DEVICE_PATH *) FindDevicePathNodeWithType (
+        DevicePath,
+        MEDIA_DEVICE_PATH,
+        MEDIA_HARDDRIVE_DP
+        );
+      if (HardDrive != NULL) {
+        CopyMem (&Identity->Uuid, HardDrive->Signature, sizeof (Identity->Uuid));
+      }
+    }
+  }
+
+  Identity->Handle = Handle;
+  return EFI_SUCCESS;
+}
+
+/**
+  Check whether filesystem identity is still valid.
+
+  @param[in] Identity  Previously obtained filesystem identity.
+
+  @retval TRUE when filesystem did not change.
+**/
+STATIC
+BOOLEAN
+IsFileSystemIdentityValid (
+  IN CONST INTERNAL_FS_IDENTITY  *Identity
+  )
+{
+  EFI_STATUS            Status;
+  INTERNAL_FS_IDENTITY  Current;
+
+  Status = GetFileSystemIdentity (Identity->Handle, &Current);
+  if (EFI_ERROR (Status)) {
+    return FALSE;
+  }
+
+  return CompareMem (&Current, Identity, sizeof (Current)) == 0;
+}
+
+/**
+  Release cached boot entry.
+
+  @param[in] BootEntry  Cached boot entry.
+**/
+STATIC
+VOID
+FreeCachedBootEntry (
+  IN OC_BOOT_ENTRY  *BootEntry
+  )
+{
+  if (BootEntry->DevicePath != NULL) {
+    FreePool (BootEntry->DevicePath);
+  }
+
+  if (BootEntry->Name != NULL) {
+    FreePool (BootEntry->Name);
+  }
+
+  if (BootEntry->PathName != NULL) {
+    FreePool (BootEntry->PathName);
+  }
+
+  if (BootEntry->LoadOptions != NULL) {
+    FreePool (BootEntry->LoadOptions);
+  }
+
+  FreePool (BootEntry);
+}
+
+/**
+  Release boot entry cache record.
+
+  @param[in] Cache  Boot entry cache record.
+**/
+STATIC
+VOID
+FreeBootEntryCache (
+  IN INTERNAL_BOOT_ENTRY_CACHE  *Cache
+  )
+{
+  UINTN  Index;
+
+  for (Index = 0; Index < Cache->EntryCount; ++Index) {
+    FreeCachedBootEntry (Cache->Entries[Index]);
+  }
+
+  if (Cache->Entries != NULL) {
+    FreePool (Cache->Entries);
+  }
+
+  FreePool (Cache);
+}
+
+OC_BOOT_ENTRY *
+InternalDuplicateBootEntry (
+  IN CONST OC_BOOT_ENTRY  *BootEntry
+  )
+{
+  OC_BOOT_ENTRY  *NewEntry;
+
+  NewEntry = AllocateCopyPool (sizeof (*NewEntry), BootEntry);
+  if (NewEntry == NULL) {
+    return NULL;
+  }
+
+  NewEntry->DevicePath  = NULL;
+  NewEntry->Name        = NULL;
+  NewEntry->PathName    = NULL;
+  NewEntry->LoadOptions = NULL;
+  NewEntry->EntryIndex  = 0;
+
+  if (BootEntry->DevicePath != NULL) {
+    NewEntry->DevicePath = DuplicateDevicePath (BootEntry->DevicePath);
+    if (NewEntry->DevicePath == NULL) {
+      FreeCachedBootEntry (NewEntry);
+      return NULL;
+    }
+  }
+
+  if (BootEntry->Name != NULL) {
+    NewEntry->Name = AllocateCopyPool (StrSize (BootEntry->Name), BootEntry->Name);
+    if (NewEntry->Name == NULL) {
+      FreeCachedBootEntry (NewEntry);
+      return NULL;
+    }
+  }
+
+  if (BootEntry->PathName != NULL) {
+    NewEntry->PathName = AllocateCopyPool (StrSize (BootEntry->PathName), BootEntry->PathName);
+    if (NewEntry->PathName == NULL) {
+      FreeCachedBootEntry (NewEntry);
+      return NULL;
+    }
+  }
+
+  if (BootEntry->LoadOptions != NULL) {
+    NewEntry->LoadOptions = AllocateCopyPool (BootEntry->LoadOptionsSize, BootEntry->LoadOptions);
+    if (NewEntry->LoadOptions == NULL) {
+      FreeCachedBootEntry (NewEntry);
+      return NULL;
+    }
+  }
+
+  return NewEntry;
+}
+
+INTERNAL_BOOT_ENTRY_CACHE *
+InternalFindBootEntryCache (
+  IN  EFI_HANDLE            Handle,
+  IN  UINT32                Flags,
+  OUT INTERNAL_FS_IDENTITY  *Identity
+  )
+{
+  EFI_STATUS                 Status;
+  LIST_ENTRY                 *Link;
+  INTERNAL_BOOT_ENTRY_CACHE  *Cache;
+
+  Status = GetFileSystemIdentity (Handle, Identity);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_INFO, "OCB: Boot entry cache is unsupported for fs %p - %r\n", Handle, Status));
+    return NULL;
+  }
+
+  for (
+    Link = GetFirstNode (&mBootEntryCache);
+    !IsNull (&mBootEntryCache, Link);
+    Link = GetNextNode (&mBootEntryCache, Link)) {
+    Cache = BASE_CR (Link, INTERNAL_BOOT_ENTRY_CACHE, Link);
+
+    if (Cache->Identity.Handle != Handle || Cache->Flags != Flags) {
+      continue;
+    }
+
+    if (CompareMem (&Cache->Identity, Identity, sizeof (*Identity)) == 0
+      && (Cache->RecoveryIdentity.Handle == NULL
+        || IsFileSystemIdentityValid (&Cache->RecoveryIdentity))) {
+      DEBUG ((
+        DEBUG_INFO,
+        "OCB: Boot entry cache hit for fs %p with %u entries\n",
+        Handle,
+        (UINT32) Cache->EntryCount
+        ));
+      return Cache;
+    }
+
+    //
+    // Filesystem changed, drop stale results.
+    //
+    RemoveEntryList (Link);
+    FreeBootEntryCache (Cache);
+    break;
+  }
+
+  DEBUG ((DEBUG_INFO, "OCB: Boot entry cache miss for fs %p\n", Handle));
+  return NULL;
+}
+
+VOID
+InternalSaveBootEntryCache (
+  IN CONST INTERNAL_FS_IDENTITY  *Identity,
+  IN UINT32                      Flags,
+  IN OC_BOOT_FILESYSTEM          *FileSystem,
+  IN LIST_ENTRY                  *FirstLink
+  )
+{
+  EFI_STATUS                 Status;
+  INTERNAL_BOOT_ENTRY_CACHE  *Cache;
+  LIST_ENTRY                 *Link;
+  UINTN                      EntryCount;
+
+  if (Identity->Handle == NULL) {
+    return;
+  }
+
+  Cache = AllocateZeroPool (sizeof (*Cache));
+  if (Cache == NULL) {
+    return;
+  }
+
+  CopyMem (&Cache->Identity, Identity, sizeof (Cache->Identity));
+  Cache->Flags           = Flags;
+  Cache->HasSelfRecovery = FileSystem->HasSelfRecovery;
+
+  if (FileSystem->RecoveryFs != NULL) {
+    Status = GetFileSystemIdentity (FileSystem->RecoveryFs->Handle, &Cache->RecoveryIdentity);
+    if (EFI_ERROR (Status)) {
+      FreePool (Cache);
+      return;
+    }
+  }
+
+  EntryCount = 0;
+  for (Link = FirstLink; !IsNull (&FileSystem->BootEntries, Link); Link = GetNextNode (&FileSystem->BootEntries, Link)) {
+    ++EntryCount;
+  }
+
+  if (EntryCount > 0) {
+    Cache->Entries = AllocatePool (EntryCount * sizeof (*Cache->Entries));
+    if (Cache->Entries == NULL) {
+      FreePool (Cache);
+      return;
+    }
+
+    for (Link = FirstLink; !IsNull (&FileSystem->BootEntries, Link); Link = GetNextNode (&FileSystem->BootEntries, Link)) {
+      Cache->Entries[Cache->EntryCount] = InternalDuplicateBootEntry (BASE_CR (Link, OC_BOOT_ENTRY, Link));
+      if (Cache->Entries[Cache->EntryCount] == NULL) {
+        FreeBootEntryCache (Cache);
+        return;
+      }
+
+      ++Cache->EntryCount;
+    }
+  }
+
+  InsertTailList (&mBootEntryCache, &Cache->Link);
+}
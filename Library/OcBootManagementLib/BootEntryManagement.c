@@ -958,6 +958,98 @@ AddBootEntryFromSelfRecovery (
   return Status;
 }
 
+/**
+  Create bootable entries from bless and recovery files on the volume.
+  Previously discovered entries are restored from the cache
+  unless the filesystem has changed.
+
+  @param[in,out] BootContext   Context of filesystems.
+  @param[in,out] FileSystem    Filesystem to scan.
+
+  @retval TRUE when the entries were restored from the cache.
+**/
+STATIC
+BOOLEAN
+AddBootEntryFromFileSystem (
+  IN OUT OC_BOOT_CONTEXT     *BootContext,
+  IN OUT OC_BOOT_FILESYSTEM  *FileSystem
+  )
+{
+  INTERNAL_BOOT_ENTRY_CACHE  *Cache;
+  INTERNAL_FS_IDENTITY       Identity;
+  OC_BOOT_ENTRY              *BootEntry;
+  LIST_ENTRY                 *LastLink;
+  UINT32                     Flags;
+  UINTN                      Index;
+
+  //
+  // Bless is only processed for filesystems without options from BootOrder.
+  //
+  Flags = 0;
+  if (IsListEmpty (&FileSystem->BootEntries)) {
+    Flags |= INTERNAL_BOOT_ENTRY_CACHE_BLESS;
+  }
+  if (BootContext->PickerContext->HideAuxiliary) {
+    Flags |= INTERNAL_BOOT_ENTRY_CACHE_HIDE_AUXILIARY;
+  }
+  if (FileSystem->HasSelfRecovery) {
+    Flags |= INTERNAL_BOOT_ENTRY_CACHE_SELF_RECOVERY;
+  }
+
+  Cache = InternalFindBootEntryCache (FileSystem->Handle, Flags, &Identity);
+  if (Cache != NULL) {
+    for (Index = 0; Index < Cache->EntryCount; ++Index) {
+      BootEntry = InternalDuplicateBootEntry (Cache->Entries[Index]);
+      if (BootEntry == NULL) {
+        break;
+      }
+
+      RegisterBootOption (BootContext, FileSystem, BootEntry);
+    }
+
+    FileSystem->HasSelfRecovery = Cache->HasSelfRecovery;
+    if (FileSystem->RecoveryFs == NULL && Cache->RecoveryIdentity.Handle != NULL) {
+      FileSystem->RecoveryFs = InternalFileSystemForHandle (
+        BootContext,
+        Cache->RecoveryIdentity.Handle,
+        FALSE
+        );
+    }
+
+    return TRUE;
+  }
+
+  //
+  // New entries are always appended to the end of the list.
+  //
+  LastLink = GetPreviousNode (&FileSystem->BootEntries, &FileSystem->BootEntries);
+
+  if ((Flags & INTERNAL_BOOT_ENTRY_CACHE_BLESS) != 0) {
+    AddBootEntryFromBless (
+      BootContext,
+      FileSystem,
+      gAppleBootPolicyPredefinedPaths,
+      gAppleBootPolicyNumPredefinedPaths,
+      FALSE,
+      FALSE
+      );
+  }
+
+  //
+  // Record predefined recoveries.
+  //
+  AddBootEntryFromSelfRecovery (BootContext, FileSystem);
+
+  InternalSaveBootEntryCache (
+    &Identity,
+    Flags,
+    FileSystem,
+    GetNextNode (&FileSystem->BootEntries, LastLink)
+    );
+
+  return FALSE;
+}
+
 /**
   Create bootable entries from boot options.
 
@@ -1549,6 +1641,11 @@ OcScanForBootEntries (
   UINTN                            Index;
   LIST_ENTRY                       *Link;
   OC_BOOT_FILESYSTEM               *FileSystem;
+  UINT32                           Span;
+  UINT32                           CacheHits;
+  UINT32                           CacheMisses;
+
+  Span = OcProfileBegin ("OcScanForBootEntries");
 
   //
   // Obtain the list of filesystems filtered by scan policy.
@@ -1558,6 +1655,7 @@ OcScanForBootEntries (
     FALSE
     );
   if (BootContext == NULL) {
+    OcProfileEnd (Span);
     return NULL;
   }
 
@@ -1585,37 +1683,31 @@ OcScanForBootEntries (
   // Create primary boot options on filesystems without options
   // and alternate boot options on all filesystems.
   //
+  CacheHits   = 0;
+  CacheMisses = 0;
+
   for (
     Link = GetFirstNode (&BootContext->FileSystems);
     !IsNull (&BootContext->FileSystems, Link);
     Link = GetNextNode (&BootContext->FileSystems, Link)) {
     FileSystem = BASE_CR (Link, OC_BOOT_FILESYSTEM, Link);
 
-    //
-    // No entries, so we process this directory with Apple Bless.
-    //
-    if (IsListEmpty (&FileSystem->BootEntries)) {
-      AddBootEntryFromBless (
-        BootContext,
-        FileSystem,
-        gAppleBootPolicyPredefinedPaths,
-        gAppleBootPolicyNumPredefinedPaths,
-        FALSE,
-        FALSE
-        );
+    if (AddBootEntryFromFileSystem (BootContext, FileSystem)) {
+      ++CacheHits;
+    } else {
+      ++CacheMisses;
     }
-
-    //
-    // Record predefined recoveries.
-    //
-    AddBootEntryFromSelfRecovery (BootContext, FileSystem);
   }
 
+  DEBUG ((DEBUG_INFO, "OCB: Boot entry cache %u hits, %u misses\n", CacheHits, CacheMisses));
+
   //
   // Build custom and system options.
   //
   AddFileSystemEntryForCustom (BootContext);
 
+  OcProfileEnd (Span);
+
   if (BootContext->BootEntryCount == 0) {
     OcFreeBootContext (BootContext);
     return NULL;
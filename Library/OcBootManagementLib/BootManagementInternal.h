@@ -167,6 +167,110 @@ InternalFileSystemForHandle (
   IN BOOLEAN          LazyScan
   );
 
+//
+// Boot entry scan cache flags describing scan conditions.
+//
+#define INTERNAL_BOOT_ENTRY_CACHE_BLESS           BIT0
+#define INTERNAL_BOOT_ENTRY_CACHE_HIDE_AUXILIARY  BIT1
+#define INTERNAL_BOOT_ENTRY_CACHE_SELF_RECOVERY   BIT2
+
+/**
+  Filesystem identity used to validate boot entry scan cache.
+**/
+typedef struct {
+  //
+  // Filesystem handle, NULL when identity is unknown.
+  //
+  EFI_HANDLE  Handle;
+  //
+  // APFS volume UUID or GPT partition UUID.
+  //
+  EFI_GUID    Uuid;
+  //
+  // Root directory modification time.
+  //
+  EFI_TIME    ModificationTime;
+} INTERNAL_FS_IDENTITY;
+
+/**
+  Cached boot entries discovered on a filesystem.
+**/
+typedef struct {
+  //
+  // Link in boot entry cache.
+  //
+  LIST_ENTRY            Link;
+  //
+  // Scanned filesystem identity.
+  //
+  INTERNAL_FS_IDENTITY  Identity;
+  //
+  // APFS recovery filesystem identity, if any.
+  //
+  INTERNAL_FS_IDENTITY  RecoveryIdentity;
+  //
+  // Scan conditions (INTERNAL_BOOT_ENTRY_CACHE_*).
+  //
+  UINT32                Flags;
+  //
+  // Self recovery presence after the scan.
+  //
+  BOOLEAN               HasSelfRecovery;
+  //
+  // Number of cached boot entries.
+  //
+  UINTN                 EntryCount;
+  //
+  // Cached boot entries.
+  //
+  OC_BOOT_ENTRY         **Entries;
+} INTERNAL_BOOT_ENTRY_CACHE;
+
+/**
+  Find valid cached boot entries for the filesystem.
+  Costs one root directory information request when the cache is present.
+
+  @param[in]  Handle    Filesystem handle.
+  @param[in]  Flags     Scan conditions (INTERNAL_BOOT_ENTRY_CACHE_*).
+  @param[out] Identity  Current filesystem identity for saving the scan results.
+
+  @retval cached boot entries or NULL.
+**/
+INTERNAL_BOOT_ENTRY_CACHE *
+InternalFindBootEntryCache (
+  IN  EFI_HANDLE            Handle,
+  IN  UINT32                Flags,
+  OUT INTERNAL_FS_IDENTITY  *Identity
+  );
+
+/**
+  Save boot entries discovered on the filesystem to the cache.
+
+  @param[in] Identity    Filesystem identity from InternalFindBootEntryCache.
+  @param[in] Flags       Scan conditions (INTERNAL_BOOT_ENTRY_CACHE_*).
+  @param[in] FileSystem  Scanned filesystem.
+  @param[in] FirstLink   First discovered boot entry link in FileSystem.
+**/
+VOID
+InternalSaveBootEntryCache (
+  IN CONST INTERNAL_FS_IDENTITY  *Identity,
+  IN UINT32                      Flags,
+  IN OC_BOOT_FILESYSTEM          *FileSystem,
+  IN LIST_ENTRY                  *FirstLink
+  );
+
+/**
+  Duplicate boot entry with its contents.
+
+  @param[in] BootEntry  Boot entry to duplicate.
+
+  @retval duplicated boot entry or NULL.
+**/
+OC_BOOT_ENTRY *
+InternalDuplicateBootEntry (
+  IN CONST OC_BOOT_ENTRY  *BootEntry
+  );
+
 /**
   Resets selected NVRAM variables and reboots the system.
 **/
@@ -47,6 +47,35 @@ STATIC
 EFI_GUID
 mBootChimeVendorVariableGuid = {0x89D4F995, 0x67E3, 0x4895, { 0x8F, 0x18, 0x45, 0x4B, 0x65, 0x1D, 0x92, 0x15 } };
 
+//
+// Maximum amount of variables in NVRAM snapshot. Reaching it normally means
+// that GetNextVariableName implementation is broken and never terminates.
+//
+#define VARIABLE_SNAPSHOT_MAX_COUNT  4096U
+
+//
+// Initial NVRAM snapshot buffer size, doubled when needed.
+//
+#define VARIABLE_SNAPSHOT_INITIAL_SIZE  BASE_4KB
+
+//
+// NVRAM snapshot entry, followed by null-terminated variable name.
+//
+typedef struct {
+  EFI_GUID  Guid;
+  UINT32    Size;
+  BOOLEAN   Deleted;
+} VARIABLE_SNAPSHOT_ENTRY;
+
+#define VARIABLE_SNAPSHOT_ENTRY_NAME(Entry) \
+  ((CHAR16 *) ((VARIABLE_SNAPSHOT_ENTRY *) (Entry) + 1))
+
+typedef struct {
+  UINT8   *Buffer;
+  UINTN   Size;
+  UINTN   AllocatedSize;
+  UINT32  Count;
+} VARIABLE_SNAPSHOT;
 
 STATIC
 BOOLEAN
@@ -245,6 +274,290 @@ DeleteVariables (
   }
 }
 
+/**
+  Append variable to NVRAM snapshot.
+
+  @param[in,out] Snapshot  NVRAM snapshot.
+  @param[in]     Name      Variable name.
+  @param[in]     NameSize  Variable name size including terminator.
+  @param[in]     Guid      Variable GUID.
+
+  @retval EFI_SUCCESS on success.
+**/
+STATIC
+EFI_STATUS
+AppendVariableSnapshot (
+  IN OUT VARIABLE_SNAPSHOT  *Snapshot,
+  IN     CONST CHAR16       *Name,
+  IN     UINTN              NameSize,
+  IN     CONST EFI_GUID     *Guid
+  )
+{
+  VARIABLE_SNAPSHOT_ENTRY  *Entry;
+  UINT8                    *TmpBuffer;
+  UINTN                    EntrySize;
+  UINTN                    NewSize;
+
+  EntrySize = ALIGN_VALUE (sizeof (*Entry) + NameSize, sizeof (UINT64));
+
+  if (Snapshot->AllocatedSize - Snapshot->Size < EntrySize) {
+    NewSize = MAX (Snapshot->AllocatedSize * 2, VARIABLE_SNAPSHOT_INITIAL_SIZE);
+    while (NewSize - Snapshot->Size < EntrySize) {
+      NewSize *= 2;
+    }
+
+    TmpBuffer = AllocatePool (NewSize);
+    if (TmpBuffer == NULL) {
+      return EFI_OUT_OF_RESOURCES;
+    }
+
+    if (Snapshot->Buffer != NULL) {
+      CopyMem (TmpBuffer, Snapshot->Buffer, Snapshot->Size);
+      FreePool (Snapshot->Buffer);
+    }
+
+    Snapshot->Buffer        = TmpBuffer;
+    Snapshot->AllocatedSize = NewSize;
+  }
+
+  Entry = (VARIABLE_SNAPSHOT_ENTRY *) (Snapshot->Buffer + Snapshot->Size);
+  CopyGuid (&Entry->Guid, Guid);
+  Entry->Size    = (UINT32) EntrySize;
+  Entry->Deleted = FALSE;
+  CopyMem (VARIABLE_SNAPSHOT_ENTRY_NAME (Entry), Name, NameSize);
+
+  Snapshot->Size += EntrySize;
+  ++Snapshot->Count;
+  return EFI_SUCCESS;
+}
+
+/**
+  Collect names and GUIDs of all variables without modifying NVRAM.
+
+  @param[out] Snapshot  NVRAM snapshot, free with FreeVariableSnapshot.
+
+  @retval EFI_SUCCESS on success.
+  @retval EFI_ABORTED when firmware enumeration looks broken.
+**/
+STATIC
+EFI_STATUS
+TakeVariableSnapshot (
+  OUT VARIABLE_SNAPSHOT  *Snapshot
+  )
+{
+  EFI_STATUS   Status;
+  EFI_GUID     CurrentGuid;
+  CHAR16       *Buffer;
+  CHAR16       *TmpBuffer;
+  UINTN        BufferSize;
+  UINTN        RequestedSize;
+  UINTN        NameSize;
+
+  ZeroMem (Snapshot, sizeof (*Snapshot));
+
+  //
+  // To start the search variable name should be L"".
+  //
+  BufferSize = 1024;
+  Buffer     = AllocateZeroPool (BufferSize);
+  if (Buffer == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  ZeroMem (&CurrentGuid, sizeof (CurrentGuid));
+
+  while (TRUE) {
+    RequestedSize = BufferSize;
+    Status = gRT->GetNextVariableName (&RequestedSize, Buffer, &CurrentGuid);
+
+    if (Status == EFI_BUFFER_TOO_SMALL) {
+      if (RequestedSize <= BufferSize) {
+        Status = EFI_ABORTED;
+        break;
+      }
+
+      TmpBuffer = AllocateZeroPool (RequestedSize);
+      if (TmpBuffer == NULL) {
+        Status = EFI_OUT_OF_RESOURCES;
+        break;
+      }
+
+      CopyMem (TmpBuffer, Buffer, BufferSize);
+      FreePool (Buffer);
+      Buffer     = TmpBuffer;
+      BufferSize = RequestedSize;
+      continue;
+    }
+
+    if (Status == EFI_NOT_FOUND) {
+      Status = EFI_SUCCESS;
+      break;
+    }
+
+    if (EFI_ERROR (Status)) {
+      break;
+    }
+
+    NameSize = StrnSizeS (Buffer, BufferSize / sizeof (CHAR16));
+    if (NameSize > BufferSize || Snapshot->Count >= VARIABLE_SNAPSHOT_MAX_COUNT) {
+      Status = EFI_ABORTED;
+      break;
+    }
+
+    Status = AppendVariableSnapshot (Snapshot, Buffer, NameSize, &CurrentGuid);
+    if (EFI_ERROR (Status)) {
+      break;
+    }
+  }
+
+  FreePool (Buffer);
+
+  if (EFI_ERROR (Status) && Snapshot->Buffer != NULL) {
+    FreePool (Snapshot->Buffer);
+    ZeroMem (Snapshot, sizeof (*Snapshot));
+  }
+
+  return Status;
+}
+
+/**
+  Find variable in NVRAM snapshot.
+
+  @param[in] Snapshot  NVRAM snapshot.
+  @param[in] Name      Variable name.
+  @param[in] Guid      Variable GUID.
+
+  @return  Snapshot entry or NULL.
+**/
+STATIC
+VARIABLE_SNAPSHOT_ENTRY *
+FindVariableSnapshot (
+  IN CONST VARIABLE_SNAPSHOT  *Snapshot,
+  IN CONST CHAR16             *Name,
+  IN CONST EFI_GUID           *Guid
+  )
+{
+  VARIABLE_SNAPSHOT_ENTRY  *Entry;
+  UINTN                    Offset;
+
+  Offset = 0;
+  while (Offset < Snapshot->Size) {
+    Entry   = (VARIABLE_SNAPSHOT_ENTRY *) (Snapshot->Buffer + Offset);
+    Offset += Entry->Size;
+    if (CompareGuid (&Entry->Guid, Guid)
+      && StrCmp (VARIABLE_SNAPSHOT_ENTRY_NAME (Entry), Name) == 0) {
+      return Entry;
+    }
+  }
+
+  return NULL;
+}
+
+/**
+  Delete variables from NVRAM snapshot in a single pass. This avoids
+  restarting the enumeration after every deletion, which is quadratic
+  in the amount of variables.
+
+  @retval TRUE when deletion is complete and verified.
+  @retval FALSE when sequential deletion needs to be used.
+**/
+STATIC
+BOOLEAN
+DeleteVariablesSnapshot (
+  VOID
+  )
+{
+  EFI_STATUS               Status;
+  VARIABLE_SNAPSHOT        Snapshot;
+  VARIABLE_SNAPSHOT        Verify;
+  VARIABLE_SNAPSHOT_ENTRY  *Entry;
+  VARIABLE_SNAPSHOT_ENTRY  *Original;
+  CHAR16                   *Name;
+  UINTN                    Offset;
+  UINT32                   DeleteCount;
+  BOOLEAN                  Result;
+
+  Status = TakeVariableSnapshot (&Snapshot);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_INFO, "OCB: Failed to snapshot NVRAM - %r\n", Status));
+    return FALSE;
+  }
+
+  DeleteCount = 0;
+
+  Offset = 0;
+  while (Offset < Snapshot.Size) {
+    Entry   = (VARIABLE_SNAPSHOT_ENTRY *) (Snapshot.Buffer + Offset);
+    Name    = VARIABLE_SNAPSHOT_ENTRY_NAME (Entry);
+    Offset += Entry->Size;
+
+    if (!IsDeletableVariable (Name, &Entry->Guid)) {
+      continue;
+    }
+
+    Status = gRT->SetVariable (Name, &Entry->Guid, 0, 0, NULL);
+    if (!EFI_ERROR (Status)) {
+      DEBUG ((DEBUG_INFO, "Deleting %g:%s... OK\n", &Entry->Guid, Name));
+      Entry->Deleted = TRUE;
+      ++DeleteCount;
+    } else if (Status == EFI_NOT_FOUND || Status == EFI_SECURITY_VIOLATION) {
+      DEBUG ((DEBUG_INFO, "Deleting %g:%s... SKIP - %r\n", &Entry->Guid, Name, Status));
+    } else {
+      DEBUG ((DEBUG_INFO, "Deleting %g:%s... FAIL - %r\n", &Entry->Guid, Name, Status));
+    }
+  }
+
+  DEBUG ((
+    DEBUG_INFO,
+    "OCB: Deleted %u of %u variables from snapshot\n",
+    DeleteCount,
+    Snapshot.Count
+    ));
+
+  //
+  // Ensure that neither deleted variables came back, nor enumeration missed any.
+  // Variables we failed to delete are expected to remain.
+  //
+  Status = TakeVariableSnapshot (&Verify);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_INFO, "OCB: Failed to verify NVRAM - %r\n", Status));
+    if (Snapshot.Buffer != NULL) {
+      FreePool (Snapshot.Buffer);
+    }
+    return FALSE;
+  }
+
+  Result = TRUE;
+
+  Offset = 0;
+  while (Offset < Verify.Size) {
+    Entry   = (VARIABLE_SNAPSHOT_ENTRY *) (Verify.Buffer + Offset);
+    Name    = VARIABLE_SNAPSHOT_ENTRY_NAME (Entry);
+    Offset += Entry->Size;
+
+    if (!IsDeletableVariable (Name, &Entry->Guid)) {
+      continue;
+    }
+
+    Original = FindVariableSnapshot (&Snapshot, Name, &Entry->Guid);
+    if (Original == NULL || Original->Deleted) {
+      DEBUG ((DEBUG_INFO, "OCB: Found %g:%s after deletion\n", &Entry->Guid, Name));
+      Result = FALSE;
+      break;
+    }
+  }
+
+  if (Snapshot.Buffer != NULL) {
+    FreePool (Snapshot.Buffer);
+  }
+
+  if (Verify.Buffer != NULL) {
+    FreePool (Verify.Buffer);
+  }
+
+  return Result;
+}
+
 VOID
 OcDeleteVariables (
   VOID
@@ -313,7 +626,10 @@ OcDeleteVariables (
     }
   }
 
-  DeleteVariables ();
+  if (!DeleteVariablesSnapshot ()) {
+    DEBUG ((DEBUG_INFO, "OCB: Falling back to sequential NVRAM cleanup\n"));
+    DeleteVariables ();
+  }
 
   if ((BootProtect & OC_BOOT_PROTECT_VARIABLE_BOOTSTRAP) != 0) {
     Status = gRT->SetVariable (
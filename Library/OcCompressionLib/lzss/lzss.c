@@ -137,6 +137,99 @@ u_int32_t decompress_lzss(
     return (u_int32_t)(dst - dststart);
 }
 
+u_int32_t decompress_lzss_stream(
+    u_int8_t           * dst,
+    u_int32_t            dstlen,
+    u_int32_t            srclen,
+    OC_DECOMPRESS_READ   read,
+    void               * context)
+{
+    /* ring buffer of size N, with extra F-1 bytes to aid string comparison */
+    u_int8_t text_buf[N + F - 1];
+    u_int8_t * dststart = dst;
+    const u_int8_t * dstend = dst + dstlen;
+    u_int8_t * window;
+    const u_int8_t * src;
+    const u_int8_t * srcend;
+    const u_int8_t * token;
+    u_int32_t srcoffset, avail, chunk;
+    int  i, j, k, r;
+    u_int8_t c;
+    unsigned int flags, nextflags;
+
+    if (dstlen > OC_COMPRESSION_MAX_LENGTH || srclen > OC_COMPRESSION_MAX_LENGTH) {
+        return 0;
+    }
+
+    window = malloc(OC_DECOMPRESS_STREAM_CHUNK_SIZE);
+    if (window == NULL) {
+        return 0;
+    }
+
+    memset(text_buf, ' ', N - F);
+    r = N - F;
+    flags = 0;
+    srcoffset = 0;
+    avail = 0;
+    src = window;
+
+    /*
+     * Same as decompress_lzss, but tokens are only consumed when complete.
+     * Incomplete tokens are moved to the window start and decoded once more
+     * source data is read.
+     */
+    while (dst < dstend) {
+        if (avail > 0) {
+            CopyMem(window, (void *) src, avail);
+        }
+
+        chunk = OC_DECOMPRESS_STREAM_CHUNK_SIZE - avail;
+        if (chunk > srclen - srcoffset) chunk = srclen - srcoffset;
+        if (chunk == 0) break;
+        if (!read(context, srcoffset, chunk, window + avail)) break;
+
+        srcoffset += chunk;
+        avail += chunk;
+        src = window;
+        srcend = window + avail;
+
+        for ( ; ; ) {
+            token = src;
+            nextflags = flags >> 1;
+            if ((nextflags & 0x100) == 0) {
+                if (token < srcend) c = *token++; else break;
+                nextflags = c | 0xFF00;  /* uses higher byte cleverly */
+            }   /* to count eight */
+            if (nextflags & 1) {
+                if (token < srcend) c = *token++; else break;
+                if (dst < dstend) *dst++ = c; else break;
+                text_buf[r++] = c;
+                r &= (N - 1);
+            } else {
+                if (srcend - token < 2) break;
+                i = *token++;
+                j = *token++;
+                i |= ((j & 0xF0) << 4);
+                j  =  (j & 0x0F) + THRESHOLD;
+                for (k = 0; k <= j; k++) {
+                    c = text_buf[(i + k) & (N - 1)];
+                    if (dst < dstend) *dst++ = c; else break;
+                    text_buf[r++] = c;
+                    r &= (N - 1);
+                }
+            }
+            src = token;
+            flags = nextflags;
+        }
+
+        avail = (u_int32_t)(srcend - src);
+    }
+
+    free(window);
+
+    return (u_int32_t)(dst - dststart);
+}
+
 /*
  * initialize state, mostly the trees
  *
@@ -29,6 +29,7 @@ typedef INT32 int32_t;
 
 #define compress_lzss CompressLZSS
 #define decompress_lzss DecompressLZSS
+#define decompress_lzss_stream DecompressLZSSStream
 
 #ifdef memset
 #undef memset
@@ -843,3 +843,62 @@ size_t lzvn_decode_buffer(unsigned char *dst, size_t dst_size,
   // This is how much we decompressed
   return dstate.dst - dst;
 }
+
+size_t lzvn_decode_stream(unsigned char *dst, size_t dst_size,
+                          uint32_t src_size, OC_DECOMPRESS_READ read,
+                          void *context) {
+  // Init LZVN decoder state
+  lzvn_decoder_state dstate;
+  unsigned char *window;
+  uint32_t src_offset;
+  size_t avail;
+  size_t chunk;
+
+  if (dst_size > OC_COMPRESSION_MAX_LENGTH || src_size > OC_COMPRESSION_MAX_LENGTH) {
+    return 0;
+  }
+
+  window = AllocatePool(OC_DECOMPRESS_STREAM_CHUNK_SIZE);
+  if (window == NULL) {
+    return 0;
+  }
+
+  memset(&dstate, 0x00, sizeof(dstate));
+  dstate.dst_begin = dst;
+  dstate.dst = dst;
+  dstate.dst_end = dst + dst_size;
+
+  src_offset = 0;
+  avail = 0;
+
+  // The decoder stops at the last complete instruction when the source is
+  // truncated, so move the remainder to the window start and read more.
+  while (!dstate.end_of_stream && dstate.dst < dstate.dst_end) {
+    if (avail > 0)
+      memmove(window, dstate.src, avail);
+
+    chunk = OC_DECOMPRESS_STREAM_CHUNK_SIZE - avail;
+    if (chunk > src_size - src_offset)
+      chunk = src_size - src_offset;
+    if (chunk == 0)
+      break; // source exhausted or instruction larger than the window
+    if (!read(context, src_offset, (uint32_t)chunk, window + avail))
+      break;
+
+    src_offset += (uint32_t)chunk;
+    avail += chunk;
+
+    dstate.src = window;
+    dstate.src_end = window + avail;
+
+    // Run LZVN decoder
+    lzvn_decode(&dstate);
+
+    avail = dstate.src_end - dstate.src;
+  }
+
+  FreePool(window);
+
+  // This is how much we decompressed
+  return dstate.dst - dst;
+}
@@ -16,6 +16,7 @@
 #define LZVN_H
 
 #include <Library/BaseMemoryLib.h>
+#include <Library/MemoryAllocationLib.h>
 #include <Library/OcCompressionLib.h>
 
 typedef UINT16 uint16_t;
@@ -30,6 +31,7 @@ typedef UINTN size_t;
 typedef UINTN uintmax_t;
 
 #define lzvn_decode_buffer DecompressLZVN
+#define lzvn_decode_stream DecompressLZVNStream
 
 #ifdef memset
 #undef memset
@@ -39,7 +41,12 @@ typedef UINTN uintmax_t;
 #undef memcpy
 #endif
 
+#ifdef memmove
+#undef memmove
+#endif
+
 #define memset(Dst, Value, Size) SetMem ((Dst), (Size), (UINT8)(Value))
 #define memcpy(Dst, Src, Size) CopyMem ((Dst), (Src), (Size))
+#define memmove(Dst, Src, Size) CopyMem ((Dst), (Src), (Size))
 
 #endif /* LZVN_H */
@@ -34,6 +34,49 @@ void ZLIB_INTERNAL zcfree (opaque, ptr)
   FreePool (ptr);
 }
 
+typedef struct {
+  UINT8  *Next;
+  UINTN  Left;
+} ZLIB_SCRATCH;
+
+STATIC
+voidpf
+ZlibScratchAlloc (
+  IN voidpf  Opaque,
+  IN uInt    Items,
+  IN uInt    Size
+  )
+{
+  ZLIB_SCRATCH  *Scratch;
+  UINTN         AllocSize;
+  VOID          *Result;
+
+  Scratch   = Opaque;
+  AllocSize = ALIGN_VALUE ((UINTN) Items * Size, sizeof (UINT64));
+  if (AllocSize > Scratch->Left) {
+    return Z_NULL;
+  }
+
+  Result         = Scratch->Next;
+  Scratch->Next += AllocSize;
+  Scratch->Left -= AllocSize;
+  return Result;
+}
+
+STATIC
+VOID
+ZlibScratchFree (
+  IN voidpf  Opaque,
+  IN voidpf  Ptr
+  )
+{
+  //
+  // Scratch is released by the caller as a whole.
+  //
+  (VOID) Opaque;
+  (VOID) Ptr;
+}
+
 UINT8 *
 CompressZLIB (
   OUT UINT8        *Dst,
@@ -75,3 +118,50 @@ DecompressZLIB (
 
   return 0;
 }
+
+UINTN
+DecompressZLIBWithScratch (
+  OUT UINT8        *Dst,
+  IN  UINTN        DstLen,
+  IN  CONST UINT8  *Src,
+  IN  UINTN        SrcLen,
+  IN  VOID         *Scratch,
+  IN  UINTN        ScratchSize
+  )
+{
+  z_stream      Stream;
+  ZLIB_SCRATCH  Context;
+  int           Result;
+
+  if (SrcLen > OC_COMPRESSION_MAX_LENGTH || DstLen > OC_COMPRESSION_MAX_LENGTH
+    || ScratchSize < OC_ZLIB_DECOMPRESS_SCRATCH_SIZE) {
+    return 0;
+  }
+
+  Context.Next = Scratch;
+  Context.Left = ScratchSize;
+
+  Stream.next_in   = (z_const Bytef *) Src;
+  Stream.avail_in  = (uInt) SrcLen;
+  Stream.next_out  = Dst;
+  Stream.avail_out = (uInt) DstLen;
+  Stream.zalloc    = ZlibScratchAlloc;
+  Stream.zfree     = ZlibScratchFree;
+  Stream.opaque    = &Context;
+
+  if (inflateInit (&Stream) != Z_OK) {
+    return 0;
+  }
+
+  //
+  // Whole output is available, so a single call either completes or fails.
+  //
+  Result = inflate (&Stream, Z_FINISH);
+  inflateEnd (&Stream);
+
+  if (Result != Z_STREAM_END) {
+    return 0;
+  }
+
+  return Stream.total_out;
+}
@@ -111,6 +111,8 @@ mAcpiDeleteSchema = OC_SCHEMA_DICT (NULL, mAcpiDeleteSchemaEntry);
 STATIC
 OC_SCHEMA
 mAcpiPatchSchemaEntry[] = {
+  OC_SCHEMA_STRING_IN    ("Base",           OC_ACPI_PATCH_ENTRY, Base),
+  OC_SCHEMA_INTEGER_IN   ("BaseSkip",       OC_ACPI_PATCH_ENTRY, BaseSkip),
   OC_SCHEMA_STRING_IN    ("Comment",        OC_ACPI_PATCH_ENTRY, Comment),
   OC_SCHEMA_INTEGER_IN   ("Count",          OC_ACPI_PATCH_ENTRY, Count),
   OC_SCHEMA_BOOLEAN_IN   ("Enabled",        OC_ACPI_PATCH_ENTRY, Enabled),
@@ -291,6 +293,7 @@ mKernelQuirksSchema[] = {
   OC_SCHEMA_BOOLEAN_IN ("AppleXcpmCfgLock",        OC_GLOBAL_CONFIG, Kernel.Quirks.AppleXcpmCfgLock),
   OC_SCHEMA_BOOLEAN_IN ("AppleXcpmExtraMsrs",      OC_GLOBAL_CONFIG, Kernel.Quirks.AppleXcpmExtraMsrs),
   OC_SCHEMA_BOOLEAN_IN ("AppleXcpmForceBoost",     OC_GLOBAL_CONFIG, Kernel.Quirks.AppleXcpmForceBoost),
+  OC_SCHEMA_BOOLEAN_IN ("CachePrelinked",          OC_GLOBAL_CONFIG, Kernel.Quirks.CachePrelinked),
   OC_SCHEMA_BOOLEAN_IN ("CustomSMBIOSGuid",        OC_GLOBAL_CONFIG, Kernel.Quirks.CustomSmbiosGuid),
   OC_SCHEMA_BOOLEAN_IN ("DisableIoMapper",         OC_GLOBAL_CONFIG, Kernel.Quirks.DisableIoMapper),
   OC_SCHEMA_BOOLEAN_IN ("DisableRtcChecksum",      OC_GLOBAL_CONFIG, Kernel.Quirks.DisableRtcChecksum),
@@ -568,6 +571,7 @@ mUefiApfsSchema[] = {
   OC_SCHEMA_BOOLEAN_IN ("EnableJumpstart",      OC_GLOBAL_CONFIG, Uefi.Apfs.EnableJumpstart),
   OC_SCHEMA_BOOLEAN_IN ("HideVerbose",          OC_GLOBAL_CONFIG, Uefi.Apfs.HideVerbose),
   OC_SCHEMA_BOOLEAN_IN ("JumpstartHotPlug",     OC_GLOBAL_CONFIG, Uefi.Apfs.JumpstartHotPlug),
+  OC_SCHEMA_BOOLEAN_IN ("JumpstartParallel",    OC_GLOBAL_CONFIG, Uefi.Apfs.JumpstartParallel),
   OC_SCHEMA_INTEGER_IN ("MinDate",              OC_GLOBAL_CONFIG, Uefi.Apfs.MinDate),
   OC_SCHEMA_INTEGER_IN ("MinVersion",           OC_GLOBAL_CONFIG, Uefi.Apfs.MinVersion),
 };
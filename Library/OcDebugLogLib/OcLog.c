@@ -16,6 +16,7 @@
 
 #include <Guid/OcVariable.h>
 
+#include <Protocol/LoadedImage.h>
 #include <Protocol/OcLog.h>
 
 #include <Library/BaseLib.h>
@@ -30,6 +31,7 @@
 #include <Library/OcMiscLib.h>
 #include <Library/OcStringLib.h>
 #include <Library/OcTimerLib.h>
+#include <Library/PeCoffGetEntryPointLib.h>
 #include <Library/SerialPortLib.h>
 #include <Library/UefiLib.h>
 #include <Library/UefiBootServicesTableLib.h>
@@ -99,7 +101,8 @@ GetTiming  (
 STATIC
 CHAR16 *
 GetLogPath (
-  IN CONST CHAR16  *LogPrefixPath
+  IN CONST CHAR16  *LogPrefixPath,
+  IN CONST CHAR16  *Extension
   )
 {
   EFI_STATUS  Status;
@@ -116,7 +119,7 @@ GetLogPath (
     ZeroMem (&Date, sizeof (Date));
   }
 
-  Size = StrSize (LogPrefixPath) + L_STR_SIZE (L"-0000-00-00-000000.txt");
+  Size = StrSize (LogPrefixPath) + L_STR_SIZE (L"-0000-00-00-000000") + StrLen (Extension) * sizeof (CHAR16);
 
   LogPath = AllocatePool (Size);
   if (LogPath == NULL) {
@@ -126,19 +129,769 @@ GetLogPath (
   UnicodeSPrint (
     LogPath,
     Size,
-    L"%s-%04u-%02u-%02u-%02u%02u%02u.txt",
+    L"%s-%04u-%02u-%02u-%02u%02u%02u%s",
     LogPrefixPath,
     (UINT32) Date.Year,
     (UINT32) Date.Month,
     (UINT32) Date.Day,
     (UINT32) Date.Hour,
     (UINT32) Date.Minute,
-    (UINT32) Date.Second
+    (UINT32) Date.Second,
+    Extension
     );
 
   return LogPath;
 }
 
+/**
+  Append data to a tracked null-terminated log buffer.
+  Data is either appended completely or not at all.
+
+  @param[in,out] Buffer      Log buffer.
+  @param[in]     BufferSize  Log buffer size including null terminator.
+  @param[in,out] Length      Current log buffer length.
+  @param[in]     Data        Data to append.
+  @param[in]     DataLength  Data length.
+  @param[in]     Data2       Additional data to append, optional.
+  @param[in]     Data2Length Additional data length.
+
+  @retval EFI_SUCCESS           Data was appended.
+  @retval EFI_BUFFER_TOO_SMALL  Not enough space.
+**/
+STATIC
+EFI_STATUS
+AppendLogBuffer (
+  IN OUT CHAR8        *Buffer,
+  IN     UINTN        BufferSize,
+  IN OUT UINTN        *Length,
+  IN     CONST CHAR8  *Data,
+  IN     UINTN        DataLength,
+  IN     CONST CHAR8  *Data2  OPTIONAL,
+  IN     UINTN        Data2Length
+  )
+{
+  UINTN  NewLength;
+
+  NewLength = *Length + DataLength + Data2Length;
+  if (NewLength >= BufferSize) {
+    return EFI_BUFFER_TOO_SMALL;
+  }
+
+  CopyMem (&Buffer[*Length], Data, DataLength);
+  if (Data2Length > 0) {
+    CopyMem (&Buffer[*Length + DataLength], Data2, Data2Length);
+  }
+  Buffer[NewLength] = '\0';
+
+  //
+  // Update length last, the flush timer may read it at any point.
+  //
+  *Length = NewLength;
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Store fixed size trace argument data.
+
+  @param[out]    Data        Argument data buffer.
+  @param[in]     DataSize    Argument data buffer size.
+  @param[in,out] Length      Current argument data length.
+  @param[in]     Value       Value to store.
+  @param[in]     ValueSize   Value size.
+
+  @retval TRUE when the value was stored.
+**/
+STATIC
+BOOLEAN
+TraceStore (
+  OUT    UINT8        *Data,
+  IN     UINTN        DataSize,
+  IN OUT UINTN        *Length,
+  IN     CONST VOID   *Value,
+  IN     UINTN        ValueSize
+  )
+{
+  if (DataSize - *Length < ValueSize) {
+    return FALSE;
+  }
+
+  CopyMem (&Data[*Length], Value, ValueSize);
+  *Length += ValueSize;
+  return TRUE;
+}
+
+/**
+  Store trace string argument as length-prefixed ASCII.
+
+  @param[out]    Data        Argument data buffer.
+  @param[in]     DataSize    Argument data buffer size.
+  @param[in,out] Length      Current argument data length.
+  @param[in]     String      ASCII or UTF-16 string, optional.
+  @param[in]     Unicode     String is UTF-16.
+  @param[in]     Precision   Maximum number of characters to read.
+
+  @retval TRUE when the string was stored completely.
+**/
+STATIC
+BOOLEAN
+TraceString (
+  OUT    UINT8        *Data,
+  IN     UINTN        DataSize,
+  IN OUT UINTN        *Length,
+  IN     CONST VOID   *String  OPTIONAL,
+  IN     BOOLEAN      Unicode,
+  IN     UINTN        Precision
+  )
+{
+  UINT16  StringLength;
+  UINT16  MaxLength;
+  CHAR16  Char;
+  UINTN   Index;
+
+  if (DataSize - *Length < sizeof (StringLength)) {
+    return FALSE;
+  }
+
+  if (String == NULL) {
+    StringLength = MAX_UINT16;
+    return TraceStore (Data, DataSize, Length, &StringLength, sizeof (StringLength));
+  }
+
+  MaxLength = (UINT16) MIN (DataSize - *Length - sizeof (StringLength), MAX_UINT16 - 1);
+  Index     = *Length + sizeof (StringLength);
+
+  for (StringLength = 0; StringLength < MaxLength && StringLength < Precision; ++StringLength) {
+    if (Unicode) {
+      Char = ((CONST CHAR16 *) String)[StringLength];
+    } else {
+      Char = ((CONST CHAR8 *) String)[StringLength];
+    }
+
+    if (Char == '\0') {
+      break;
+    }
+
+    Data[Index++] = Char < 0x80 ? (UINT8) Char : '?';
+  }
+
+  CopyMem (&Data[*Length], &StringLength, sizeof (StringLength));
+  *Length = Index;
+
+  if (StringLength < Precision && StringLength == MaxLength) {
+    //
+    // Check whether the string was cut.
+    //
+    if (Unicode) {
+      return ((CONST CHAR16 *) String)[StringLength] == '\0';
+    }
+    return ((CONST CHAR8 *) String)[StringLength] == '\0';
+  }
+
+  return TRUE;
+}
+
+/**
+  Store trace pointer argument contents with a presence flag.
+
+  @param[out]    Data        Argument data buffer.
+  @param[in]     DataSize    Argument data buffer size.
+  @param[in,out] Length      Current argument data length.
+  @param[in]     Pointer     Argument pointer, optional.
+  @param[in]     PointerSize Size of the pointed data.
+
+  @retval TRUE when the argument was stored.
+**/
+STATIC
+BOOLEAN
+TracePointer (
+  OUT    UINT8        *Data,
+  IN     UINTN        DataSize,
+  IN OUT UINTN        *Length,
+  IN     CONST VOID   *Pointer  OPTIONAL,
+  IN     UINTN        PointerSize
+  )
+{
+  UINT8  Present;
+
+  Present = Pointer != NULL;
+  if (DataSize - *Length < sizeof (Present) + (Present ? PointerSize : 0)) {
+    return FALSE;
+  }
+
+  TraceStore (Data, DataSize, Length, &Present, sizeof (Present));
+  if (Present) {
+    TraceStore (Data, DataSize, Length, Pointer, PointerSize);
+  }
+
+  return TRUE;
+}
+
+/**
+  Collect raw format arguments for a trace entry without formatting them.
+  The format string is parsed in the same way as in PrintLib to consume
+  the right amount of arguments.
+
+  @param[out] Data          Argument data buffer.
+  @param[in]  DataSize      Argument data buffer size.
+  @param[in]  FormatString  Format string.
+  @param[in]  Marker        Format arguments.
+  @param[out] Truncated     Set to TRUE when not all arguments fit.
+
+  @return  Argument data length.
+**/
+STATIC
+UINTN
+TraceArguments (
+  OUT UINT8        *Data,
+  IN  UINTN        DataSize,
+  IN  CONST CHAR8  *FormatString,
+  IN  VA_LIST      Marker,
+  OUT BOOLEAN      *Truncated
+  )
+{
+  UINTN    Length;
+  BOOLEAN  Stored;
+  BOOLEAN  Long;
+  BOOLEAN  HasPrecision;
+  UINTN    Precision;
+  UINT64   Value;
+
+  Length     = 0;
+  *Truncated = FALSE;
+
+  while (*FormatString != '\0') {
+    if (*FormatString++ != '%') {
+      continue;
+    }
+
+    Long         = FALSE;
+    HasPrecision = FALSE;
+    Precision    = MAX_UINTN;
+    Stored       = TRUE;
+
+    for (; *FormatString != '\0'; ++FormatString) {
+      if (*FormatString == '.') {
+        HasPrecision = TRUE;
+        Precision    = 0;
+      } else if (*FormatString == 'l' || *FormatString == 'L') {
+        Long = TRUE;
+      } else if (*FormatString == '*') {
+        Value = VA_ARG (Marker, UINTN);
+        if (HasPrecision) {
+          Precision = (UINTN) Value;
+        }
+        Stored = TraceStore (Data, DataSize, &Length, &Value, sizeof (Value));
+        if (!Stored) {
+          break;
+        }
+      } else if (*FormatString >= '0' && *FormatString <= '9') {
+        if (HasPrecision) {
+          Precision = Precision * 10 + (*FormatString - '0');
+        }
+      } else if (*FormatString != '-' && *FormatString != '+'
+        && *FormatString != ' ' && *FormatString != ',') {
+        break;
+      }
+    }
+
+    if (!Stored) {
+      *Truncated = TRUE;
+      break;
+    }
+
+    switch (*FormatString) {
+      case 'p':
+        Value  = (UINTN) VA_ARG (Marker, VOID *);
+        Stored = TraceStore (Data, DataSize, &Length, &Value, sizeof (Value));
+        break;
+      case 'X':
+      case 'x':
+      case 'u':
+      case 'd':
+        if (Long) {
+          Value = VA_ARG (Marker, UINT64);
+        } else {
+          Value = (UINT64) (INT64) VA_ARG (Marker, int);
+        }
+        Stored = TraceStore (Data, DataSize, &Length, &Value, sizeof (Value));
+        break;
+      case 'c':
+        Value  = VA_ARG (Marker, UINTN);
+        Stored = TraceStore (Data, DataSize, &Length, &Value, sizeof (Value));
+        break;
+      case 'r':
+        Value  = VA_ARG (Marker, RETURN_STATUS);
+        Stored = TraceStore (Data, DataSize, &Length, &Value, sizeof (Value));
+        break;
+      case 'a':
+        Stored = TraceString (Data, DataSize, &Length, VA_ARG (Marker, CHAR8 *), FALSE, Precision);
+        break;
+      case 's':
+      case 'S':
+        Stored = TraceString (Data, DataSize, &Length, VA_ARG (Marker, CHAR16 *), TRUE, Precision);
+        break;
+      case 'g':
+        Stored = TracePointer (Data, DataSize, &Length, VA_ARG (Marker, GUID *), sizeof (GUID));
+        break;
+      case 't':
+        Stored = TracePointer (Data, DataSize, &Length, VA_ARG (Marker, EFI_TIME *), sizeof (EFI_TIME));
+        break;
+      case '\0':
+        return Length;
+      default:
+        break;
+    }
+
+    if (!Stored) {
+      *Truncated = TRUE;
+      break;
+    }
+
+    ++FormatString;
+  }
+
+  return Length;
+}
+
+/**
+  Copy data to the trace ring buffer. Caller must ensure there is space.
+
+  @param[in,out] Private   Log private data.
+  @param[in]     Data      Data to copy.
+  @param[in]     DataSize  Data size.
+**/
+STATIC
+VOID
+TraceRingWrite (
+  IN OUT OC_LOG_PRIVATE_DATA  *Private,
+  IN     CONST VOID           *Data,
+  IN     UINTN                DataSize
+  )
+{
+  UINTN  Offset;
+  UINTN  Size;
+
+  Offset = Private->TraceHead & (OC_LOG_TRACE_BUFFER_SIZE - 1);
+  Size   = MIN (DataSize, OC_LOG_TRACE_BUFFER_SIZE - Offset);
+
+  CopyMem (&Private->TraceBuffer[Offset], Data, Size);
+  if (Size < DataSize) {
+    CopyMem (Private->TraceBuffer, (CONST UINT8 *) Data + Size, DataSize - Size);
+  }
+
+  //
+  // Update head last, the flush timer may read it at any point.
+  //
+  Private->TraceHead += DataSize;
+}
+
+/**
+  Record trace entry into the ring buffer. No formatting is done here,
+  only the timestamp, format string address, and raw arguments are saved.
+  Entries are dropped when the ring buffer has no space left, dropped entry
+  count is recorded once space becomes available.
+
+  @param[in,out] Private       Log private data.
+  @param[in]     ErrorLevel    Debug level.
+  @param[in]     FormatString  Format string.
+  @param[in]     Marker        Format arguments.
+**/
+STATIC
+VOID
+AddTraceEntry (
+  IN OUT OC_LOG_PRIVATE_DATA  *Private,
+  IN     UINTN                ErrorLevel,
+  IN     CONST CHAR8          *FormatString,
+  IN     VA_LIST              Marker
+  )
+{
+  UINT64               Entry[OC_LOG_TRACE_ENTRY_SIZE / sizeof (UINT64)];
+  OC_LOG_TRACE_RECORD  *Record;
+  OC_LOG_TRACE_RECORD  Lost;
+  BOOLEAN              Truncated;
+  UINTN                Size;
+  EFI_TPL              OldTpl;
+
+  Record = (OC_LOG_TRACE_RECORD *) Entry;
+  Size   = TraceArguments (
+    (UINT8 *) (Record + 1),
+    sizeof (Entry) - sizeof (*Record),
+    FormatString,
+    Marker,
+    &Truncated
+    );
+
+  Record->Size       = (UINT16) (sizeof (*Record) + Size);
+  Record->Type       = OC_LOG_TRACE_RECORD_ENTRY;
+  Record->Flags      = Truncated ? OC_LOG_TRACE_FLAG_TRUNCATED : 0;
+  Record->ErrorLevel = (UINT32) ErrorLevel;
+  Record->Tsc        = AsmReadTsc ();
+  Record->Address    = (UINTN) FormatString;
+
+  //
+  // Serialise ring buffer access with nested log calls.
+  //
+  OldTpl = gBS->RaiseTPL (TPL_HIGH_LEVEL);
+
+  Size = Record->Size;
+  if (Private->TraceLost > 0) {
+    Size += sizeof (Lost);
+  }
+
+  if (Private->TraceHead - Private->TraceFlushed + Size > OC_LOG_TRACE_BUFFER_SIZE) {
+    ++Private->TraceLost;
+  } else {
+    if (Private->TraceLost > 0) {
+      ZeroMem (&Lost, sizeof (Lost));
+      Lost.Size       = sizeof (Lost);
+      Lost.Type       = OC_LOG_TRACE_RECORD_LOST;
+      Lost.ErrorLevel = Private->TraceLost;
+      Lost.Tsc        = Record->Tsc;
+      TraceRingWrite (Private, &Lost, sizeof (Lost));
+      Private->TraceLost = 0;
+    }
+
+    TraceRingWrite (Private, Record, Record->Size);
+  }
+
+  gBS->RestoreTPL (OldTpl);
+}
+
+/**
+  Write trace header to an empty trace file.
+
+  @param[in,out] Private  Log private data.
+  @param[in]     File     Trace file at position 0.
+
+  @retval EFI_SUCCESS on success.
+**/
+STATIC
+EFI_STATUS
+WriteTraceHeader (
+  IN OUT OC_LOG_PRIVATE_DATA  *Private,
+  IN     EFI_FILE_PROTOCOL    *File
+  )
+{
+  EFI_STATUS           Status;
+  OC_LOG_TRACE_HEADER  Header;
+  UINTN                Size;
+
+  Header.Signature    = OC_LOG_TRACE_SIGNATURE;
+  Header.Version      = OC_LOG_TRACE_VERSION;
+  Header.PointerSize  = sizeof (UINTN);
+  Header.TscFrequency = Private->TscFrequency;
+  Header.TscStart     = Private->TscStart;
+
+  Size   = sizeof (Header);
+  Status = File->Write (File, &Size, &Header);
+  if (!EFI_ERROR (Status)) {
+    Private->FileWrittenLength += Size;
+  }
+
+  return Status;
+}
+
+/**
+  Write module records for all loaded images not yet written to the trace
+  file. These are needed to resolve format string addresses offline.
+
+  @param[in,out] Private  Log private data.
+  @param[in]     File     Trace file at the current end.
+
+  @retval EFI_SUCCESS on success.
+**/
+STATIC
+EFI_STATUS
+WriteTraceModules (
+  IN OUT OC_LOG_PRIVATE_DATA  *Private,
+  IN     EFI_FILE_PROTOCOL    *File
+  )
+{
+  EFI_STATUS                 Status;
+  EFI_HANDLE                 *Handles;
+  UINTN                      HandleCount;
+  UINTN                      Index;
+  UINT32                     Module;
+  EFI_LOADED_IMAGE_PROTOCOL  *LoadedImage;
+  CONST CHAR8                *PdbPath;
+  OC_LOG_TRACE_RECORD        Record;
+  UINTN                      PathLength;
+  UINTN                      Size;
+
+  Status = gBS->LocateHandleBuffer (
+    ByProtocol,
+    &gEfiLoadedImageProtocolGuid,
+    NULL,
+    &HandleCount,
+    &Handles
+    );
+  if (EFI_ERROR (Status)) {
+    return EFI_SUCCESS;
+  }
+
+  for (Index = 0; Index < HandleCount && Private->TraceModuleCount < OC_LOG_TRACE_MAX_MODULES; ++Index) {
+    Status = gBS->HandleProtocol (
+      Handles[Index],
+      &gEfiLoadedImageProtocolGuid,
+      (VOID **) &LoadedImage
+      );
+    if (EFI_ERROR (Status) || LoadedImage->ImageBase == NULL) {
+      continue;
+    }
+
+    for (Module = 0; Module < Private->TraceModuleCount; ++Module) {
+      if (Private->TraceModules[Module] == (UINTN) LoadedImage->ImageBase) {
+        break;
+      }
+    }
+
+    if (Module < Private->TraceModuleCount) {
+      continue;
+    }
+
+    PdbPath    = PeCoffLoaderGetPdbPointer (LoadedImage->ImageBase);
+    PathLength = PdbPath != NULL ? AsciiStrnLenS (PdbPath, MAX_UINT16 - sizeof (Record)) : 0;
+
+    ZeroMem (&Record, sizeof (Record));
+    Record.Size    = (UINT16) (sizeof (Record) + PathLength);
+    Record.Type    = OC_LOG_TRACE_RECORD_MODULE;
+    Record.Tsc     = LoadedImage->ImageSize;
+    Record.Address = (UINTN) LoadedImage->ImageBase;
+
+    Size   = sizeof (Record);
+    Status = File->Write (File, &Size, &Record);
+    if (!EFI_ERROR (Status) && PathLength > 0) {
+      Size   = PathLength;
+      Status = File->Write (File, &Size, (VOID *) PdbPath);
+    }
+
+    if (EFI_ERROR (Status)) {
+      break;
+    }
+
+    Private->FileWrittenLength += sizeof (Record) + PathLength;
+    Private->TraceModules[Private->TraceModuleCount++] = (UINTN) LoadedImage->ImageBase;
+  }
+
+  FreePool (Handles);
+  return Status;
+}
+
+/**
+  Write pending trace ring buffer contents to the end of the trace file.
+  Ring space is not released here, as written data may still be lost
+  on file flush.
+
+  @param[in,out] Private  Log private data.
+  @param[in]     File     Trace file at the current end.
+  @param[in,out] Flushed  Ring position written up to.
+
+  @retval EFI_SUCCESS on success.
+**/
+STATIC
+EFI_STATUS
+WriteTraceRing (
+  IN OUT OC_LOG_PRIVATE_DATA  *Private,
+  IN     EFI_FILE_PROTOCOL    *File,
+  IN OUT UINTN                *Flushed
+  )
+{
+  EFI_STATUS  Status;
+  UINTN       Head;
+  UINTN       Offset;
+  UINTN       Size;
+
+  Status = EFI_SUCCESS;
+  Head   = Private->TraceHead;
+
+  while (*Flushed != Head) {
+    Offset = *Flushed & (OC_LOG_TRACE_BUFFER_SIZE - 1);
+    Size   = MIN (Head - *Flushed, OC_LOG_TRACE_BUFFER_SIZE - Offset);
+
+    Status = File->Write (File, &Size, &Private->TraceBuffer[Offset]);
+    if (EFI_ERROR (Status)) {
+      break;
+    }
+
+    Private->FileWrittenLength += Size;
+    *Flushed                   += Size;
+  }
+
+  return Status;
+}
+
+/**
+  Write pending log buffer contents to the end of the log file.
+  Since the log buffer is append-only and the data is written at its own
+  offset, interrupted or repeated writes are harmless.
+  In trace mode pending trace records are written instead.
+
+  @param[in,out] Private  Log private data.
+**/
+STATIC
+VOID
+FlushLogFile (
+  IN OUT OC_LOG_PRIVATE_DATA  *Private
+  )
+{
+  EFI_STATUS         Status;
+  EFI_FILE_PROTOCOL  *File;
+  BOOLEAN            Trace;
+  UINTN              Length;
+  UINTN              Size;
+  UINTN              WrittenLength;
+  UINT32             ModuleCount;
+  UINTN              Flushed;
+
+  if (Private->FileFlushing
+    || Private->OcLog.FileSystem == NULL
+    || (Private->OcLog.Options & OC_LOG_FILE) == 0
+    || EfiGetCurrentTpl () > TPL_CALLBACK) {
+    return;
+  }
+
+  Trace = (Private->OcLog.Options & OC_LOG_TRACE) != 0 && Private->TraceBuffer != NULL;
+
+  if (Trace) {
+    Length = 0;
+    if (Private->FileWrittenLength > 0 && Private->TraceFlushed == Private->TraceHead) {
+      return;
+    }
+  } else {
+    Length = Private->AsciiBufferLength;
+    if ((Private->OcLog.Options & OC_LOG_FILE_REWRITE) != 0
+      || Private->FileWrittenLength >= Length) {
+      return;
+    }
+  }
+
+  Private->FileFlushing = TRUE;
+
+  Status = SafeFileOpen (
+    Private->OcLog.FileSystem,
+    &File,
+    Private->OcLog.FilePath,
+    EFI_FILE_MODE_CREATE | EFI_FILE_MODE_READ | EFI_FILE_MODE_WRITE,
+    0
+    );
+  if (!EFI_ERROR (Status) && Trace && Private->FileWrittenLength == 0) {
+    //
+    // First trace flush writes the header and every module record separately.
+    //
+    Status = CreateBufferedFile (File, 0, OC_BUFFERED_FILE_WRITE_BEHIND_SIZE, TRUE, &File);
+  }
+  if (!EFI_ERROR (Status)) {
+    Status = File->SetPosition (File, Private->FileWrittenLength);
+    if (!EFI_ERROR (Status)) {
+      if (Trace) {
+        WrittenLength = Private->FileWrittenLength;
+        ModuleCount   = Private->TraceModuleCount;
+        Flushed       = Private->TraceFlushed;
+
+        if (Private->FileWrittenLength == 0) {
+          Status = WriteTraceHeader (Private, File);
+        }
+        if (!EFI_ERROR (Status)) {
+          Status = WriteTraceModules (Private, File);
+        }
+        if (!EFI_ERROR (Status)) {
+          WriteTraceRing (Private, File, &Flushed);
+        }
+
+        //
+        // Buffered writes only reach the file on flush, so everything written
+        // is committed after it succeeds and is written again otherwise.
+        //
+        Status = File->Flush (File);
+        if (!EFI_ERROR (Status)) {
+          Private->TraceFlushed = Flushed;
+        } else {
+          Private->FileWrittenLength = WrittenLength;
+          Private->TraceModuleCount  = ModuleCount;
+        }
+      } else {
+        Size   = Length - Private->FileWrittenLength;
+        Status = File->Write (File, &Size, &Private->AsciiBuffer[Private->FileWrittenLength]);
+        if (!EFI_ERROR (Status)) {
+          Private->FileWrittenLength += Size;
+        }
+      }
+    }
+
+    File->Close (File);
+  }
+
+  Private->FileFlushing = FALSE;
+}
+
+STATIC
+VOID
+EFIAPI
+FlushLogFileTimer (
+  IN EFI_EVENT  Event,
+  IN VOID       *Context
+  )
+{
+  FlushLogFile (Context);
+}
+
+/**
+  Stop periodic flushing and flush the log file for the last time,
+  as file access is no longer possible after ExitBootServices.
+**/
+STATIC
+VOID
+EFIAPI
+FlushLogFileExitBootServices (
+  IN EFI_EVENT  Event,
+  IN VOID       *Context
+  )
+{
+  OC_LOG_PRIVATE_DATA  *Private;
+
+  Private = Context;
+
+  if (Private->FileFlushEvent != NULL) {
+    gBS->SetTimer (Private->FileFlushEvent, TimerCancel, 0);
+    gBS->CloseEvent (Private->FileFlushEvent);
+    Private->FileFlushEvent = NULL;
+  }
+
+  FlushLogFile (Private);
+
+  //
+  // The file system is gone, disable flushing on threshold.
+  //
+  Private->OcLog.FileSystem = NULL;
+}
+
+VOID
+OcLogSetFileFlushTimer (
+  IN BOOLEAN  Enable
+  )
+{
+  OC_LOG_PROTOCOL      *OcLog;
+  OC_LOG_PRIVATE_DATA  *Private;
+
+  OcLog = InternalGetOcLog ();
+  if (OcLog == NULL) {
+    return;
+  }
+
+  Private = OC_LOG_PRIVATE_DATA_FROM_OC_LOG_THIS (OcLog);
+  if (Private->FileFlushEvent == NULL) {
+    return;
+  }
+
+  if (Enable) {
+    gBS->SetTimer (Private->FileFlushEvent, TimerPeriodic, OC_LOG_FILE_FLUSH_PERIOD);
+  } else {
+    gBS->SetTimer (Private->FileFlushEvent, TimerCancel, 0);
+    FlushLogFile (Private);
+  }
+}
+
 EFI_STATUS
 EFIAPI
 OcLogAddEntry  (
@@ -168,12 +921,27 @@ OcLogAddEntry  (
     return EFI_SUCCESS;
   }
 
-  AsciiVSPrint (
-    Private->LineBuffer,
-    sizeof (Private->LineBuffer),
-    FormatString,
-    Marker
-    );
+  if ((OcLog->Options & OC_LOG_TRACE) != 0 && Private->TraceBuffer != NULL) {
+    //
+    // Trace mode only records raw arguments, formatting is done offline
+    // by logdecode utility. Other targets are skipped.
+    //
+    AddTraceEntry (Private, ErrorLevel, FormatString, Marker);
+
+    if ((ErrorLevel & (DEBUG_ERROR | DEBUG_WARN)) != 0
+      || Private->TraceHead - Private->TraceFlushed >= OC_LOG_TRACE_FLUSH_THRESHOLD) {
+      FlushLogFile (Private);
+    }
+
+    *Private->LineBuffer = '\0';
+  } else {
+    AsciiVSPrint (
+      Private->LineBuffer,
+      sizeof (Private->LineBuffer),
+      FormatString,
+      Marker
+      );
+  }
 
   //
   // Add Entry.
@@ -279,25 +1047,36 @@ OcLogAddEntry  (
     //
     // Write to internal buffer.
     //
-
-    Status = AsciiStrCatS (Private->AsciiBuffer, Private->AsciiBufferSize, Private->TimingTxt);
-    if (!EFI_ERROR (Status)) {
-      Status = AsciiStrCatS (Private->AsciiBuffer, Private->AsciiBufferSize, Private->LineBuffer);
-    }
+    Status = AppendLogBuffer (
+      Private->AsciiBuffer,
+      Private->AsciiBufferSize,
+      &Private->AsciiBufferLength,
+      Private->TimingTxt,
+      TimingLength,
+      Private->LineBuffer,
+      LineLength
+      );
 
     //
     // Write to a file.
-    // Always overwriting file completely is most reliable.
-    // I know it is slow, but fixed size write is more reliable with broken FAT32 driver.
+    // By default only the appended tail is written in batches.
+    // Overwriting file completely is most reliable, yet very slow,
+    // and is only done on request for broken FAT32 drivers as
+    // fixed size write is more reliable there.
     //
     if ((OcLog->Options & OC_LOG_FILE) != 0 && OcLog->FileSystem != NULL) {
-      if (EfiGetCurrentTpl () <= TPL_CALLBACK) {
-        SetFileData (
-          OcLog->FileSystem,
-          OcLog->FilePath,
-          Private->AsciiBuffer,
-          (UINT32) Private->AsciiBufferSize
-          );
+      if ((OcLog->Options & OC_LOG_FILE_REWRITE) != 0) {
+        if (EfiGetCurrentTpl () <= TPL_CALLBACK) {
+          SetFileData (
+            OcLog->FileSystem,
+            OcLog->FilePath,
+            Private->AsciiBuffer,
+            (UINT32) Private->AsciiBufferSize
+            );
+        }
+      } else if ((ErrorLevel & (DEBUG_ERROR | DEBUG_WARN)) != 0
+        || Private->AsciiBufferLength - Private->FileWrittenLength >= OC_LOG_FILE_FLUSH_THRESHOLD) {
+        FlushLogFile (Private);
       }
     }
 
@@ -309,11 +1088,15 @@ OcLogAddEntry  (
       // Do not log timing information to NVRAM, it is already large.
       // This check is here, because Microsoft is retarded and asserts.
       //
-      if (Private->NvramBufferSize - AsciiStrSize (Private->NvramBuffer) >= AsciiStrLen (Private->LineBuffer)) {
-        Status = AsciiStrCatS (Private->NvramBuffer, Private->NvramBufferSize, Private->LineBuffer);
-      } else {
-        Status = EFI_BUFFER_TOO_SMALL;
-      }
+      Status = AppendLogBuffer (
+        Private->NvramBuffer,
+        Private->NvramBufferSize,
+        &Private->NvramBufferLength,
+        Private->LineBuffer,
+        LineLength,
+        NULL,
+        0
+        );
       if (!EFI_ERROR (Status)) {
         Attributes = EFI_VARIABLE_BOOTSERVICE_ACCESS | EFI_VARIABLE_RUNTIME_ACCESS;
         if ((OcLog->Options & OC_LOG_NONVOLATILE) != 0) {
@@ -324,7 +1107,7 @@ OcLogAddEntry  (
           OC_LOG_VARIABLE_NAME,
           &gOcVendorVariableGuid,
           Attributes,
-          AsciiStrLen (Private->NvramBuffer),
+          Private->NvramBufferLength,
           Private->NvramBuffer
           );
 
@@ -441,10 +1224,23 @@ OcConfigureLogProtocol (
   EFI_HANDLE            Handle;
   EFI_FILE_PROTOCOL     *LogRoot;
   CHAR16                *LogPath;
+  UINT8                 *TraceBuffer;
+
+  //
+  // Binary trace is written to file only.
+  //
+  TraceBuffer = NULL;
+  if ((Options & (OC_LOG_TRACE | OC_LOG_FILE | OC_LOG_ENABLE)) == (OC_LOG_TRACE | OC_LOG_FILE | OC_LOG_ENABLE)) {
+    TraceBuffer = AllocatePool (OC_LOG_TRACE_BUFFER_SIZE);
+  }
+
+  if (TraceBuffer == NULL) {
+    Options &= ~OC_LOG_TRACE;
+  }
 
   if ((Options & (OC_LOG_FILE | OC_LOG_ENABLE)) == (OC_LOG_FILE | OC_LOG_ENABLE)) {
     LogRoot = NULL;
-    LogPath = GetLogPath (LogPrefixPath);
+    LogPath = GetLogPath (LogPrefixPath, (Options & OC_LOG_TRACE) != 0 ? L".bin" : L".txt");
 
     if (LogPath != NULL) {
       if (LogFileSystem != NULL) {
@@ -497,26 +1293,34 @@ OcConfigureLogProtocol (
     OcLog->FileSystem   = LogRoot;
     OcLog->FilePath     = LogPath;
 
+    Private = OC_LOG_PRIVATE_DATA_FROM_OC_LOG_THIS (OcLog);
+    Private->FileWrittenLength = 0;
+    Private->TraceModuleCount  = 0;
+
     Status = EFI_SUCCESS;
   } else {
     Private = AllocateZeroPool (sizeof (*Private));
     Status  = EFI_OUT_OF_RESOURCES;
 
     if (Private != NULL) {
-      Private->Signature          = OC_LOG_PRIVATE_DATA_SIGNATURE;
-      Private->AsciiBufferSize    = OC_LOG_BUFFER_SIZE;
-      Private->NvramBufferSize    = OC_LOG_NVRAM_BUFFER_SIZE;
-      Private->OcLog.Revision     = OC_LOG_REVISION;
-      Private->OcLog.AddEntry     = OcLogAddEntry;
-      Private->OcLog.GetLog       = OcLogGetLog;
-      Private->OcLog.SaveLog      = OcLogSaveLog;
-      Private->OcLog.ResetTimers  = OcLogResetTimers;
-      Private->OcLog.Options      = Options;
-      Private->OcLog.DisplayDelay = DisplayDelay;
-      Private->OcLog.DisplayLevel = DisplayLevel;
-      Private->OcLog.HaltLevel    = HaltLevel;
-      Private->OcLog.FileSystem   = LogRoot;
-      Private->OcLog.FilePath     = LogPath;
+      Private->Signature           = OC_LOG_PRIVATE_DATA_SIGNATURE;
+      Private->AsciiBufferSize     = OC_LOG_BUFFER_SIZE;
+      Private->NvramBufferSize     = OC_LOG_NVRAM_BUFFER_SIZE;
+      Private->OcLog.Revision      = OC_LOG_REVISION;
+      Private->OcLog.AddEntry      = OcLogAddEntry;
+      Private->OcLog.GetLog        = OcLogGetLog;
+      Private->OcLog.SaveLog       = OcLogSaveLog;
+      Private->OcLog.ResetTimers   = OcLogResetTimers;
+      Private->OcLog.ProfileBegin  = OcLogProfileBegin;
+      Private->OcLog.ProfileEnd    = OcLogProfileEnd;
+      Private->OcLog.ProfileReport = OcLogProfileReport;
+      Private->OcLog.Options       = Options;
+      Private->OcLog.DisplayDelay  = DisplayDelay;
+      Private->OcLog.DisplayLevel  = DisplayLevel;
+      Private->OcLog.HaltLevel     = HaltLevel;
+      Private->OcLog.FileSystem    = LogRoot;
+      Private->OcLog.FilePath      = LogPath;
+      Private->ProfileCurrent      = OC_LOG_PROFILE_SPAN_INVALID;
 
       Handle = NULL;
       Status = gBS->InstallProtocolInterface (
@@ -534,19 +1338,101 @@ OcConfigureLogProtocol (
     }
   }
 
+  if (TraceBuffer != NULL) {
+    if (!EFI_ERROR (Status)) {
+      Private = OC_LOG_PRIVATE_DATA_FROM_OC_LOG_THIS (OcLog);
+
+      if (Private->TraceBuffer == NULL) {
+        Private->TraceBuffer = TraceBuffer;
+      } else {
+        FreePool (TraceBuffer);
+      }
+
+      if (Private->TscFrequency == 0) {
+        Private->TscFrequency = OcGetTSCFrequency ();
+        Private->TscStart     = AsmReadTsc ();
+        Private->TscLast      = Private->TscStart;
+      }
+    } else {
+      FreePool (TraceBuffer);
+    }
+  }
+
+  if (!EFI_ERROR (Status) && (Options & OC_LOG_PROFILE) != 0) {
+    Private = OC_LOG_PRIVATE_DATA_FROM_OC_LOG_THIS (OcLog);
+
+    if (Private->ProfileSpans == NULL) {
+      Private->ProfileSpans = AllocatePool (OC_LOG_PROFILE_MAX_SPANS * sizeof (*Private->ProfileSpans));
+    }
+
+    if (Private->TscFrequency == 0) {
+      Private->TscFrequency = OcGetTSCFrequency ();
+      Private->TscStart     = AsmReadTsc ();
+      Private->TscLast      = Private->TscStart;
+    }
+  }
+
   if (LogRoot != NULL) {
     if (!EFI_ERROR (Status)) {
       if ((Options & (OC_LOG_SERIAL | OC_LOG_ENABLE)) == (OC_LOG_SERIAL | OC_LOG_ENABLE)) {
         SerialPortInitialize ();
       }
 
-      if (OC_LOG_PRIVATE_DATA_FROM_OC_LOG_THIS (OcLog)->AsciiBufferSize > 0) {
+      Private = OC_LOG_PRIVATE_DATA_FROM_OC_LOG_THIS (OcLog);
+
+      if ((Options & (OC_LOG_FILE_REWRITE | OC_LOG_TRACE)) == OC_LOG_FILE_REWRITE) {
         SetFileData (
           LogRoot,
           LogPath,
-          OC_LOG_PRIVATE_DATA_FROM_OC_LOG_THIS (OcLog)->AsciiBuffer,
-          (UINT32) OC_LOG_PRIVATE_DATA_FROM_OC_LOG_THIS (OcLog)->AsciiBufferSize
+          Private->AsciiBuffer,
+          (UINT32) Private->AsciiBufferSize
           );
+      } else {
+        FlushLogFile (Private);
+
+        if (Private->FileFlushEvent == NULL) {
+          Status = gBS->CreateEvent (
+            EVT_TIMER | EVT_NOTIFY_SIGNAL,
+            TPL_CALLBACK,
+            FlushLogFileTimer,
+            Private,
+            &Private->FileFlushEvent
+            );
+          if (!EFI_ERROR (Status)) {
+            Status = gBS->SetTimer (
+              Private->FileFlushEvent,
+              TimerPeriodic,
+              OC_LOG_FILE_FLUSH_PERIOD
+              );
+            if (EFI_ERROR (Status)) {
+              gBS->CloseEvent (Private->FileFlushEvent);
+              Private->FileFlushEvent = NULL;
+            }
+          }
+
+          //
+          // Timer is optional, flushing is also done on threshold.
+          //
+          Status = EFI_SUCCESS;
+        }
+
+        if (Private->ExitBootServicesEvent == NULL) {
+          Status = gBS->CreateEvent (
+            EVT_SIGNAL_EXIT_BOOT_SERVICES,
+            TPL_CALLBACK,
+            FlushLogFileExitBootServices,
+            Private,
+            &Private->ExitBootServicesEvent
+            );
+          if (EFI_ERROR (Status)) {
+            Private->ExitBootServicesEvent = NULL;
+          }
+
+          //
+          // Entries logged after the last flush are lost without the event.
+          //
+          Status = EFI_SUCCESS;
+        }
       }
     } else {
       LogRoot->Close (LogRoot);
@@ -24,6 +24,96 @@
 #define OC_LOG_FILE_PATH_BUFFER_SIZE  256
 #define OC_LOG_TIMING_BUFFER_SIZE     64
 
+//
+// Append-only log file is flushed once this amount of data is pending,
+// on warnings and errors, and periodically from a timer.
+//
+#define OC_LOG_FILE_FLUSH_THRESHOLD   BASE_4KB
+#define OC_LOG_FILE_FLUSH_PERIOD      EFI_TIMER_PERIOD_MILLISECONDS (500)
+
+//
+// Binary trace ring buffer size, must be a power of two.
+// Trace is flushed once half of the buffer is pending.
+//
+#define OC_LOG_TRACE_BUFFER_SIZE      BASE_256KB
+#define OC_LOG_TRACE_FLUSH_THRESHOLD  (OC_LOG_TRACE_BUFFER_SIZE / 2)
+#define OC_LOG_TRACE_ENTRY_SIZE       512
+#define OC_LOG_TRACE_MAX_MODULES      64
+
+//
+// Binary trace file format.
+// Must be kept in sync with Utilities/logdecode.
+//
+// The file starts with OC_LOG_TRACE_HEADER followed by a stream of
+// OC_LOG_TRACE_RECORD records, each immediately followed by its data.
+// Records are packed and little endian.
+//
+// OC_LOG_TRACE_RECORD_ENTRY:
+//   Address is the format string address, Tsc is the timestamp.
+//   Data contains the arguments in format string order:
+//   - numeric arguments, '*' width and precision, %c, %p and %r are UINT64,
+//     non-long %d, %x, %X and %u are stored sign-extended from INT32;
+//   - %a, %s, %S are a UINT16 length (MAX_UINT16 for NULL) followed by
+//     ASCII characters (UTF-16 is narrowed, non-ASCII becomes '?');
+//   - %g and %t are a UINT8 presence flag followed by GUID or EFI_TIME
+//     contents when present.
+//   Arguments not fitting OC_LOG_TRACE_ENTRY_SIZE are dropped and
+//   OC_LOG_TRACE_FLAG_TRUNCATED is set.
+//
+// OC_LOG_TRACE_RECORD_MODULE:
+//   Address is the image base, Tsc is the image size, data contains
+//   image PDB path without a null terminator.
+//
+// OC_LOG_TRACE_RECORD_LOST:
+//   ErrorLevel contains the number of entries dropped due to
+//   ring buffer overflow, Tsc is the timestamp.
+//
+#define OC_LOG_TRACE_SIGNATURE       SIGNATURE_32 ('O', 'C', 'T', 'R')
+#define OC_LOG_TRACE_VERSION         1
+
+#define OC_LOG_TRACE_RECORD_ENTRY    0
+#define OC_LOG_TRACE_RECORD_MODULE   1
+#define OC_LOG_TRACE_RECORD_LOST     2
+
+#define OC_LOG_TRACE_FLAG_TRUNCATED  BIT0
+
+#pragma pack(push, 1)
+
+typedef struct {
+  UINT32  Signature;
+  UINT16  Version;
+  UINT16  PointerSize;
+  UINT64  TscFrequency;
+  UINT64  TscStart;
+} OC_LOG_TRACE_HEADER;
+
+typedef struct {
+  UINT16  Size;
+  UINT8   Type;
+  UINT8   Flags;
+  UINT32  ErrorLevel;
+  UINT64  Tsc;
+  UINT64  Address;
+} OC_LOG_TRACE_RECORD;
+
+#pragma pack(pop)
+
+//
+// Boot profiling span storage.
+//
+#define OC_LOG_PROFILE_MAX_SPANS      512
+#define OC_LOG_PROFILE_NAME_SIZE      48
+#define OC_LOG_PROFILE_MAX_DEPTH      16
+#define OC_LOG_PROFILE_SUMMARY_SIZE   BASE_1KB
+
+typedef struct {
+  CHAR8   Name[OC_LOG_PROFILE_NAME_SIZE];
+  UINT64  Start;
+  UINT64  End;
+  UINT32  Parent;
+  UINT32  Depth;
+} OC_LOG_PROFILE_SPAN;
+
 #define OC_LOG_PRIVATE_DATA_SIGNATURE  SIGNATURE_32 ('O', 'C', 'L', 'G')
 
 #define OC_LOG_PRIVATE_DATA_FROM_OC_LOG_THIS(a) \
@@ -39,8 +129,24 @@ typedef struct {
   CHAR16                 UnicodeLineBuffer[OC_LOG_LINE_BUFFER_SIZE];
   CHAR8                  AsciiBuffer[OC_LOG_BUFFER_SIZE];
   UINTN                  AsciiBufferSize;
+  UINTN                  AsciiBufferLength;
   CHAR8                  NvramBuffer[OC_LOG_NVRAM_BUFFER_SIZE];
   UINTN                  NvramBufferSize;
+  UINTN                  NvramBufferLength;
+  UINTN                  FileWrittenLength;
+  EFI_EVENT              FileFlushEvent;
+  EFI_EVENT              ExitBootServicesEvent;
+  BOOLEAN                FileFlushing;
+  UINT8                  *TraceBuffer;
+  UINTN                  TraceHead;
+  UINTN                  TraceFlushed;
+  UINT32                 TraceLost;
+  UINT32                 TraceModuleCount;
+  UINT64                 TraceModules[OC_LOG_TRACE_MAX_MODULES];
+  OC_LOG_PROFILE_SPAN    *ProfileSpans;
+  UINT32                 ProfileSpanCount;
+  UINT32                 ProfileCurrent;
+  BOOLEAN                ProfileReported;
   UINT32                 LogCounter;
   CHAR16                 *LogFilePathName;
   EFI_DATA_HUB_PROTOCOL  *DataHub;
@@ -52,4 +158,24 @@ InternalGetOcLog (
   VOID
   );
 
+UINT32
+EFIAPI
+OcLogProfileBegin (
+  IN OC_LOG_PROTOCOL  *This,
+  IN CONST CHAR8      *Name
+  );
+
+VOID
+EFIAPI
+OcLogProfileEnd (
+  IN OC_LOG_PROTOCOL  *This,
+  IN UINT32           Span
+  );
+
+EFI_STATUS
+EFIAPI
+OcLogProfileReport (
+  IN OC_LOG_PROTOCOL  *This
+  );
+
 #endif // OC_LOG_INTERNAL_H
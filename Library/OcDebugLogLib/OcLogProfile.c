@@ -0,0 +1,443 @@
+/** @file
+  Copyright (C) 2020, vit9696. All rights reserved.
+
+  All rights reserved.
+
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+**/
+
+#include <Uefi.h>
+
+#include <Guid/OcVariable.h>
+
+#include <Protocol/OcLog.h>
+
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/OcDebugLogLib.h>
+#include <Library/OcFileLib.h>
+#include <Library/PrintLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+#include <Library/UefiLib.h>
+#include <Library/UefiRuntimeServicesTableLib.h>
+
+#include "OcLogInternal.h"
+
+/**
+  Replace characters reserved by folded stack and summary formats,
+  so that span names from configuration cannot break the reports.
+
+  @param[in,out] Name  Span name.
+**/
+STATIC
+VOID
+ProfileSanitizeName (
+  IN OUT CHAR8  *Name
+  )
+{
+  while (*Name != '\0') {
+    if ((UINT8) *Name <= ' ' || (UINT8) *Name >= 0x7F || *Name == ';' || *Name == '=') {
+      *Name = '_';
+    }
+    ++Name;
+  }
+}
+
+UINT32
+EFIAPI
+OcLogProfileBegin (
+  IN OC_LOG_PROTOCOL  *This,
+  IN CONST CHAR8      *Name
+  )
+{
+  OC_LOG_PRIVATE_DATA  *Private;
+  OC_LOG_PROFILE_SPAN  *Span;
+  UINT32               Index;
+
+  Private = OC_LOG_PRIVATE_DATA_FROM_OC_LOG_THIS (This);
+
+  if ((This->Options & OC_LOG_PROFILE) == 0
+    || Private->ProfileSpans == NULL
+    || Private->ProfileSpanCount >= OC_LOG_PROFILE_MAX_SPANS) {
+    return OC_LOG_PROFILE_SPAN_INVALID;
+  }
+
+  Index = Private->ProfileSpanCount++;
+  Span  = &Private->ProfileSpans[Index];
+
+  AsciiStrnCpyS (Span->Name, sizeof (Span->Name), Name, sizeof (Span->Name) - 1);
+  ProfileSanitizeName (Span->Name);
+  Span->Parent = Private->ProfileCurrent;
+  Span->Depth  = Span->Parent != OC_LOG_PROFILE_SPAN_INVALID
+    ? Private->ProfileSpans[Span->Parent].Depth + 1 : 0;
+  Span->End    = 0;
+
+  Private->ProfileCurrent = Index;
+
+  //
+  // Read timestamp last to exclude bookkeeping.
+  //
+  Span->Start = AsmReadTsc ();
+
+  return Index;
+}
+
+VOID
+EFIAPI
+OcLogProfileEnd (
+  IN OC_LOG_PROTOCOL  *This,
+  IN UINT32           Span
+  )
+{
+  OC_LOG_PRIVATE_DATA  *Private;
+  UINT64               Tsc;
+  UINT32               Index;
+
+  Tsc     = AsmReadTsc ();
+  Private = OC_LOG_PRIVATE_DATA_FROM_OC_LOG_THIS (This);
+
+  if (Private->ProfileSpans == NULL
+    || Span >= Private->ProfileSpanCount
+    || Private->ProfileSpans[Span].End != 0) {
+    return;
+  }
+
+  //
+  // Any span started later and still running is nested in this one,
+  // end it as well to keep the tree consistent.
+  //
+  for (Index = Span; Index < Private->ProfileSpanCount; ++Index) {
+    if (Private->ProfileSpans[Index].End == 0) {
+      Private->ProfileSpans[Index].End = Tsc;
+    }
+  }
+
+  Private->ProfileCurrent = Private->ProfileSpans[Span].Parent;
+}
+
+/**
+  Convert TSC ticks to microseconds.
+**/
+STATIC
+UINT64
+ProfileTicksToMicroseconds (
+  IN UINT64  Ticks,
+  IN UINT64  Frequency
+  )
+{
+  if ((INT64) Ticks <= 0) {
+    return 0;
+  }
+
+  return DivU64x64Remainder (MultU64x32 (Ticks, 1000000), Frequency, NULL);
+}
+
+/**
+  Build folded stack report, one line per span with its self time
+  in microseconds, e.g. "OcMain;OcLoadAcpiSupport 1234".
+  This format is understood by flamegraph.pl and similar tools.
+
+  @param[in]  Private   Log private data.
+  @param[in]  SelfTime  Span self time in ticks.
+  @param[out] Length    Report length.
+
+  @return  Report allocated from pool or NULL.
+**/
+STATIC
+CHAR8 *
+ProfileBuildReport (
+  IN  OC_LOG_PRIVATE_DATA  *Private,
+  IN  CONST UINT64         *SelfTime,
+  OUT UINTN                *Length
+  )
+{
+  CHAR8   *Report;
+  UINTN   Size;
+  UINTN   Offset;
+  UINT32  Stack[OC_LOG_PROFILE_MAX_DEPTH];
+  UINT32  Depth;
+  UINT32  Index;
+  UINT32  Parent;
+
+  //
+  // Each line is at most MAX_DEPTH names with separators and a number.
+  //
+  Size   = Private->ProfileSpanCount * (OC_LOG_PROFILE_MAX_DEPTH * OC_LOG_PROFILE_NAME_SIZE + 32);
+  Report = AllocatePool (Size);
+  if (Report == NULL) {
+    return NULL;
+  }
+
+  Offset = 0;
+
+  for (Index = 0; Index < Private->ProfileSpanCount; ++Index) {
+    //
+    // Collect the stack from the leaf, deepest frames are kept.
+    //
+    Depth  = OC_LOG_PROFILE_MAX_DEPTH;
+    Parent = Index;
+    while (Parent != OC_LOG_PROFILE_SPAN_INVALID && Depth > 0) {
+      Stack[--Depth] = Parent;
+      Parent = Private->ProfileSpans[Parent].Parent;
+    }
+
+    for (; Depth < OC_LOG_PROFILE_MAX_DEPTH; ++Depth) {
+      Offset += AsciiSPrint (
+        &Report[Offset],
+        Size - Offset,
+        Depth + 1 < OC_LOG_PROFILE_MAX_DEPTH ? "%a;" : "%a",
+        Private->ProfileSpans[Stack[Depth]].Name
+        );
+    }
+
+    Offset += AsciiSPrint (
+      &Report[Offset],
+      Size - Offset,
+      " %Lu\n",
+      ProfileTicksToMicroseconds (SelfTime[Index], Private->TscFrequency)
+      );
+  }
+
+  *Length = Offset;
+  return Report;
+}
+
+/**
+  Build short summary of top level spans in milliseconds,
+  e.g. "OcMain=1520;OcLoadAcpiSupport=12;".
+
+  @param[in]  Private   Log private data.
+  @param[in]  Now       Current timestamp for unfinished spans.
+  @param[out] Summary   Summary buffer.
+  @param[in]  Size      Summary buffer size.
+
+  @return  Summary length.
+**/
+STATIC
+UINTN
+ProfileBuildSummary (
+  IN  OC_LOG_PRIVATE_DATA  *Private,
+  IN  UINT64               Now,
+  OUT CHAR8                *Summary,
+  IN  UINTN                Size
+  )
+{
+  OC_LOG_PROFILE_SPAN  *Span;
+  UINT32               Index;
+  UINTN                Offset;
+  UINTN                Length;
+
+  Offset = 0;
+
+  for (Index = 0; Index < Private->ProfileSpanCount; ++Index) {
+    Span = &Private->ProfileSpans[Index];
+    if (Span->Depth > 1) {
+      continue;
+    }
+
+    Length = AsciiSPrint (
+      &Summary[Offset],
+      Size - Offset,
+      "%a=%Lu;",
+      Span->Name,
+      DivU64x32 (ProfileTicksToMicroseconds ((Span->End != 0 ? Span->End : Now) - Span->Start, Private->TscFrequency), 1000)
+      );
+
+    //
+    // Stop when the summary does not fit, partial entry is discarded.
+    //
+    if (Offset + Length + 1 >= Size) {
+      Summary[Offset] = '\0';
+      break;
+    }
+
+    Offset += Length;
+  }
+
+  return Offset;
+}
+
+/**
+  Get profile report file path from log file path,
+  e.g. opencore-2020-07-04-130500-profile.txt.
+
+  @param[in] LogPath  Log file path.
+
+  @return  Report path allocated from pool or NULL.
+**/
+STATIC
+CHAR16 *
+ProfileGetReportPath (
+  IN CONST CHAR16  *LogPath
+  )
+{
+  CHAR16  *Path;
+  UINTN   Length;
+  UINTN   Size;
+
+  Length = StrLen (LogPath);
+  while (Length > 0 && LogPath[Length - 1] != L'.') {
+    --Length;
+  }
+
+  if (Length == 0) {
+    Length = StrLen (LogPath);
+  } else {
+    --Length;
+  }
+
+  Size = Length * sizeof (CHAR16) + L_STR_SIZE (L"-profile.txt");
+  Path = AllocatePool (Size);
+  if (Path == NULL) {
+    return NULL;
+  }
+
+  CopyMem (Path, LogPath, Length * sizeof (CHAR16));
+  CopyMem (&Path[Length], L"-profile.txt", L_STR_SIZE (L"-profile.txt"));
+  return Path;
+}
+
+EFI_STATUS
+EFIAPI
+OcLogProfileReport (
+  IN OC_LOG_PROTOCOL  *This
+  )
+{
+  EFI_STATUS           Status;
+  OC_LOG_PRIVATE_DATA  *Private;
+  OC_LOG_PROFILE_SPAN  *Span;
+  UINT64               *SelfTime;
+  UINT64               Now;
+  UINT64               Duration;
+  UINT32               Index;
+  CHAR8                *Report;
+  UINTN                ReportLength;
+  CHAR16               *ReportPath;
+  CHAR8                Summary[OC_LOG_PROFILE_SUMMARY_SIZE];
+  UINTN                SummaryLength;
+
+  Now     = AsmReadTsc ();
+  Private = OC_LOG_PRIVATE_DATA_FROM_OC_LOG_THIS (This);
+
+  if (Private->ProfileSpans == NULL || Private->ProfileSpanCount == 0) {
+    return EFI_NOT_READY;
+  }
+
+  if (Private->TscFrequency == 0) {
+    return EFI_UNSUPPORTED;
+  }
+
+  if (Private->ProfileReported) {
+    return EFI_ALREADY_STARTED;
+  }
+
+  Private->ProfileReported = TRUE;
+
+  //
+  // Self time is span duration without the duration of its direct children.
+  // Parents always precede their children.
+  //
+  SelfTime = AllocatePool (Private->ProfileSpanCount * sizeof (*SelfTime));
+  if (SelfTime == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  for (Index = 0; Index < Private->ProfileSpanCount; ++Index) {
+    Span     = &Private->ProfileSpans[Index];
+    Duration = (Span->End != 0 ? Span->End : Now) - Span->Start;
+
+    SelfTime[Index] = Duration;
+    if (Span->Parent != OC_LOG_PROFILE_SPAN_INVALID) {
+      SelfTime[Span->Parent] -= Duration;
+    }
+  }
+
+  Status = EFI_SUCCESS;
+
+  if (This->FileSystem != NULL && This->FilePath != NULL && EfiGetCurrentTpl () <= TPL_CALLBACK) {
+    Report     = ProfileBuildReport (Private, SelfTime, &ReportLength);
+    ReportPath = ProfileGetReportPath (This->FilePath);
+    if (Report != NULL && ReportPath != NULL) {
+      Status = SetFileData (This->FileSystem, ReportPath, Report, (UINT32) ReportLength);
+    } else {
+      Status = EFI_OUT_OF_RESOURCES;
+    }
+
+    if (Report != NULL) {
+      FreePool (Report);
+    }
+    if (ReportPath != NULL) {
+      FreePool (ReportPath);
+    }
+  }
+
+  FreePool (SelfTime);
+
+  SummaryLength = ProfileBuildSummary (Private, Now, Summary, sizeof (Summary));
+  if (SummaryLength > 0) {
+    gRT->SetVariable (
+      OC_LOG_VARIABLE_PROFILE,
+      &gOcVendorVariableGuid,
+      EFI_VARIABLE_BOOTSERVICE_ACCESS | EFI_VARIABLE_RUNTIME_ACCESS,
+      SummaryLength,
+      Summary
+      );
+  }
+
+  DEBUG ((DEBUG_INFO, "OCL: Saved profile of %u spans - %r\n", Private->ProfileSpanCount, Status));
+
+  return Status;
+}
+
+UINT32
+OcProfileBegin (
+  IN CONST CHAR8  *Name
+  )
+{
+  OC_LOG_PROTOCOL  *OcLog;
+
+  OcLog = InternalGetOcLog ();
+  if (OcLog == NULL) {
+    return OC_LOG_PROFILE_SPAN_INVALID;
+  }
+
+  return OcLog->ProfileBegin (OcLog, Name);
+}
+
+VOID
+OcProfileEnd (
+  IN UINT32  Span
+  )
+{
+  OC_LOG_PROTOCOL  *OcLog;
+
+  if (Span == OC_LOG_PROFILE_SPAN_INVALID) {
+    return;
+  }
+
+  OcLog = InternalGetOcLog ();
+  if (OcLog != NULL) {
+    OcLog->ProfileEnd (OcLog, Span);
+  }
+}
+
+VOID
+OcProfileReport (
+  VOID
+  )
+{
+  OC_LOG_PROTOCOL  *OcLog;
+
+  OcLog = InternalGetOcLog ();
+  if (OcLog != NULL && (OcLog->Options & OC_LOG_PROFILE) != 0) {
+    OcLog->ProfileReport (OcLog);
+  }
+}
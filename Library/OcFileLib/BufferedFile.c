@@ -0,0 +1,732 @@
+/** @file
+  Copyright (C) 2020, vit9696. All rights reserved.
+
+  All rights reserved.
+
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+**/
+
+#include <Uefi.h>
+#include <Protocol/SimpleFileSystem.h>
+
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/OcFileLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+
+#define BUFFERED_FILE_DATA_SIGNATURE  \
+  SIGNATURE_32 ('B', 'F', 'F', 'f')
+
+#define BUFFERED_FILE_FROM_PROTOCOL(This) \
+  CR (                            \
+    This,                         \
+    BUFFERED_FILE_DATA,           \
+    Protocol,                     \
+    BUFFERED_FILE_DATA_SIGNATURE  \
+    )
+
+typedef struct {
+  UINT32                  Signature;
+  EFI_FILE_PROTOCOL       *OriginalProtocol;
+  ///
+  /// Current position as seen by the caller.
+  ///
+  UINT64                  Position;
+  ///
+  /// Read-ahead window contains ReadLength bytes from ReadStart.
+  ///
+  UINT8                   *ReadBuffer;
+  UINT32                  ReadBufferSize;
+  UINT32                  ReadLength;
+  UINT64                  ReadStart;
+  ///
+  /// Write-behind buffer contains WriteLength bytes to be written at WriteStart.
+  ///
+  UINT8                   *WriteBuffer;
+  UINT32                  WriteBufferSize;
+  UINT32                  WriteLength;
+  UINT64                  WriteStart;
+  OC_BUFFERED_FILE_STATS  Stats;
+  EFI_FILE_PROTOCOL       Protocol;
+} BUFFERED_FILE_DATA;
+
+STATIC
+EFI_STATUS
+BufferedFileDeviceRead (
+  IN OUT BUFFERED_FILE_DATA  *Data,
+  IN     UINT64              Position,
+  IN OUT UINTN               *Size,
+     OUT VOID                *Buffer
+  )
+{
+  EFI_STATUS  Status;
+
+  Status = Data->OriginalProtocol->SetPosition (Data->OriginalProtocol, Position);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  ++Data->Stats.DeviceReads;
+  Status = Data->OriginalProtocol->Read (Data->OriginalProtocol, Size, Buffer);
+  if (!EFI_ERROR (Status)) {
+    Data->Stats.DeviceReadBytes += *Size;
+  }
+
+  return Status;
+}
+
+STATIC
+EFI_STATUS
+BufferedFileDeviceWrite (
+  IN OUT BUFFERED_FILE_DATA  *Data,
+  IN     UINT64              Position,
+  IN OUT UINTN               *Size,
+  IN     VOID                *Buffer
+  )
+{
+  EFI_STATUS  Status;
+
+  Status = Data->OriginalProtocol->SetPosition (Data->OriginalProtocol, Position);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  ++Data->Stats.DeviceWrites;
+  Status = Data->OriginalProtocol->Write (Data->OriginalProtocol, Size, Buffer);
+  if (!EFI_ERROR (Status)) {
+    Data->Stats.DeviceWriteBytes += *Size;
+  }
+
+  return Status;
+}
+
+STATIC
+EFI_STATUS
+BufferedFileFlushWrites (
+  IN OUT BUFFERED_FILE_DATA  *Data
+  )
+{
+  EFI_STATUS  Status;
+  UINTN       Size;
+
+  if (Data->WriteLength == 0) {
+    return EFI_SUCCESS;
+  }
+
+  //
+  // Pending data is dropped on failure, as there is no way to retry it reliably.
+  //
+  Size              = Data->WriteLength;
+  Data->WriteLength = 0;
+  Status = BufferedFileDeviceWrite (Data, Data->WriteStart, &Size, Data->WriteBuffer);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_INFO, "OCFS: Buffered file failed to write %u bytes - %r\n", (UINT32) Size, Status));
+  }
+
+  return Status;
+}
+
+STATIC
+VOID
+BufferedFileLogStats (
+  IN BUFFERED_FILE_DATA  *Data
+  )
+{
+  DEBUG ((
+    DEBUG_VERBOSE,
+    "OCFS: Buffered file reads %u (%u hits) %Lu bytes in %u (%Lu), writes %u %Lu bytes in %u (%Lu)\n",
+    Data->Stats.Reads,
+    Data->Stats.ReadHits,
+    Data->Stats.ReadBytes,
+    Data->Stats.DeviceReads,
+    Data->Stats.DeviceReadBytes,
+    Data->Stats.Writes,
+    Data->Stats.WriteBytes,
+    Data->Stats.DeviceWrites,
+    Data->Stats.DeviceWriteBytes
+    ));
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+BufferedFileOpen (
+  IN  EFI_FILE_PROTOCOL       *This,
+  OUT EFI_FILE_PROTOCOL       **NewHandle,
+  IN  CHAR16                  *FileName,
+  IN  UINT64                  OpenMode,
+  IN  UINT64                  Attributes
+  )
+{
+  BUFFERED_FILE_DATA  *Data;
+
+  Data = BUFFERED_FILE_FROM_PROTOCOL (This);
+
+  //
+  // New handles are not buffered, the caller may wrap them when needed.
+  //
+  return Data->OriginalProtocol->Open (
+    Data->OriginalProtocol,
+    NewHandle,
+    FileName,
+    OpenMode,
+    Attributes
+    );
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+BufferedFileClose (
+  IN EFI_FILE_PROTOCOL  *This
+  )
+{
+  EFI_STATUS          Status;
+  EFI_STATUS          CloseStatus;
+  BUFFERED_FILE_DATA  *Data;
+
+  Data = BUFFERED_FILE_FROM_PROTOCOL (This);
+
+  Status = BufferedFileFlushWrites (Data);
+  BufferedFileLogStats (Data);
+
+  CloseStatus = Data->OriginalProtocol->Close (
+    Data->OriginalProtocol
+    );
+  FreePool (Data);
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  return CloseStatus;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+BufferedFileDelete (
+  IN EFI_FILE_PROTOCOL  *This
+  )
+{
+  EFI_STATUS          Status;
+  BUFFERED_FILE_DATA  *Data;
+
+  Data = BUFFERED_FILE_FROM_PROTOCOL (This);
+
+  //
+  // No need to write the data of a file being deleted.
+  //
+  Data->WriteLength = 0;
+  BufferedFileLogStats (Data);
+
+  Status = Data->OriginalProtocol->Delete (
+    Data->OriginalProtocol
+    );
+  FreePool (Data);
+
+  return Status;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+BufferedFileRead (
+  IN EFI_FILE_PROTOCOL        *This,
+  IN OUT UINTN                *BufferSize,
+     OUT VOID                 *Buffer
+  )
+{
+  EFI_STATUS          Status;
+  BUFFERED_FILE_DATA  *Data;
+  UINT64              ReadEnd;
+  UINTN               Requested;
+  UINTN               Done;
+  UINTN               Size;
+  BOOLEAN             Hit;
+
+  Data = BUFFERED_FILE_FROM_PROTOCOL (This);
+
+  //
+  // Pending writes must be visible to reads.
+  //
+  Status = BufferedFileFlushWrites (Data);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  ++Data->Stats.Reads;
+
+  Requested = *BufferSize;
+  Done      = 0;
+  Hit       = TRUE;
+
+  while (Done < Requested) {
+    ReadEnd = Data->ReadStart + Data->ReadLength;
+
+    if (Data->Position >= Data->ReadStart && Data->Position < ReadEnd) {
+      Size = (UINTN) MIN (ReadEnd - Data->Position, Requested - Done);
+      CopyMem (
+        (UINT8 *) Buffer + Done,
+        &Data->ReadBuffer[Data->Position - Data->ReadStart],
+        Size
+        );
+      Done           += Size;
+      Data->Position += Size;
+      continue;
+    }
+
+    //
+    // Short read-ahead means that the window ends at the end of file.
+    //
+    if (Data->ReadLength > 0
+      && Data->ReadLength < Data->ReadBufferSize
+      && Data->Position == ReadEnd) {
+      break;
+    }
+
+    Hit = FALSE;
+
+    //
+    // Large requests are read directly into the caller buffer.
+    //
+    if (Requested - Done >= Data->ReadBufferSize) {
+      Size   = Requested - Done;
+      Status = BufferedFileDeviceRead (Data, Data->Position, &Size, (UINT8 *) Buffer + Done);
+      if (!EFI_ERROR (Status)) {
+        Done           += Size;
+        Data->Position += Size;
+      }
+      break;
+    }
+
+    Size   = Data->ReadBufferSize;
+    Status = BufferedFileDeviceRead (Data, Data->Position, &Size, Data->ReadBuffer);
+    if (EFI_ERROR (Status)) {
+      Data->ReadLength = 0;
+      break;
+    }
+
+    Data->ReadStart  = Data->Position;
+    Data->ReadLength = (UINT32) Size;
+
+    if (Size == 0) {
+      break;
+    }
+  }
+
+  if (EFI_ERROR (Status)) {
+    //
+    // Report nothing read, so restore the position.
+    //
+    Data->Position -= Done;
+    return Status;
+  }
+
+  if (Hit && Requested > 0) {
+    ++Data->Stats.ReadHits;
+  }
+
+  Data->Stats.ReadBytes += Done;
+  *BufferSize = Done;
+
+  return EFI_SUCCESS;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+BufferedFileWrite (
+  IN EFI_FILE_PROTOCOL        *This,
+  IN OUT UINTN                *BufferSize,
+  IN VOID                     *Buffer
+  )
+{
+  EFI_STATUS          Status;
+  BUFFERED_FILE_DATA  *Data;
+  UINT64              ReadEnd;
+  UINTN               Size;
+
+  Data = BUFFERED_FILE_FROM_PROTOCOL (This);
+  Size = *BufferSize;
+
+  ++Data->Stats.Writes;
+  Data->Stats.WriteBytes += Size;
+
+  //
+  // Drop read-ahead window when the write changes or extends its data.
+  // Short window also marks the end of file, which moves with writes past it.
+  //
+  ReadEnd = Data->ReadStart + Data->ReadLength;
+  if (Data->ReadLength > 0
+    && Data->Position + Size >= Data->ReadStart
+    && (Data->Position <= ReadEnd || Data->ReadLength < Data->ReadBufferSize)) {
+    Data->ReadLength = 0;
+  }
+
+  //
+  // Only writes continuing the pending data are coalesced.
+  //
+  if (Data->WriteLength > 0
+    && (Data->Position != Data->WriteStart + Data->WriteLength
+      || Size > Data->WriteBufferSize - Data->WriteLength)) {
+    Status = BufferedFileFlushWrites (Data);
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+  }
+
+  if (Size >= Data->WriteBufferSize) {
+    Status = BufferedFileDeviceWrite (Data, Data->Position, &Size, Buffer);
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+
+    Data->Position += Size;
+    *BufferSize     = Size;
+    return EFI_SUCCESS;
+  }
+
+  if (Data->WriteLength == 0) {
+    Data->WriteStart = Data->Position;
+  }
+
+  CopyMem (&Data->WriteBuffer[Data->WriteLength], Buffer, Size);
+  Data->WriteLength += (UINT32) Size;
+  Data->Position    += Size;
+
+  return EFI_SUCCESS;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+BufferedFileSetPosition (
+  IN EFI_FILE_PROTOCOL        *This,
+  IN UINT64                   Position
+  )
+{
+  EFI_STATUS          Status;
+  BUFFERED_FILE_DATA  *Data;
+
+  Data = BUFFERED_FILE_FROM_PROTOCOL (This);
+
+  if (Position != 0xFFFFFFFFFFFFFFFFULL) {
+    //
+    // Seeking past the end of the file is allowed.
+    //
+    Data->Position = Position;
+    return EFI_SUCCESS;
+  }
+
+  //
+  // End of file is only known to the original file.
+  //
+  Status = BufferedFileFlushWrites (Data);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Status = Data->OriginalProtocol->SetPosition (Data->OriginalProtocol, Position);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  return Data->OriginalProtocol->GetPosition (Data->OriginalProtocol, &Data->Position);
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+BufferedFileGetPosition (
+  IN  EFI_FILE_PROTOCOL       *This,
+  OUT UINT64                  *Position
+  )
+{
+  BUFFERED_FILE_DATA  *Data;
+
+  Data = BUFFERED_FILE_FROM_PROTOCOL (This);
+
+  *Position = Data->Position;
+  return EFI_SUCCESS;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+BufferedFileGetInfo (
+  IN  EFI_FILE_PROTOCOL       *This,
+  IN  EFI_GUID                *InformationType,
+  IN  OUT UINTN               *BufferSize,
+  OUT VOID                    *Buffer
+  )
+{
+  EFI_STATUS          Status;
+  BUFFERED_FILE_DATA  *Data;
+
+  Data = BUFFERED_FILE_FROM_PROTOCOL (This);
+
+  //
+  // File size must account for pending writes.
+  //
+  Status = BufferedFileFlushWrites (Data);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  return Data->OriginalProtocol->GetInfo (
+    Data->OriginalProtocol,
+    InformationType,
+    BufferSize,
+    Buffer
+    );
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+BufferedFileSetInfo (
+  IN EFI_FILE_PROTOCOL        *This,
+  IN EFI_GUID                 *InformationType,
+  IN UINTN                    BufferSize,
+  IN VOID                     *Buffer
+  )
+{
+  EFI_STATUS          Status;
+  BUFFERED_FILE_DATA  *Data;
+
+  Data = BUFFERED_FILE_FROM_PROTOCOL (This);
+
+  Status = BufferedFileFlushWrites (Data);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  //
+  // File size may change.
+  //
+  Data->ReadLength = 0;
+
+  return Data->OriginalProtocol->SetInfo (
+    Data->OriginalProtocol,
+    InformationType,
+    BufferSize,
+    Buffer
+    );
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+BufferedFileFlush (
+  IN EFI_FILE_PROTOCOL        *This
+  )
+{
+  EFI_STATUS          Status;
+  BUFFERED_FILE_DATA  *Data;
+
+  Data = BUFFERED_FILE_FROM_PROTOCOL (This);
+
+  Status = BufferedFileFlushWrites (Data);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  return Data->OriginalProtocol->Flush (
+    Data->OriginalProtocol
+    );
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+BufferedFileOpenEx (
+  IN     EFI_FILE_PROTOCOL    *This,
+  OUT    EFI_FILE_PROTOCOL    **NewHandle,
+  IN     CHAR16               *FileName,
+  IN     UINT64               OpenMode,
+  IN     UINT64               Attributes,
+  IN OUT EFI_FILE_IO_TOKEN    *Token
+  )
+{
+  EFI_STATUS  Status;
+
+  //
+  // Asynchronous interface is implemented synchronously.
+  //
+  Status = BufferedFileOpen (
+    This,
+    NewHandle,
+    FileName,
+    OpenMode,
+    Attributes
+    );
+
+  if (!EFI_ERROR (Status) && Token->Event != NULL) {
+    Token->Status = EFI_SUCCESS;
+    gBS->SignalEvent (Token->Event);
+  }
+
+  return Status;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+BufferedFileReadEx (
+  IN EFI_FILE_PROTOCOL      *This,
+  IN OUT EFI_FILE_IO_TOKEN  *Token
+  )
+{
+  EFI_STATUS  Status;
+
+  Status = BufferedFileRead (This, &Token->BufferSize, Token->Buffer);
+
+  if (!EFI_ERROR (Status) && Token->Event != NULL) {
+    Token->Status = EFI_SUCCESS;
+    gBS->SignalEvent (Token->Event);
+  }
+
+  return Status;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+BufferedFileWriteEx (
+  IN EFI_FILE_PROTOCOL      *This,
+  IN OUT EFI_FILE_IO_TOKEN  *Token
+  )
+{
+  EFI_STATUS  Status;
+
+  Status = BufferedFileWrite (This, &Token->BufferSize, Token->Buffer);
+
+  if (!EFI_ERROR (Status) && Token->Event != NULL) {
+    Token->Status = EFI_SUCCESS;
+    gBS->SignalEvent (Token->Event);
+  }
+
+  return Status;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+BufferedFileFlushEx (
+  IN EFI_FILE_PROTOCOL      *This,
+  IN OUT EFI_FILE_IO_TOKEN  *Token
+  )
+{
+  EFI_STATUS  Status;
+
+  Status = BufferedFileFlush (This);
+
+  if (!EFI_ERROR (Status) && Token->Event != NULL) {
+    Token->Status = EFI_SUCCESS;
+    gBS->SignalEvent (Token->Event);
+  }
+
+  return Status;
+}
+
+STATIC
+CONST
+EFI_FILE_PROTOCOL
+mBufferedFileProtocolTemplate = {
+  .Revision    = EFI_FILE_PROTOCOL_REVISION2,
+  .Open        = BufferedFileOpen,
+  .Close       = BufferedFileClose,
+  .Delete      = BufferedFileDelete,
+  .Read        = BufferedFileRead,
+  .Write       = BufferedFileWrite,
+  .GetPosition = BufferedFileGetPosition,
+  .SetPosition = BufferedFileSetPosition,
+  .GetInfo     = BufferedFileGetInfo,
+  .SetInfo     = BufferedFileSetInfo,
+  .Flush       = BufferedFileFlush,
+  .OpenEx      = BufferedFileOpenEx,
+  .ReadEx      = BufferedFileReadEx,
+  .WriteEx     = BufferedFileWriteEx,
+  .FlushEx     = BufferedFileFlushEx
+};
+
+EFI_STATUS
+CreateBufferedFile (
+  IN  EFI_FILE_PROTOCOL  *OriginalFile,
+  IN  UINT32             ReadAheadSize,
+  IN  UINT32             WriteBehindSize,
+  IN  BOOLEAN            CloseOnFailure,
+  OUT EFI_FILE_PROTOCOL  **File
+  )
+{
+  EFI_STATUS          Status;
+  BUFFERED_FILE_DATA  *Data;
+  UINT64              Position;
+
+  ASSERT (OriginalFile != NULL);
+  ASSERT (File != NULL);
+
+  Data   = NULL;
+  Status = OriginalFile->GetPosition (OriginalFile, &Position);
+
+  if (!EFI_ERROR (Status)) {
+    //
+    // Both buffers follow the private data in a single allocation.
+    //
+    Data = AllocatePool (sizeof (BUFFERED_FILE_DATA) + (UINTN) ReadAheadSize + WriteBehindSize);
+    if (Data == NULL) {
+      Status = EFI_OUT_OF_RESOURCES;
+    }
+  }
+
+  if (EFI_ERROR (Status)) {
+    if (CloseOnFailure) {
+      OriginalFile->Close (OriginalFile);
+    }
+    return Status;
+  }
+
+  ZeroMem (Data, sizeof (*Data));
+  Data->Signature        = BUFFERED_FILE_DATA_SIGNATURE;
+  Data->OriginalProtocol = OriginalFile;
+  Data->Position         = Position;
+  Data->ReadBuffer       = (UINT8 *) (Data + 1);
+  Data->ReadBufferSize   = ReadAheadSize;
+  Data->WriteBuffer      = Data->ReadBuffer + ReadAheadSize;
+  Data->WriteBufferSize  = WriteBehindSize;
+  CopyMem (&Data->Protocol, &mBufferedFileProtocolTemplate, sizeof (Data->Protocol));
+
+  *File = &Data->Protocol;
+
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+GetBufferedFileStats (
+  IN  EFI_FILE_PROTOCOL       *File,
+  OUT OC_BUFFERED_FILE_STATS  *Stats
+  )
+{
+  BUFFERED_FILE_DATA  *Data;
+
+  ASSERT (File != NULL);
+  ASSERT (Stats != NULL);
+
+  if (File->Read != BufferedFileRead) {
+    return EFI_UNSUPPORTED;
+  }
+
+  Data = BUFFERED_FILE_FROM_PROTOCOL (File);
+  CopyMem (Stats, &Data->Stats, sizeof (*Stats));
+
+  return EFI_SUCCESS;
+}
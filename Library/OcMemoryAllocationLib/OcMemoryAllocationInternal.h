@@ -0,0 +1,69 @@
+/** @file
+  Copyright (C) 2020, vit9696. All rights reserved.
+
+  All rights reserved.
+
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+**/
+
+#ifndef OC_MEMORY_ALLOCATION_INTERNAL_H
+#define OC_MEMORY_ALLOCATION_INTERNAL_H
+
+#include <Library/OcMemoryAllocationLib.h>
+
+/**
+  Allocate block from slabs.
+
+  @param[in]  Size  Allocation size in bytes.
+
+  @retval Allocated block or NULL when the allocation needs to be served by firmware.
+**/
+VOID *
+InternalSlabAllocate (
+  IN UINTN  Size
+  );
+
+/**
+  Free block previously allocated from slabs.
+
+  @param[in]  Buffer  Block to free.
+
+  @retval TRUE when the block belongs to slabs and was freed.
+**/
+BOOLEAN
+InternalSlabFree (
+  IN VOID  *Buffer
+  );
+
+/**
+  Resize block allocated from slabs in place when it has enough room.
+  The memory after OldSize is zeroed.
+
+  @param[in]  Buffer   Block to resize.
+  @param[in]  OldSize  Current allocation size in bytes.
+  @param[in]  NewSize  New allocation size in bytes.
+
+  @retval TRUE when the block belongs to slabs and fits NewSize.
+**/
+BOOLEAN
+InternalSlabReallocateInPlace (
+  IN VOID   *Buffer,
+  IN UINTN  OldSize,
+  IN UINTN  NewSize
+  );
+
+/**
+  Account pool allocation served by firmware.
+**/
+VOID
+InternalSlabCountFirmwareAllocation (
+  VOID
+  );
+
+#endif // OC_MEMORY_ALLOCATION_INTERNAL_H
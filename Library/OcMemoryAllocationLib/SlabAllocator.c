@@ -0,0 +1,436 @@
+/** @file
+  Copyright (C) 2020, vit9696. All rights reserved.
+
+  All rights reserved.
+
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+**/
+
+#include <Uefi.h>
+
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/OcMemoryLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+
+#include "OcMemoryAllocationInternal.h"
+
+//
+// Arena pages are assigned to a single size class each when first needed.
+//
+typedef struct {
+  UINT8   *Base;
+  UINT32  UsedPages;
+  UINT8   PageClass[OC_SLAB_ARENA_PAGES];
+} OC_SLAB_ARENA;
+
+//
+// Free blocks are linked through their first bytes.
+//
+typedef struct OC_SLAB_FREE_BLOCK_ {
+  struct OC_SLAB_FREE_BLOCK_  *Next;
+} OC_SLAB_FREE_BLOCK;
+
+STATIC OC_SLAB_ARENA               mSlabArenas[OC_SLAB_MAX_ARENAS];
+STATIC OC_SLAB_FREE_BLOCK          *mSlabFreeBlocks[OC_SLAB_CLASS_COUNT];
+STATIC UINTN                       mSlabLowAddress = MAX_UINTN;
+STATIC UINTN                       mSlabHighAddress;
+STATIC OC_MEMORY_ALLOCATION_STATS  mSlabStats;
+
+//
+// Set while allocating an arena. Arena allocation obtains the memory map,
+// which requires pool memory that must be served by firmware.
+//
+STATIC BOOLEAN                     mSlabGrowing;
+
+//
+// Set when no more arenas can be allocated.
+//
+STATIC BOOLEAN                     mSlabExhausted;
+
+//
+// Boot services FreePool replaced by SlabFreePool.
+//
+STATIC EFI_FREE_POOL               mSlabOriginalFreePool;
+
+STATIC
+UINT32
+SlabSizeToClass (
+  IN UINTN  Size
+  )
+{
+  if (Size <= (1U << OC_SLAB_MIN_BLOCK_SHIFT)) {
+    return 0;
+  }
+
+  return (UINT32) HighBitSet32 ((UINT32) Size - 1) + 1 - OC_SLAB_MIN_BLOCK_SHIFT;
+}
+
+/**
+  Boot services FreePool override returning slab blocks to slabs.
+  Slab blocks may end up in other modules, e.g. as protocol outputs,
+  which free them with gBS->FreePool.
+**/
+STATIC
+EFI_STATUS
+EFIAPI
+SlabFreePool (
+  IN VOID  *Buffer
+  )
+{
+  if (InternalSlabFree (Buffer)) {
+    return EFI_SUCCESS;
+  }
+
+  return mSlabOriginalFreePool (Buffer);
+}
+
+STATIC
+VOID
+SlabInstallFreePool (
+  VOID
+  )
+{
+  EFI_TPL  OldTpl;
+
+  OldTpl = gBS->RaiseTPL (TPL_HIGH_LEVEL);
+
+  mSlabOriginalFreePool = gBS->FreePool;
+  gBS->FreePool         = SlabFreePool;
+
+  gBS->Hdr.CRC32 = 0;
+  gBS->Hdr.CRC32 = CalculateCrc32 (gBS, gBS->Hdr.HeaderSize);
+
+  gBS->RestoreTPL (OldTpl);
+}
+
+STATIC
+OC_SLAB_ARENA *
+SlabAddArena (
+  VOID
+  )
+{
+  EFI_STATUS            Status;
+  EFI_PHYSICAL_ADDRESS  Address;
+  OC_SLAB_ARENA         *Arena;
+
+  if (mSlabExhausted) {
+    return NULL;
+  }
+
+  if (mSlabStats.Arenas == OC_SLAB_MAX_ARENAS) {
+    DEBUG ((DEBUG_INFO, "OCMA: Slab arena limit reached, using firmware pool\n"));
+    mSlabExhausted = TRUE;
+    return NULL;
+  }
+
+  //
+  // Allocate below 4 GB as some firmwares expect pool memory there.
+  //
+  Address      = BASE_4GB;
+  mSlabGrowing = TRUE;
+  Status = OcAllocatePagesFromTop (
+    EfiBootServicesData,
+    OC_SLAB_ARENA_PAGES,
+    &Address,
+    NULL,
+    NULL
+    );
+  mSlabGrowing = FALSE;
+
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_INFO, "OCMA: Slab arena allocation failure, using firmware pool - %r\n", Status));
+    mSlabExhausted = TRUE;
+    return NULL;
+  }
+
+  Arena            = &mSlabArenas[mSlabStats.Arenas];
+  Arena->Base      = (UINT8 *)(UINTN) Address;
+  Arena->UsedPages = 0;
+
+  mSlabLowAddress  = MIN (mSlabLowAddress, (UINTN) Address);
+  mSlabHighAddress = MAX (mSlabHighAddress, (UINTN) Address + EFI_PAGES_TO_SIZE (OC_SLAB_ARENA_PAGES));
+
+  ++mSlabStats.Arenas;
+  mSlabStats.ArenaBytes += EFI_PAGES_TO_SIZE (OC_SLAB_ARENA_PAGES);
+
+  if (mSlabOriginalFreePool == NULL) {
+    SlabInstallFreePool ();
+  }
+
+  DEBUG ((DEBUG_VERBOSE, "OCMA: Slab arena %u at %LX\n", mSlabStats.Arenas, Address));
+
+  return Arena;
+}
+
+STATIC
+BOOLEAN
+SlabRefill (
+  IN UINT32  Class
+  )
+{
+  OC_SLAB_ARENA       *Arena;
+  UINT8               *Page;
+  UINT32              BlockSize;
+  UINT32              Offset;
+  OC_SLAB_FREE_BLOCK  *Block;
+
+  //
+  // Arenas are filled sequentially, so only the last one may have free pages.
+  //
+  Arena = NULL;
+  if (mSlabStats.Arenas > 0
+    && mSlabArenas[mSlabStats.Arenas - 1].UsedPages < OC_SLAB_ARENA_PAGES) {
+    Arena = &mSlabArenas[mSlabStats.Arenas - 1];
+  }
+
+  if (Arena == NULL) {
+    Arena = SlabAddArena ();
+    if (Arena == NULL) {
+      return FALSE;
+    }
+  }
+
+  Page = Arena->Base + EFI_PAGES_TO_SIZE (Arena->UsedPages);
+  Arena->PageClass[Arena->UsedPages] = (UINT8) Class;
+  ++Arena->UsedPages;
+
+  //
+  // Link blocks in reverse, so that they are handed out in address order.
+  //
+  BlockSize = 1U << (Class + OC_SLAB_MIN_BLOCK_SHIFT);
+  Offset    = EFI_PAGE_SIZE;
+  while (Offset > 0) {
+    Offset -= BlockSize;
+    Block       = (OC_SLAB_FREE_BLOCK *) (Page + Offset);
+    Block->Next = mSlabFreeBlocks[Class];
+    mSlabFreeBlocks[Class] = Block;
+  }
+
+  mSlabStats.SlabBytes         += EFI_PAGE_SIZE;
+  mSlabStats.FreeBlocks[Class] += EFI_PAGE_SIZE / BlockSize;
+
+  return TRUE;
+}
+
+STATIC
+OC_SLAB_ARENA *
+SlabFindArena (
+  IN VOID  *Buffer
+  )
+{
+  UINT32  Index;
+
+  if ((UINTN) Buffer < mSlabLowAddress || (UINTN) Buffer >= mSlabHighAddress) {
+    return NULL;
+  }
+
+  for (Index = 0; Index < mSlabStats.Arenas; ++Index) {
+    if ((UINT8 *) Buffer >= mSlabArenas[Index].Base
+      && (UINT8 *) Buffer < mSlabArenas[Index].Base + EFI_PAGES_TO_SIZE (mSlabArenas[Index].UsedPages)) {
+      return &mSlabArenas[Index];
+    }
+  }
+
+  return NULL;
+}
+
+VOID *
+InternalSlabAllocate (
+  IN UINTN  Size
+  )
+{
+  EFI_TPL             OldTpl;
+  UINT32              Class;
+  UINT32              BlockSize;
+  OC_SLAB_FREE_BLOCK  *Block;
+
+  if (Size > OC_SLAB_MAX_BLOCK_SIZE || mSlabGrowing) {
+    return NULL;
+  }
+
+  Class     = SlabSizeToClass (Size);
+  BlockSize = 1U << (Class + OC_SLAB_MIN_BLOCK_SHIFT);
+
+  OldTpl = gBS->RaiseTPL (TPL_NOTIFY);
+
+  if (mSlabFreeBlocks[Class] == NULL && !SlabRefill (Class)) {
+    gBS->RestoreTPL (OldTpl);
+    return NULL;
+  }
+
+  Block = mSlabFreeBlocks[Class];
+  mSlabFreeBlocks[Class] = Block->Next;
+
+  ++mSlabStats.Allocations;
+  mSlabStats.RequestedBytes += Size;
+  mSlabStats.BlockBytes     += BlockSize;
+  mSlabStats.UsedBytes      += BlockSize;
+  mSlabStats.PeakUsedBytes   = MAX (mSlabStats.PeakUsedBytes, mSlabStats.UsedBytes);
+  ++mSlabStats.UsedBlocks[Class];
+  --mSlabStats.FreeBlocks[Class];
+
+  gBS->RestoreTPL (OldTpl);
+
+  return Block;
+}
+
+BOOLEAN
+InternalSlabFree (
+  IN VOID  *Buffer
+  )
+{
+  EFI_TPL             OldTpl;
+  OC_SLAB_ARENA       *Arena;
+  UINTN               Offset;
+  UINT32              Class;
+  OC_SLAB_FREE_BLOCK  *Block;
+
+  //
+  // Avoid raising TPL for firmware pool, as this is called for every FreePool.
+  //
+  if ((UINTN) Buffer < mSlabLowAddress || (UINTN) Buffer >= mSlabHighAddress) {
+    return FALSE;
+  }
+
+  OldTpl = gBS->RaiseTPL (TPL_NOTIFY);
+
+  Arena = SlabFindArena (Buffer);
+  if (Arena == NULL) {
+    gBS->RestoreTPL (OldTpl);
+    return FALSE;
+  }
+
+  Offset = (UINT8 *) Buffer - Arena->Base;
+  Class  = Arena->PageClass[Offset / EFI_PAGE_SIZE];
+  ASSERT ((Offset & ((1U << (Class + OC_SLAB_MIN_BLOCK_SHIFT)) - 1)) == 0);
+
+  Block       = Buffer;
+  Block->Next = mSlabFreeBlocks[Class];
+  mSlabFreeBlocks[Class] = Block;
+
+  ++mSlabStats.Frees;
+  mSlabStats.UsedBytes -= 1U << (Class + OC_SLAB_MIN_BLOCK_SHIFT);
+  --mSlabStats.UsedBlocks[Class];
+  ++mSlabStats.FreeBlocks[Class];
+
+  gBS->RestoreTPL (OldTpl);
+
+  return TRUE;
+}
+
+BOOLEAN
+InternalSlabReallocateInPlace (
+  IN VOID   *Buffer,
+  IN UINTN  OldSize,
+  IN UINTN  NewSize
+  )
+{
+  EFI_TPL        OldTpl;
+  OC_SLAB_ARENA  *Arena;
+  UINTN          BlockSize;
+
+  if ((UINTN) Buffer < mSlabLowAddress || (UINTN) Buffer >= mSlabHighAddress) {
+    return FALSE;
+  }
+
+  Arena = SlabFindArena (Buffer);
+  if (Arena == NULL) {
+    return FALSE;
+  }
+
+  BlockSize = 1U << (Arena->PageClass[((UINT8 *) Buffer - Arena->Base) / EFI_PAGE_SIZE] + OC_SLAB_MIN_BLOCK_SHIFT);
+  if (NewSize > BlockSize) {
+    return FALSE;
+  }
+
+  if (NewSize > OldSize) {
+    ZeroMem ((UINT8 *) Buffer + OldSize, NewSize - OldSize);
+  }
+
+  OldTpl = gBS->RaiseTPL (TPL_NOTIFY);
+
+  //
+  // The block now serves the new request size.
+  //
+  ++mSlabStats.InPlaceReallocations;
+  if (NewSize >= OldSize) {
+    mSlabStats.RequestedBytes += NewSize - OldSize;
+  } else {
+    mSlabStats.RequestedBytes -= MIN (OldSize - NewSize, mSlabStats.RequestedBytes);
+  }
+
+  gBS->RestoreTPL (OldTpl);
+
+  return TRUE;
+}
+
+VOID
+InternalSlabCountFirmwareAllocation (
+  VOID
+  )
+{
+  ++mSlabStats.FirmwareAllocations;
+}
+
+VOID
+OcGetMemoryAllocationStats (
+  OUT OC_MEMORY_ALLOCATION_STATS  *Stats
+  )
+{
+  CopyMem (Stats, &mSlabStats, sizeof (*Stats));
+}
+
+VOID
+OcLogMemoryAllocationStats (
+  VOID
+  )
+{
+  OC_MEMORY_ALLOCATION_STATS  Stats;
+  UINT32                      Class;
+
+  OcGetMemoryAllocationStats (&Stats);
+
+  DEBUG ((
+    DEBUG_INFO,
+    "OCMA: Slab %Lu allocs %Lu frees %Lu in place %Lu firmware\n",
+    Stats.Allocations,
+    Stats.Frees,
+    Stats.InPlaceReallocations,
+    Stats.FirmwareAllocations
+    ));
+
+  //
+  // Internal fragmentation is block space wasted by rounding up to size classes,
+  // external fragmentation is free block space in already carved slabs.
+  //
+  DEBUG ((
+    DEBUG_INFO,
+    "OCMA: Slab used %u KB peak %u KB slabs %u KB arenas %u/%u, internal %u%% external %u%%\n",
+    (UINT32) (Stats.UsedBytes / BASE_1KB),
+    (UINT32) (Stats.PeakUsedBytes / BASE_1KB),
+    (UINT32) (Stats.SlabBytes / BASE_1KB),
+    Stats.Arenas,
+    OC_SLAB_MAX_ARENAS,
+    (UINT32) (Stats.BlockBytes > 0 ? DivU64x64Remainder (
+      MultU64x32 (Stats.BlockBytes - Stats.RequestedBytes, 100), Stats.BlockBytes, NULL) : 0),
+    (UINT32) (Stats.SlabBytes > 0 ? (Stats.SlabBytes - Stats.UsedBytes) * 100 / Stats.SlabBytes : 0)
+    ));
+
+  for (Class = 0; Class < OC_SLAB_CLASS_COUNT; ++Class) {
+    DEBUG ((
+      DEBUG_INFO,
+      "OCMA: Slab class %4u used %6u free %6u\n",
+      1U << (Class + OC_SLAB_MIN_BLOCK_SHIFT),
+      Stats.UsedBlocks[Class],
+      Stats.FreeBlocks[Class]
+      ));
+  }
+}
@@ -208,6 +208,182 @@ OcGetCurrentMemoryMapAlloc (
   return Status;
 }
 
+STATIC
+EFI_MEMORY_DESCRIPTOR *
+OcMemoryDescriptorAt (
+  IN EFI_MEMORY_DESCRIPTOR  *MemoryMap,
+  IN UINTN                  Index,
+  IN UINTN                  DescriptorSize
+  )
+{
+  return (EFI_MEMORY_DESCRIPTOR *) ((UINT8 *) MemoryMap + Index * DescriptorSize);
+}
+
+STATIC
+VOID
+OcSwapMemoryDescriptors (
+  IN OUT EFI_MEMORY_DESCRIPTOR  *First,
+  IN OUT EFI_MEMORY_DESCRIPTOR  *Second,
+  IN     UINTN                  DescriptorSize
+  )
+{
+  UINT64  *FirstWalker;
+  UINT64  *SecondWalker;
+  UINT8   *FirstTail;
+  UINT8   *SecondTail;
+  UINT64  Temp;
+  UINT8   TempTail;
+  UINTN   Index;
+
+  //
+  // Descriptors may be larger than EFI_MEMORY_DESCRIPTOR, swap them as a whole
+  // without an intermediate buffer.
+  //
+  FirstWalker  = (UINT64 *) First;
+  SecondWalker = (UINT64 *) Second;
+  for (Index = 0; Index < DescriptorSize / sizeof (UINT64); ++Index) {
+    Temp                = FirstWalker[Index];
+    FirstWalker[Index]  = SecondWalker[Index];
+    SecondWalker[Index] = Temp;
+  }
+
+  FirstTail  = (UINT8 *) (FirstWalker + Index);
+  SecondTail = (UINT8 *) (SecondWalker + Index);
+  for (Index = 0; Index < DescriptorSize % sizeof (UINT64); ++Index) {
+    TempTail          = FirstTail[Index];
+    FirstTail[Index]  = SecondTail[Index];
+    SecondTail[Index] = TempTail;
+  }
+}
+
+STATIC
+BOOLEAN
+OcIsMemoryMapSorted (
+  IN EFI_MEMORY_DESCRIPTOR  *MemoryMap,
+  IN UINTN                  EntryCount,
+  IN UINTN                  DescriptorSize
+  )
+{
+  EFI_MEMORY_DESCRIPTOR  *PrevDesc;
+  EFI_MEMORY_DESCRIPTOR  *Desc;
+  UINTN                  Index;
+
+  PrevDesc = MemoryMap;
+  for (Index = 1; Index < EntryCount; ++Index) {
+    Desc = NEXT_MEMORY_DESCRIPTOR (PrevDesc, DescriptorSize);
+    if (PrevDesc->PhysicalStart > Desc->PhysicalStart) {
+      return FALSE;
+    }
+
+    PrevDesc = Desc;
+  }
+
+  return TRUE;
+}
+
+STATIC
+VOID
+OcSiftDownMemoryDescriptor (
+  IN OUT EFI_MEMORY_DESCRIPTOR  *MemoryMap,
+  IN     UINTN                  Root,
+  IN     UINTN                  EntryCount,
+  IN     UINTN                  DescriptorSize
+  )
+{
+  EFI_MEMORY_DESCRIPTOR  *RootDesc;
+  EFI_MEMORY_DESCRIPTOR  *ChildDesc;
+  EFI_MEMORY_DESCRIPTOR  *SiblingDesc;
+  UINTN                  Child;
+
+  RootDesc = OcMemoryDescriptorAt (MemoryMap, Root, DescriptorSize);
+
+  while (Root < EntryCount / 2) {
+    Child     = 2 * Root + 1;
+    ChildDesc = OcMemoryDescriptorAt (MemoryMap, Child, DescriptorSize);
+    if (Child + 1 < EntryCount) {
+      SiblingDesc = NEXT_MEMORY_DESCRIPTOR (ChildDesc, DescriptorSize);
+      if (SiblingDesc->PhysicalStart > ChildDesc->PhysicalStart) {
+        ++Child;
+        ChildDesc = SiblingDesc;
+      }
+    }
+
+    if (RootDesc->PhysicalStart >= ChildDesc->PhysicalStart) {
+      break;
+    }
+
+    OcSwapMemoryDescriptors (RootDesc, ChildDesc, DescriptorSize);
+    Root     = Child;
+    RootDesc = ChildDesc;
+  }
+}
+
+STATIC
+VOID
+OcBuildMemoryDescriptorHeap (
+  IN OUT EFI_MEMORY_DESCRIPTOR  *MemoryMap,
+  IN     UINTN                  EntryCount,
+  IN     UINTN                  DescriptorSize
+  )
+{
+  UINTN  Index;
+
+  for (Index = EntryCount / 2; Index > 0; --Index) {
+    OcSiftDownMemoryDescriptor (MemoryMap, Index - 1, EntryCount, DescriptorSize);
+  }
+}
+
+/**
+  Determine the type of two adjacent descriptors joined together.
+
+  @param[in]  PrevDesc  Lower descriptor.
+  @param[in]  Desc      Higher descriptor.
+
+  @retval Joined descriptor type or EfiMaxMemoryType when cannot be joined.
+**/
+STATIC
+UINT32
+OcJoinedMemoryType (
+  IN CONST EFI_MEMORY_DESCRIPTOR  *PrevDesc,
+  IN CONST EFI_MEMORY_DESCRIPTOR  *Desc
+  )
+{
+  BOOLEAN  PrevFree;
+  BOOLEAN  Free;
+
+  if (Desc->Attribute != PrevDesc->Attribute
+    || PrevDesc->PhysicalStart + EFI_PAGES_TO_SIZE (PrevDesc->NumberOfPages) != Desc->PhysicalStart) {
+    return EfiMaxMemoryType;
+  }
+
+  //
+  // It *should* be safe to join this with conventional memory, because the firmware should not use
+  // GetMemoryMap for allocation, and for the kernel it does not matter, since it joins them.
+  //
+  Free = Desc->Type == EfiBootServicesCode
+    || Desc->Type == EfiBootServicesData
+    || Desc->Type == EfiConventionalMemory
+    || Desc->Type == EfiLoaderCode
+    || Desc->Type == EfiLoaderData;
+
+  PrevFree = PrevDesc->Type == EfiBootServicesCode
+    || PrevDesc->Type == EfiBootServicesData
+    || PrevDesc->Type == EfiConventionalMemory
+    || PrevDesc->Type == EfiLoaderCode
+    || PrevDesc->Type == EfiLoaderData;
+
+  if (Free && PrevFree) {
+    return EfiConventionalMemory;
+  }
+
+  if ((Desc->Type == EfiRuntimeServicesCode || Desc->Type == EfiRuntimeServicesData)
+    && Desc->Type == PrevDesc->Type) {
+    return Desc->Type;
+  }
+
+  return EfiMaxMemoryType;
+}
+
 VOID
 OcSortMemoryMap (
   IN UINTN                      MemoryMapSize,
@@ -215,27 +391,31 @@ OcSortMemoryMap (
   IN UINTN                      DescriptorSize
   )
 {
-  EFI_MEMORY_DESCRIPTOR       *MemoryMapEntry;
-  EFI_MEMORY_DESCRIPTOR       *NextMemoryMapEntry;
-  EFI_MEMORY_DESCRIPTOR       *MemoryMapEnd;
-  EFI_MEMORY_DESCRIPTOR       TempMemoryMap;
-
-  MemoryMapEntry = MemoryMap;
-  NextMemoryMapEntry = NEXT_MEMORY_DESCRIPTOR (MemoryMapEntry, DescriptorSize);
-  MemoryMapEnd = (EFI_MEMORY_DESCRIPTOR *) ((UINT8 *) MemoryMap + MemoryMapSize);
-  while (MemoryMapEntry < MemoryMapEnd) {
-    while (NextMemoryMapEntry < MemoryMapEnd) {
-      if (MemoryMapEntry->PhysicalStart > NextMemoryMapEntry->PhysicalStart) {
-        CopyMem (&TempMemoryMap, MemoryMapEntry, sizeof(EFI_MEMORY_DESCRIPTOR));
-        CopyMem (MemoryMapEntry, NextMemoryMapEntry, sizeof(EFI_MEMORY_DESCRIPTOR));
-        CopyMem (NextMemoryMapEntry, &TempMemoryMap, sizeof(EFI_MEMORY_DESCRIPTOR));
-      }
+  UINTN  EntryCount;
+  UINTN  Index;
 
-      NextMemoryMapEntry = NEXT_MEMORY_DESCRIPTOR (NextMemoryMapEntry, DescriptorSize);
-    }
+  EntryCount = MemoryMapSize / DescriptorSize;
+
+  //
+  // Most firmwares already report sorted memory maps.
+  //
+  if (OcIsMemoryMapSorted (MemoryMap, EntryCount, DescriptorSize)) {
+    return;
+  }
 
-    MemoryMapEntry      = NEXT_MEMORY_DESCRIPTOR (MemoryMapEntry, DescriptorSize);
-    NextMemoryMapEntry  = NEXT_MEMORY_DESCRIPTOR (MemoryMapEntry, DescriptorSize);
+  //
+  // Heap sort needs no extra memory, which we cannot allocate in GetMemoryMap
+  // or ExitBootServices hooks.
+  //
+  OcBuildMemoryDescriptorHeap (MemoryMap, EntryCount, DescriptorSize);
+
+  for (Index = EntryCount - 1; Index > 0; --Index) {
+    OcSwapMemoryDescriptors (
+      MemoryMap,
+      OcMemoryDescriptorAt (MemoryMap, Index, DescriptorSize),
+      DescriptorSize
+      );
+    OcSiftDownMemoryDescriptor (MemoryMap, 0, Index, DescriptorSize);
   }
 }
 
@@ -247,13 +427,11 @@ OcShrinkMemoryMap (
   )
 {
   EFI_STATUS              Status;
-  UINTN                   SizeFromDescToEnd;
-  UINT64                  Bytes;
+  UINTN                   EntryCount;
+  UINTN                   Index;
+  UINT32                  Type;
   EFI_MEMORY_DESCRIPTOR   *PrevDesc;
   EFI_MEMORY_DESCRIPTOR   *Desc;
-  BOOLEAN                 CanBeJoinedFree;
-  BOOLEAN                 CanBeJoinedRt;
-  BOOLEAN                 HasEntriesToRemove;
 
   Status = EFI_NOT_FOUND;
 
@@ -261,86 +439,103 @@ OcShrinkMemoryMap (
     return Status;
   }
 
-  PrevDesc           = MemoryMap;
-  Desc               = NEXT_MEMORY_DESCRIPTOR (PrevDesc, DescriptorSize);
-  SizeFromDescToEnd  = *MemoryMapSize - DescriptorSize;
-  *MemoryMapSize     = DescriptorSize;
-  HasEntriesToRemove = FALSE;
-
-  while (SizeFromDescToEnd > 0) {
-    Bytes = EFI_PAGES_TO_SIZE (PrevDesc->NumberOfPages);
-    CanBeJoinedFree = FALSE;
-    CanBeJoinedRt   = FALSE;
-    if (Desc->Attribute == PrevDesc->Attribute
-      && PrevDesc->PhysicalStart + Bytes == Desc->PhysicalStart) {
-      //
-      // It *should* be safe to join this with conventional memory, because the firmware should not use
-      // GetMemoryMap for allocation, and for the kernel it does not matter, since it joins them.
-      //
-      CanBeJoinedFree = (
-          Desc->Type == EfiBootServicesCode
-          || Desc->Type == EfiBootServicesData
-          || Desc->Type == EfiConventionalMemory
-          || Desc->Type == EfiLoaderCode
-          || Desc->Type == EfiLoaderData
-        ) && (
-          PrevDesc->Type == EfiBootServicesCode
-          || PrevDesc->Type == EfiBootServicesData
-          || PrevDesc->Type == EfiConventionalMemory
-          || PrevDesc->Type == EfiLoaderCode
-          || PrevDesc->Type == EfiLoaderData
-        );
-
-      CanBeJoinedRt = (
-          Desc->Type == EfiRuntimeServicesCode
-          && PrevDesc->Type == EfiRuntimeServicesCode
-        ) || (
-          Desc->Type == EfiRuntimeServicesData
-          && PrevDesc->Type == EfiRuntimeServicesData
-        );
-    }
-
-    if (CanBeJoinedFree) {
-      //
-      // Two entries are the same/similar - join them
-      //
-      PrevDesc->Type           = EfiConventionalMemory;
-      PrevDesc->NumberOfPages += Desc->NumberOfPages;
-      HasEntriesToRemove       = TRUE;
-      Status                   = EFI_SUCCESS;
-    } else if (CanBeJoinedRt) {
+  //
+  // Join into PrevDesc and compact the map in place in a single pass.
+  //
+  EntryCount = *MemoryMapSize / DescriptorSize;
+  PrevDesc   = MemoryMap;
+  Desc       = NEXT_MEMORY_DESCRIPTOR (PrevDesc, DescriptorSize);
+
+  for (Index = 1; Index < EntryCount; ++Index) {
+    Type = OcJoinedMemoryType (PrevDesc, Desc);
+    if (Type != EfiMaxMemoryType) {
+      PrevDesc->Type           = Type;
       PrevDesc->NumberOfPages += Desc->NumberOfPages;
-      HasEntriesToRemove       = TRUE;
       Status                   = EFI_SUCCESS;
     } else {
-      //
-      // Cannot be joined - we need to move to next
-      //
-      *MemoryMapSize += DescriptorSize;
-      PrevDesc        = NEXT_MEMORY_DESCRIPTOR (PrevDesc, DescriptorSize);
-      if (HasEntriesToRemove) {
-        //
-        // Have entries between PrevDesc and Desc which are joined to PrevDesc,
-        // we need to copy [Desc, end of list] to PrevDesc + 1
-        //
-        CopyMem (PrevDesc, Desc, SizeFromDescToEnd);
-        Desc = PrevDesc;
-        HasEntriesToRemove = FALSE;
+      PrevDesc = NEXT_MEMORY_DESCRIPTOR (PrevDesc, DescriptorSize);
+      if (PrevDesc != Desc) {
+        CopyMem (PrevDesc, Desc, DescriptorSize);
       }
     }
 
     Desc = NEXT_MEMORY_DESCRIPTOR (Desc, DescriptorSize);
-    SizeFromDescToEnd -= DescriptorSize;
   }
 
+  *MemoryMapSize = (UINTN) ((UINT8 *) NEXT_MEMORY_DESCRIPTOR (PrevDesc, DescriptorSize) - (UINT8 *) MemoryMap);
+
+  return Status;
+}
+
+EFI_STATUS
+OcSortAndShrinkMemoryMap (
+  IN OUT UINTN                  *MemoryMapSize,
+  IN OUT EFI_MEMORY_DESCRIPTOR  *MemoryMap,
+  IN     UINTN                  DescriptorSize
+  )
+{
+  EFI_STATUS              Status;
+  UINTN                   EntryCount;
+  UINTN                   HeapSize;
+  UINTN                   Output;
+  UINT32                  Type;
+  UINT64                  NumberOfPages;
+  EFI_MEMORY_DESCRIPTOR   *Desc;
+  EFI_MEMORY_DESCRIPTOR   *OutputDesc;
+
+  EntryCount = *MemoryMapSize / DescriptorSize;
+
+  if (OcIsMemoryMapSorted (MemoryMap, EntryCount, DescriptorSize)) {
+    return OcShrinkMemoryMap (MemoryMapSize, MemoryMap, DescriptorSize);
+  }
+
+  Status = EFI_NOT_FOUND;
+
+  OcBuildMemoryDescriptorHeap (MemoryMap, EntryCount, DescriptorSize);
+
   //
-  // Handle last entries if they were merged.
+  // Extract descriptors from the highest address, joining each one with the
+  // lowest descriptor produced so far. Output grows downwards from the end of
+  // the map and always stays above the heap.
   //
-  if (HasEntriesToRemove) {
-    *MemoryMapSize += DescriptorSize;
+  Output     = EntryCount;
+  OutputDesc = NULL;
+  for (HeapSize = EntryCount; HeapSize > 0; --HeapSize) {
+    Desc = OcMemoryDescriptorAt (MemoryMap, HeapSize - 1, DescriptorSize);
+    if (HeapSize > 1) {
+      OcSwapMemoryDescriptors (MemoryMap, Desc, DescriptorSize);
+      OcSiftDownMemoryDescriptor (MemoryMap, 0, HeapSize - 1, DescriptorSize);
+    }
+
+    if (OutputDesc != NULL) {
+      Type = OcJoinedMemoryType (Desc, OutputDesc);
+      if (Type != EfiMaxMemoryType) {
+        //
+        // Joined descriptor inherits the lower descriptor just like in OcShrinkMemoryMap.
+        //
+        NumberOfPages = OutputDesc->NumberOfPages;
+        CopyMem (OutputDesc, Desc, DescriptorSize);
+        OutputDesc->Type           = Type;
+        OutputDesc->NumberOfPages += NumberOfPages;
+        Status                     = EFI_SUCCESS;
+        continue;
+      }
+    }
+
+    --Output;
+    OutputDesc = OcMemoryDescriptorAt (MemoryMap, Output, DescriptorSize);
+    if (OutputDesc != Desc) {
+      CopyMem (OutputDesc, Desc, DescriptorSize);
+    }
   }
 
-  return EFI_SUCCESS;
+  if (Output > 0) {
+    CopyMem (MemoryMap, OutputDesc, (EntryCount - Output) * DescriptorSize);
+  }
+
+  *MemoryMapSize = (EntryCount - Output) * DescriptorSize;
+
+  return Status;
 }
 
 EFI_STATUS
@@ -0,0 +1,713 @@
+/** @file
+
+OcPngLib - direct BGRA PNG decoder
+
+Copyright (c) 2020, vit9696
+
+All rights reserved.
+
+This program and the accompanying materials
+are licensed and made available under the terms and conditions of the BSD License
+which accompanies this distribution.  The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+#include <Base.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/OcCompressionLib.h>
+#include <Library/OcGuardLib.h>
+#include <Library/OcPngLib.h>
+#include "lodepng.h"
+
+//
+// PNG scanline filter types.
+//
+#define PNG_FILTER_NONE   0U
+#define PNG_FILTER_SUB    1U
+#define PNG_FILTER_UP     2U
+#define PNG_FILTER_AVG    3U
+#define PNG_FILTER_PAETH  4U
+
+//
+// Byte lane masks for word-parallel arithmetic.
+//
+#define PNG_LANE_LOW7_64  0x7F7F7F7F7F7F7F7FULL
+#define PNG_LANE_HIGH_64  0x8080808080808080ULL
+#define PNG_LANE_LOW7_32  0x7F7F7F7FU
+#define PNG_LANE_HIGH_32  0x80808080U
+#define PNG_LANE_RB_32    0x00FF00FFU
+
+/**
+  Add bytes of two 64-bit words lane-wise modulo 256.
+**/
+STATIC
+UINT64
+PngAddBytes64 (
+  IN UINT64  A,
+  IN UINT64  B
+  )
+{
+  return ((A & PNG_LANE_LOW7_64) + (B & PNG_LANE_LOW7_64)) ^ ((A ^ B) & PNG_LANE_HIGH_64);
+}
+
+/**
+  Add bytes of two 32-bit words lane-wise modulo 256.
+**/
+STATIC
+UINT32
+PngAddBytes32 (
+  IN UINT32  A,
+  IN UINT32  B
+  )
+{
+  return ((A & PNG_LANE_LOW7_32) + (B & PNG_LANE_LOW7_32)) ^ ((A ^ B) & PNG_LANE_HIGH_32);
+}
+
+/**
+  Compute floor ((A + B) / 2) for bytes of two 32-bit words lane-wise.
+**/
+STATIC
+UINT32
+PngAvgBytes32 (
+  IN UINT32  A,
+  IN UINT32  B
+  )
+{
+  return (A & B) + (((A ^ B) >> 1U) & PNG_LANE_LOW7_32);
+}
+
+/**
+  Paeth predictor as defined by PNG specification.
+**/
+STATIC
+UINT8
+PngPaeth (
+  IN INT32  A,
+  IN INT32  B,
+  IN INT32  C
+  )
+{
+  INT32  Pa;
+  INT32  Pb;
+  INT32  Pc;
+
+  Pa = B - C;
+  Pb = A - C;
+  Pc = Pa + Pb;
+
+  Pa = Pa < 0 ? -Pa : Pa;
+  Pb = Pb < 0 ? -Pb : Pb;
+  Pc = Pc < 0 ? -Pc : Pc;
+
+  if (Pa <= Pb && Pa <= Pc) {
+    return (UINT8) A;
+  }
+
+  return (UINT8) (Pb <= Pc ? B : C);
+}
+
+/**
+  Reverse PNG scanline filter in place.
+
+  @param[in]     FilterType  Scanline filter type.
+  @param[in,out] Line        Scanline without filter type byte.
+  @param[in]     Prev        Previous reconstructed scanline or zeroes.
+  @param[in]     LineBytes   Scanline length in bytes.
+  @param[in]     Bpp         Bytes per pixel (1 to 4).
+
+  @retval TRUE on success.
+**/
+STATIC
+BOOLEAN
+PngUnfilterLine (
+  IN     UINT8        FilterType,
+  IN OUT UINT8        *Line,
+  IN     CONST UINT8  *Prev,
+  IN     UINTN        LineBytes,
+  IN     UINTN        Bpp
+  )
+{
+  UINTN   Index;
+  UINT32  Left;
+  UINT32  UpLeft;
+  UINT32  Up;
+
+  switch (FilterType) {
+    case PNG_FILTER_NONE:
+      return TRUE;
+
+    case PNG_FILTER_SUB:
+      if (Bpp == 4) {
+        Left = 0;
+        for (Index = 0; Index < LineBytes; Index += 4) {
+          Left = PngAddBytes32 (ReadUnaligned32 ((UINT32 *) &Line[Index]), Left);
+          WriteUnaligned32 ((UINT32 *) &Line[Index], Left);
+        }
+      } else {
+        for (Index = Bpp; Index < LineBytes; ++Index) {
+          Line[Index] = (UINT8) (Line[Index] + Line[Index - Bpp]);
+        }
+      }
+      return TRUE;
+
+    case PNG_FILTER_UP:
+      //
+      // Up filter has no dependency within the scanline, process 8 bytes at once.
+      //
+      for (Index = 0; Index + sizeof (UINT64) <= LineBytes; Index += sizeof (UINT64)) {
+        WriteUnaligned64 (
+          (UINT64 *) &Line[Index],
+          PngAddBytes64 (
+            ReadUnaligned64 ((UINT64 *) &Line[Index]),
+            ReadUnaligned64 ((UINT64 *) &Prev[Index])
+            )
+          );
+      }
+      for (; Index < LineBytes; ++Index) {
+        Line[Index] = (UINT8) (Line[Index] + Prev[Index]);
+      }
+      return TRUE;
+
+    case PNG_FILTER_AVG:
+      if (Bpp == 4) {
+        Left = 0;
+        for (Index = 0; Index < LineBytes; Index += 4) {
+          Left = PngAddBytes32 (
+            ReadUnaligned32 ((UINT32 *) &Line[Index]),
+            PngAvgBytes32 (Left, ReadUnaligned32 ((UINT32 *) &Prev[Index]))
+            );
+          WriteUnaligned32 ((UINT32 *) &Line[Index], Left);
+        }
+      } else {
+        for (Index = 0; Index < Bpp; ++Index) {
+          Line[Index] = (UINT8) (Line[Index] + (Prev[Index] >> 1U));
+        }
+        for (; Index < LineBytes; ++Index) {
+          Line[Index] = (UINT8) (Line[Index] + ((Line[Index - Bpp] + Prev[Index]) >> 1U));
+        }
+      }
+      return TRUE;
+
+    case PNG_FILTER_PAETH:
+      for (Index = 0; Index < Bpp; ++Index) {
+        Line[Index] = (UINT8) (Line[Index] + Prev[Index]);
+      }
+      for (; Index < LineBytes; ++Index) {
+        Left   = Line[Index - Bpp];
+        Up     = Prev[Index];
+        UpLeft = Prev[Index - Bpp];
+        Line[Index] = (UINT8) (Line[Index] + PngPaeth ((INT32) Left, (INT32) Up, (INT32) UpLeft));
+      }
+      return TRUE;
+
+    default:
+      return FALSE;
+  }
+}
+
+/**
+  Premultiply BGRA pixel, which has red and blue channels in the low bytes
+  of 16-bit lanes and green channel separately, by its alpha.
+  Uses exact floor (X * A / 255) without divisions.
+**/
+STATIC
+UINT32
+PngPremultiply (
+  IN UINT32  RedBlue,
+  IN UINT32  Green,
+  IN UINT32  Alpha
+  )
+{
+  if (Alpha == 0xFF) {
+    return RedBlue | (Green << 8U) | 0xFF000000U;
+  }
+
+  if (Alpha == 0) {
+    return 0;
+  }
+
+  RedBlue *= Alpha;
+  RedBlue  = ((RedBlue + ((RedBlue >> 8U) & PNG_LANE_RB_32) + 0x00010001U) >> 8U) & PNG_LANE_RB_32;
+  Green   *= Alpha;
+  Green    = (Green + (Green >> 8U) + 1U) >> 8U;
+
+  return RedBlue | (Green << 8U) | (Alpha << 24U);
+}
+
+/**
+  Convert reconstructed scanline to BGRA pixels.
+
+  @param[out] Dst          Destination pixels, may alias Src for 4 bytes per pixel.
+  @param[in]  Src          Reconstructed scanline.
+  @param[in]  Width        Scanline width in pixels.
+  @param[in]  ColorType    Scanline colour type.
+  @param[in]  Premultiply  Premultiply colour channels by alpha.
+**/
+STATIC
+VOID
+PngLineToBgra (
+  OUT UINT32            *Dst,
+  IN  CONST UINT8       *Src,
+  IN  UINT32            Width,
+  IN  LodePNGColorType  ColorType,
+  IN  BOOLEAN           Premultiply
+  )
+{
+  UINT32  Index;
+  UINT32  Pixel;
+  UINT32  RedBlue;
+  UINT32  Grey;
+
+  switch (ColorType) {
+    case LCT_RGBA:
+      for (Index = 0; Index < Width; ++Index, Src += 4) {
+        Pixel   = ReadUnaligned32 ((UINT32 *) Src);
+        RedBlue = Pixel & PNG_LANE_RB_32;
+        RedBlue = ((RedBlue << 16U) | (RedBlue >> 16U)) & PNG_LANE_RB_32;
+        if (Premultiply) {
+          Dst[Index] = PngPremultiply (RedBlue, (Pixel >> 8U) & 0xFFU, Pixel >> 24U);
+        } else {
+          Dst[Index] = RedBlue | (Pixel & 0xFF00FF00U);
+        }
+      }
+      break;
+
+    case LCT_RGB:
+      for (Index = 0; Index < Width; ++Index, Src += 3) {
+        Dst[Index] = Src[2] | ((UINT32) Src[1] << 8U) | ((UINT32) Src[0] << 16U) | 0xFF000000U;
+      }
+      break;
+
+    case LCT_GREY_ALPHA:
+      for (Index = 0; Index < Width; ++Index, Src += 2) {
+        Grey = Src[0];
+        if (Premultiply) {
+          Dst[Index] = PngPremultiply (Grey | (Grey << 16U), Grey, Src[1]);
+        } else {
+          Dst[Index] = (Grey * 0x010101U) | ((UINT32) Src[1] << 24U);
+        }
+      }
+      break;
+
+    case LCT_GREY:
+      for (Index = 0; Index < Width; ++Index, ++Src) {
+        Dst[Index] = (Src[0] * 0x010101U) | 0xFF000000U;
+      }
+      break;
+
+    default:
+      ASSERT (FALSE);
+      break;
+  }
+}
+
+/**
+  Gather IDAT chunk payload and check that the image needs no colour key
+  or palette handling.
+
+  @param[in]  Buffer     PNG image.
+  @param[in]  Size       PNG image size.
+  @param[out] Data       IDAT payload, may point to Buffer for single IDAT.
+  @param[out] DataSize   IDAT payload size.
+  @param[out] Allocated  Set when Data must be freed.
+
+  @retval TRUE when the image can be decoded by the fast path.
+**/
+STATIC
+BOOLEAN
+PngGetImageData (
+  IN  CONST UINT8  *Buffer,
+  IN  UINTN        Size,
+  OUT CONST UINT8  **Data,
+  OUT UINTN        *DataSize,
+  OUT BOOLEAN      *Allocated
+  )
+{
+  CONST UINT8  *Chunk;
+  CONST UINT8  *FirstData;
+  UINT8        *Walker;
+  UINTN        ChunkLength;
+  UINTN        TotalSize;
+  UINT32       Count;
+
+  FirstData = NULL;
+  TotalSize = 0;
+  Count     = 0;
+
+  //
+  // First pass calculates total IDAT size. Chunk layout was already validated
+  // by lodepng_inspect up to the first chunk after the header.
+  //
+  Chunk = &Buffer[33];
+  while (TRUE) {
+    if ((UINTN) (Chunk - Buffer) + 12 > Size) {
+      return FALSE;
+    }
+
+    ChunkLength = lodepng_chunk_length (Chunk);
+    if (ChunkLength > Size - (UINTN) (Chunk - Buffer) - 12) {
+      return FALSE;
+    }
+
+    if (lodepng_chunk_type_equals (Chunk, "IDAT")) {
+      if (FirstData == NULL) {
+        FirstData = lodepng_chunk_data_const (Chunk);
+      }
+      TotalSize += ChunkLength;
+      ++Count;
+    } else if (lodepng_chunk_type_equals (Chunk, "IEND")) {
+      break;
+    } else if (lodepng_chunk_type_equals (Chunk, "tRNS")
+      || lodepng_chunk_type_equals (Chunk, "PLTE")) {
+      return FALSE;
+    }
+
+    Chunk += ChunkLength + 12;
+  }
+
+  if (Count == 0) {
+    return FALSE;
+  }
+
+  *DataSize = TotalSize;
+
+  if (Count == 1) {
+    *Data      = FirstData;
+    *Allocated = FALSE;
+    return TRUE;
+  }
+
+  Walker = AllocatePool (TotalSize);
+  if (Walker == NULL) {
+    return FALSE;
+  }
+
+  *Data      = Walker;
+  *Allocated = TRUE;
+
+  //
+  // Second pass concatenates IDAT chunks, bounds were verified above.
+  //
+  Chunk = &Buffer[33];
+  while (!lodepng_chunk_type_equals (Chunk, "IEND")) {
+    ChunkLength = lodepng_chunk_length (Chunk);
+    if (lodepng_chunk_type_equals (Chunk, "IDAT")) {
+      CopyMem (Walker, lodepng_chunk_data_const (Chunk), ChunkLength);
+      Walker += ChunkLength;
+    }
+    Chunk += ChunkLength + 12;
+  }
+
+  return TRUE;
+}
+
+/**
+  Compute scratch layout for decoding: reconstructed scanlines, zero
+  previous line, and ZLIB decoder state.
+
+  @retval FALSE  Scratch size overflows.
+**/
+STATIC
+BOOLEAN
+PngGetScratchLayout (
+  IN  UINTN  LineBytes,
+  IN  UINT32 Height,
+  OUT UINTN  *ZeroLineOffset,
+  OUT UINTN  *ZlibOffset,
+  OUT UINTN  *ScratchSize
+  )
+{
+  UINTN  ScanlinesSize;
+
+  if (OcOverflowMulUN (LineBytes + 1, Height, &ScanlinesSize)
+    || ScanlinesSize > OC_COMPRESSION_MAX_LENGTH) {
+    return FALSE;
+  }
+
+  *ZeroLineOffset = ALIGN_VALUE (ScanlinesSize, sizeof (UINT64));
+  *ZlibOffset     = *ZeroLineOffset + ALIGN_VALUE (LineBytes, sizeof (UINT64));
+  *ScratchSize    = *ZlibOffset + OC_ZLIB_DECOMPRESS_SCRATCH_SIZE;
+  return TRUE;
+}
+
+/**
+  Prepare 8-bit non-interlaced non-palette PNG image for direct BGRA decoding.
+
+  @retval EFI_SUCCESS      Image was prepared.
+  @retval EFI_UNSUPPORTED  Image needs generic decoding.
+  @retval other            Allocation failed.
+**/
+STATIC
+EFI_STATUS
+PngPrepareBgraFast (
+  IN  CONST UINT8         *Buffer,
+  IN  UINTN               Size,
+  IN  UINT32              Width,
+  IN  UINT32              Height,
+  IN  LodePNGColorType    ColorType,
+  IN  BOOLEAN             Premultiply,
+  OUT OC_PNG_BGRA_DECODE  *Decode
+  )
+{
+  UINTN  Bpp;
+  UINTN  LineBytes;
+  UINTN  PixelsSize;
+  UINTN  ZeroLineOffset;
+  UINTN  ZlibOffset;
+  UINTN  ScratchSize;
+
+  switch (ColorType) {
+    case LCT_RGBA:
+      Bpp = 4;
+      break;
+    case LCT_RGB:
+      Bpp = 3;
+      break;
+    case LCT_GREY_ALPHA:
+      Bpp = 2;
+      break;
+    case LCT_GREY:
+      Bpp = 1;
+      break;
+    default:
+      return EFI_UNSUPPORTED;
+  }
+
+  if (OcOverflowMulUN (Width, Bpp, &LineBytes)
+    || OcOverflowTriMulUN (Width, Height, sizeof (UINT32), &PixelsSize)
+    || !PngGetScratchLayout (LineBytes, Height, &ZeroLineOffset, &ZlibOffset, &ScratchSize)) {
+    return EFI_UNSUPPORTED;
+  }
+
+  if (!PngGetImageData (Buffer, Size, &Decode->Data, &Decode->DataSize, &Decode->DataAllocated)) {
+    return EFI_UNSUPPORTED;
+  }
+
+  Decode->Scratch = AllocatePool (ScratchSize);
+  Decode->Pixels  = AllocatePool (PixelsSize);
+  if (Decode->Scratch == NULL || Decode->Pixels == NULL) {
+    if (Decode->DataAllocated) {
+      FreePool ((VOID *) Decode->Data);
+    }
+    if (Decode->Scratch != NULL) {
+      FreePool (Decode->Scratch);
+    }
+    if (Decode->Pixels != NULL) {
+      FreePool (Decode->Pixels);
+    }
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  ZeroMem (&Decode->Scratch[ZeroLineOffset], LineBytes);
+
+  Decode->ScratchSize = ScratchSize;
+  Decode->Width       = Width;
+  Decode->Height      = Height;
+  Decode->LineBytes   = LineBytes;
+  Decode->Bpp         = Bpp;
+  Decode->ColorType   = ColorType;
+  Decode->Premultiply = Premultiply;
+  Decode->Status      = EFI_NOT_READY;
+
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+DecodePngBgraPrepare (
+  IN   VOID                *Buffer,
+  IN   UINTN               Size,
+  IN   BOOLEAN             Premultiply,
+  OUT  OC_PNG_BGRA_DECODE  *Decode
+  )
+{
+  EFI_STATUS        Status;
+  LodePNGState      State;
+  unsigned          Error;
+  unsigned          W;
+  unsigned          H;
+
+  //
+  // Init state
+  //
+  lodepng_state_init (&State);
+  State.decoder.ignore_crc                  = TRUE;
+  State.decoder.zlibsettings.ignore_adler32 = TRUE;
+  State.decoder.zlibsettings.ignore_nlen    = TRUE;
+
+  Error = lodepng_inspect (&W, &H, &State, Buffer, Size);
+  if (Error != 0) {
+    DEBUG ((DEBUG_INFO, "OCPNG: Error while getting image dimensions from PNG header\n"));
+    lodepng_state_cleanup (&State);
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Status = EFI_UNSUPPORTED;
+  if (State.info_png.color.bitdepth == 8 && State.info_png.interlace_method == 0) {
+    Status = PngPrepareBgraFast (
+      Buffer,
+      Size,
+      (UINT32) W,
+      (UINT32) H,
+      State.info_png.color.colortype,
+      Premultiply,
+      Decode
+      );
+  }
+
+  if (Status == EFI_SUCCESS) {
+    Decode->HasAlphaType = lodepng_is_alpha_type (&State.info_png.color) != 0;
+  }
+
+  lodepng_state_cleanup (&State);
+
+  return Status;
+}
+
+VOID
+DecodePngBgraRun (
+  IN OUT  OC_PNG_BGRA_DECODE  *Decode
+  )
+{
+  UINTN   ScanlinesSize;
+  UINTN   ZeroLineOffset;
+  UINTN   ZlibOffset;
+  UINTN   ScratchSize;
+  UINT8   *Line;
+  UINT8   *Prev;
+  UINT32  Row;
+
+  if (Decode->Status != EFI_NOT_READY) {
+    return;
+  }
+
+  //
+  // Layout was validated when preparing.
+  //
+  PngGetScratchLayout (Decode->LineBytes, Decode->Height, &ZeroLineOffset, &ZlibOffset, &ScratchSize);
+  ScanlinesSize = (Decode->LineBytes + 1) * Decode->Height;
+
+  if (DecompressZLIBWithScratch (
+    Decode->Scratch,
+    ScanlinesSize,
+    Decode->Data,
+    Decode->DataSize,
+    &Decode->Scratch[ZlibOffset],
+    ScratchSize - ZlibOffset
+    ) != ScanlinesSize) {
+    Decode->Status = EFI_INVALID_PARAMETER;
+    return;
+  }
+
+  //
+  // Reconstruct each scanline and immediately convert it while it is still hot in cache.
+  //
+  Prev = &Decode->Scratch[ZeroLineOffset];
+  Line = Decode->Scratch;
+  for (Row = 0; Row < Decode->Height; ++Row) {
+    if (!PngUnfilterLine (Line[0], &Line[1], Prev, Decode->LineBytes, Decode->Bpp)) {
+      Decode->Status = EFI_INVALID_PARAMETER;
+      return;
+    }
+
+    PngLineToBgra (
+      &Decode->Pixels[(UINTN) Row * Decode->Width],
+      &Line[1],
+      Decode->Width,
+      (LodePNGColorType) Decode->ColorType,
+      Decode->Premultiply
+      );
+
+    Prev  = &Line[1];
+    Line += Decode->LineBytes + 1;
+  }
+
+  Decode->Status = EFI_SUCCESS;
+}
+
+EFI_STATUS
+DecodePngBgraComplete (
+  IN OUT  OC_PNG_BGRA_DECODE  *Decode,
+  OUT     VOID                **RawData,
+  OUT     UINT32              *Width,
+  OUT     UINT32              *Height
+  )
+{
+  if (Decode->DataAllocated) {
+    FreePool ((VOID *) Decode->Data);
+  }
+
+  FreePool (Decode->Scratch);
+
+  if (EFI_ERROR (Decode->Status)) {
+    DEBUG ((DEBUG_INFO, "OCPNG: Error while decoding PNG image - %r\n", Decode->Status));
+    FreePool (Decode->Pixels);
+    return Decode->Status;
+  }
+
+  *RawData = Decode->Pixels;
+  *Width   = Decode->Width;
+  *Height  = Decode->Height;
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+DecodePngBgra (
+  IN   VOID     *Buffer,
+  IN   UINTN    Size,
+  IN   BOOLEAN  Premultiply,
+  OUT  VOID     **RawData,
+  OUT  UINT32   *Width,
+  OUT  UINT32   *Height,
+  OUT  BOOLEAN  *HasAlphaType OPTIONAL
+  )
+{
+  EFI_STATUS          Status;
+  OC_PNG_BGRA_DECODE  Decode;
+  UINT32              *Pixels;
+  UINT32              Row;
+
+  Status = DecodePngBgraPrepare (Buffer, Size, Premultiply, &Decode);
+
+  if (Status == EFI_UNSUPPORTED) {
+    //
+    // Palette, 16-bit, interlaced and colour keyed images are rare,
+    // decode them generically and convert in place.
+    //
+    Status = DecodePng (Buffer, Size, (VOID **) &Pixels, Width, Height, HasAlphaType);
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+
+    for (Row = 0; Row < *Height; ++Row) {
+      PngLineToBgra (
+        &Pixels[(UINTN) Row * *Width],
+        (UINT8 *) &Pixels[(UINTN) Row * *Width],
+        *Width,
+        LCT_RGBA,
+        Premultiply
+        );
+    }
+
+    *RawData = Pixels;
+    return EFI_SUCCESS;
+  }
+
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_INFO, "OCPNG: Error while decoding PNG image - %r\n", Status));
+    return Status;
+  }
+
+  DecodePngBgraRun (&Decode);
+
+  if (HasAlphaType != NULL) {
+    *HasAlphaType = Decode.HasAlphaType;
+  }
+
+  return DecodePngBgraComplete (&Decode, RawData, Width, Height);
+}
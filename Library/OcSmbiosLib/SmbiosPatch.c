@@ -46,6 +46,54 @@ STATIC SMBIOS_TABLE_3_0_ENTRY_POINT    *mOriginalSmbios3;
 STATIC APPLE_SMBIOS_STRUCTURE_POINTER  mOriginalTable;
 STATIC UINT32                          mOriginalTableSize;
 
+//
+// Original table structures grouped by type in table order.
+// Built once during table preparation to avoid rescanning the table
+// for every structure lookup.
+//
+STATIC APPLE_SMBIOS_STRUCTURE_POINTER  *mOriginalStructures;
+STATIC UINT32                          mOriginalTypeStart[MAX_UINT8 + 1];
+STATIC UINT16                          mOriginalTypeCount[MAX_UINT8 + 1];
+STATIC UINT32                          mOriginalTypeStrings[MAX_UINT8 + 1];
+
+//
+// Structures written by OcSmbiosCreate for size planning.
+// MaxCount of 1 means that the structure is always written once.
+//
+typedef struct {
+  SMBIOS_TYPE  Type;
+  UINT8        MinLength;
+  UINT16       MaxCount;
+} OC_SMBIOS_PLAN_ENTRY;
+
+STATIC CONST OC_SMBIOS_PLAN_ENTRY mSmbiosPlan[] = {
+  { SMBIOS_TYPE_BIOS_INFORMATION,                sizeof (SMBIOS_TABLE_TYPE0),          1          },
+  { SMBIOS_TYPE_SYSTEM_INFORMATION,              sizeof (SMBIOS_TABLE_TYPE1),          1          },
+  { SMBIOS_TYPE_BASEBOARD_INFORMATION,           sizeof (SMBIOS_TABLE_TYPE2),          1          },
+  { SMBIOS_TYPE_SYSTEM_ENCLOSURE,                sizeof (SMBIOS_TABLE_TYPE3),          1          },
+  { SMBIOS_TYPE_PROCESSOR_INFORMATION,           sizeof (SMBIOS_TABLE_TYPE4),          1          },
+  { SMBIOS_TYPE_CACHE_INFORMATION,               sizeof (SMBIOS_TABLE_TYPE7),          3          },
+  { SMBIOS_TYPE_PORT_CONNECTOR_INFORMATION,      sizeof (SMBIOS_TABLE_TYPE8),          MAX_UINT16 },
+  { SMBIOS_TYPE_SYSTEM_SLOTS,                    sizeof (SMBIOS_TABLE_TYPE9),          MAX_UINT16 },
+  { SMBIOS_TYPE_PHYSICAL_MEMORY_ARRAY,           sizeof (SMBIOS_TABLE_TYPE16),         1          },
+  { SMBIOS_TYPE_MEMORY_ARRAY_MAPPED_ADDRESS,     sizeof (SMBIOS_TABLE_TYPE19),         MAX_UINT16 },
+  { SMBIOS_TYPE_MEMORY_DEVICE,                   sizeof (SMBIOS_TABLE_TYPE17),         MAX_UINT16 },
+  { SMBIOS_TYPE_MEMORY_DEVICE_MAPPED_ADDRESS,    sizeof (SMBIOS_TABLE_TYPE20),         MAX_UINT16 },
+  { SMBIOS_TYPE_PORTABLE_BATTERY,                sizeof (SMBIOS_TABLE_TYPE22),         1          },
+  { SMBIOS_TYPE_SYSTEM_BOOT_INFORMATION,         sizeof (SMBIOS_TABLE_TYPE32),         1          },
+  { APPLE_SMBIOS_TYPE_PROCESSOR_TYPE,            sizeof (APPLE_SMBIOS_TABLE_TYPE131),  1          },
+  { APPLE_SMBIOS_TYPE_PROCESSOR_BUS_SPEED,       sizeof (APPLE_SMBIOS_TABLE_TYPE132),  1          },
+  { APPLE_SMBIOS_TYPE_FIRMWARE_INFORMATION,      sizeof (APPLE_SMBIOS_TABLE_TYPE128),  1          },
+  { APPLE_SMBIOS_TYPE_PLATFORM_FEATURE,          sizeof (APPLE_SMBIOS_TABLE_TYPE133),  1          },
+  { APPLE_SMBIOS_TYPE_SMC_INFORMATION,           sizeof (APPLE_SMBIOS_TABLE_TYPE134),  1          },
+  { SMBIOS_TYPE_END_OF_TABLE,                    sizeof (SMBIOS_TABLE_TYPE127),        1          }
+};
+
+//
+// Longest slot designation we may write instead of the original one, including the terminator.
+//
+#define OC_SMBIOS_SLOT_DESIGNATION_SIZE  sizeof ("AirPort")
+
 #define SMBIOS_OVERRIDE_S(Table, Field, Original, Value, Index, Fallback) \
   do { \
     CONST CHAR8  *RealValue__ = (Value); \
@@ -84,10 +132,21 @@ SmbiosGetOriginalStructure (
   IN  UINT16        Index
   )
 {
+  APPLE_SMBIOS_STRUCTURE_POINTER  Structure;
+
   if (mOriginalTable.Raw == NULL) {
     return mOriginalTable;
   }
 
+  if (mOriginalStructures != NULL) {
+    if (Index == 0 || Index > mOriginalTypeCount[Type]) {
+      Structure.Raw = NULL;
+      return Structure;
+    }
+
+    return mOriginalStructures[mOriginalTypeStart[Type] + Index - 1];
+  }
+
   return SmbiosGetStructureOfType (mOriginalTable, mOriginalTableSize, Type, Index);
 }
 
@@ -101,9 +160,175 @@ SmbiosGetOriginalStructureCount (
     return 0;
   }
 
+  if (mOriginalStructures != NULL) {
+    return mOriginalTypeCount[Type];
+  }
+
   return SmbiosGetStructureCount (mOriginalTable, mOriginalTableSize, Type);
 }
 
+/**
+  Index original table structures by type and instance.
+  Lookups fall back to table scanning when the index cannot be built.
+**/
+STATIC
+VOID
+SmbiosIndexOriginalTable (
+  VOID
+  )
+{
+  APPLE_SMBIOS_STRUCTURE_POINTER  Walker;
+  UINT32                          Remaining;
+  UINT32                          Length;
+  UINT32                          Total;
+  UINT32                          Index;
+  UINT8                           Type;
+
+  if (mOriginalStructures != NULL) {
+    FreePool (mOriginalStructures);
+    mOriginalStructures = NULL;
+  }
+
+  ZeroMem (mOriginalTypeStart, sizeof (mOriginalTypeStart));
+  ZeroMem (mOriginalTypeCount, sizeof (mOriginalTypeCount));
+  ZeroMem (mOriginalTypeStrings, sizeof (mOriginalTypeStrings));
+
+  if (mOriginalTable.Raw == NULL) {
+    return;
+  }
+
+  //
+  // Count structures of each type with the same validation as SmbiosGetStructureOfType.
+  //
+  Total     = 0;
+  Walker    = mOriginalTable;
+  Remaining = mOriginalTableSize;
+  while (Remaining >= sizeof (SMBIOS_STRUCTURE)) {
+    Length = SmbiosGetStructureLength (Walker, Remaining);
+    if (Length == 0) {
+      break;
+    }
+
+    Type = Walker.Standard.Hdr->Type;
+    if (mOriginalTypeCount[Type] == MAX_UINT16) {
+      break;
+    }
+
+    ++mOriginalTypeCount[Type];
+    mOriginalTypeStrings[Type] += Length - Walker.Standard.Hdr->Length;
+    ++Total;
+
+    if (Type == SMBIOS_TYPE_END_OF_TABLE) {
+      break;
+    }
+
+    Walker.Raw += Length;
+    Remaining  -= Length;
+  }
+
+  if (Total == 0) {
+    return;
+  }
+
+  mOriginalStructures = AllocatePool (Total * sizeof (*mOriginalStructures));
+  if (mOriginalStructures == NULL) {
+    DEBUG ((DEBUG_INFO, "OCSMB: Cannot index %u original structures\n", Total));
+    return;
+  }
+
+  Index = 0;
+  for (Length = 0; Length <= MAX_UINT8; ++Length) {
+    mOriginalTypeStart[Length] = Index;
+    Index += mOriginalTypeCount[Length];
+    //
+    // Reused as the fill position below and restored by the end of the walk.
+    //
+    mOriginalTypeCount[Length] = 0;
+  }
+
+  Walker = mOriginalTable;
+  for (Index = 0; Index < Total; ++Index) {
+    Length = SmbiosGetStructureLength (Walker, mOriginalTableSize - (UINT32) (Walker.Raw - mOriginalTable.Raw));
+    Type   = Walker.Standard.Hdr->Type;
+    mOriginalStructures[mOriginalTypeStart[Type] + mOriginalTypeCount[Type]] = Walker;
+    ++mOriginalTypeCount[Type];
+    Walker.Raw += Length;
+  }
+
+  DEBUG ((DEBUG_INFO, "OCSMB: Indexed %u original structures\n", Total));
+}
+
+/**
+  Calculate the size of the table written by OcSmbiosCreate.
+  The result never underestimates the size unless the original table
+  has structures with duplicate handles, in which case the table grows
+  as necessary.
+
+  @param[in] Data   Pointer to location containing SMBIOS data.
+
+  @retval Planned table size in bytes.
+**/
+STATIC
+UINT32
+SmbiosPlanTableSize (
+  IN OC_SMBIOS_DATA  *Data
+  )
+{
+  UINT32       Size;
+  UINT32       Index;
+  UINT32       Count;
+  UINT32       Length;
+  CONST CHAR8  *Strings[19];
+
+  Size = 0;
+
+  for (Index = 0; Index < ARRAY_SIZE (mSmbiosPlan); ++Index) {
+    Count = mSmbiosPlan[Index].MaxCount;
+    if (Count != 1) {
+      Count = MIN (Count, SmbiosGetOriginalStructureCount (mSmbiosPlan[Index].Type));
+    }
+
+    //
+    // Written strings come either from the original structure or from the overrides.
+    //
+    Size += Count * (mSmbiosPlan[Index].MinLength + SMBIOS_STRUCTURE_TERMINATOR_SIZE)
+      + mOriginalTypeStrings[mSmbiosPlan[Index].Type];
+
+    if (mSmbiosPlan[Index].Type == SMBIOS_TYPE_SYSTEM_SLOTS) {
+      Size += Count * OC_SMBIOS_SLOT_DESIGNATION_SIZE;
+    }
+  }
+
+  Strings[0]  = Data->BIOSVendor;
+  Strings[1]  = Data->BIOSVersion;
+  Strings[2]  = Data->BIOSReleaseDate;
+  Strings[3]  = Data->SystemManufacturer;
+  Strings[4]  = Data->SystemProductName;
+  Strings[5]  = Data->SystemVersion;
+  Strings[6]  = Data->SystemSerialNumber;
+  Strings[7]  = Data->SystemSKUNumber;
+  Strings[8]  = Data->SystemFamily;
+  Strings[9]  = Data->BoardManufacturer;
+  Strings[10] = Data->BoardProduct;
+  Strings[11] = Data->BoardVersion;
+  Strings[12] = Data->BoardSerialNumber;
+  Strings[13] = Data->BoardAssetTag;
+  Strings[14] = Data->BoardLocationInChassis;
+  Strings[15] = Data->ChassisManufacturer;
+  Strings[16] = Data->ChassisVersion;
+  Strings[17] = Data->ChassisSerialNumber;
+  Strings[18] = Data->ChassisAssetTag;
+
+  for (Index = 0; Index < ARRAY_SIZE (Strings); ++Index) {
+    if (Strings[Index] != NULL) {
+      Length = (UINT32) AsciiStrLen (Strings[Index]);
+      Size  += MIN (Length, SMBIOS_STRING_MAX_LENGTH) + 1;
+    }
+  }
+
+  return Size;
+}
+
 /** Type 0
 
   @param[in] Table                  Pointer to location containing the current address within the buffer.
@@ -808,7 +1033,7 @@ PatchMemoryMappedDevice (
   if (Original.Raw != NULL && SMBIOS_ACCESSIBLE(Original, Standard.Type20->MemoryArrayMappedAddressHandle)) {
     for (MapIndex = 0; MapIndex < MappingNum; MapIndex++) {
       if (Mapping[MapIndex].Old == Original.Standard.Type20->MemoryArrayMappedAddressHandle) {
-        Table->CurrentPtr.Standard.Type20->MemoryArrayMappedAddressHandle = Mapping[Index].New;
+        Table->CurrentPtr.Standard.Type20->MemoryArrayMappedAddressHandle = Mapping[MapIndex].New;
         break;
       }
     }
@@ -1251,6 +1476,8 @@ OcSmbiosTablePrepare (
     mOriginalTable.Raw = (UINT8 *)(UINTN) mOriginalSmbios3->TableAddress;
   }
 
+  SmbiosIndexOriginalTable ();
+
   if (mOriginalSmbios != NULL) {
     DEBUG ((
       DEBUG_INFO,
@@ -1293,6 +1520,11 @@ OcSmbiosTableFree (
     FreePool (Table->Table);
   }
 
+  if (mOriginalStructures != NULL) {
+    FreePool (mOriginalStructures);
+    mOriginalStructures = NULL;
+  }
+
   ZeroMem (Table, sizeof (*Table));
 }
 
@@ -1690,6 +1922,7 @@ OcSmbiosCreate (
   UINT16                          MemoryMappedNo;
   OC_SMBIOS_MAPPING               *Mapping;
   UINT16                          MappingNum;
+  UINT32                          PlannedSize;
 
   ASSERT (Data != NULL);
 
@@ -1699,6 +1932,20 @@ OcSmbiosCreate (
     return EFI_OUT_OF_RESOURCES;
   }
 
+  //
+  // Reserve the whole table at once, so that structures are written
+  // without reallocating the table. Should the plan be insufficient,
+  // the table is still extended on demand.
+  //
+  PlannedSize = MIN (
+    SmbiosPlanTableSize (Data),
+    SMBIOS_TABLE_MAX_LENGTH - SMBIOS_STRUCTURE_TERMINATOR_SIZE
+    );
+  Status = SmbiosExtendTable (SmbiosTable, PlannedSize);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_INFO, "OCSMB: Cannot reserve %u bytes for table - %r\n", PlannedSize, Status));
+  }
+
   PatchBiosInformation (SmbiosTable, Data);
   PatchSystemInformation (SmbiosTable, Data);
   PatchBaseboardInformation (SmbiosTable, Data);
@@ -1765,6 +2012,13 @@ OcSmbiosCreate (
 
   FreePool (Mapping);
 
+  DEBUG ((
+    DEBUG_INFO,
+    "OCSMB: Wrote %u bytes with %u planned\n",
+    (UINT32) (SmbiosTable->CurrentPtr.Raw - SmbiosTable->Table),
+    PlannedSize
+    ));
+
   Status = SmbiosTableApply (SmbiosTable, Mode);
 
   return Status;
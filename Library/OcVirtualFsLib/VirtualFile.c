@@ -46,6 +46,7 @@ VirtualFileOpen (
 
   if (Data->OpenCallback != NULL) {
     return Data->OpenCallback (
+      Data->DeviceHandle,
       Data->OriginalProtocol,
       NewHandle,
       FileName,
@@ -63,7 +64,7 @@ VirtualFileOpen (
       Attributes
       );
     if (!EFI_ERROR (Status)) {
-      return CreateRealFile (*NewHandle, NULL, TRUE, NewHandle);
+      return CreateRealFile (*NewHandle, Data->DeviceHandle, NULL, TRUE, NewHandle);
     }
     return Status;
   }
@@ -88,7 +89,7 @@ VirtualFileClose (
   Data = VIRTUAL_FILE_FROM_PROTOCOL (This);
 
   if (Data->OriginalProtocol == NULL) {
-    FreePool (Data->FileBuffer);
+    ReleaseVirtualFileBuffer (Data->SharedBuffer);
     FreePool (Data->FileName);
     FreePool (Data);
 
@@ -116,7 +117,7 @@ VirtualFileDelete (
   Data = VIRTUAL_FILE_FROM_PROTOCOL (This);
 
   if (Data->OriginalProtocol == NULL) {
-    FreePool (Data->FileBuffer);
+    ReleaseVirtualFileBuffer (Data->SharedBuffer);
     FreePool (Data->FileName);
     FreePool (Data);
     //
@@ -449,7 +450,7 @@ VirtualFileReadEx (
   Data = VIRTUAL_FILE_FROM_PROTOCOL (This);
 
   if (Data->OriginalProtocol == NULL) {
-    Status = VirtualFileRead (This, Token->Buffer, &Token->BufferSize);
+    Status = VirtualFileRead (This, &Token->BufferSize, Token->Buffer);
 
     if (!EFI_ERROR (Status) && Token->Event != NULL) {
       Token->Status = EFI_SUCCESS;
@@ -457,7 +458,7 @@ VirtualFileReadEx (
     }
   } else {
     Status = Data->OriginalProtocol->ReadEx (
-      This,
+      Data->OriginalProtocol,
       Token
       );
   }
@@ -485,7 +486,7 @@ VirtualFileWriteEx (
   }
 
   return Data->OriginalProtocol->WriteEx (
-    This,
+    Data->OriginalProtocol,
     Token
     );
 }
@@ -510,7 +511,7 @@ VirtualFileFlushEx (
   }
 
   return Data->OriginalProtocol->FlushEx (
-    This,
+    Data->OriginalProtocol,
     Token
     );
 }
@@ -537,32 +538,86 @@ mVirtualFileProtocolTemplate = {
 };
 
 EFI_STATUS
-CreateVirtualFile (
-  IN     CHAR16             *FileName,
-  IN     VOID               *FileBuffer,
-  IN     UINT64             FileSize,
-  IN     EFI_TIME           *ModificationTime OPTIONAL,
-  IN OUT EFI_FILE_PROTOCOL  **File
+CreateVirtualFileBuffer (
+  IN  VOID                    *FileBuffer,
+  IN  UINT64                  FileSize,
+  OUT OC_VIRTUAL_FILE_BUFFER  **SharedBuffer
+  )
+{
+  OC_VIRTUAL_FILE_BUFFER  *Buffer;
+
+  ASSERT (FileBuffer != NULL);
+  ASSERT (SharedBuffer != NULL);
+
+  Buffer = AllocatePool (sizeof (OC_VIRTUAL_FILE_BUFFER));
+
+  if (Buffer == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Buffer->Signature = VIRTUAL_FILE_BUFFER_SIGNATURE;
+  Buffer->RefCount  = 1;
+  Buffer->Buffer    = FileBuffer;
+  Buffer->Size      = FileSize;
+
+  *SharedBuffer = Buffer;
+
+  return EFI_SUCCESS;
+}
+
+VOID
+ReleaseVirtualFileBuffer (
+  IN OC_VIRTUAL_FILE_BUFFER  *SharedBuffer
+  )
+{
+  ASSERT (SharedBuffer != NULL);
+  ASSERT (SharedBuffer->Signature == VIRTUAL_FILE_BUFFER_SIGNATURE);
+  ASSERT (SharedBuffer->RefCount > 0);
+
+  --SharedBuffer->RefCount;
+  if (SharedBuffer->RefCount > 0) {
+    return;
+  }
+
+  FreePool (SharedBuffer->Buffer);
+  FreePool (SharedBuffer);
+}
+
+EFI_STATUS
+CreateVirtualFileFromBuffer (
+  IN     CHAR16                  *FileName,
+  IN     OC_VIRTUAL_FILE_BUFFER  *SharedBuffer,
+  IN     EFI_TIME                *ModificationTime OPTIONAL,
+  IN OUT EFI_FILE_PROTOCOL       **File
   )
 {
   VIRTUAL_FILE_DATA  *Data;
 
   ASSERT (FileName != NULL);
-  ASSERT (FileBuffer != NULL);
+  ASSERT (SharedBuffer != NULL);
+  ASSERT (SharedBuffer->Signature == VIRTUAL_FILE_BUFFER_SIGNATURE);
   ASSERT (File != NULL);
 
+  if (SharedBuffer->RefCount == MAX_UINT32) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
   Data = AllocatePool (sizeof (VIRTUAL_FILE_DATA));
 
   if (Data == NULL) {
     return EFI_OUT_OF_RESOURCES;
   }
 
+  ++SharedBuffer->RefCount;
+
   Data->Signature        = VIRTUAL_FILE_DATA_SIGNATURE;
   Data->FileName         = FileName;
-  Data->FileBuffer       = FileBuffer;
-  Data->FileSize         = FileSize;
+  Data->SharedBuffer     = SharedBuffer;
+  Data->FileBuffer       = SharedBuffer->Buffer;
+  Data->FileSize         = SharedBuffer->Size;
   Data->FilePosition     = 0;
   Data->OpenCallback     = NULL;
+  Data->DeviceHandle     = NULL;
   Data->OriginalProtocol = NULL;
   CopyMem (&Data->Protocol, &mVirtualFileProtocolTemplate, sizeof (Data->Protocol));
   if (ModificationTime != NULL) {
@@ -576,25 +631,62 @@ CreateVirtualFile (
   return EFI_SUCCESS;
 }
 
+EFI_STATUS
+CreateVirtualFile (
+  IN     CHAR16             *FileName,
+  IN     VOID               *FileBuffer,
+  IN     UINT64             FileSize,
+  IN     EFI_TIME           *ModificationTime OPTIONAL,
+  IN OUT EFI_FILE_PROTOCOL  **File
+  )
+{
+  EFI_STATUS              Status;
+  OC_VIRTUAL_FILE_BUFFER  *SharedBuffer;
+
+  Status = CreateVirtualFileBuffer (FileBuffer, FileSize, &SharedBuffer);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Status = CreateVirtualFileFromBuffer (FileName, SharedBuffer, ModificationTime, File);
+  if (EFI_ERROR (Status)) {
+    //
+    // FileBuffer ownership stays with the caller on failure.
+    //
+    FreePool (SharedBuffer);
+    return Status;
+  }
+
+  //
+  // The file holds the only reference now.
+  //
+  ReleaseVirtualFileBuffer (SharedBuffer);
+
+  return EFI_SUCCESS;
+}
+
 STATIC
 VOID
 InternalInitVirtualVolumeData (
-  IN OUT VIRTUAL_FILE_DATA  *Data,
-  IN     EFI_FILE_OPEN      OpenCallback
+  IN OUT VIRTUAL_FILE_DATA   *Data,
+  IN     EFI_HANDLE          DeviceHandle,
+  IN     OC_VIRTUAL_FS_OPEN  OpenCallback
   )
 {
   ZeroMem (Data, sizeof (*Data));
   Data->Signature    = VIRTUAL_FILE_DATA_SIGNATURE;
+  Data->DeviceHandle = DeviceHandle;
   Data->OpenCallback = OpenCallback;
   CopyMem (&Data->Protocol, &mVirtualFileProtocolTemplate, sizeof (Data->Protocol));
 }
 
 EFI_STATUS
 CreateRealFile (
-  IN     EFI_FILE_PROTOCOL  *OriginalFile OPTIONAL,
-  IN     EFI_FILE_OPEN      OpenCallback OPTIONAL,
-  IN     BOOLEAN            CloseOnFailure,
-  IN OUT EFI_FILE_PROTOCOL  **File
+  IN     EFI_FILE_PROTOCOL   *OriginalFile OPTIONAL,
+  IN     EFI_HANDLE          DeviceHandle OPTIONAL,
+  IN     OC_VIRTUAL_FS_OPEN  OpenCallback OPTIONAL,
+  IN     BOOLEAN             CloseOnFailure,
+  IN OUT EFI_FILE_PROTOCOL   **File
   )
 {
   VIRTUAL_FILE_DATA  *Data;
@@ -611,7 +703,7 @@ CreateRealFile (
     return EFI_OUT_OF_RESOURCES;
   }
 
-  InternalInitVirtualVolumeData (Data, OpenCallback);
+  InternalInitVirtualVolumeData (Data, DeviceHandle, OpenCallback);
   Data->OriginalProtocol = OriginalFile;
 
   *File = &Data->Protocol;
@@ -28,12 +28,13 @@
 
 STATIC EFI_HANDLE_PROTOCOL mOriginalHandleProtocol;
 STATIC EFI_LOCATE_PROTOCOL mOriginalLocateProtocol;
-STATIC EFI_FILE_OPEN       mOpenCallback;
+STATIC OC_VIRTUAL_FS_OPEN  mOpenCallback;
 STATIC UINT32              mEntranceCount;
 
 STATIC
 VOID
 VirtualFsWrapProtocol (
+  IN  EFI_HANDLE        Handle OPTIONAL,
   IN  EFI_GUID          *Protocol,
   OUT VOID              **Interface
   )
@@ -45,7 +46,7 @@ VirtualFsWrapProtocol (
     return;
   }
 
-  Status = CreateVirtualFs (*Interface, mOpenCallback, &FileSystem);
+  Status = CreateVirtualFs (*Interface, Handle, mOpenCallback, &FileSystem);
   if (!EFI_ERROR (Status)) {
     *Interface = FileSystem;
   }
@@ -66,7 +67,7 @@ VirtualFsHandleProtocol (
 
   if (!EFI_ERROR (Status) && Interface != NULL && mEntranceCount == 0) {
     ++mEntranceCount;
-    VirtualFsWrapProtocol (Protocol, Interface);
+    VirtualFsWrapProtocol (Handle, Protocol, Interface);
     --mEntranceCount;
   }
 
@@ -88,7 +89,7 @@ VirtualFsLocateProtocol (
 
   if (!EFI_ERROR (Status) && Interface != NULL && mEntranceCount == 0) {
     ++mEntranceCount;
-    VirtualFsWrapProtocol (Protocol, Interface);
+    VirtualFsWrapProtocol (NULL, Protocol, Interface);
     --mEntranceCount;
   }
 
@@ -98,7 +99,7 @@ VirtualFsLocateProtocol (
 EFI_STATUS
 EnableVirtualFs (
   IN OUT EFI_BOOT_SERVICES       *BootServices,
-  IN     EFI_FILE_OPEN           OpenCallback
+  IN     OC_VIRTUAL_FS_OPEN      OpenCallback
   )
 {
   if (mOriginalHandleProtocol != NULL
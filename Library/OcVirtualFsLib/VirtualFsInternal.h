@@ -16,6 +16,7 @@
 #define VIRTUAL_FS_INTERNAL_H
 
 #include <Uefi.h>
+#include <Library/OcVirtualFsLib.h>
 #include <Protocol/SimpleFileSystem.h>
 
 #define VIRTUAL_VOLUME_DATA_SIGNATURE  \
@@ -40,17 +41,29 @@
     VIRTUAL_FILE_DATA_SIGNATURE  \
     )
 
+#define VIRTUAL_FILE_BUFFER_SIGNATURE  \
+  SIGNATURE_32 ('V', 'F', 'S', 'b')
+
 typedef struct VIRTUAL_FILESYSTEM_DATA_ VIRTUAL_FILESYSTEM_DATA;
 typedef struct VIRTUAL_FILE_DATA_ VIRTUAL_FILE_DATA;
 
+struct OC_VIRTUAL_FILE_BUFFER_ {
+  UINT32                   Signature;
+  UINT32                   RefCount;
+  UINT8                    *Buffer;
+  UINT64                   Size;
+};
+
 struct VIRTUAL_FILE_DATA_ {
   UINT32                   Signature;
   CHAR16                   *FileName;
+  OC_VIRTUAL_FILE_BUFFER   *SharedBuffer;
   UINT8                    *FileBuffer;
   UINT64                   FileSize;
   UINT64                   FilePosition;
   EFI_TIME                 ModificationTime;
-  EFI_FILE_OPEN            OpenCallback;
+  OC_VIRTUAL_FS_OPEN       OpenCallback;
+  EFI_HANDLE               DeviceHandle;
   EFI_FILE_PROTOCOL        *OriginalProtocol;
   EFI_FILE_PROTOCOL        Protocol;
 };
@@ -58,7 +71,8 @@ struct VIRTUAL_FILE_DATA_ {
 struct VIRTUAL_FILESYSTEM_DATA_ {
   UINT32                           Signature;
   EFI_SIMPLE_FILE_SYSTEM_PROTOCOL  *OriginalFileSystem;
-  EFI_FILE_OPEN                    OpenCallback;
+  EFI_HANDLE                       DeviceHandle;
+  OC_VIRTUAL_FS_OPEN               OpenCallback;
   EFI_SIMPLE_FILE_SYSTEM_PROTOCOL  FileSystem;
 };
 
@@ -53,7 +53,7 @@ VirtualFsOpenVolume (
     );
 
   if (!EFI_ERROR (Status)) {
-    return CreateRealFile (NewFile, Data->OpenCallback, TRUE, Root);
+    return CreateRealFile (NewFile, Data->DeviceHandle, Data->OpenCallback, TRUE, Root);
   }
 
   return Status;
@@ -70,7 +70,8 @@ mVirtualFileSystemProtocolTemplate = {
 EFI_STATUS
 CreateVirtualFs (
   IN     EFI_SIMPLE_FILE_SYSTEM_PROTOCOL  *OriginalFileSystem,
-  IN     EFI_FILE_OPEN                    OpenCallback,
+  IN     EFI_HANDLE                       DeviceHandle OPTIONAL,
+  IN     OC_VIRTUAL_FS_OPEN               OpenCallback,
   IN OUT EFI_SIMPLE_FILE_SYSTEM_PROTOCOL  **NewFileSystem
   )
 {
@@ -83,6 +84,12 @@ CreateVirtualFs (
   //
   for (Index = 0; Index < mVirtualFileSystemsUsed; ++Index) {
     if (mVirtualFileSystems[Index]->OriginalFileSystem == OriginalFileSystem) {
+      //
+      // File systems wrapped on LocateProtocol have no handle known.
+      //
+      if (mVirtualFileSystems[Index]->DeviceHandle == NULL) {
+        mVirtualFileSystems[Index]->DeviceHandle = DeviceHandle;
+      }
       *NewFileSystem = &mVirtualFileSystems[Index]->FileSystem;
       return EFI_SUCCESS;
     }
@@ -119,6 +126,7 @@ CreateVirtualFs (
 
   Data->Signature          = VIRTUAL_VOLUME_DATA_SIGNATURE;
   Data->OriginalFileSystem = OriginalFileSystem;
+  Data->DeviceHandle       = DeviceHandle;
   Data->OpenCallback       = OpenCallback;
   CopyMem (&Data->FileSystem, &mVirtualFileSystemProtocolTemplate, sizeof (Data->FileSystem));
 
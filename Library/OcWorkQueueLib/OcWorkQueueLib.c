@@ -0,0 +1,253 @@
+/** @file
+  Copyright (C) 2020, vit9696. All rights reserved.
+
+  All rights reserved.
+
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+**/
+
+#include <Uefi.h>
+
+#include <Protocol/MpService.h>
+
+#include <Library/BaseLib.h>
+#include <Library/DebugLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/OcWorkQueueLib.h>
+#include <Library/SynchronizationLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+
+/**
+  Claim and run jobs until the queue is drained.
+  This function is executed on both the BSP and the APs.
+
+  @param[in,out]  Queue  Work queue.
+  @param[in]      OnAp   Running on an application processor.
+**/
+STATIC
+VOID
+InternalWorkQueueDrain (
+  IN OUT OC_WORK_QUEUE  *Queue,
+  IN     BOOLEAN        OnAp
+  )
+{
+  UINT32  Index;
+
+  while (TRUE) {
+    Index = InterlockedIncrement (&Queue->NextJob) - 1;
+    if (Index >= Queue->JobCount) {
+      break;
+    }
+
+    Queue->Jobs[Index].Procedure (Queue->Jobs[Index].Context);
+
+    if (OnAp) {
+      InterlockedIncrement (&Queue->ApJobs);
+    }
+  }
+}
+
+/**
+  AP procedure for MP services.
+
+  @param[in,out]  Buffer  Work queue.
+**/
+STATIC
+VOID
+EFIAPI
+InternalWorkQueueApProcedure (
+  IN OUT VOID  *Buffer
+  )
+{
+  InternalWorkQueueDrain (Buffer, TRUE);
+}
+
+/**
+  Run work queue on all processors.
+
+  @param[in,out]  Queue       Work queue.
+  @param[in]      MpServices  MP services protocol.
+
+  @retval EFI_SUCCESS when the jobs were started on the APs.
+**/
+STATIC
+EFI_STATUS
+InternalWorkQueueRunMp (
+  IN OUT OC_WORK_QUEUE             *Queue,
+  IN     EFI_MP_SERVICES_PROTOCOL  *MpServices
+  )
+{
+  EFI_STATUS  Status;
+  EFI_EVENT   Event;
+  UINTN       ProcessorCount;
+  UINTN       EnabledCount;
+
+  Status = MpServices->GetNumberOfProcessors (
+    MpServices,
+    &ProcessorCount,
+    &EnabledCount
+    );
+  if (EFI_ERROR (Status) || EnabledCount <= 1) {
+    return EFI_UNSUPPORTED;
+  }
+
+  //
+  // Prefer non-blocking mode, so that the BSP takes jobs as well.
+  // Completion is detected via the event, as the APs may still hold
+  // the queue pointer after the last job is claimed.
+  //
+  Status = gBS->CreateEvent (0, 0, NULL, NULL, &Event);
+  if (!EFI_ERROR (Status)) {
+    Status = MpServices->StartupAllAPs (
+      MpServices,
+      InternalWorkQueueApProcedure,
+      FALSE,
+      Event,
+      0,
+      Queue,
+      NULL
+      );
+
+    if (!EFI_ERROR (Status)) {
+      InternalWorkQueueDrain (Queue, FALSE);
+      while (gBS->CheckEvent (Event) == EFI_NOT_READY) {
+        CpuPause ();
+      }
+    }
+
+    gBS->CloseEvent (Event);
+  }
+
+  //
+  // Some implementations do not support non-blocking mode.
+  // The remaining jobs, if any, are picked up by the caller.
+  //
+  if (Status == EFI_UNSUPPORTED) {
+    Status = MpServices->StartupAllAPs (
+      MpServices,
+      InternalWorkQueueApProcedure,
+      FALSE,
+      NULL,
+      0,
+      Queue,
+      NULL
+      );
+  }
+
+  return Status;
+}
+
+EFI_STATUS
+OcWorkQueueInit (
+  OUT OC_WORK_QUEUE  *Queue,
+  IN  UINT32         MaxJobs
+  )
+{
+  ASSERT (Queue != NULL);
+  ASSERT (MaxJobs > 0);
+
+  Queue->Jobs = AllocatePool (MaxJobs * sizeof (Queue->Jobs[0]));
+  if (Queue->Jobs == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Queue->JobCount = 0;
+  Queue->MaxJobs  = MaxJobs;
+  Queue->NextJob  = 0;
+  Queue->ApJobs   = 0;
+
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+OcWorkQueueAdd (
+  IN OUT OC_WORK_QUEUE            *Queue,
+  IN     OC_WORK_QUEUE_PROCEDURE  Procedure,
+  IN     VOID                     *Context
+  )
+{
+  ASSERT (Queue != NULL);
+  ASSERT (Procedure != NULL);
+
+  if (Queue->JobCount >= Queue->MaxJobs) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Queue->Jobs[Queue->JobCount].Procedure = Procedure;
+  Queue->Jobs[Queue->JobCount].Context   = Context;
+  ++Queue->JobCount;
+
+  return EFI_SUCCESS;
+}
+
+VOID
+OcWorkQueueRun (
+  IN OUT OC_WORK_QUEUE  *Queue
+  )
+{
+  EFI_STATUS                Status;
+  EFI_MP_SERVICES_PROTOCOL  *MpServices;
+  UINT32                    Pending;
+
+  ASSERT (Queue != NULL);
+
+  if (Queue->NextJob >= Queue->JobCount) {
+    return;
+  }
+
+  Pending       = Queue->JobCount - Queue->NextJob;
+  Queue->ApJobs = 0;
+  Status        = EFI_UNSUPPORTED;
+
+  if (Pending > 1) {
+    Status = gBS->LocateProtocol (
+      &gEfiMpServiceProtocolGuid,
+      NULL,
+      (VOID **) &MpServices
+      );
+    if (!EFI_ERROR (Status)) {
+      Status = InternalWorkQueueRunMp (Queue, MpServices);
+    }
+  }
+
+  //
+  // Serial fallback, also completes anything left after blocking mode.
+  //
+  InternalWorkQueueDrain (Queue, FALSE);
+
+  //
+  // Every processor overshoots the claim index once, restore it.
+  //
+  Queue->NextJob = Queue->JobCount;
+
+  DEBUG ((
+    DEBUG_VERBOSE,
+    "OCWQ: Completed %u jobs, %u on APs - %r\n",
+    Pending,
+    Queue->ApJobs,
+    Status
+    ));
+}
+
+VOID
+OcWorkQueueFree (
+  IN OUT OC_WORK_QUEUE  *Queue
+  )
+{
+  ASSERT (Queue != NULL);
+
+  if (Queue->Jobs != NULL) {
+    FreePool (Queue->Jobs);
+    Queue->Jobs = NULL;
+  }
+
+  Queue->JobCount = 0;
+  Queue->MaxJobs  = 0;
+  Queue->NextJob  = 0;
+}
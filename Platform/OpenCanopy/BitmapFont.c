@@ -29,6 +29,10 @@ BmfGetChar (
 
   ASSERT (Context != NULL);
 
+  if (Char < BMF_ASCII_CHARS && Context->AsciiChars[Char] != NULL) {
+    return Context->AsciiChars[Char];
+  }
+
   Chars = Context->Chars;
 
   for (Index = 0; Index < 2; ++Index) {
@@ -474,6 +478,13 @@ BmfContextInitialize (
     }
   }
 
+  //
+  // Resolve printable characters once, as labels are mostly ASCII.
+  //
+  for (Index = ' '; Index < BMF_ASCII_CHARS; ++Index) {
+    Context->AsciiChars[Index] = BmfGetChar (Context, (UINT32) Index);
+  }
+
   return TRUE;
 }
 
@@ -598,49 +609,39 @@ BmfGetTextInfo (
   return TextInfo;
 }
 
-STATIC
-EFI_GRAPHICS_OUTPUT_BLT_PIXEL
-mBlack = { 0, 0, 0, 255 };
-
-STATIC
-EFI_GRAPHICS_OUTPUT_BLT_PIXEL
-mWhite = { 255, 255, 255, 255 };
-
 STATIC
 VOID
-BlendMem (
-  EFI_GRAPHICS_OUTPUT_BLT_PIXEL *Dst,
-  EFI_GRAPHICS_OUTPUT_BLT_PIXEL *AlphaSrc,
-  EFI_GRAPHICS_OUTPUT_BLT_PIXEL *Color,
-  UINTN                         PixelCount
+BlendAlphaMem (
+  IN OUT UINT8        *Dst,
+  IN     CONST UINT8  *AlphaSrc,
+  IN     UINTN        PixelCount
   )
 {
   UINTN  Index;
 
+  //
+  // Equivalent of GuiBlendPixel for a solid colour over the label, which
+  // only accumulates coverage: Dst = Src + (1 - Src) * Dst.
+  //
   for (Index = 0; Index < PixelCount; ++Index) {
-    //
-    // We assume that the font is generated by dpFontBaker
-    // and has only gray channel, which should be interpreted as alpha.
-    //
-    GuiBlendPixel(Dst, Color, AlphaSrc->Red);
-    ++Dst;
-    ++AlphaSrc;
+    Dst[Index] = (UINT8) (AlphaSrc[Index] + ((0xFF - AlphaSrc[Index]) * Dst[Index]) / 0xFF);
   }
 }
 
-BOOLEAN
-GuiGetLabel (
-  OUT GUI_IMAGE               *LabelImage,
-  IN  CONST GUI_FONT_CONTEXT  *Context,
-  IN  CONST CHAR16            *String,
-  IN  UINTN                   StringLen,
-  IN  BOOLEAN                 Inverted
+STATIC
+EFI_GRAPHICS_OUTPUT_BLT_PIXEL *
+InternalRenderLabel (
+  IN CONST GUI_FONT_CONTEXT  *Context,
+  IN CONST BMF_TEXT_INFO     *TextInfo,
+  IN UINTN                   StringLen,
+  IN BOOLEAN                 Inverted
   )
 {
   EFI_GRAPHICS_OUTPUT_BLT_PIXEL *Buffer;
-  BMF_TEXT_INFO                 *TextInfo;
+  UINT8                         *Alpha;
   CONST BMF_KERNING_PAIR        **InfoPairs;
   UINTN                         Index;
+  UINTN                         PixelCount;
 
   UINT16                        RowIndex;
   UINT32                        SourceRowOffset;
@@ -648,26 +649,28 @@ GuiGetLabel (
   INT32                         TargetCharX;
   INT32                         InitialCharX;
   INT32                         InitialWidthOffset;
-
-  ASSERT (LabelImage != NULL);
-  ASSERT (Context    != NULL);
-  ASSERT (String     != NULL);
-
-  TextInfo = BmfGetTextInfo (&Context->BmfContext, String, StringLen, 0);
-  if (TextInfo == NULL) {
-    DEBUG ((DEBUG_WARN, "BMF: GetTextInfo failed\n"));
-    return FALSE;
-  }
-
-  Buffer = AllocateZeroPool ((UINT32) TextInfo->Width * (UINT32) TextInfo->Height * sizeof (*Buffer));
-  if (Buffer == NULL) {
-    DEBUG ((DEBUG_WARN, "BMF: out of res\n"));
-    FreePool (TextInfo);
-    return FALSE;
+  INT32                         StartX;
+  INT32                         RowWidth;
+  INT32                         BlendWidth;
+  INT32                         WrittenX;
+
+  PixelCount = (UINT32) TextInfo->Width * (UINT32) TextInfo->Height;
+
+  Alpha  = AllocateZeroPool (PixelCount);
+  Buffer = AllocatePool (PixelCount * sizeof (*Buffer));
+  if (Alpha == NULL || Buffer == NULL) {
+    if (Alpha != NULL) {
+      FreePool (Alpha);
+    }
+    if (Buffer != NULL) {
+      FreePool (Buffer);
+    }
+    return NULL;
   }
 
   InfoPairs   = (CONST BMF_KERNING_PAIR **)&TextInfo->Chars[StringLen];
   TargetCharX = 0;
+  WrittenX    = 0;
 
   if (TextInfo->Chars[0]->xoffset >= 0) {
     InitialCharX       = 0;
@@ -677,9 +680,18 @@ GuiGetLabel (
     InitialWidthOffset = TextInfo->Chars[0]->xoffset;
   }
 
+  //
+  // Compose glyph coverage first. Glyphs only overlap their predecessors
+  // due to negative offsets and kerning, so only the columns left of
+  // the rightmost drawn pixel need blending and the rest is copied.
+  //
   for (Index = 0; Index < StringLen; ++Index) {
     ASSERT (TextInfo->Chars[Index]->yoffset + TextInfo->OffsetY >= 0);
 
+    StartX     = TargetCharX + TextInfo->Chars[Index]->xoffset + InitialCharX;
+    RowWidth   = TextInfo->Chars[Index]->width + InitialWidthOffset;
+    BlendWidth = MIN (MAX (WrittenX - StartX, 0), RowWidth);
+
     for (
       RowIndex = 0,
         SourceRowOffset = TextInfo->Chars[Index]->y * Context->FontImage.Width,
@@ -689,24 +701,20 @@ GuiGetLabel (
         SourceRowOffset += Context->FontImage.Width,
         TargetRowOffset += TextInfo->Width
       ) {
-
-      if (Inverted) {
-        BlendMem (
-          &Buffer[TargetRowOffset + TargetCharX + TextInfo->Chars[Index]->xoffset + InitialCharX],
-          &Context->FontImage.Buffer[SourceRowOffset + TextInfo->Chars[Index]->x + InitialCharX],
-          &mBlack,
-          (TextInfo->Chars[Index]->width + InitialWidthOffset)
-          );
-      } else {
-        BlendMem (
-          &Buffer[TargetRowOffset + TargetCharX + TextInfo->Chars[Index]->xoffset + InitialCharX],
-          &Context->FontImage.Buffer[SourceRowOffset + TextInfo->Chars[Index]->x + InitialCharX],
-          &mWhite,
-          (TextInfo->Chars[Index]->width + InitialWidthOffset)
-          );
-      }
+      BlendAlphaMem (
+        &Alpha[TargetRowOffset + StartX],
+        &Context->FontAlpha[SourceRowOffset + TextInfo->Chars[Index]->x + InitialCharX],
+        (UINTN) BlendWidth
+        );
+      CopyMem (
+        &Alpha[TargetRowOffset + StartX + BlendWidth],
+        &Context->FontAlpha[SourceRowOffset + TextInfo->Chars[Index]->x + InitialCharX + BlendWidth],
+        (UINTN) (RowWidth - BlendWidth)
+        );
     }
 
+    WrittenX = MAX (WrittenX, StartX + RowWidth);
+
     TargetCharX += TextInfo->Chars[Index]->xadvance;
 
     if (InfoPairs[Index] != NULL) {
@@ -717,10 +725,275 @@ GuiGetLabel (
     InitialWidthOffset = 0;
   }
 
+  //
+  // Expand coverage to premultiplied white or black.
+  //
+  if (Inverted) {
+    for (Index = 0; Index < PixelCount; ++Index) {
+      Buffer[Index].Blue     = 0;
+      Buffer[Index].Green    = 0;
+      Buffer[Index].Red      = 0;
+      Buffer[Index].Reserved = Alpha[Index];
+    }
+  } else {
+    for (Index = 0; Index < PixelCount; ++Index) {
+      Buffer[Index].Blue     = Alpha[Index];
+      Buffer[Index].Green    = Alpha[Index];
+      Buffer[Index].Red      = Alpha[Index];
+      Buffer[Index].Reserved = Alpha[Index];
+    }
+  }
+
+  FreePool (Alpha);
+  return Buffer;
+}
+
+STATIC
+GUI_LABEL_CACHE_ENTRY *
+InternalLabelCacheLookup (
+  IN GUI_FONT_CONTEXT  *Context,
+  IN CONST CHAR16      *String,
+  IN UINTN             StringLen,
+  IN BOOLEAN           Inverted
+  )
+{
+  UINTN                  Index;
+  GUI_LABEL_CACHE_ENTRY  *Entry;
+
+  for (Index = 0; Index < ARRAY_SIZE (Context->LabelCache); ++Index) {
+    Entry = &Context->LabelCache[Index];
+    if (Entry->String != NULL
+      && Entry->Inverted == Inverted
+      && Entry->StringLen == StringLen
+      && CompareMem (Entry->String, String, StringLen * sizeof (*String)) == 0) {
+      return Entry;
+    }
+  }
+
+  return NULL;
+}
+
+STATIC
+VOID
+InternalLabelCacheFreeEntry (
+  IN OUT GUI_LABEL_CACHE_ENTRY  *Entry
+  )
+{
+  if (Entry->String != NULL) {
+    FreePool (Entry->String);
+    Entry->String = NULL;
+  }
+  if (Entry->Label.Buffer != NULL) {
+    FreePool (Entry->Label.Buffer);
+    Entry->Label.Buffer = NULL;
+  }
+}
+
+STATIC
+VOID
+InternalLabelCacheInsert (
+  IN OUT GUI_FONT_CONTEXT  *Context,
+  IN     CONST CHAR16      *String,
+  IN     UINTN             StringLen,
+  IN     BOOLEAN           Inverted,
+  IN     CONST GUI_IMAGE   *Label
+  )
+{
+  GUI_LABEL_CACHE_ENTRY  *Entry;
+
+  //
+  // Replace entries in round-robin order, the picker uses few labels anyway.
+  //
+  Entry = &Context->LabelCache[Context->LabelCacheNext];
+  Context->LabelCacheNext = (Context->LabelCacheNext + 1) % ARRAY_SIZE (Context->LabelCache);
+
+  InternalLabelCacheFreeEntry (Entry);
+
+  Entry->String       = AllocateCopyPool (StringLen * sizeof (*String), String);
+  Entry->Label.Buffer = AllocateCopyPool (
+    Label->Width * Label->Height * sizeof (*Label->Buffer),
+    Label->Buffer
+    );
+  if (Entry->String == NULL || Entry->Label.Buffer == NULL) {
+    InternalLabelCacheFreeEntry (Entry);
+    return;
+  }
+
+  Entry->StringLen    = StringLen;
+  Entry->Inverted     = Inverted;
+  Entry->Label.Width  = Label->Width;
+  Entry->Label.Height = Label->Height;
+}
+
+BOOLEAN
+GuiGetLabel (
+  OUT    GUI_IMAGE         *LabelImage,
+  IN OUT GUI_FONT_CONTEXT  *Context,
+  IN     CONST CHAR16      *String,
+  IN     UINTN             StringLen,
+  IN     BOOLEAN           Inverted
+  )
+{
+  EFI_GRAPHICS_OUTPUT_BLT_PIXEL *Buffer;
+  BMF_TEXT_INFO                 *TextInfo;
+  GUI_LABEL_CACHE_ENTRY         *Entry;
+
+  ASSERT (LabelImage != NULL);
+  ASSERT (Context    != NULL);
+  ASSERT (String     != NULL);
+
+  Entry = InternalLabelCacheLookup (Context, String, StringLen, Inverted);
+  if (Entry != NULL) {
+    Buffer = AllocateCopyPool (
+      Entry->Label.Width * Entry->Label.Height * sizeof (*Buffer),
+      Entry->Label.Buffer
+      );
+    if (Buffer == NULL) {
+      DEBUG ((DEBUG_WARN, "BMF: out of res\n"));
+      return FALSE;
+    }
+
+    ++Context->LabelCacheHits;
+    DEBUG ((
+      DEBUG_VERBOSE,
+      "BMF: Label cache hit %u/%u\n",
+      Context->LabelCacheHits,
+      Context->LabelCacheHits + Context->LabelCacheMisses
+      ));
+
+    LabelImage->Width  = Entry->Label.Width;
+    LabelImage->Height = Entry->Label.Height;
+    LabelImage->Buffer = Buffer;
+    return TRUE;
+  }
+
+  ++Context->LabelCacheMisses;
+
+  TextInfo = BmfGetTextInfo (&Context->BmfContext, String, StringLen, 0);
+  if (TextInfo == NULL) {
+    DEBUG ((DEBUG_WARN, "BMF: GetTextInfo failed\n"));
+    return FALSE;
+  }
+
+  Buffer = InternalRenderLabel (Context, TextInfo, StringLen, Inverted);
+  if (Buffer == NULL) {
+    DEBUG ((DEBUG_WARN, "BMF: out of res\n"));
+    FreePool (TextInfo);
+    return FALSE;
+  }
+
   LabelImage->Width  = TextInfo->Width;
   LabelImage->Height = TextInfo->Height;
   LabelImage->Buffer = Buffer;
   FreePool (TextInfo);
+
+  InternalLabelCacheInsert (Context, String, StringLen, Inverted, LabelImage);
+  return TRUE;
+}
+
+/**
+  Scale font metric from FontScale to Scale rounding towards negative
+  infinity. As floor (A) + floor (B) <= floor (A + B), scaled glyphs never
+  exceed the scaled bounds of their original glyphs.
+**/
+STATIC
+INT32
+InternalScaleFontMetric (
+  IN INT32  Value,
+  IN UINT8  Scale,
+  IN UINT8  FontScale
+  )
+{
+  Value *= Scale;
+
+  if (Value >= 0) {
+    return Value / FontScale;
+  }
+
+  return -((-Value + FontScale - 1) / FontScale);
+}
+
+/**
+  Resample font atlas and metrics validated by BmfContextInitialize
+  from FontScale to Scale. The metrics are updated in the font file buffer,
+  which is owned by the font context.
+**/
+STATIC
+BOOLEAN
+InternalScaleFont (
+  IN OUT GUI_FONT_CONTEXT  *Context,
+  IN     UINT8             Scale,
+  IN     UINT8             FontScale
+  )
+{
+  EFI_STATUS        Status;
+  GUI_IMAGE         Scaled;
+  BMF_BLOCK_COMMON  *Common;
+  BMF_CHAR          *Chars;
+  BMF_KERNING_PAIR  *Pairs;
+  CONST BMF_CHAR    *Char;
+  UINT32            Width;
+  UINT32            Height;
+  UINTN             Index;
+
+  Chars = (BMF_CHAR *) Context->BmfContext.Chars;
+
+  for (Index = 0; Index < Context->BmfContext.NumChars; ++Index) {
+    if ((UINT32) Chars[Index].x + Chars[Index].width > Context->FontImage.Width
+      || (UINT32) Chars[Index].y + Chars[Index].height > Context->FontImage.Height) {
+      DEBUG ((DEBUG_WARN, "BMF: Char %u is out of font image bounds\n", Chars[Index].id));
+      return FALSE;
+    }
+  }
+
+  Width  = (UINT32) MAX (InternalScaleFontMetric ((INT32) Context->FontImage.Width, Scale, FontScale), 1);
+  Height = (UINT32) MAX (InternalScaleFontMetric ((INT32) Context->FontImage.Height, Scale, FontScale), 1);
+
+  Status = GuiScaleImage (&Scaled, &Context->FontImage, Width, Height);
+  if (EFI_ERROR (Status)) {
+    return FALSE;
+  }
+
+  FreePool (Context->FontImage.Buffer);
+  Context->FontImage = Scaled;
+
+  for (Index = 0; Index < Context->BmfContext.NumChars; ++Index) {
+    Chars[Index].x        = (UINT16) InternalScaleFontMetric (Chars[Index].x, Scale, FontScale);
+    Chars[Index].y        = (UINT16) InternalScaleFontMetric (Chars[Index].y, Scale, FontScale);
+    Chars[Index].width    = (UINT16) InternalScaleFontMetric (Chars[Index].width, Scale, FontScale);
+    Chars[Index].height   = (UINT16) InternalScaleFontMetric (Chars[Index].height, Scale, FontScale);
+    Chars[Index].xoffset  = (INT16) InternalScaleFontMetric (Chars[Index].xoffset, Scale, FontScale);
+    Chars[Index].yoffset  = (INT16) InternalScaleFontMetric (Chars[Index].yoffset, Scale, FontScale);
+    Chars[Index].xadvance = (INT16) InternalScaleFontMetric (Chars[Index].xadvance, Scale, FontScale);
+    //
+    // Rounding may move negative offsets past the glyph extents, which
+    // BmfContextInitialize rejects, shift such glyphs by a pixel instead.
+    //
+    Chars[Index].xoffset  = (INT16) MAX (Chars[Index].xoffset, -MIN ((INT32) Chars[Index].width, (INT32) Chars[Index].xadvance));
+    Chars[Index].yoffset  = (INT16) MAX (Chars[Index].yoffset, -(INT32) Chars[Index].height);
+  }
+
+  Pairs = (BMF_KERNING_PAIR *) Context->BmfContext.KerningPairs;
+
+  for (Index = 0; Index < Context->BmfContext.NumKerningPairs; ++Index) {
+    Pairs[Index].amount = (INT16) InternalScaleFontMetric (Pairs[Index].amount, Scale, FontScale);
+    //
+    // Pair characters are known to exist after BmfContextInitialize.
+    //
+    Char = BmfGetChar (&Context->BmfContext, Pairs[Index].first);
+    ASSERT (Char != NULL);
+    Pairs[Index].amount = (INT16) MAX (
+      Pairs[Index].amount,
+      -(Char->xoffset + MIN ((INT32) Char->width, (INT32) Char->xadvance))
+      );
+  }
+
+  Common             = (BMF_BLOCK_COMMON *) Context->BmfContext.Common;
+  Common->lineHeight = (UINT16) InternalScaleFontMetric (Common->lineHeight, Scale, FontScale);
+  Common->base       = (UINT16) InternalScaleFontMetric (Common->base, Scale, FontScale);
+  Common->scaleW     = (UINT16) Width;
+  Common->scaleH     = (UINT16) Height;
+
   return TRUE;
 }
 
@@ -730,17 +1003,23 @@ GuiFontConstruct (
   IN  VOID              *FontImage,
   IN  UINTN             FontImageSize,
   IN  VOID              *FileBuffer,
-  IN  UINT32            FileSize
+  IN  UINT32            FileSize,
+  IN  UINT8             Scale,
+  IN  UINT8             FontScale
   )
 {
   EFI_STATUS    Status;
   BOOLEAN       Result;
+  UINTN         PixelCount;
+  UINTN         Index;
 
   ASSERT (Context       != NULL);
   ASSERT (FontImage     != NULL);
   ASSERT (FontImageSize > 0);
   ASSERT (FileBuffer    != NULL);
   ASSERT (FileSize      > 0);
+  ASSERT (Scale         > 0);
+  ASSERT (FontScale     > 0);
 
   ZeroMem (Context, sizeof (*Context));
 
@@ -758,6 +1037,40 @@ GuiFontConstruct (
     return FALSE;
   }
 
+  //
+  // Resample the font once, so that labels are rendered at the exact scale.
+  //
+  if (Scale != FontScale) {
+    Result = BmfContextInitialize (&Context->BmfContext, FileBuffer, FileSize);
+    if (Result) {
+      Result = InternalScaleFont (Context, Scale, FontScale);
+    }
+
+    if (!Result) {
+      GuiFontDestruct (Context);
+      return FALSE;
+    }
+  }
+
+  //
+  // We assume that the font is generated by dpFontBaker and has only gray
+  // channel, which should be interpreted as alpha. Keep it as a plain alpha
+  // atlas, so that glyph rows can be copied directly.
+  //
+  PixelCount = (UINTN) Context->FontImage.Width * Context->FontImage.Height;
+  Context->FontAlpha = AllocatePool (PixelCount);
+  if (Context->FontAlpha == NULL) {
+    GuiFontDestruct (Context);
+    return FALSE;
+  }
+
+  for (Index = 0; Index < PixelCount; ++Index) {
+    Context->FontAlpha[Index] = Context->FontImage.Buffer[Index].Red;
+  }
+
+  FreePool (Context->FontImage.Buffer);
+  Context->FontImage.Buffer = NULL;
+
   Result = BmfContextInitialize (&Context->BmfContext, FileBuffer, FileSize);
   if (!Result) {
     GuiFontDestruct (Context);
@@ -773,11 +1086,29 @@ GuiFontDestruct (
   IN GUI_FONT_CONTEXT  *Context
   )
 {
+  UINTN  Index;
+
   ASSERT (Context != NULL);
+
+  DEBUG ((
+    DEBUG_INFO,
+    "OCUI: Label cache %u hits %u misses\n",
+    Context->LabelCacheHits,
+    Context->LabelCacheMisses
+    ));
+
+  for (Index = 0; Index < ARRAY_SIZE (Context->LabelCache); ++Index) {
+    InternalLabelCacheFreeEntry (&Context->LabelCache[Index]);
+  }
+
   if (Context->FontImage.Buffer != NULL) {
     FreePool (Context->FontImage.Buffer);
     Context->FontImage.Buffer = NULL;
   }
+  if (Context->FontAlpha != NULL) {
+    FreePool (Context->FontAlpha);
+    Context->FontAlpha = NULL;
+  }
   if (Context->KerningData != NULL) {
     FreePool (Context->KerningData);
     Context->KerningData = NULL;
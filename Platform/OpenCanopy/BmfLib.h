@@ -11,6 +11,8 @@
 #include "BmfFile.h"
 #include "OpenCanopy.h"
 
+#define BMF_ASCII_CHARS  128
+
 typedef struct {
   CONST BMF_BLOCK_INFO          *Info;
   CONST BMF_BLOCK_COMMON        *Common;
@@ -21,21 +23,55 @@ typedef struct {
   UINT32                        NumKerningPairs;
   UINT16                        Height;
   INT16                         OffsetY;
+  //
+  // Direct lookup for the most common characters.
+  //
+  CONST BMF_CHAR                *AsciiChars[BMF_ASCII_CHARS];
 } BMF_CONTEXT;
 
+#define GUI_LABEL_CACHE_SIZE  32
+
+typedef struct {
+  CHAR16    *String;
+  UINTN     StringLen;
+  BOOLEAN   Inverted;
+  GUI_IMAGE Label;
+} GUI_LABEL_CACHE_ENTRY;
+
 typedef struct {
-  GUI_IMAGE   FontImage;
-  BMF_CONTEXT BmfContext;
-  VOID        *KerningData;
+  GUI_IMAGE             FontImage;
+  UINT8                 *FontAlpha;
+  BMF_CONTEXT           BmfContext;
+  VOID                  *KerningData;
+  GUI_LABEL_CACHE_ENTRY LabelCache[GUI_LABEL_CACHE_SIZE];
+  UINT32                LabelCacheNext;
+  UINT32                LabelCacheHits;
+  UINT32                LabelCacheMisses;
 } GUI_FONT_CONTEXT;
 
+/**
+  Construct font context from a BMF font, taking ownership of both buffers.
+
+  @param[out] Context        Font context.
+  @param[in]  FontImage      Font image PNG data, freed by this function.
+  @param[in]  FontImageSize  Font image PNG data size.
+  @param[in]  FileBuffer     Font metrics data, freed by GuiFontDestruct.
+  @param[in]  FileSize       Font metrics data size.
+  @param[in]  Scale          Requested font scale.
+  @param[in]  FontScale      Scale the font was made for, the font is
+                             resampled when it differs from Scale.
+
+  @retval TRUE on success.
+**/
 BOOLEAN
 GuiFontConstruct (
   OUT GUI_FONT_CONTEXT  *Context,
   IN  VOID              *FontImage,
   IN  UINTN             FontImageSize,
   IN  VOID              *FileBuffer,
-  IN  UINT32            FileSize
+  IN  UINT32            FileSize,
+  IN  UINT8             Scale,
+  IN  UINT8             FontScale
   );
 
 VOID
@@ -45,11 +81,11 @@ GuiFontDestruct (
 
 BOOLEAN
 GuiGetLabel (
-  OUT GUI_IMAGE               *LabelImage,
-  IN  CONST GUI_FONT_CONTEXT  *Context,
-  IN  CONST CHAR16            *String,
-  IN  UINTN                   StringLen,
-  IN  BOOLEAN                 Inverted
+  OUT    GUI_IMAGE         *LabelImage,
+  IN OUT GUI_FONT_CONTEXT  *Context,
+  IN     CONST CHAR16      *String,
+  IN     UINTN             StringLen,
+  IN     BOOLEAN           Inverted
   );
 
 #endif // BMF_LIB_H
@@ -10,10 +10,12 @@
 #include <IndustryStandard/AppleIcon.h>
 #include <Protocol/OcInterface.h>
 
+#include <Library/BaseMemoryLib.h>
 #include <Library/DebugLib.h>
 #include <Library/MemoryAllocationLib.h>
 #include <Library/OcBootManagementLib.h>
 #include <Library/OcStorageLib.h>
+#include <Library/OcWorkQueueLib.h>
 #include <Library/UefiBootServicesTableLib.h>
 #include <Library/UefiRuntimeServicesTableLib.h>
 #include <Library/PrintLib.h>
@@ -96,7 +98,7 @@ InternalContextDestruct (
     InternalSafeFreePool (Context->Labels[Index].Buffer);
   }
 
-  InternalSafeFreePool (Context->FontContext.FontImage.Buffer);
+  GuiFontDestruct (&Context->FontContext);
   /*
   InternalSafeFreePool (Context->Poof[0].Buffer);
   InternalSafeFreePool (Context->Poof[1].Buffer);
@@ -106,10 +108,53 @@ InternalContextDestruct (
   */
 }
 
+typedef struct {
+  GUI_ICNS_DECODE  Decode;
+  VOID             *FileData;
+} GUI_ICON_DECODE_JOB;
+
+STATIC
+VOID
+EFIAPI
+InternalIconDecodeJob (
+  IN OUT VOID  *Context
+  )
+{
+  GUI_ICON_DECODE_JOB  *Job;
+
+  Job = Context;
+  GuiIcnsDecodeImageIcon (&Job->Decode);
+}
+
+typedef struct {
+  GUI_IMAGE        *SelectedImage;
+  CONST GUI_IMAGE  *SourceImage;
+} GUI_HIGHLIGHT_JOB;
+
+STATIC
+VOID
+EFIAPI
+InternalHighlightJob (
+  IN OUT VOID  *Context
+  )
+{
+  GUI_HIGHLIGHT_JOB  *Job;
+
+  Job = Context;
+  GuiDrawHighlightedImage (Job->SelectedImage, Job->SourceImage, &mHighlightPixel);
+}
+
+/**
+  Read icon files and prepare them for decoding, PNG decoding is left to
+  the jobs added to Queue. Every job must be completed by
+  CompleteImageFileFromStorage.
+**/
 STATIC
 EFI_STATUS
 LoadImageFileFromStorage (
   OUT GUI_IMAGE                *Images,
+  OUT GUI_ICON_DECODE_JOB      *Jobs,
+  IN  OC_WORK_QUEUE            *Queue,
   IN  OC_STORAGE_CONTEXT       *Storage,
   IN  CONST CHAR8              *ImageFilePath,
   IN  UINT8                    Scale,
@@ -128,7 +173,7 @@ LoadImageFileFromStorage (
   UINT32        Index;
 
   ASSERT (ImageFilePath != NULL);
-  ASSERT (Scale == 1 || Scale == 2);
+  ASSERT (Scale > 0);
 
   ImageCount = Icon ? ICON_TYPE_COUNT : 1; ///< Icons can be external.
 
@@ -150,18 +195,27 @@ LoadImageFileFromStorage (
     if (OcStorageExistsFileUnicode (Storage, Path)) {
       FileData = OcStorageReadFileUnicode (Storage, Path, &FileSize);
       if (FileData != NULL && FileSize > 0) {
-        Status = GuiIcnsToImageIcon (
+        Status = GuiIcnsPrepareImageIcon (
           &Images[Index],
           FileData,
           FileSize,
           Scale,
           MatchWidth,
           MatchHeight,
-          AllowLessSize
+          AllowLessSize,
+          &Jobs[Index].Decode
           );
       }
 
-      if (FileData != NULL) {
+      if (!EFI_ERROR (Status) && Jobs[Index].Decode.Pending) {
+        //
+        // Icon data is referenced until the decoding completes.
+        //
+        Jobs[Index].FileData = FileData;
+        if (EFI_ERROR (OcWorkQueueAdd (Queue, InternalIconDecodeJob, &Jobs[Index]))) {
+          InternalIconDecodeJob (&Jobs[Index]);
+        }
+      } else if (FileData != NULL) {
         FreePool (FileData);
       }
     }
@@ -184,12 +238,51 @@ LoadImageFileFromStorage (
   return EFI_SUCCESS;
 }
 
+/**
+  Complete icons prepared by LoadImageFileFromStorage.
+**/
+STATIC
+EFI_STATUS
+CompleteImageFileFromStorage (
+  IN OUT GUI_ICON_DECODE_JOB  *Jobs,
+  IN     CONST CHAR8          *ImageFilePath
+  )
+{
+  EFI_STATUS  Status;
+  EFI_STATUS  ImageStatus;
+  UINT32      Index;
+
+  Status = EFI_SUCCESS;
+
+  for (Index = 0; Index < ICON_TYPE_COUNT; ++Index) {
+    ImageStatus = GuiIcnsCompleteImageIcon (&Jobs[Index].Decode);
+    InternalSafeFreePool (Jobs[Index].FileData);
+    Jobs[Index].FileData = NULL;
+
+    if (EFI_ERROR (ImageStatus)) {
+      DEBUG ((
+        DEBUG_INFO,
+        "OCUI: Failed to decode image (%u/%u) %a - %r\n",
+        Index+1,
+        ICON_TYPE_COUNT,
+        ImageFilePath,
+        ImageStatus
+        ));
+      if (Index == ICON_TYPE_BASE) {
+        Status = EFI_NOT_FOUND;
+      }
+    }
+  }
+
+  return Status;
+}
+
 STATIC
 EFI_STATUS
 LoadLabelFileFromStorageForScale (
   IN  OC_STORAGE_CONTEXT       *Storage,
   IN  CONST CHAR8              *LabelFilePath,
-  IN  UINT8                    Scale,
+  IN  BOOLEAN                  HighRes,
   OUT VOID                     **FileData,
   OUT UINT32                   *FileSize
   )
@@ -197,14 +290,12 @@ LoadLabelFileFromStorageForScale (
   EFI_STATUS    Status;
   CHAR16        Path[OC_STORAGE_SAFE_PATH_MAX];
 
-  ASSERT (Scale == 1 || Scale == 2);
-
   Status = OcUnicodeSafeSPrint (
     Path,
     sizeof (Path),
     OPEN_CORE_LABEL_PATH L"%a.%a",
     LabelFilePath,
-    Scale == 2 ? "l2x" : "lbl"
+    HighRes ? "l2x" : "lbl"
     );
   if (EFI_ERROR (Status)) {
     DEBUG ((DEBUG_WARN, "OCUI: Cannot fit %a\n", LabelFilePath));
@@ -227,32 +318,110 @@ LoadLabelFileFromStorageForScale (
   return EFI_SUCCESS;
 }
 
+typedef struct {
+  GUI_IMAGE  *Image;
+  VOID       *FileData;
+  BOOLEAN    Inverted;
+  UINT8      LabelScale;
+} GUI_LABEL_DECODE_JOB;
+
+STATIC
+VOID
+EFIAPI
+InternalLabelDecodeJob (
+  IN OUT VOID  *Context
+  )
+{
+  GUI_LABEL_DECODE_JOB  *Job;
+
+  Job = Context;
+  GuiLabelDecodeImage (Job->Image, Job->FileData, Job->Inverted);
+}
+
+/**
+  Load labels and decode them on Queue together with the jobs already added
+  to it. Queue is run even on failure.
+**/
+STATIC
 EFI_STATUS
-LoadLabelFromStorage (
+LoadLabelsFromStorage (
+  IN  OC_WORK_QUEUE            *Queue,
   IN  OC_STORAGE_CONTEXT       *Storage,
-  IN  CONST CHAR8              *ImageFilePath,
   IN  UINT8                    Scale,
   IN  BOOLEAN                  Inverted,
-  OUT GUI_IMAGE                *Image
+  OUT GUI_IMAGE                *Labels
   )
 {
-  VOID           *ImageData;
-  UINT32         ImageSize;
-  EFI_STATUS     Status;
+  EFI_STATUS            Status;
+  GUI_LABEL_DECODE_JOB  Jobs[LABEL_NUM_TOTAL];
+  UINT32                FileSize;
+  UINT32                Index;
 
-  ASSERT (Scale == 1 || Scale == 2);
+  ASSERT (Scale > 0);
 
-  Status = LoadLabelFileFromStorageForScale (Storage, ImageFilePath, Scale, &ImageData, &ImageSize);
-  if (EFI_ERROR (Status)) {
-    return Status;
+  ZeroMem (Jobs, sizeof (Jobs));
+
+  //
+  // Storage access and allocations are done on the BSP, only the pixel
+  // expansion is distributed over the available processors.
+  //
+  for (Index = 0; Index < LABEL_NUM_TOTAL; ++Index) {
+    //
+    // Prefer 2x labels, which are resampled to the exact scale below.
+    //
+    Jobs[Index].LabelScale = 2;
+    Status = LoadLabelFileFromStorageForScale (
+      Storage,
+      mLabelNames[Index],
+      TRUE,
+      &Jobs[Index].FileData,
+      &FileSize
+      );
+    if (EFI_ERROR (Status)) {
+      Jobs[Index].LabelScale = 1;
+      Status = LoadLabelFileFromStorageForScale (
+        Storage,
+        mLabelNames[Index],
+        FALSE,
+        &Jobs[Index].FileData,
+        &FileSize
+        );
+    }
+
+    if (EFI_ERROR (Status)) {
+      Jobs[Index].FileData = NULL;
+      break;
+    }
+
+    Status = GuiLabelAllocateImage (
+      &Labels[Index],
+      Jobs[Index].FileData,
+      FileSize,
+      Jobs[Index].LabelScale
+      );
+    if (EFI_ERROR (Status)) {
+      DEBUG ((DEBUG_WARN, "OCUI: Failed to decode label %a - %r\n", mLabelNames[Index], Status));
+      break;
+    }
+
+    Jobs[Index].Image    = &Labels[Index];
+    Jobs[Index].Inverted = Inverted;
+    if (EFI_ERROR (OcWorkQueueAdd (Queue, InternalLabelDecodeJob, &Jobs[Index]))) {
+      InternalLabelDecodeJob (&Jobs[Index]);
+    }
   }
 
-  Status = GuiLabelToImage (Image, ImageData, ImageSize, Scale, Inverted);
+  //
+  // Queued labels reference their file data, so run them even on failure.
+  //
+  OcWorkQueueRun (Queue);
 
-  FreePool (ImageData);
+  for (Index = 0; Index < LABEL_NUM_TOTAL; ++Index) {
+    InternalSafeFreePool (Jobs[Index].FileData);
 
-  if (EFI_ERROR (Status)) {
-    DEBUG ((DEBUG_WARN, "OCUI: Failed to decode label %a - %r\n", ImageFilePath, Status));
+    if (!EFI_ERROR (Status)) {
+      Status = GuiLabelScaleImage (&Labels[Index], Scale, Jobs[Index].LabelScale);
+    }
   }
 
   return Status;
@@ -272,10 +441,15 @@ InternalContextConstruct (
   UINT32                             FontImageSize;
   UINT32                             FontDataSize;
   UINTN                              UiScaleSize;
+  UINT8                              FontScale;
   UINT32                             Index;
   UINT32                             ImageDimension;
   BOOLEAN                            Old;
   BOOLEAN                            Result;
+  OC_WORK_QUEUE                      Queue;
+  GUI_ICON_DECODE_JOB                *IconJobs;
+  EFI_STATUS                         IconStatus[ICON_NUM_TOTAL];
+  GUI_HIGHLIGHT_JOB                  HighlightJob;
 
   ASSERT (Context != NULL);
 
@@ -290,7 +464,10 @@ InternalContextConstruct (
     (VOID *) &Context->Scale
     );
 
-  if (EFI_ERROR (Status) || Context->Scale != 2) {
+  //
+  // Any scale is supported, assets are resampled to it once while loading.
+  //
+  if (EFI_ERROR (Status) || Context->Scale == 0) {
     Context->Scale = 1;
   }
 
@@ -335,8 +512,29 @@ InternalContextConstruct (
 
   Context->BootEntry = NULL;
 
-  Status = EFI_SUCCESS;
+  IconJobs = AllocateZeroPool (ICON_NUM_TOTAL * ICON_TYPE_COUNT * sizeof (*IconJobs));
+  if (IconJobs == NULL) {
+    DEBUG ((DEBUG_WARN, "OCUI: Failed to load images\n"));
+    InternalContextDestruct (Context);
+    return EFI_UNSUPPORTED;
+  }
+
+  //
+  // Every icon image may need decoding, then the selector needs highlighting
+  // while the labels are decoded.
+  //
+  Status = OcWorkQueueInit (&Queue, ICON_NUM_TOTAL * ICON_TYPE_COUNT + 1 + LABEL_NUM_TOTAL);
+  if (EFI_ERROR (Status)) {
+    FreePool (IconJobs);
+    DEBUG ((DEBUG_WARN, "OCUI: Failed to load images\n"));
+    InternalContextDestruct (Context);
+    return EFI_UNSUPPORTED;
+  }
 
+  //
+  // Storage access and allocations are done on the BSP, PNG decoding
+  // with premultiplication is distributed over the available processors.
+  //
   for (Index = 0; Index < ICON_NUM_TOTAL; ++Index) {
     if (Index == ICON_CURSOR) {
       ImageDimension = MAX_CURSOR_DIMENSION;
@@ -348,8 +546,10 @@ InternalContextConstruct (
       ImageDimension = BOOT_ENTRY_ICON_DIMENSION;
     }
 
-    Status = LoadImageFileFromStorage (
+    IconStatus[Index] = LoadImageFileFromStorage (
       Context->Icons[Index],
+      &IconJobs[Index * ICON_TYPE_COUNT],
+      &Queue,
       Storage,
       mIconNames[Index],
       Context->Scale,
@@ -359,13 +559,42 @@ InternalContextConstruct (
       Old,
       Index == ICON_CURSOR
       );
+  }
+
+  OcWorkQueueRun (&Queue);
+
+  //
+  // All icons are completed to release decoding memory even on failure.
+  //
+  for (Index = 0; Index < ICON_NUM_TOTAL; ++Index) {
+    Status = CompleteImageFileFromStorage (
+      &IconJobs[Index * ICON_TYPE_COUNT],
+      mIconNames[Index]
+      );
+    if (!EFI_ERROR (IconStatus[Index])) {
+      IconStatus[Index] = Status;
+    }
+  }
+
+  FreePool (IconJobs);
+
+  Status = EFI_SUCCESS;
+
+  for (Index = 0; Index < ICON_NUM_TOTAL; ++Index) {
+    Status = IconStatus[Index];
 
     if (!EFI_ERROR (Status) && Index == ICON_SELECTOR) {
-      Status = GuiCreateHighlightedImage (
+      Status = GuiAllocateHighlightedImage (
         &Context->Icons[Index][ICON_TYPE_HELD],
-        &Context->Icons[Index][ICON_TYPE_BASE],
-        &mHighlightPixel
+        &Context->Icons[Index][ICON_TYPE_BASE]
         );
+      if (!EFI_ERROR (Status)) {
+        HighlightJob.SelectedImage = &Context->Icons[Index][ICON_TYPE_HELD];
+        HighlightJob.SourceImage   = &Context->Icons[Index][ICON_TYPE_BASE];
+        if (EFI_ERROR (OcWorkQueueAdd (&Queue, InternalHighlightJob, &HighlightJob))) {
+          InternalHighlightJob (&HighlightJob);
+        }
+      }
     }
 
     //
@@ -388,28 +617,41 @@ InternalContextConstruct (
     Status = EFI_SUCCESS;
   }
 
+  //
+  // Highlighting runs in parallel with label decoding, and is run even
+  // on failure, as its image is already allocated.
+  //
   if (!EFI_ERROR (Status)) {
-    for (Index = 0; Index < LABEL_NUM_TOTAL; ++Index) {
-      Status |= LoadLabelFromStorage (
-        Storage,
-        mLabelNames[Index],
-        Context->Scale,
-        Context->LightBackground,
-        &Context->Labels[Index]
-        );
-    }
+    Status = LoadLabelsFromStorage (
+      &Queue,
+      Storage,
+      Context->Scale,
+      Context->LightBackground,
+      Context->Labels
+      );
+  } else {
+    OcWorkQueueRun (&Queue);
   }
 
+  OcWorkQueueFree (&Queue);
+
   if (EFI_ERROR (Status)) {
     DEBUG ((DEBUG_WARN, "OCUI: Failed to load images\n"));
     InternalContextDestruct (Context);
     return EFI_UNSUPPORTED;
   }
 
-  if (Context->Scale == 2) {
-    FontImage = OcStorageReadFileUnicode (Storage, OPEN_CORE_FONT_PATH L"Font_2x.png", &FontImageSize);
-    FontData  = OcStorageReadFileUnicode (Storage, OPEN_CORE_FONT_PATH L"Font_2x.bin", &FontDataSize);
-  } else {
+  //
+  // Prefer the 2x font, which is resampled to the exact scale.
+  //
+  FontScale = 2;
+  FontImage = OcStorageReadFileUnicode (Storage, OPEN_CORE_FONT_PATH L"Font_2x.png", &FontImageSize);
+  FontData  = OcStorageReadFileUnicode (Storage, OPEN_CORE_FONT_PATH L"Font_2x.bin", &FontDataSize);
+
+  if (FontImage == NULL || FontData == NULL) {
+    InternalSafeFreePool (FontImage);
+    InternalSafeFreePool (FontData);
+    FontScale = 1;
     FontImage = OcStorageReadFileUnicode (Storage, OPEN_CORE_FONT_PATH L"Font_1x.png", &FontImageSize);
     FontData  = OcStorageReadFileUnicode (Storage, OPEN_CORE_FONT_PATH L"Font_1x.bin", &FontDataSize);
   }
@@ -420,7 +662,9 @@ InternalContextConstruct (
       FontImage,
       FontImageSize,
       FontData,
-      FontDataSize
+      FontDataSize,
+      Context->Scale,
+      FontScale
       );
     if (Context->FontContext.BmfContext.Height != BOOT_ENTRY_LABEL_HEIGHT * Context->Scale) {
         DEBUG((
@@ -432,6 +676,8 @@ InternalContextConstruct (
       Result = FALSE;
     }
   } else {
+    InternalSafeFreePool (FontImage);
+    InternalSafeFreePool (FontData);
     Result = FALSE;
   }
 
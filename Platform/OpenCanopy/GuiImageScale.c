@@ -0,0 +1,315 @@
+/** @file
+  This file is part of OpenCanopy, OpenCore GUI.
+
+  Copyright (C) 2020, vit9696. All rights reserved.<BR>
+  SPDX-License-Identifier: BSD-3-Clause
+**/
+
+#include <Uefi.h>
+
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/OcGuardLib.h>
+
+#include "OpenCanopy.h"
+
+//
+// Pixels are processed as two 16-bit lanes holding Blue/Red and Green/Alpha
+// channels respectively, which allows handling all four channels with two
+// multiplications without touching vector registers. Since all images are
+// premultiplied, linear combinations of pixels stay premultiplied.
+//
+#define GUI_SCALE_LANE_MASK  0x00FF00FFU
+
+//
+// Bilinear weights have 8 bits of precision.
+//
+#define GUI_SCALE_WEIGHT_BITS  8U
+#define GUI_SCALE_WEIGHT_ONE   (1U << GUI_SCALE_WEIGHT_BITS)
+
+/**
+  Average a 2x2 block of premultiplied pixels with rounding.
+**/
+STATIC
+UINT32
+InternalAverage4 (
+  IN UINT32  P0,
+  IN UINT32  P1,
+  IN UINT32  P2,
+  IN UINT32  P3
+  )
+{
+  UINT32  Low;
+  UINT32  High;
+
+  Low  = (P0 & GUI_SCALE_LANE_MASK) + (P1 & GUI_SCALE_LANE_MASK)
+    + (P2 & GUI_SCALE_LANE_MASK) + (P3 & GUI_SCALE_LANE_MASK) + 0x00020002U;
+  High = ((P0 >> 8U) & GUI_SCALE_LANE_MASK) + ((P1 >> 8U) & GUI_SCALE_LANE_MASK)
+    + ((P2 >> 8U) & GUI_SCALE_LANE_MASK) + ((P3 >> 8U) & GUI_SCALE_LANE_MASK) + 0x00020002U;
+
+  return ((Low >> 2U) & GUI_SCALE_LANE_MASK) | ((High << 6U) & ~GUI_SCALE_LANE_MASK);
+}
+
+/**
+  Linearly interpolate two premultiplied pixels, Weight is in [0, 256].
+**/
+STATIC
+UINT32
+InternalLerp (
+  IN UINT32  P0,
+  IN UINT32  P1,
+  IN UINT32  Weight
+  )
+{
+  UINT32  InvWeight;
+  UINT32  Low;
+  UINT32  High;
+
+  InvWeight = GUI_SCALE_WEIGHT_ONE - Weight;
+
+  Low  = (P0 & GUI_SCALE_LANE_MASK) * InvWeight + (P1 & GUI_SCALE_LANE_MASK) * Weight;
+  High = ((P0 >> 8U) & GUI_SCALE_LANE_MASK) * InvWeight + ((P1 >> 8U) & GUI_SCALE_LANE_MASK) * Weight;
+
+  return ((Low >> GUI_SCALE_WEIGHT_BITS) & GUI_SCALE_LANE_MASK) | (High & ~GUI_SCALE_LANE_MASK);
+}
+
+/**
+  Allocate image of the given dimensions.
+**/
+STATIC
+EFI_STATUS
+InternalAllocateImage (
+  OUT GUI_IMAGE  *Image,
+  IN  UINT32     Width,
+  IN  UINT32     Height
+  )
+{
+  UINTN  Size;
+
+  if (Width == 0 || Height == 0
+    || OcOverflowTriMulUN (Width, Height, sizeof (*Image->Buffer), &Size)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Image->Buffer = AllocatePool (Size);
+  if (Image->Buffer == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Image->Width  = Width;
+  Image->Height = Height;
+  return EFI_SUCCESS;
+}
+
+/**
+  Downscale image by 2 in both directions with a box filter.
+  Odd trailing rows and columns are folded into the last output pixel.
+**/
+STATIC
+VOID
+InternalHalveImage (
+  OUT GUI_IMAGE        *Destination,
+  IN  CONST GUI_IMAGE  *Source
+  )
+{
+  CONST UINT32  *SourceRow0;
+  CONST UINT32  *SourceRow1;
+  UINT32        *Target;
+  UINT32        X;
+  UINT32        Y;
+  UINT32        X0;
+  UINT32        X1;
+
+  Target = (UINT32 *) Destination->Buffer;
+
+  for (Y = 0; Y < Destination->Height; ++Y) {
+    SourceRow0 = (CONST UINT32 *) Source->Buffer + (UINTN) (Y * 2) * Source->Width;
+    SourceRow1 = Y * 2 + 1 < Source->Height ? SourceRow0 + Source->Width : SourceRow0;
+
+    for (X = 0; X < Destination->Width; ++X) {
+      X0 = X * 2;
+      X1 = X0 + 1 < Source->Width ? X0 + 1 : X0;
+      *Target++ = InternalAverage4 (SourceRow0[X0], SourceRow0[X1], SourceRow1[X0], SourceRow1[X1]);
+    }
+  }
+}
+
+/**
+  Resample image with a bilinear filter using pixel centre alignment.
+**/
+STATIC
+EFI_STATUS
+InternalBilinearImage (
+  OUT GUI_IMAGE        *Destination,
+  IN  CONST GUI_IMAGE  *Source
+  )
+{
+  UINT32        *Columns;
+  UINT8         *Weights;
+  CONST UINT32  *SourceRow0;
+  CONST UINT32  *SourceRow1;
+  UINT32        *Target;
+  UINT32        X;
+  UINT32        Y;
+  UINT32        Column;
+  UINT32        WeightY;
+  UINT64        Position;
+  UINT64        Step;
+  UINT32        Top;
+  UINT32        Bottom;
+
+  //
+  // Precompute source columns and weights shared by all rows.
+  //
+  Columns = AllocatePool (Destination->Width * (sizeof (*Columns) + sizeof (*Weights)));
+  if (Columns == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Weights = (UINT8 *) (Columns + Destination->Width);
+
+  //
+  // Positions are in 32.32 fixed point, shifted by half a pixel to make
+  // them non-negative: Source = (Target + 0.5) * Step - 0.5.
+  //
+  Step     = DivU64x32 (LShiftU64 (Source->Width, 32), Destination->Width);
+  Position = RShiftU64 (Step, 1);
+  for (X = 0; X < Destination->Width; ++X, Position += Step) {
+    if (Position < BIT31) {
+      Columns[X] = 0;
+      Weights[X] = 0;
+    } else {
+      Column = (UINT32) RShiftU64 (Position - BIT31, 32);
+      if (Column + 1 >= Source->Width) {
+        Columns[X] = Source->Width - 1;
+        Weights[X] = 0;
+      } else {
+        Columns[X] = Column;
+        Weights[X] = (UINT8) ((UINT32) (Position - BIT31) >> (32U - GUI_SCALE_WEIGHT_BITS));
+      }
+    }
+  }
+
+  Target   = (UINT32 *) Destination->Buffer;
+  Step     = DivU64x32 (LShiftU64 (Source->Height, 32), Destination->Height);
+  Position = RShiftU64 (Step, 1);
+  for (Y = 0; Y < Destination->Height; ++Y, Position += Step) {
+    if (Position < BIT31) {
+      Top     = 0;
+      Bottom  = 0;
+      WeightY = 0;
+    } else {
+      Top = (UINT32) RShiftU64 (Position - BIT31, 32);
+      if (Top + 1 >= Source->Height) {
+        Top     = Source->Height - 1;
+        Bottom  = Top;
+        WeightY = 0;
+      } else {
+        Bottom  = Top + 1;
+        WeightY = (UINT32) (Position - BIT31) >> (32U - GUI_SCALE_WEIGHT_BITS);
+      }
+    }
+
+    SourceRow0 = (CONST UINT32 *) Source->Buffer + (UINTN) Top * Source->Width;
+    SourceRow1 = (CONST UINT32 *) Source->Buffer + (UINTN) Bottom * Source->Width;
+
+    for (X = 0; X < Destination->Width; ++X) {
+      Column = Columns[X];
+      if (Weights[X] == 0) {
+        *Target++ = InternalLerp (SourceRow0[Column], SourceRow1[Column], WeightY);
+      } else {
+        *Target++ = InternalLerp (
+          InternalLerp (SourceRow0[Column], SourceRow0[Column + 1], Weights[X]),
+          InternalLerp (SourceRow1[Column], SourceRow1[Column + 1], Weights[X]),
+          WeightY
+          );
+      }
+    }
+  }
+
+  FreePool (Columns);
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+GuiScaleImage (
+  OUT GUI_IMAGE        *Destination,
+  IN  CONST GUI_IMAGE  *Source,
+  IN  UINT32           Width,
+  IN  UINT32           Height
+  )
+{
+  EFI_STATUS  Status;
+  GUI_IMAGE   Current;
+  GUI_IMAGE   Next;
+
+  ASSERT (Destination != NULL);
+  ASSERT (Source != NULL);
+  ASSERT (Source->Buffer != NULL);
+
+  if (Source->Width == 0 || Source->Height == 0 || Width == 0 || Height == 0) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  //
+  // Box-filter by halves while at least twice as large. This keeps bilinear
+  // sampling, which only looks at 2x2 neighbours, from skipping pixels.
+  //
+  Current = *Source;
+  while (Current.Width >= Width * 2 && Current.Height >= Height * 2) {
+    Status = InternalAllocateImage (&Next, (Current.Width + 1) / 2, (Current.Height + 1) / 2);
+    if (!EFI_ERROR (Status)) {
+      InternalHalveImage (&Next, &Current);
+    }
+
+    if (Current.Buffer != Source->Buffer) {
+      FreePool (Current.Buffer);
+    }
+
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+
+    Current = Next;
+  }
+
+  if (Current.Width == Width && Current.Height == Height) {
+    if (Current.Buffer == Source->Buffer) {
+      Status = InternalAllocateImage (Destination, Width, Height);
+      if (!EFI_ERROR (Status)) {
+        CopyMem (Destination->Buffer, Source->Buffer, Width * Height * sizeof (*Source->Buffer));
+      }
+
+      return Status;
+    }
+
+    *Destination = Current;
+    return EFI_SUCCESS;
+  }
+
+  Status = InternalAllocateImage (Destination, Width, Height);
+  if (!EFI_ERROR (Status)) {
+    Status = InternalBilinearImage (Destination, &Current);
+    if (EFI_ERROR (Status)) {
+      FreePool (Destination->Buffer);
+    }
+  }
+
+  if (Current.Buffer != Source->Buffer) {
+    FreePool (Current.Buffer);
+  }
+
+  DEBUG ((
+    DEBUG_VERBOSE,
+    "OCUI: Scaled %ux%u image to %ux%u - %r\n",
+    Source->Width,
+    Source->Height,
+    Width,
+    Height,
+    Status
+    ));
+
+  return Status;
+}
@@ -43,6 +43,21 @@ GuiOutputBlt (
   IN UINTN                              Delta OPTIONAL
   );
 
+/**
+  Copy 32-bit pixels to the framebuffer with non-temporal stores.
+
+  @param[out] Destination  Framebuffer pointer.
+  @param[in]  Source       Source pixels.
+  @param[in]  PixelCount   Number of pixels to copy.
+**/
+VOID
+EFIAPI
+GuiOutputStreamPixels (
+  OUT VOID        *Destination,
+  IN  CONST VOID  *Source,
+  IN  UINTN       PixelCount
+  );
+
 CONST EFI_GRAPHICS_OUTPUT_MODE_INFORMATION *
 GuiOutputGetInfo (
   IN GUI_OUTPUT_CONTEXT  *Context
@@ -47,18 +47,22 @@ OcShowMenuByOc (
 {
   EFI_STATUS    Status;
   UINTN         Index;
+  UINT32        Span;
 
   *ChosenBootEntry = NULL;
   mGuiContext.BootEntry = NULL;
   mGuiContext.HideAuxiliary = BootContext->PickerContext->HideAuxiliary;
   mGuiContext.Refresh = FALSE;
 
+  Span = OcProfileBegin ("GuiMenuStart");
+
   Status = GuiLibConstruct (
     BootContext->PickerContext,
     mGuiContext.CursorDefaultX,
     mGuiContext.CursorDefaultY
     );
   if (EFI_ERROR (Status)) {
+    OcProfileEnd (Span);
     return Status;
   }
 
@@ -74,6 +78,7 @@ OcShowMenuByOc (
     );
   if (EFI_ERROR (Status)) {
     GuiLibDestruct ();
+    OcProfileEnd (Span);
     return Status;
   }
 
@@ -86,10 +91,13 @@ OcShowMenuByOc (
       );
     if (EFI_ERROR (Status)) {
       GuiLibDestruct ();
+      OcProfileEnd (Span);
       return Status;
     }
   }
 
+  OcProfileEnd (Span);
+
   GuiDrawLoop (&mDrawContext, BootContext->PickerContext->TimeoutSeconds);
   ASSERT (mGuiContext.BootEntry != NULL || mGuiContext.Refresh);
 
@@ -139,8 +147,11 @@ GuiOcInterfaceRun (
   )
 {
   EFI_STATUS Status;
+  UINT32     Span;
 
+  Span   = OcProfileBegin ("GuiContextConstruct");
   Status = InternalContextConstruct (&mGuiContext, Storage, Context);
+  OcProfileEnd (Span);
   if (EFI_ERROR (Status)) {
     return Status;
   }
@@ -1280,15 +1280,134 @@ GuiClearScreen (
     );
 }
 
+/**
+  Bring decoded icon to the requested dimensions. The image is converted
+  from its own scale to the requested scale, and images larger than
+  requested are downscaled preserving aspect ratio. Unless smaller images
+  are allowed, images not reaching the requested dimensions are rejected,
+  and non-matching aspect ratio is padded with transparent pixels to
+  the exact requested dimensions.
+**/
+STATIC
 EFI_STATUS
-GuiIcnsToImageIcon (
-  OUT GUI_IMAGE  *Image,
-  IN  VOID       *IcnsImage,
-  IN  UINT32     IcnsImageSize,
-  IN  UINT8      Scale,
-  IN  UINT32     MatchWidth,
-  IN  UINT32     MatchHeight,
-  IN  BOOLEAN    AllowLess
+InternalFitIconImage (
+  IN OUT GUI_IMAGE  *Image,
+  IN     UINT8      Scale,
+  IN     UINT32     MatchWidth,
+  IN     UINT32     MatchHeight,
+  IN     BOOLEAN    AllowLess,
+  IN     UINT8      ImageScale
+  )
+{
+  EFI_STATUS                     Status;
+  GUI_IMAGE                      Scaled;
+  EFI_GRAPHICS_OUTPUT_BLT_PIXEL  *Buffer;
+  UINT32                         Width;
+  UINT32                         Height;
+  UINT32                         TargetWidth;
+  UINT32                         TargetHeight;
+  UINT32                         OffsetX;
+  UINT32                         OffsetY;
+  UINT32                         Row;
+
+  ASSERT (Scale > 0);
+  ASSERT (ImageScale > 0);
+
+  TargetWidth  = MatchWidth * Scale;
+  TargetHeight = MatchHeight * Scale;
+
+  if (Image->Width == 0 || Image->Height == 0) {
+    Width  = 0;
+    Height = 0;
+  } else {
+    Width  = (UINT32) MAX (DivU64x32 (MultU64x32 (Image->Width, Scale), ImageScale), 1);
+    Height = (UINT32) MAX (DivU64x32 (MultU64x32 (Image->Height, Scale), ImageScale), 1);
+  }
+
+  if (Width > 0 && MatchWidth > 0 && MatchHeight > 0) {
+    if (Width > TargetWidth || Height > TargetHeight) {
+      //
+      // Fit into the requested dimensions by the most constraining side.
+      //
+      if (MultU64x32 (Image->Width, TargetHeight) > MultU64x32 (Image->Height, TargetWidth)) {
+        Width  = TargetWidth;
+        Height = (UINT32) MAX (DivU64x32 (MultU64x32 (Image->Height, TargetWidth), Image->Width), 1);
+      } else {
+        Width  = (UINT32) MAX (DivU64x32 (MultU64x32 (Image->Width, TargetHeight), Image->Height), 1);
+        Height = TargetHeight;
+      }
+    } else if (!AllowLess && Width < TargetWidth && Height < TargetHeight) {
+      Width = 0;
+    }
+  }
+
+  if (Width == 0) {
+    DEBUG ((
+      DEBUG_INFO,
+      "OCUI: Expected %dx%d, actual %dx%d@%ux, allow less: %d\n",
+       TargetWidth,
+       TargetHeight,
+       Image->Width,
+       Image->Height,
+       ImageScale,
+       AllowLess
+      ));
+    FreePool (Image->Buffer);
+    return EFI_UNSUPPORTED;
+  }
+
+  if (Width != Image->Width || Height != Image->Height) {
+    Status = GuiScaleImage (&Scaled, Image, Width, Height);
+    FreePool (Image->Buffer);
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+
+    *Image = Scaled;
+  }
+
+  if (AllowLess || MatchWidth == 0 || MatchHeight == 0
+    || (Width == TargetWidth && Height == TargetHeight)) {
+    return EFI_SUCCESS;
+  }
+
+  //
+  // Centre the image on a transparent canvas of the requested dimensions.
+  //
+  Buffer = AllocateZeroPool (TargetWidth * TargetHeight * sizeof (*Buffer));
+  if (Buffer == NULL) {
+    FreePool (Image->Buffer);
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  OffsetX = (TargetWidth - Width) / 2;
+  OffsetY = (TargetHeight - Height) / 2;
+
+  for (Row = 0; Row < Height; ++Row) {
+    CopyMem (
+      &Buffer[(OffsetY + Row) * TargetWidth + OffsetX],
+      &Image->Buffer[Row * Width],
+      Width * sizeof (*Buffer)
+      );
+  }
+
+  FreePool (Image->Buffer);
+  Image->Width  = TargetWidth;
+  Image->Height = TargetHeight;
+  Image->Buffer = Buffer;
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+GuiIcnsPrepareImageIcon (
+  OUT GUI_IMAGE        *Image,
+  IN  VOID             *IcnsImage,
+  IN  UINT32           IcnsImageSize,
+  IN  UINT8            Scale,
+  IN  UINT32           MatchWidth,
+  IN  UINT32           MatchHeight,
+  IN  BOOLEAN          AllowLess,
+  OUT GUI_ICNS_DECODE  *Decode
   )
 {
   EFI_STATUS         Status;
@@ -1297,10 +1416,16 @@ GuiIcnsToImageIcon (
   UINT32             ImageSize;
   UINT32             DecodedBytes;
   APPLE_ICNS_RECORD  *Record;
+  APPLE_ICNS_RECORD  *RecordIC07;
+  APPLE_ICNS_RECORD  *RecordIC13;
   APPLE_ICNS_RECORD  *RecordIT32;
   APPLE_ICNS_RECORD  *RecordT8MK;
+  UINT8              ImageScale;
+
+  ASSERT (Scale > 0);
+  ASSERT (Decode != NULL);
 
-  ASSERT (Scale == 1 || Scale == 2);
+  Decode->Pending = FALSE;
 
   //
   // We do not need to support 'it32' 128x128 icon format,
@@ -1317,6 +1442,8 @@ GuiIcnsToImageIcon (
     return EFI_SECURITY_VIOLATION;
   }
 
+  RecordIC07 = NULL;
+  RecordIC13 = NULL;
   RecordIT32 = NULL;
   RecordT8MK = NULL;
 
@@ -1337,94 +1464,207 @@ GuiIcnsToImageIcon (
       return EFI_SECURITY_VIOLATION;
     }
 
-    if ((Scale == 1 && Record->Type == APPLE_ICNS_IC07)
-      || (Scale == 2 && Record->Type == APPLE_ICNS_IC13)) {
-      Status = GuiPngToImage (
-        Image,
-        Record->Data,
-        RecordLength - sizeof (APPLE_ICNS_RECORD),
+    if (Record->Type == APPLE_ICNS_IC07) {
+      RecordIC07 = Record;
+    } else if (Record->Type == APPLE_ICNS_IC13) {
+      RecordIC13 = Record;
+    } else if (Record->Type == APPLE_ICNS_IT32) {
+      RecordIT32 = Record;
+    } else if (Record->Type == APPLE_ICNS_T8MK) {
+      RecordT8MK = Record;
+    }
+  }
+
+  //
+  // Prefer the high resolution icon, which is resampled once to the exact
+  // requested dimensions, lower resolutions are only used without it.
+  //
+  if (RecordIC13 != NULL) {
+    Record     = RecordIC13;
+    ImageScale = 2;
+  } else {
+    Record     = RecordIC07;
+    ImageScale = 1;
+  }
+
+  if (Record == NULL) {
+    if (RecordT8MK != NULL && RecordIT32 != NULL) {
+      Image->Width  = MatchWidth;
+      Image->Height = MatchHeight;
+      ImageSize     = (MatchWidth * MatchHeight) * sizeof (EFI_GRAPHICS_OUTPUT_BLT_PIXEL);
+      Image->Buffer = AllocateZeroPool (ImageSize);
+
+      if (Image->Buffer == NULL) {
+        return EFI_OUT_OF_RESOURCES;
+      }
+
+      //
+      // We have to add an additional UINT32 for IT32, since it has a reserved field.
+      //
+      DecodedBytes = DecompressMaskedRLE24 (
+        (UINT8 *) Image->Buffer,
+        ImageSize,
+        RecordIT32->Data + sizeof (UINT32),
+        SwapBytes32 (RecordIT32->Size) - sizeof (APPLE_ICNS_RECORD) - sizeof (UINT32),
+        RecordT8MK->Data,
+        SwapBytes32 (RecordT8MK->Size) - sizeof (APPLE_ICNS_RECORD),
         TRUE
         );
 
-      if (!EFI_ERROR (Status) && MatchWidth > 0 && MatchHeight > 0) {
-        if (AllowLess
-          ? (Image->Width >  MatchWidth * Scale || Image->Height >  MatchWidth * Scale
-          || Image->Width == 0 || Image->Height == 0)
-          : (Image->Width != MatchWidth * Scale || Image->Height != MatchHeight * Scale)) {
-          FreePool (Image->Buffer);
-          DEBUG ((
-            DEBUG_INFO,
-            "OCUI: Expected %dx%d, actual %dx%d, allow less: %d\n",
-             MatchWidth * Scale,
-             MatchHeight * Scale,
-             Image->Width,
-             Image->Height,
-             AllowLess
-            ));
-          Status = EFI_UNSUPPORTED;
-        }
+      if (DecodedBytes != ImageSize) {
+        FreePool (Image->Buffer);
+        return EFI_UNSUPPORTED;
       }
 
+      return InternalFitIconImage (
+        Image,
+        Scale,
+        MatchWidth,
+        MatchHeight,
+        AllowLess,
+        1
+        );
+    }
+
+    return EFI_NOT_FOUND;
+  }
+
+  Status = DecodePngBgraPrepare (
+    Record->Data,
+    SwapBytes32 (Record->Size) - sizeof (APPLE_ICNS_RECORD),
+    TRUE,
+    &Decode->Png
+    );
+  if (Status == EFI_UNSUPPORTED) {
+    //
+    // Images needing generic decoding are rare, decode them right away.
+    //
+    Status = GuiPngToImage (
+      Image,
+      Record->Data,
+      SwapBytes32 (Record->Size) - sizeof (APPLE_ICNS_RECORD),
+      TRUE
+      );
+    if (EFI_ERROR (Status)) {
       return Status;
     }
 
-    if (Scale == 1) {
-      if (Record->Type == APPLE_ICNS_IT32) {
-        RecordIT32 = Record;
-      } else if (Record->Type == APPLE_ICNS_T8MK) {
-        RecordT8MK = Record;
-      }
+    return InternalFitIconImage (
+      Image,
+      Scale,
+      MatchWidth,
+      MatchHeight,
+      AllowLess,
+      ImageScale
+      );
+  }
 
-      if (RecordT8MK != NULL && RecordIT32 != NULL) {
-        Image->Width  = MatchWidth;
-        Image->Height = MatchHeight;
-        ImageSize     = (MatchWidth * MatchHeight) * sizeof (EFI_GRAPHICS_OUTPUT_BLT_PIXEL);
-        Image->Buffer = AllocateZeroPool (ImageSize);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_INFO, "OCUI: DecodePNG - %r\n", Status));
+    return Status;
+  }
 
-        if (Image->Buffer == NULL) {
-          return EFI_OUT_OF_RESOURCES;
-        }
+  Decode->Image       = Image;
+  Decode->Scale       = Scale;
+  Decode->MatchWidth  = MatchWidth;
+  Decode->MatchHeight = MatchHeight;
+  Decode->AllowLess   = AllowLess;
+  Decode->ImageScale  = ImageScale;
+  Decode->Pending     = TRUE;
 
-        //
-        // We have to add an additional UINT32 for IT32, since it has a reserved field.
-        //
-        DecodedBytes = DecompressMaskedRLE24 (
-          (UINT8 *) Image->Buffer,
-          ImageSize,
-          RecordIT32->Data + sizeof (UINT32),
-          SwapBytes32 (RecordIT32->Size) - sizeof (APPLE_ICNS_RECORD) - sizeof (UINT32),
-          RecordT8MK->Data,
-          SwapBytes32 (RecordT8MK->Size) - sizeof (APPLE_ICNS_RECORD),
-          TRUE
-          );
+  return EFI_SUCCESS;
+}
 
-        if (DecodedBytes != ImageSize) {
-          FreePool (Image->Buffer);
-          return EFI_UNSUPPORTED;
-        }
+VOID
+GuiIcnsDecodeImageIcon (
+  IN OUT GUI_ICNS_DECODE  *Decode
+  )
+{
+  if (Decode->Pending) {
+    DecodePngBgraRun (&Decode->Png);
+  }
+}
 
-        return EFI_SUCCESS;
-      }
-    }
+EFI_STATUS
+GuiIcnsCompleteImageIcon (
+  IN OUT GUI_ICNS_DECODE  *Decode
+  )
+{
+  EFI_STATUS  Status;
+  GUI_IMAGE   *Image;
+
+  if (!Decode->Pending) {
+    return EFI_SUCCESS;
   }
 
-  return EFI_NOT_FOUND;
+  Decode->Pending = FALSE;
+  Image           = Decode->Image;
+
+  Status = DecodePngBgraComplete (
+    &Decode->Png,
+    (VOID **) &Image->Buffer,
+    &Image->Width,
+    &Image->Height
+    );
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_INFO, "OCUI: DecodePNG - %r\n", Status));
+    return Status;
+  }
+
+  return InternalFitIconImage (
+    Image,
+    Decode->Scale,
+    Decode->MatchWidth,
+    Decode->MatchHeight,
+    Decode->AllowLess,
+    Decode->ImageScale
+    );
 }
 
 EFI_STATUS
-GuiLabelToImage (
+GuiIcnsToImageIcon (
+  OUT GUI_IMAGE  *Image,
+  IN  VOID       *IcnsImage,
+  IN  UINT32     IcnsImageSize,
+  IN  UINT8      Scale,
+  IN  UINT32     MatchWidth,
+  IN  UINT32     MatchHeight,
+  IN  BOOLEAN    AllowLess
+  )
+{
+  EFI_STATUS       Status;
+  GUI_ICNS_DECODE  Decode;
+
+  Status = GuiIcnsPrepareImageIcon (
+    Image,
+    IcnsImage,
+    IcnsImageSize,
+    Scale,
+    MatchWidth,
+    MatchHeight,
+    AllowLess,
+    &Decode
+    );
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  GuiIcnsDecodeImageIcon (&Decode);
+  return GuiIcnsCompleteImageIcon (&Decode);
+}
+
+EFI_STATUS
+GuiLabelAllocateImage (
   OUT GUI_IMAGE *Image,
   IN  VOID      *RawData,
   IN  UINT32    DataLength,
-  IN  UINT8     Scale,
-  IN  BOOLEAN   Inverted
+  IN  UINT8     Scale
   )
 {
   APPLE_DISK_LABEL  *Label;
-  UINT32            PixelIdx;
 
   ASSERT (RawData != NULL);
-  ASSERT (Scale == 1 || Scale == 2);
+  ASSERT (Scale > 0);
 
   if (DataLength < sizeof (APPLE_DISK_LABEL)) {
     return EFI_INVALID_PARAMETER;
@@ -1449,6 +1689,21 @@ GuiLabelToImage (
     return EFI_OUT_OF_RESOURCES;
   }
 
+  return EFI_SUCCESS;
+}
+
+VOID
+GuiLabelDecodeImage (
+  IN OUT GUI_IMAGE   *Image,
+  IN     CONST VOID  *RawData,
+  IN     BOOLEAN     Inverted
+  )
+{
+  CONST APPLE_DISK_LABEL  *Label;
+  UINT32                  PixelIdx;
+
+  Label = RawData;
+
   if (Inverted) {
     for (PixelIdx = 0; PixelIdx < Image->Width * Image->Height; PixelIdx++) {
       Image->Buffer[PixelIdx].Blue     = 0;
@@ -1464,10 +1719,68 @@ GuiLabelToImage (
       Image->Buffer[PixelIdx].Reserved = 255 -  gAppleDiskLabelImagePalette[Label->Data[PixelIdx]];
     }
   }
+}
+
+EFI_STATUS
+GuiLabelScaleImage (
+  IN OUT GUI_IMAGE  *Image,
+  IN     UINT8      Scale,
+  IN     UINT8      LabelScale
+  )
+{
+  EFI_STATUS  Status;
+  GUI_IMAGE   Scaled;
+
+  ASSERT (Scale > 0);
+  ASSERT (LabelScale > 0);
+
+  if (Scale == LabelScale) {
+    return EFI_SUCCESS;
+  }
 
+  Status = GuiScaleImage (
+    &Scaled,
+    Image,
+    (UINT32) MAX (DivU64x32 (MultU64x32 (Image->Width, Scale), LabelScale), 1),
+    (UINT32) MAX (DivU64x32 (MultU64x32 (Image->Height, Scale), LabelScale), 1)
+    );
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  FreePool (Image->Buffer);
+  *Image = Scaled;
   return EFI_SUCCESS;
 }
 
+EFI_STATUS
+GuiLabelToImage (
+  OUT GUI_IMAGE *Image,
+  IN  VOID      *RawData,
+  IN  UINT32    DataLength,
+  IN  UINT8     Scale,
+  IN  UINT8     LabelScale,
+  IN  BOOLEAN   Inverted
+  )
+{
+  EFI_STATUS  Status;
+
+  Status = GuiLabelAllocateImage (Image, RawData, DataLength, LabelScale);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  GuiLabelDecodeImage (Image, RawData, Inverted);
+
+  Status = GuiLabelScaleImage (Image, Scale, LabelScale);
+  if (EFI_ERROR (Status)) {
+    FreePool (Image->Buffer);
+    Image->Buffer = NULL;
+  }
+
+  return Status;
+}
+
 EFI_STATUS
 GuiPngToImage (
   OUT GUI_IMAGE  *Image,
@@ -1477,13 +1790,14 @@ GuiPngToImage (
   )
 {
   EFI_STATUS                       Status;
-  EFI_GRAPHICS_OUTPUT_BLT_PIXEL    *BufferWalker;
-  UINTN                            Index;
-  UINT8                            TmpChannel;
 
-  Status = DecodePng (
+  //
+  // Decode straight into EFI_GRAPHICS_OUTPUT_BLT_PIXEL layout.
+  //
+  Status = DecodePngBgra (
     ImageData,
     ImageDataSize,
+    PremultiplyAlpha,
     (VOID **) &Image->Buffer,
     &Image->Width,
     &Image->Height,
@@ -1495,25 +1809,38 @@ GuiPngToImage (
     return Status;
   }
 
-  if (PremultiplyAlpha) {
-    BufferWalker = Image->Buffer;
-    for (Index = 0; Index < (UINTN) Image->Width * Image->Height; ++Index) {
-      TmpChannel             = (UINT8) ((BufferWalker->Blue * BufferWalker->Reserved) / 0xFF);
-      BufferWalker->Blue     = (UINT8) ((BufferWalker->Red * BufferWalker->Reserved) / 0xFF);
-      BufferWalker->Green    = (UINT8) ((BufferWalker->Green * BufferWalker->Reserved) / 0xFF);
-      BufferWalker->Red      = TmpChannel;
-      ++BufferWalker;
-    }
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+GuiAllocateHighlightedImage (
+  OUT GUI_IMAGE        *SelectedImage,
+  IN  CONST GUI_IMAGE  *SourceImage
+  )
+{
+  ASSERT (SelectedImage != NULL);
+  ASSERT (SourceImage != NULL);
+  ASSERT (SourceImage->Buffer != NULL);
+  //
+  // The multiplication cannot wrap around because the original allocation sane.
+  //
+  SelectedImage->Buffer = AllocatePool (
+    SourceImage->Width * SourceImage->Height * sizeof (*SourceImage->Buffer)
+    );
+  if (SelectedImage->Buffer == NULL) {
+    return EFI_OUT_OF_RESOURCES;
   }
 
+  SelectedImage->Width  = SourceImage->Width;
+  SelectedImage->Height = SourceImage->Height;
   return EFI_SUCCESS;
 }
 
-EFI_STATUS
-GuiCreateHighlightedImage (
-  OUT GUI_IMAGE                            *SelectedImage,
-  IN  CONST GUI_IMAGE                      *SourceImage,
-  IN  CONST EFI_GRAPHICS_OUTPUT_BLT_PIXEL  *HighlightPixel
+VOID
+GuiDrawHighlightedImage (
+  IN OUT GUI_IMAGE                            *SelectedImage,
+  IN     CONST GUI_IMAGE                      *SourceImage,
+  IN     CONST EFI_GRAPHICS_OUTPUT_BLT_PIXEL  *HighlightPixel
   )
 {
   EFI_GRAPHICS_OUTPUT_BLT_PIXEL PremulPixel;
@@ -1526,19 +1853,17 @@ GuiCreateHighlightedImage (
   UINT32                        RowOffset;
 
   ASSERT (SelectedImage != NULL);
+  ASSERT (SelectedImage->Buffer != NULL);
   ASSERT (SourceImage != NULL);
   ASSERT (SourceImage->Buffer != NULL);
   ASSERT (HighlightPixel != NULL);
-  //
-  // The multiplication cannot wrap around because the original allocation sane.
-  //
-  Buffer = AllocateCopyPool (
-             SourceImage->Width * SourceImage->Height * sizeof (*SourceImage->Buffer),
-             SourceImage->Buffer
-             );
-  if (Buffer == NULL) {
-    return EFI_OUT_OF_RESOURCES;
-  }
+
+  Buffer = SelectedImage->Buffer;
+  CopyMem (
+    Buffer,
+    SourceImage->Buffer,
+    SourceImage->Width * SourceImage->Height * sizeof (*SourceImage->Buffer)
+    );
 
   PremulPixel.Blue     = (UINT8)((HighlightPixel->Blue  * HighlightPixel->Reserved) / 0xFF);
   PremulPixel.Green    = (UINT8)((HighlightPixel->Green * HighlightPixel->Reserved) / 0xFF);
@@ -1582,10 +1907,23 @@ GuiCreateHighlightedImage (
       }
     }
   }
+}
 
-  SelectedImage->Width  = SourceImage->Width;
-  SelectedImage->Height = SourceImage->Height;
-  SelectedImage->Buffer = Buffer;
+EFI_STATUS
+GuiCreateHighlightedImage (
+  OUT GUI_IMAGE                            *SelectedImage,
+  IN  CONST GUI_IMAGE                      *SourceImage,
+  IN  CONST EFI_GRAPHICS_OUTPUT_BLT_PIXEL  *HighlightPixel
+  )
+{
+  EFI_STATUS  Status;
+
+  Status = GuiAllocateHighlightedImage (SelectedImage, SourceImage);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  GuiDrawHighlightedImage (SelectedImage, SourceImage, HighlightPixel);
   return EFI_SUCCESS;
 }
 
@@ -9,6 +9,7 @@
 #define OPEN_CANOPY_H
 
 #include <Library/OcBootManagementLib.h>
+#include <Library/OcPngLib.h>
 #include <Protocol/GraphicsOutput.h>
 #include <Protocol/SimpleTextIn.h>
 
@@ -143,6 +144,94 @@ GuiPngToImage (
   IN  BOOLEAN    PremultiplyAlpha
   );
   
+/**
+  Resample premultiplied image to the given dimensions. Downscaling is done
+  with a box filter by halves followed by a bilinear filter for the
+  remaining fractional ratio.
+
+  @param[out] Destination  Resulting image, to be freed by the caller.
+  @param[in]  Source       Source image.
+  @param[in]  Width        Resulting image width.
+  @param[in]  Height       Resulting image height.
+
+  @retval EFI_SUCCESS on success.
+**/
+EFI_STATUS
+GuiScaleImage (
+  OUT GUI_IMAGE        *Destination,
+  IN  CONST GUI_IMAGE  *Source,
+  IN  UINT32           Width,
+  IN  UINT32           Height
+  );
+
+/**
+  Icon decoding prepared by GuiIcnsPrepareImageIcon.
+**/
+typedef struct {
+  GUI_IMAGE           *Image;
+  OC_PNG_BGRA_DECODE  Png;
+  UINT8               Scale;
+  UINT32              MatchWidth;
+  UINT32              MatchHeight;
+  UINT8               ImageScale;
+  BOOLEAN             AllowLess;
+  BOOLEAN             Pending;
+} GUI_ICNS_DECODE;
+
+/**
+  Parse ICNS image and prepare its icon for decoding. Icons, which do not
+  need PNG decoding or need generic PNG decoding, are decoded right away.
+  Otherwise the icon is pending, IcnsImage must stay valid until the icon
+  is completed, and memory for decoding is allocated.
+
+  @param[out] Image          Resulting image.
+  @param[in]  IcnsImage      ICNS image data.
+  @param[in]  IcnsImageSize  ICNS image data size.
+  @param[in]  Scale          Image scale.
+  @param[in]  MatchWidth     Requested image width.
+  @param[in]  MatchHeight    Requested image height.
+  @param[in]  AllowLess      Allow images smaller than requested.
+  @param[out] Decode         Prepared decoding to be run by GuiIcnsDecodeImageIcon
+                             and completed by GuiIcnsCompleteImageIcon.
+
+  @retval EFI_SUCCESS on success.
+**/
+EFI_STATUS
+GuiIcnsPrepareImageIcon (
+  OUT GUI_IMAGE        *Image,
+  IN  VOID             *IcnsImage,
+  IN  UINT32           IcnsImageSize,
+  IN  UINT8            Scale,
+  IN  UINT32           MatchWidth,
+  IN  UINT32           MatchHeight,
+  IN  BOOLEAN          AllowLess,
+  OUT GUI_ICNS_DECODE  *Decode
+  );
+
+/**
+  Decode icon prepared by GuiIcnsPrepareImageIcon.
+  This function does not call any UEFI services and is safe to run on APs.
+
+  @param[in,out] Decode  Prepared decoding.
+**/
+VOID
+GuiIcnsDecodeImageIcon (
+  IN OUT GUI_ICNS_DECODE  *Decode
+  );
+
+/**
+  Complete icon decoding and bring the icon to the requested dimensions.
+  Must be called for every icon prepared by GuiIcnsPrepareImageIcon.
+
+  @param[in,out] Decode  Prepared decoding.
+
+  @retval EFI_SUCCESS on success.
+**/
+EFI_STATUS
+GuiIcnsCompleteImageIcon (
+  IN OUT GUI_ICNS_DECODE  *Decode
+  );
+
 EFI_STATUS
 GuiIcnsToImageIcon (
   OUT GUI_IMAGE  *Image,
@@ -154,15 +243,79 @@ GuiIcnsToImageIcon (
   IN  BOOLEAN    AllowLess
   );
 
+/**
+  Decode label data and resample it to the requested scale.
+
+  @param[out] Image       Resulting image.
+  @param[in]  RawData     Label data.
+  @param[in]  DataLength  Label data length.
+  @param[in]  Scale       Requested scale.
+  @param[in]  LabelScale  Scale the label was made for.
+  @param[in]  Inverted    Produce black text instead of white.
+
+  @retval EFI_SUCCESS on success.
+**/
 EFI_STATUS
 GuiLabelToImage (
   OUT GUI_IMAGE *Image,
   IN  VOID      *RawData,
   IN  UINT32    DataLength,
   IN  UINT8     Scale,
+  IN  UINT8     LabelScale,
   IN  BOOLEAN   Inverted
   );
 
+/**
+  Resample decoded label image made for LabelScale to Scale.
+  The original image is freed on success.
+
+  @param[in,out] Image       Label image.
+  @param[in]     Scale       Requested scale.
+  @param[in]     LabelScale  Scale the label was made for.
+
+  @retval EFI_SUCCESS on success.
+**/
+EFI_STATUS
+GuiLabelScaleImage (
+  IN OUT GUI_IMAGE  *Image,
+  IN     UINT8      Scale,
+  IN     UINT8      LabelScale
+  );
+
+/**
+  Validate label data and allocate the resulting image buffer.
+  The image is expected to be filled by GuiLabelDecodeImage.
+
+  @param[out] Image       Label image with allocated buffer.
+  @param[in]  RawData     Label data.
+  @param[in]  DataLength  Label data length.
+  @param[in]  Scale       Label scale.
+
+  @retval EFI_SUCCESS on success.
+**/
+EFI_STATUS
+GuiLabelAllocateImage (
+  OUT GUI_IMAGE *Image,
+  IN  VOID      *RawData,
+  IN  UINT32    DataLength,
+  IN  UINT8     Scale
+  );
+
+/**
+  Expand label data validated by GuiLabelAllocateImage.
+  This function does not call any UEFI services and is safe to run on APs.
+
+  @param[in,out] Image     Label image with allocated buffer.
+  @param[in]     RawData   Label data.
+  @param[in]     Inverted  Produce black text instead of white.
+**/
+VOID
+GuiLabelDecodeImage (
+  IN OUT GUI_IMAGE   *Image,
+  IN     CONST VOID  *RawData,
+  IN     BOOLEAN     Inverted
+  );
+
 VOID
 GuiObjDrawDelegate (
   IN OUT GUI_OBJ                 *This,
@@ -288,6 +441,36 @@ GuiCreateHighlightedImage (
   IN  CONST EFI_GRAPHICS_OUTPUT_BLT_PIXEL  *HighlightPixel
   );
 
+/**
+  Allocate highlighted image buffer of source image dimensions.
+  The image is expected to be filled by GuiDrawHighlightedImage.
+
+  @param[out] SelectedImage  Highlighted image with allocated buffer.
+  @param[in]  SourceImage    Source image.
+
+  @retval EFI_SUCCESS on success.
+**/
+EFI_STATUS
+GuiAllocateHighlightedImage (
+  OUT GUI_IMAGE        *SelectedImage,
+  IN  CONST GUI_IMAGE  *SourceImage
+  );
+
+/**
+  Fill image allocated by GuiAllocateHighlightedImage.
+  This function does not call any UEFI services and is safe to run on APs.
+
+  @param[in,out] SelectedImage   Highlighted image with allocated buffer.
+  @param[in]     SourceImage     Source image.
+  @param[in]     HighlightPixel  Highlight colour.
+**/
+VOID
+GuiDrawHighlightedImage (
+  IN OUT GUI_IMAGE                            *SelectedImage,
+  IN     CONST GUI_IMAGE                      *SourceImage,
+  IN     CONST EFI_GRAPHICS_OUTPUT_BLT_PIXEL  *HighlightPixel
+  );
+
 typedef enum {
   GuiInterpolTypeLinear,
   GuiInterpolTypeSmooth
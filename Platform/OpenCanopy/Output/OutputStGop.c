@@ -8,7 +8,9 @@
 #include <Uefi.h>
 
 #include <Protocol/GraphicsOutput.h>
+#include <Register/Intel/Cpuid.h>
 
+#include <Library/BaseLib.h>
 #include <Library/DebugLib.h>
 #include <Library/MemoryAllocationLib.h>
 #include <Library/UefiBootServicesTableLib.h>
@@ -17,6 +19,17 @@
 
 struct GUI_OUTPUT_CONTEXT_ {
   EFI_GRAPHICS_OUTPUT_PROTOCOL *Gop;
+  //
+  // Linear framebuffer for direct output, NULL when Blt must be used.
+  //
+  UINT32                       *FrameBuffer;
+  UINT32                       PixelsPerScanLine;
+  UINT32                       Width;
+  UINT32                       Height;
+  //
+  // Scanline for pixel format conversion, NULL for native BGRX framebuffer.
+  //
+  UINT32                       *ConvertLine;
 };
 
 STATIC
@@ -47,6 +60,83 @@ InternalGuiOutputLocateGop (
   return Gop;
 }
 
+STATIC
+VOID
+InternalGuiOutputSetupFrameBuffer (
+  IN OUT GUI_OUTPUT_CONTEXT  *Context
+  )
+{
+  EFI_GRAPHICS_OUTPUT_PROTOCOL_MODE     *Mode;
+  EFI_GRAPHICS_OUTPUT_MODE_INFORMATION  *Info;
+  CPUID_VERSION_INFO_EDX                RegEdx;
+  UINT64                                RequiredSize;
+
+  Context->FrameBuffer = NULL;
+  Context->ConvertLine = NULL;
+
+  Mode = Context->Gop->Mode;
+  Info = Mode->Info;
+
+  if (Info->PixelFormat != PixelBlueGreenRedReserved8BitPerColor
+    && Info->PixelFormat != PixelRedGreenBlueReserved8BitPerColor) {
+    DEBUG ((DEBUG_INFO, "OCUI: No linear framebuffer for format %u, using Blt\n", Info->PixelFormat));
+    return;
+  }
+
+  RequiredSize = MultU64x32 (
+    (UINT64) Info->PixelsPerScanLine * Info->VerticalResolution,
+    sizeof (UINT32)
+    );
+
+  if (Mode->FrameBufferBase == 0
+    || Info->PixelsPerScanLine < Info->HorizontalResolution
+    || Mode->FrameBufferSize < RequiredSize
+    || (UINTN) Mode->FrameBufferBase != Mode->FrameBufferBase
+    || (Mode->FrameBufferBase & (sizeof (UINT32) - 1)) != 0) {
+    DEBUG ((
+      DEBUG_INFO,
+      "OCUI: Unusable framebuffer %Lx/%Lx for %ux%u (%u), using Blt\n",
+      (UINT64) Mode->FrameBufferBase,
+      (UINT64) Mode->FrameBufferSize,
+      Info->HorizontalResolution,
+      Info->VerticalResolution,
+      Info->PixelsPerScanLine
+      ));
+    return;
+  }
+
+  //
+  // Non-temporal stores need SSE2.
+  //
+  AsmCpuid (CPUID_VERSION_INFO, NULL, NULL, NULL, &RegEdx.Uint32);
+  if (RegEdx.Bits.SSE2 == 0) {
+    DEBUG ((DEBUG_INFO, "OCUI: No SSE2 for direct framebuffer, using Blt\n"));
+    return;
+  }
+
+  if (Info->PixelFormat == PixelRedGreenBlueReserved8BitPerColor) {
+    Context->ConvertLine = AllocatePool (Info->HorizontalResolution * sizeof (UINT32));
+    if (Context->ConvertLine == NULL) {
+      return;
+    }
+  }
+
+  Context->FrameBuffer       = (UINT32 *)(UINTN) Mode->FrameBufferBase;
+  Context->PixelsPerScanLine = Info->PixelsPerScanLine;
+  Context->Width             = Info->HorizontalResolution;
+  Context->Height            = Info->VerticalResolution;
+
+  DEBUG ((
+    DEBUG_INFO,
+    "OCUI: Using direct framebuffer %Lx for %ux%u (%u)%a\n",
+    (UINT64) Mode->FrameBufferBase,
+    Context->Width,
+    Context->Height,
+    Context->PixelsPerScanLine,
+    Context->ConvertLine != NULL ? " with RGB conversion" : ""
+    ));
+}
+
 GUI_OUTPUT_CONTEXT *
 GuiOutputConstruct (
   VOID
@@ -66,9 +156,58 @@ GuiOutputConstruct (
   }
 
   Context->Gop = Gop;
+  InternalGuiOutputSetupFrameBuffer (Context);
   return Context;
 }
 
+STATIC
+VOID
+InternalGuiOutputBufferToFrameBuffer (
+  IN GUI_OUTPUT_CONTEXT             *Context,
+  IN EFI_GRAPHICS_OUTPUT_BLT_PIXEL  *BltBuffer,
+  IN UINTN                          SourceX,
+  IN UINTN                          SourceY,
+  IN UINTN                          DestinationX,
+  IN UINTN                          DestinationY,
+  IN UINTN                          Width,
+  IN UINTN                          Height,
+  IN UINTN                          Delta
+  )
+{
+  UINT32  *Source;
+  UINT32  *Target;
+  UINT32  *Line;
+  UINTN   SourcePitch;
+  UINTN   Index;
+  UINT32  Pixel;
+
+  //
+  // Delta is in bytes, zero means tightly packed rectangle.
+  //
+  SourcePitch = Delta != 0 ? Delta / sizeof (UINT32) : Width;
+  Source      = (UINT32 *) BltBuffer + SourceY * SourcePitch + SourceX;
+  Target      = Context->FrameBuffer + DestinationY * Context->PixelsPerScanLine + DestinationX;
+
+  while (Height > 0) {
+    Line = Source;
+
+    if (Context->ConvertLine != NULL) {
+      for (Index = 0; Index < Width; ++Index) {
+        Pixel = Source[Index];
+        Context->ConvertLine[Index] = (Pixel & 0xFF00FF00U)
+          | ((Pixel & 0xFFU) << 16U) | ((Pixel >> 16U) & 0xFFU);
+      }
+      Line = Context->ConvertLine;
+    }
+
+    GuiOutputStreamPixels (Target, Line, Width);
+
+    Source += SourcePitch;
+    Target += Context->PixelsPerScanLine;
+    --Height;
+  }
+}
+
 EFI_STATUS
 EFIAPI
 GuiOutputBlt (
@@ -84,6 +223,33 @@ GuiOutputBlt (
   IN UINTN                              Delta OPTIONAL
   )
 {
+  //
+  // Write straight to the framebuffer when possible, as Blt performance
+  // varies a lot between firmware implementations.
+  //
+  if (Context->FrameBuffer != NULL
+    && BltOperation == EfiBltBufferToVideo
+    && BltBuffer != NULL
+    && Width > 0
+    && Height > 0
+    && DestinationX < Context->Width
+    && DestinationY < Context->Height
+    && Width <= Context->Width - DestinationX
+    && Height <= Context->Height - DestinationY) {
+    InternalGuiOutputBufferToFrameBuffer (
+      Context,
+      BltBuffer,
+      SourceX,
+      SourceY,
+      DestinationX,
+      DestinationY,
+      Width,
+      Height,
+      Delta
+      );
+    return EFI_SUCCESS;
+  }
+
   return Context->Gop->Blt (
     Context->Gop,
     BltBuffer,
@@ -112,5 +278,8 @@ GuiOutputDestruct (
   )
 {
   ASSERT (Context != NULL);
+  if (Context->ConvertLine != NULL) {
+    FreePool (Context->ConvertLine);
+  }
   FreePool (Context);
 }
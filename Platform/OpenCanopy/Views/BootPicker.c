@@ -728,6 +728,7 @@ BootPickerEntriesAdd (
   UINT32                      IconFileSize;
   UINT32                      IconTypeIndex;
   VOID                        *IconFileData;
+  UINT8                       LabelScale;
   BOOLEAN                     UseVolumeIcon;
   BOOLEAN                     UseDiskLabel;
   BOOLEAN                     UseGenericLabel;
@@ -750,19 +751,35 @@ BootPickerEntriesAdd (
   }
 
   if (UseDiskLabel) {
+    //
+    // Prefer the 2x label, which is resampled to the exact scale.
+    //
+    LabelScale = 2;
     Status = OcGetBootEntryLabelImage (
       Context,
       Entry,
-      GuiContext->Scale,
+      LabelScale,
       &IconFileData,
       &IconFileSize
       );
+    if (EFI_ERROR (Status)) {
+      LabelScale = 1;
+      Status = OcGetBootEntryLabelImage (
+        Context,
+        Entry,
+        LabelScale,
+        &IconFileData,
+        &IconFileSize
+        );
+    }
+
     if (!EFI_ERROR (Status)) {
       Status = GuiLabelToImage (
         &VolumeEntry->Label,
         IconFileData,
         IconFileSize,
         GuiContext->Scale,
+        LabelScale,
         GuiContext->LightBackground
         );
     }
@@ -834,8 +851,8 @@ BootPickerEntriesAdd (
         IconFileData,
         IconFileSize,
         GuiContext->Scale,
-        BOOT_ENTRY_ICON_DIMENSION * GuiContext->Scale,
-        BOOT_ENTRY_ICON_DIMENSION * GuiContext->Scale,
+        BOOT_ENTRY_ICON_DIMENSION,
+        BOOT_ENTRY_ICON_DIMENSION,
         FALSE
         );
       FreePool (IconFileData);
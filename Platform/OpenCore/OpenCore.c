@@ -32,6 +32,7 @@ WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
 #include <Library/OcConsoleLib.h>
 #include <Library/OcCpuLib.h>
 #include <Library/OcDevicePathLib.h>
+#include <Library/OcMemoryAllocationLib.h>
 #include <Library/OcStorageLib.h>
 #include <Library/PrintLib.h>
 #include <Library/UefiBootServicesTableLib.h>
@@ -78,16 +79,39 @@ OcStartImage (
 
   OldMode = OcConsoleControlSetMode (EfiConsoleControlScreenGraphics);
 
+  //
+  // macOS kernel processing is profiled as well, report it from the kernel hook.
+  //
+  if ((Chosen->Type & (OC_BOOT_APPLE_OS | OC_BOOT_APPLE_RECOVERY | OC_BOOT_APPLE_TIME_MACHINE)) == 0) {
+    OcProfileReport ();
+  }
+
+#ifdef OC_SLAB_POOL
+  OcLogMemoryAllocationStats ();
+#endif
+
+  //
+  // Periodic log flushing must not interfere with the OS loader.
+  //
+  OcLogSetFileFlushTimer (FALSE);
+
   Status = gBS->StartImage (
     ImageHandle,
     ExitDataSize,
     ExitData
     );
 
+  OcLogSetFileFlushTimer (TRUE);
+
   if (EFI_ERROR (Status)) {
     DEBUG ((DEBUG_WARN, "OC: Boot failed - %r\n", Status));
   }
 
+  //
+  // Booter returned, the next boot may need a differently patched kernel.
+  //
+  OcReleaseKernelSupportCache ();
+
   OcConsoleControlSetMode (OldMode);
 
   return Status;
@@ -102,6 +126,8 @@ OcMain (
 {
   EFI_STATUS                Status;
   OC_PRIVILEGE_CONTEXT      *Privilege;
+  UINT32                    MainSpan;
+  UINT32                    Span;
 
   DEBUG ((DEBUG_INFO, "OC: OcMiscEarlyInit...\n"));
   Status = OcMiscEarlyInit (
@@ -114,24 +140,46 @@ OcMain (
     return;
   }
 
+  //
+  // Profiling becomes available once logging is configured by OcMiscEarlyInit.
+  // OcMain span is not ended when booting, and is reported up to boot time.
+  //
+  MainSpan = OcProfileBegin ("OcMain");
+
   OcCpuScanProcessor (&mOpenCoreCpuInfo);
 
   DEBUG ((DEBUG_INFO, "OC: OcLoadNvramSupport...\n"));
+  Span = OcProfileBegin ("OcLoadNvramSupport");
   OcLoadNvramSupport (Storage, &mOpenCoreConfiguration);
+  OcProfileEnd (Span);
   DEBUG ((DEBUG_INFO, "OC: OcMiscMiddleInit...\n"));
+  Span = OcProfileBegin ("OcMiscMiddleInit");
   OcMiscMiddleInit (Storage, &mOpenCoreConfiguration, LoadPath, &mLoadHandle);
+  OcProfileEnd (Span);
   DEBUG ((DEBUG_INFO, "OC: OcLoadUefiSupport...\n"));
+  Span = OcProfileBegin ("OcLoadUefiSupport");
   OcLoadUefiSupport (Storage, &mOpenCoreConfiguration, &mOpenCoreCpuInfo);
+  OcProfileEnd (Span);
   DEBUG ((DEBUG_INFO, "OC: OcLoadAcpiSupport...\n"));
+  Span = OcProfileBegin ("OcLoadAcpiSupport");
   OcLoadAcpiSupport (&mOpenCoreStorage, &mOpenCoreConfiguration);
+  OcProfileEnd (Span);
   DEBUG ((DEBUG_INFO, "OC: OcLoadPlatformSupport...\n"));
+  Span = OcProfileBegin ("OcLoadPlatformSupport");
   OcLoadPlatformSupport (&mOpenCoreConfiguration, &mOpenCoreCpuInfo);
+  OcProfileEnd (Span);
   DEBUG ((DEBUG_INFO, "OC: OcLoadDevPropsSupport...\n"));
+  Span = OcProfileBegin ("OcLoadDevPropsSupport");
   OcLoadDevPropsSupport (&mOpenCoreConfiguration);
+  OcProfileEnd (Span);
   DEBUG ((DEBUG_INFO, "OC: OcMiscLateInit...\n"));
+  Span = OcProfileBegin ("OcMiscLateInit");
   OcMiscLateInit (Storage, &mOpenCoreConfiguration);
+  OcProfileEnd (Span);
   DEBUG ((DEBUG_INFO, "OC: OcLoadKernelSupport...\n"));
+  Span = OcProfileBegin ("OcLoadKernelSupport");
   OcLoadKernelSupport (&mOpenCoreStorage, &mOpenCoreConfiguration, &mOpenCoreCpuInfo);
+  OcProfileEnd (Span);
 
   if (mOpenCoreConfiguration.Misc.Security.EnablePassword) {
     mOpenCorePrivilege.CurrentLevel = OcPrivilegeUnauthorized;
@@ -146,6 +194,7 @@ OcMain (
 
   DEBUG ((DEBUG_INFO, "OC: All green, starting boot management...\n"));
 
+  Span = OcProfileBegin ("OcMiscBoot");
   OcMiscBoot (
     &mOpenCoreStorage,
     &mOpenCoreConfiguration,
@@ -154,6 +203,9 @@ OcMain (
     mOpenCoreConfiguration.Uefi.Quirks.RequestBootVarRouting,
     mLoadHandle
     );
+  OcProfileEnd (Span);
+
+  OcProfileEnd (MainSpan);
 }
 
 STATIC
@@ -18,6 +18,7 @@ WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
 #include <Library/DebugLib.h>
 #include <Library/MemoryAllocationLib.h>
 #include <Library/OcAcpiLib.h>
+#include <Library/OcDebugLogLib.h>
 #include <Library/OcMiscLib.h>
 #include <Library/OcStringLib.h>
 #include <Library/PrintLib.h>
@@ -140,7 +141,21 @@ OcAcpiPatchTables (
   EFI_STATUS           Status;
   UINT32               Index;
   OC_ACPI_PATCH_ENTRY  *UserPatch;
-  OC_ACPI_PATCH        Patch;
+  OC_ACPI_PATCH        *Patches;
+  OC_ACPI_PATCH        *Patch;
+  OC_ACPI_PATCH        SinglePatch;
+  UINT32               PatchCount;
+
+  if (Config->Acpi.Patch.Count == 0) {
+    return;
+  }
+
+  //
+  // Patches are applied in one batch to avoid rescanning the tables
+  // for every patch. Fallback to applying them one by one on failure.
+  //
+  Patches    = AllocatePool (Config->Acpi.Patch.Count * sizeof (*Patches));
+  PatchCount = 0;
 
   for (Index = 0; Index < Config->Acpi.Patch.Count; ++Index) {
     UserPatch = Config->Acpi.Patch.Values[Index];
@@ -163,32 +178,55 @@ OcAcpiPatchTables (
       continue;
     }
 
-    ZeroMem (&Patch, sizeof (Patch));
+    Patch = Patches != NULL ? &Patches[PatchCount] : &SinglePatch;
 
-    Patch.Find  = OC_BLOB_GET (&UserPatch->Find);
-    Patch.Replace = OC_BLOB_GET (&UserPatch->Replace);
+    ZeroMem (Patch, sizeof (*Patch));
+
+    Patch->Find  = OC_BLOB_GET (&UserPatch->Find);
+    Patch->Replace = OC_BLOB_GET (&UserPatch->Replace);
 
     if (UserPatch->Mask.Size > 0) {
-      Patch.Mask  = OC_BLOB_GET (&UserPatch->Mask);
+      Patch->Mask  = OC_BLOB_GET (&UserPatch->Mask);
     }
 
     if (UserPatch->ReplaceMask.Size > 0) {
-      Patch.ReplaceMask = OC_BLOB_GET (&UserPatch->ReplaceMask);
+      Patch->ReplaceMask = OC_BLOB_GET (&UserPatch->ReplaceMask);
+    }
+
+    Patch->Size        = UserPatch->Replace.Size;
+    Patch->Count       = UserPatch->Count;
+    Patch->Skip        = UserPatch->Skip;
+    Patch->Limit       = UserPatch->Limit;
+    Patch->BaseSkip    = UserPatch->BaseSkip;
+    if (OC_BLOB_GET (&UserPatch->Base)[0] != '\0') {
+      Patch->Base      = OC_BLOB_GET (&UserPatch->Base);
     }
+    CopyMem (&Patch->TableSignature, UserPatch->TableSignature, sizeof (UserPatch->TableSignature));
+    Patch->TableLength = UserPatch->TableLength;
+    CopyMem (&Patch->OemTableId, UserPatch->OemTableId, sizeof (UserPatch->OemTableId));
 
-    Patch.Size        = UserPatch->Replace.Size;
-    Patch.Count       = UserPatch->Count;
-    Patch.Skip        = UserPatch->Skip;
-    Patch.Limit       = UserPatch->Limit;
-    CopyMem (&Patch.TableSignature, UserPatch->TableSignature, sizeof (UserPatch->TableSignature));
-    Patch.TableLength = UserPatch->TableLength;
-    CopyMem (&Patch.OemTableId, UserPatch->OemTableId, sizeof (UserPatch->OemTableId));
+    if (Patches != NULL) {
+      ++PatchCount;
+      continue;
+    }
 
-    Status = AcpiApplyPatch (Context, &Patch);
+    Status = AcpiApplyPatch (Context, Patch);
     if (EFI_ERROR (Status)) {
       DEBUG ((DEBUG_WARN, "OC: ACPI patcher failed %u - %r\n", Index, Status));
     }
   }
+
+  if (Patches != NULL) {
+    Status = AcpiApplyPatches (Context, Patches, PatchCount);
+    if (EFI_ERROR (Status)) {
+      DEBUG ((DEBUG_WARN, "OC: ACPI batch patcher failed for %u patches - %r\n", PatchCount, Status));
+      for (Index = 0; Index < PatchCount; ++Index) {
+        AcpiApplyPatch (Context, &Patches[Index]);
+      }
+    }
+
+    FreePool (Patches);
+  }
 }
 
 VOID
@@ -199,6 +237,7 @@ OcLoadAcpiSupport (
 {
   EFI_STATUS        Status;
   OC_ACPI_CONTEXT   Context;
+  UINT32            Span;
 
   Status = AcpiInitContext (&Context);
 
@@ -211,11 +250,15 @@ OcLoadAcpiSupport (
     AcpiLoadRegions (&Context);
   }
 
+  Span = OcProfileBegin ("OcAcpiPatchTables");
   OcAcpiPatchTables (Config, &Context);
+  OcProfileEnd (Span);
 
   OcAcpiDeleteTables (Config, &Context);
 
+  Span = OcProfileBegin ("OcAcpiAddTables");
   OcAcpiAddTables (Config, Storage, &Context);
+  OcProfileEnd (Span);
 
   if (Config->Acpi.Quirks.FadtEnableReset) {
     AcpiFadtEnableReset (&Context);
@@ -238,7 +281,9 @@ OcLoadAcpiSupport (
     AcpiNormalizeHeaders (&Context);
   }
 
+  Span = OcProfileBegin ("AcpiApplyContext");
   AcpiApplyContext (&Context);
+  OcProfileEnd (Span);
 
   AcpiFreeContext (&Context);
 }
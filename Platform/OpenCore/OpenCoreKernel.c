@@ -15,9 +15,11 @@ WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
 #include <OpenCore.h>
 
 #include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
 #include <Library/DebugLib.h>
 #include <Library/MemoryAllocationLib.h>
 #include <Library/OcAppleKernelLib.h>
+#include <Library/OcDebugLogLib.h>
 #include <Library/OcMiscLib.h>
 #include <Library/OcStringLib.h>
 #include <Library/OcVirtualFsLib.h>
@@ -28,6 +30,19 @@ STATIC OC_STORAGE_CONTEXT  *mOcStorage;
 STATIC OC_GLOBAL_CONFIG    *mOcConfiguration;
 STATIC OC_CPU_INFO         *mOcCpuInfo;
 
+//
+// Last served kernel image shared with all its virtual files,
+// boot.efi may open the same kernel more than once.
+// Released when boot.efi returns, on successful boot the memory is reclaimed
+// by the kernel after ExitBootServices. Device is the handle of the volume
+// the kernel was opened from.
+//
+STATIC OC_VIRTUAL_FILE_BUFFER  *mOcKernelBuffer;
+STATIC EFI_HANDLE              mOcKernelDevice;
+STATIC CHAR16                  *mOcKernelFileName;
+STATIC UINT32                  mOcKernelFileSize;
+STATIC EFI_TIME                mOcKernelModificationTime;
+
 STATIC
 UINT32
 OcParseDarwinVersion (
@@ -597,7 +612,10 @@ OcKernelProcessPrelinked (
   OC_KERNEL_ADD_ENTRY  *Kext;
   UINT32               MaxKernel;
   UINT32               MinKernel;
+  UINT32               Span;
+  UINT32               KextSpan;
 
+  Span   = OcProfileBegin ("OcKernelProcessPrelinked");
   Status = PrelinkedContextInit (&Context, Kernel, *KernelSize, AllocatedSize);
 
   if (!EFI_ERROR (Status)) {
@@ -646,7 +664,8 @@ OcKernelProcessPrelinked (
           ExecutablePath = NULL;
         }
 
-        Status = PrelinkedInjectKext (
+        KextSpan = OcProfileBegin (BundlePath);
+        Status   = PrelinkedInjectKext (
           &Context,
           FullPath,
           Kext->PlistData,
@@ -655,6 +674,7 @@ OcKernelProcessPrelinked (
           Kext->ImageData,
           Kext->ImageDataSize
           );
+        OcProfileEnd (KextSpan);
 
         DEBUG ((
           EFI_ERROR (Status) ? DEBUG_WARN : DEBUG_INFO,
@@ -678,13 +698,356 @@ OcKernelProcessPrelinked (
     PrelinkedContextFree (&Context);
   }
 
+  OcProfileEnd (Span);
+
   return Status;
 }
 
+//
+// Patched prelinked kernel cache header, followed by the kernel itself.
+//
+#define OC_KERNEL_CACHE_SIGNATURE   SIGNATURE_32 ('O', 'C', 'K', 'C')
+#define OC_KERNEL_CACHE_VERSION     1
+#define OC_KERNEL_CACHE_CHUNK_SIZE  BASE_1MB
+
+typedef struct {
+  UINT32  Signature;
+  UINT32  Version;
+  UINT32  KernelSize;
+  UINT32  Reserved;
+  UINT8   Key[SHA256_DIGEST_SIZE];
+} OC_KERNEL_CACHE_HEADER;
+
+STATIC
+VOID
+OcKernelCacheHashData (
+  IN OUT SHA256_CONTEXT  *Context,
+  IN     CONST VOID      *Data  OPTIONAL,
+  IN     UINT32          Size
+  )
+{
+  //
+  // Hash the size first to keep adjacent fields unambiguous.
+  //
+  Sha256Update (Context, (CONST UINT8 *) &Size, sizeof (Size));
+  if (Data != NULL && Size > 0) {
+    Sha256Update (Context, Data, Size);
+  }
+}
+
+#define OC_KERNEL_CACHE_HASH_BLOB(Context, Blob) \
+  OcKernelCacheHashData ((Context), OC_BLOB_GET (Blob), (Blob)->Size)
+
+#define OC_KERNEL_CACHE_HASH_VALUE(Context, Value) \
+  OcKernelCacheHashData ((Context), &(Value), sizeof (Value))
+
+STATIC
+EFI_STATUS
+OcKernelCacheComputeKey (
+  IN  OC_GLOBAL_CONFIG   *Config,
+  IN  EFI_FILE_PROTOCOL  *File,
+  OUT UINT8              *Key
+  )
+{
+  EFI_STATUS             Status;
+  SHA256_CONTEXT         Context;
+  UINT8                  *Buffer;
+  UINT32                 FileSize;
+  UINT32                 Offset;
+  UINT32                 ChunkSize;
+  UINT32                 Index;
+  UINT32                 Version;
+  OC_KERNEL_ADD_ENTRY    *Kext;
+  OC_KERNEL_BLOCK_ENTRY  *Block;
+  OC_KERNEL_PATCH_ENTRY  *Patch;
+
+  Status = GetFileSize (File, &FileSize);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Buffer = AllocatePool (OC_KERNEL_CACHE_CHUNK_SIZE);
+  if (Buffer == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Sha256Init (&Context);
+
+  Version = OC_KERNEL_CACHE_VERSION;
+  OC_KERNEL_CACHE_HASH_VALUE (&Context, Version);
+  OC_KERNEL_CACHE_HASH_VALUE (&Context, FileSize);
+
+  for (Offset = 0; Offset < FileSize; Offset += ChunkSize) {
+    ChunkSize = MIN (FileSize - Offset, OC_KERNEL_CACHE_CHUNK_SIZE);
+    Status    = GetFileData (File, Offset, ChunkSize, Buffer);
+    if (EFI_ERROR (Status)) {
+      FreePool (Buffer);
+      return Status;
+    }
+
+    Sha256Update (&Context, Buffer, ChunkSize);
+  }
+
+  FreePool (Buffer);
+
+  //
+  // Comments are ignored as they do not affect the resulting kernel.
+  // Kext binaries must already be loaded by OcKernelLoadKextsAndReserve.
+  //
+  OC_KERNEL_CACHE_HASH_VALUE (&Context, Config->Kernel.Add.Count);
+  for (Index = 0; Index < Config->Kernel.Add.Count; ++Index) {
+    Kext = Config->Kernel.Add.Values[Index];
+    OC_KERNEL_CACHE_HASH_VALUE (&Context, Kext->Enabled);
+    OC_KERNEL_CACHE_HASH_BLOB (&Context, &Kext->BundlePath);
+    OC_KERNEL_CACHE_HASH_BLOB (&Context, &Kext->ExecutablePath);
+    OC_KERNEL_CACHE_HASH_BLOB (&Context, &Kext->MaxKernel);
+    OC_KERNEL_CACHE_HASH_BLOB (&Context, &Kext->MinKernel);
+    OcKernelCacheHashData (&Context, Kext->PlistData, Kext->PlistDataSize);
+    OcKernelCacheHashData (&Context, Kext->ImageData, Kext->ImageDataSize);
+  }
+
+  OC_KERNEL_CACHE_HASH_VALUE (&Context, Config->Kernel.Block.Count);
+  for (Index = 0; Index < Config->Kernel.Block.Count; ++Index) {
+    Block = Config->Kernel.Block.Values[Index];
+    OC_KERNEL_CACHE_HASH_VALUE (&Context, Block->Enabled);
+    OC_KERNEL_CACHE_HASH_BLOB (&Context, &Block->Identifier);
+    OC_KERNEL_CACHE_HASH_BLOB (&Context, &Block->MaxKernel);
+    OC_KERNEL_CACHE_HASH_BLOB (&Context, &Block->MinKernel);
+  }
+
+  OC_KERNEL_CACHE_HASH_VALUE (&Context, Config->Kernel.Patch.Count);
+  for (Index = 0; Index < Config->Kernel.Patch.Count; ++Index) {
+    Patch = Config->Kernel.Patch.Values[Index];
+    OC_KERNEL_CACHE_HASH_VALUE (&Context, Patch->Enabled);
+    OC_KERNEL_CACHE_HASH_BLOB (&Context, &Patch->Base);
+    OC_KERNEL_CACHE_HASH_VALUE (&Context, Patch->Count);
+    OC_KERNEL_CACHE_HASH_BLOB (&Context, &Patch->Find);
+    OC_KERNEL_CACHE_HASH_BLOB (&Context, &Patch->Identifier);
+    OC_KERNEL_CACHE_HASH_BLOB (&Context, &Patch->Mask);
+    OC_KERNEL_CACHE_HASH_BLOB (&Context, &Patch->MaxKernel);
+    OC_KERNEL_CACHE_HASH_BLOB (&Context, &Patch->MinKernel);
+    OC_KERNEL_CACHE_HASH_BLOB (&Context, &Patch->Replace);
+    OC_KERNEL_CACHE_HASH_BLOB (&Context, &Patch->ReplaceMask);
+    OC_KERNEL_CACHE_HASH_VALUE (&Context, Patch->Limit);
+    OC_KERNEL_CACHE_HASH_VALUE (&Context, Patch->Skip);
+  }
+
+  OC_KERNEL_CACHE_HASH_VALUE (&Context, Config->Kernel.Emulate);
+  OC_KERNEL_CACHE_HASH_VALUE (&Context, Config->Kernel.Quirks);
+
+  //
+  // CPUID patching merges emulated values with the host ones.
+  //
+  OC_KERNEL_CACHE_HASH_VALUE (&Context, mOcCpuInfo->CpuidVerEax.Uint32);
+  OC_KERNEL_CACHE_HASH_VALUE (&Context, mOcCpuInfo->CpuidVerEbx.Uint32);
+  OC_KERNEL_CACHE_HASH_VALUE (&Context, mOcCpuInfo->CpuidVerEcx.Uint32);
+  OC_KERNEL_CACHE_HASH_VALUE (&Context, mOcCpuInfo->CpuidVerEdx.Uint32);
+
+  Sha256Final (&Context, Key);
+
+  return EFI_SUCCESS;
+}
+
+STATIC
+EFI_STATUS
+OcKernelCacheRead (
+  IN  CONST UINT8  *Key,
+  OUT UINT8        **Kernel,
+  OUT UINT32       *KernelSize
+  )
+{
+  UINT8                   *CacheData;
+  UINT32                  CacheSize;
+  OC_KERNEL_CACHE_HEADER  *Header;
+
+  CacheData = OcStorageReadFileUnicode (mOcStorage, OPEN_CORE_KERNEL_CACHE_PATH, &CacheSize);
+  if (CacheData == NULL) {
+    DEBUG ((DEBUG_INFO, "OC: Prelinked cache is missing\n"));
+    return EFI_NOT_FOUND;
+  }
+
+  Header = (OC_KERNEL_CACHE_HEADER *) CacheData;
+  if (CacheSize < sizeof (*Header)
+    || Header->Signature != OC_KERNEL_CACHE_SIGNATURE
+    || Header->Version != OC_KERNEL_CACHE_VERSION
+    || Header->KernelSize != CacheSize - sizeof (*Header)
+    || CompareMem (Header->Key, Key, sizeof (Header->Key)) != 0) {
+    DEBUG ((DEBUG_INFO, "OC: Prelinked cache of %u bytes is outdated\n", CacheSize));
+    FreePool (CacheData);
+    return EFI_NOT_FOUND;
+  }
+
+  *KernelSize = Header->KernelSize;
+  CopyMem (CacheData, CacheData + sizeof (*Header), *KernelSize);
+  *Kernel = CacheData;
+
+  return EFI_SUCCESS;
+}
+
+STATIC
+EFI_STATUS
+OcKernelCacheWrite (
+  IN CONST UINT8  *Key,
+  IN UINT8        *Kernel,
+  IN UINT32       KernelSize
+  )
+{
+  EFI_STATUS              Status;
+  EFI_FILE_PROTOCOL       *RootFs;
+  EFI_FILE_PROTOCOL       *File;
+  OC_KERNEL_CACHE_HEADER  Header;
+  UINTN                   WrittenSize;
+
+  //
+  // Storage root is read-only, write through the volume root instead.
+  //
+  Status = mOcStorage->FileSystem->OpenVolume (mOcStorage->FileSystem, &RootFs);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  //
+  // File writes do not truncate, so remove the previous cache first.
+  //
+  Status = SafeFileOpen (
+    RootFs,
+    &File,
+    OPEN_CORE_ROOT_PATH L"\\" OPEN_CORE_KERNEL_CACHE_PATH,
+    EFI_FILE_MODE_READ | EFI_FILE_MODE_WRITE,
+    0
+    );
+  if (!EFI_ERROR (Status)) {
+    File->Delete (File);
+  }
+
+  Status = SafeFileOpen (
+    RootFs,
+    &File,
+    OPEN_CORE_ROOT_PATH L"\\" OPEN_CORE_KERNEL_CACHE_PATH,
+    EFI_FILE_MODE_CREATE | EFI_FILE_MODE_READ | EFI_FILE_MODE_WRITE,
+    0
+    );
+  RootFs->Close (RootFs);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  //
+  // Write an invalid header first and fix it up at the end,
+  // so that interrupted writes never produce a valid cache.
+  //
+  ZeroMem (&Header, sizeof (Header));
+  WrittenSize = sizeof (Header);
+  Status = File->Write (File, &WrittenSize, &Header);
+
+  if (!EFI_ERROR (Status)) {
+    WrittenSize = KernelSize;
+    Status = File->Write (File, &WrittenSize, Kernel);
+    if (!EFI_ERROR (Status) && WrittenSize != KernelSize) {
+      Status = EFI_VOLUME_FULL;
+    }
+  }
+
+  if (!EFI_ERROR (Status)) {
+    Status = File->SetPosition (File, 0);
+  }
+
+  if (!EFI_ERROR (Status)) {
+    Header.Signature  = OC_KERNEL_CACHE_SIGNATURE;
+    Header.Version    = OC_KERNEL_CACHE_VERSION;
+    Header.KernelSize = KernelSize;
+    CopyMem (Header.Key, Key, sizeof (Header.Key));
+    WrittenSize = sizeof (Header);
+    Status = File->Write (File, &WrittenSize, &Header);
+  }
+
+  if (EFI_ERROR (Status)) {
+    File->Delete (File);
+  } else {
+    File->Close (File);
+  }
+
+  return Status;
+}
+
+STATIC
+VOID
+OcKernelForgetBuffer (
+  VOID
+  )
+{
+  if (mOcKernelBuffer != NULL) {
+    ReleaseVirtualFileBuffer (mOcKernelBuffer);
+    FreePool (mOcKernelFileName);
+    mOcKernelBuffer   = NULL;
+    mOcKernelDevice   = NULL;
+    mOcKernelFileName = NULL;
+  }
+}
+
+STATIC
+VOID
+OcKernelRememberBuffer (
+  IN OC_VIRTUAL_FILE_BUFFER  *KernelBuffer,
+  IN EFI_HANDLE              DeviceHandle,
+  IN CONST CHAR16            *FileName,
+  IN UINT32                  FileSize,
+  IN CONST EFI_TIME          *ModificationTime
+  )
+{
+  CHAR16  *FileNameCopy;
+
+  OcKernelForgetBuffer ();
+
+  FileNameCopy = AllocateCopyPool (StrSize (FileName), FileName);
+  if (FileNameCopy == NULL) {
+    ReleaseVirtualFileBuffer (KernelBuffer);
+    return;
+  }
+
+  mOcKernelBuffer   = KernelBuffer;
+  mOcKernelDevice   = DeviceHandle;
+  mOcKernelFileName = FileNameCopy;
+  mOcKernelFileSize = FileSize;
+  CopyMem (&mOcKernelModificationTime, ModificationTime, sizeof (mOcKernelModificationTime));
+}
+
+STATIC
+EFI_STATUS
+OcKernelServeBuffer (
+  IN  OC_VIRTUAL_FILE_BUFFER  *KernelBuffer,
+  IN  CONST CHAR16            *FileName,
+  IN  EFI_TIME                *ModificationTime,
+  OUT EFI_FILE_PROTOCOL       **NewHandle
+  )
+{
+  EFI_STATUS  Status;
+  CHAR16      *FileNameCopy;
+
+  //
+  // This was our file, yet firmware is dying.
+  //
+  FileNameCopy = AllocateCopyPool (StrSize (FileName), FileName);
+  if (FileNameCopy == NULL) {
+    DEBUG ((DEBUG_WARN, "OC: Failed to allocate kernel name (%s) copy\n", FileName));
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Status = CreateVirtualFileFromBuffer (FileNameCopy, KernelBuffer, ModificationTime, NewHandle);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_WARN, "OC: Failed to virtualise kernel file (%s)\n", FileName));
+    FreePool (FileNameCopy);
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  return EFI_SUCCESS;
+}
+
 STATIC
 EFI_STATUS
 EFIAPI
 OcKernelFileOpen (
+  IN  EFI_HANDLE              DeviceHandle  OPTIONAL,
   IN  EFI_FILE_PROTOCOL       *This,
   OUT EFI_FILE_PROTOCOL       **NewHandle,
   IN  CHAR16                  *FileName,
@@ -692,15 +1055,18 @@ OcKernelFileOpen (
   IN  UINT64                  Attributes
   )
 {
-  EFI_STATUS         Status;
-  UINT8              *Kernel;
-  UINT32             KernelSize;
-  UINT32             AllocatedSize;
-  CHAR16             *FileNameCopy;
-  EFI_FILE_PROTOCOL  *VirtualFileHandle;
-  EFI_STATUS         PrelinkedStatus;
-  EFI_TIME           ModificationTime;
-  UINT32             DarwinVersion;
+  EFI_STATUS              Status;
+  UINT8                   *Kernel;
+  UINT32                  KernelSize;
+  UINT32                  AllocatedSize;
+  UINT32                  FileSize;
+  OC_VIRTUAL_FILE_BUFFER  *KernelBuffer;
+  EFI_STATUS              PrelinkedStatus;
+  EFI_TIME                ModificationTime;
+  UINT32                  DarwinVersion;
+  UINT32                  ReserveSize;
+  BOOLEAN                 UseCache;
+  UINT8                   CacheKey[SHA256_DIGEST_SIZE];
 
   Status = SafeFileOpen (This, NewHandle, FileName, OpenMode, Attributes);
 
@@ -726,69 +1092,123 @@ OcKernelFileOpen (
     && StrCmp (FileName, L"System\\Library\\Kernels\\kernel") != 0) {
 
     DEBUG ((DEBUG_INFO, "OC: Trying XNU hook on %s\n", FileName));
-    Status = ReadAppleKernel (
-      *NewHandle,
-      &Kernel,
-      &KernelSize,
-      &AllocatedSize,
-      OcKernelLoadKextsAndReserve (mOcStorage, mOcConfiguration)
-      );
-    DEBUG ((DEBUG_INFO, "OC: Result of XNU hook on %s is %r\n", FileName, Status));
+
+    Status = GetFileModifcationTime (*NewHandle, &ModificationTime);
+    if (EFI_ERROR (Status)) {
+      ZeroMem (&ModificationTime, sizeof (ModificationTime));
+    }
+
+    Status = GetFileSize (*NewHandle, &FileSize);
+    if (EFI_ERROR (Status)) {
+      FileSize = 0;
+    }
 
     //
-    // This is not Apple kernel, just return the original file.
+    // Serve the same file from the already patched image without reading it again.
+    // Directory protocol instances differ between opens, so match the volume.
     //
-    if (!EFI_ERROR (Status)) {
-      DarwinVersion = OcKernelReadDarwinVersion (Kernel, KernelSize);
-      OcKernelApplyPatches (mOcConfiguration, DarwinVersion, NULL, Kernel, KernelSize);
+    if (mOcKernelBuffer != NULL
+      && DeviceHandle != NULL
+      && DeviceHandle == mOcKernelDevice
+      && FileSize != 0
+      && FileSize == mOcKernelFileSize
+      && StrCmp (FileName, mOcKernelFileName) == 0
+      && CompareMem (&ModificationTime, &mOcKernelModificationTime, sizeof (ModificationTime)) == 0) {
+      DEBUG ((DEBUG_INFO, "OC: Reusing patched kernel for %s\n", FileName));
+      (*NewHandle)->Close (*NewHandle);
+      return OcKernelServeBuffer (mOcKernelBuffer, FileName, &ModificationTime, NewHandle);
+    }
 
-      PrelinkedStatus = OcKernelProcessPrelinked (
-        mOcConfiguration,
-        DarwinVersion,
-        Kernel,
+    ReserveSize = OcKernelLoadKextsAndReserve (mOcStorage, mOcConfiguration);
+
+    //
+    // The cache is written at boot time, so it can never match the vault.
+    //
+    UseCache = FALSE;
+    Status   = EFI_NOT_FOUND;
+    if (mOcConfiguration->Kernel.Quirks.CachePrelinked && !mOcStorage->HasVault) {
+      Status = OcKernelCacheComputeKey (mOcConfiguration, *NewHandle, CacheKey);
+      if (!EFI_ERROR (Status)) {
+        UseCache = TRUE;
+        Status   = OcKernelCacheRead (CacheKey, &Kernel, &KernelSize);
+        DEBUG ((DEBUG_INFO, "OC: Prelinked cache lookup for %s - %r\n", FileName, Status));
+      } else {
+        DEBUG ((DEBUG_INFO, "OC: Prelinked cache key failure for %s - %r\n", FileName, Status));
+        Status = EFI_NOT_FOUND;
+      }
+    }
+
+    if (EFI_ERROR (Status)) {
+      Status = ReadAppleKernel (
+        *NewHandle,
+        &Kernel,
         &KernelSize,
-        AllocatedSize
+        &AllocatedSize,
+        ReserveSize
         );
+      DEBUG ((DEBUG_INFO, "OC: Result of XNU hook on %s is %r\n", FileName, Status));
+
+      //
+      // This is not Apple kernel, just return the original file.
+      //
+      if (!EFI_ERROR (Status)) {
+        DarwinVersion = OcKernelReadDarwinVersion (Kernel, KernelSize);
+        OcKernelApplyPatches (mOcConfiguration, DarwinVersion, NULL, Kernel, KernelSize);
+
+        PrelinkedStatus = OcKernelProcessPrelinked (
+          mOcConfiguration,
+          DarwinVersion,
+          Kernel,
+          &KernelSize,
+          AllocatedSize
+          );
 
-      DEBUG ((DEBUG_INFO, "OC: Prelinked status - %r\n", PrelinkedStatus));
+        DEBUG ((DEBUG_INFO, "OC: Prelinked status - %r\n", PrelinkedStatus));
 
-      Status = GetFileModifcationTime (*NewHandle, &ModificationTime);
-      if (EFI_ERROR (Status)) {
-        ZeroMem (&ModificationTime, sizeof (ModificationTime));
+        //
+        // Only cache fully processed prelinked kernels, others are cheap to patch.
+        //
+        if (UseCache && !EFI_ERROR (PrelinkedStatus)) {
+          PrelinkedStatus = OcKernelCacheWrite (CacheKey, Kernel, KernelSize);
+          DEBUG ((DEBUG_INFO, "OC: Prelinked cache update of %u bytes - %r\n", KernelSize, PrelinkedStatus));
+        }
       }
+    }
 
-      (*NewHandle)->Close(*NewHandle);
-
+    if (!EFI_ERROR (Status)) {
       //
-      // This was our file, yet firmware is dying.
+      // Kernel processing is the last profiled step before the kernel starts,
+      // the report is only saved for the first processed kernel.
       //
-      FileNameCopy = AllocateCopyPool (StrSize (FileName), FileName);
-      if (FileNameCopy == NULL) {
-        DEBUG ((DEBUG_WARN, "OC: Failed to allocate kernel name (%a) copy\n", FileName));
-        FreePool (Kernel);
-        return EFI_OUT_OF_RESOURCES;
-      }
+      OcProfileReport ();
 
-      Status = CreateVirtualFile (FileNameCopy, Kernel, KernelSize, &ModificationTime, &VirtualFileHandle);
+      (*NewHandle)->Close(*NewHandle);
+
+      Status = CreateVirtualFileBuffer (Kernel, KernelSize, &KernelBuffer);
       if (EFI_ERROR (Status)) {
-        DEBUG ((DEBUG_WARN, "OC: Failed to virtualise kernel file (%a)\n", FileName));
+        DEBUG ((DEBUG_WARN, "OC: Failed to share kernel file (%s)\n", FileName));
         FreePool (Kernel);
-        FreePool (FileNameCopy);
         return EFI_OUT_OF_RESOURCES;
       }
 
       //
-      // Return our handle.
+      // Return our handle, the buffer is freed with the last file using it.
       //
-      *NewHandle = VirtualFileHandle;
-      return EFI_SUCCESS;
+      Status = OcKernelServeBuffer (KernelBuffer, FileName, &ModificationTime, NewHandle);
+      if (!EFI_ERROR (Status) && FileSize != 0 && DeviceHandle != NULL) {
+        OcKernelRememberBuffer (KernelBuffer, DeviceHandle, FileName, FileSize, &ModificationTime);
+      } else {
+        ReleaseVirtualFileBuffer (KernelBuffer);
+      }
+
+      return Status;
     }
   }
 
   //
   // We recurse the filtering to additionally catch com.apple.boot.[RPS] directories.
   //
-  return CreateRealFile (*NewHandle, OcKernelFileOpen, TRUE, NewHandle);
+  return CreateRealFile (*NewHandle, DeviceHandle, OcKernelFileOpen, TRUE, NewHandle);
 }
 
 VOID
@@ -826,4 +1246,14 @@ OcUnloadKernelSupport (
     mOcStorage       = NULL;
     mOcConfiguration = NULL;
   }
+
+  OcKernelForgetBuffer ();
+}
+
+VOID
+OcReleaseKernelSupportCache (
+  VOID
+  )
+{
+  OcKernelForgetBuffer ();
 }
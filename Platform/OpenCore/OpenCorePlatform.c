@@ -23,6 +23,7 @@ WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
 #include <Library/PrintLib.h>
 #include <Library/OcCpuLib.h>
 #include <Library/OcDataHubLib.h>
+#include <Library/OcDebugLogLib.h>
 #include <Library/OcSmbiosLib.h>
 #include <Library/OcStringLib.h>
 #include <Library/UefiBootServicesTableLib.h>
@@ -561,6 +562,7 @@ OcLoadPlatformSupport (
   EFI_STATUS             Status;
   OC_SMBIOS_TABLE        SmbiosTable;
   BOOLEAN                ExposeOem;
+  UINT32                 Span;
 
   if (Config->PlatformInfo.Automatic) {
     GetMacInfo (OC_BLOB_GET (&Config->PlatformInfo.Generic.SystemProductName), &InfoData);
@@ -576,6 +578,7 @@ OcLoadPlatformSupport (
   ExposeOem = (Config->Misc.Security.ExposeSensitiveData & OCS_EXPOSE_OEM_INFO) != 0;
 
   if (ExposeOem || Config->PlatformInfo.UpdateSmbios) {
+    Span   = OcProfileBegin ("OcSmbios");
     Status = OcSmbiosTablePrepare (&SmbiosTable);
     if (!EFI_ERROR (Status)) {
       if (ExposeOem) {
@@ -605,6 +608,7 @@ OcLoadPlatformSupport (
     } else {
       DEBUG ((DEBUG_WARN, "OC: Unable to obtain SMBIOS - %r\n", Status));
     }
+    OcProfileEnd (Span);
   }
 
   if (Config->PlatformInfo.UpdateNvram) {
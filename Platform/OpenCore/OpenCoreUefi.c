@@ -90,6 +90,7 @@ OcLoadDrivers (
   EFI_HANDLE  *DriversToConnectIterator;
   VOID        *DriverBinding;
   BOOLEAN     SkipDriver;
+  UINT32      Span;
 
   DriversToConnectIterator = NULL;
   if (DriversToConnect != NULL) {
@@ -132,6 +133,7 @@ OcLoadDrivers (
       continue;
     }
 
+    Span   = OcProfileBegin (OC_BLOB_GET (Config->Uefi.Drivers.Values[Index]));
     Driver = OcStorageReadFileUnicode (Storage, DriverPath, &DriverSize);
     if (Driver == NULL) {
       DEBUG ((
@@ -143,6 +145,7 @@ OcLoadDrivers (
       //
       // TODO: This should cause security violation if configured!
       //
+      OcProfileEnd (Span);
       continue;
     }
 
@@ -167,6 +170,7 @@ OcLoadDrivers (
         Status
         ));
       FreePool (Driver);
+      OcProfileEnd (Span);
       continue;
     }
 
@@ -187,6 +191,8 @@ OcLoadDrivers (
       gBS->UnloadImage (ImageHandle);
     }
 
+    OcProfileEnd (Span);
+
     if (!EFI_ERROR (Status)) {
       DEBUG ((
         DEBUG_INFO,
@@ -541,7 +547,8 @@ OcLoadUefiSupport (
       );
 
     OcApfsConnectDevices (
-      Config->Uefi.Apfs.JumpstartHotPlug
+      Config->Uefi.Apfs.JumpstartHotPlug,
+      Config->Uefi.Apfs.JumpstartParallel
       );
   }
 
@@ -43,6 +43,10 @@
 // functions
 
 static struct fsw_dnode *fsw_vol_lookup_dnode_id(struct fsw_volume *vol, fsw_u32 dnode_id);
+static void fsw_dnode_unregister(struct fsw_volume *vol, struct fsw_dnode *dno);
+static struct fsw_blockcache *fsw_blockcache_lookup(struct fsw_volume *vol, fsw_u32 phys_bno);
+static void fsw_blockcache_insert(struct fsw_volume *vol, struct fsw_blockcache *entry);
+static struct fsw_blockcache *fsw_blockcache_evict(struct fsw_volume *vol);
 static void fsw_blockcache_free(struct fsw_volume *vol);
 
 #define MAX_CACHE_LEVEL (5)
@@ -182,8 +186,8 @@ void fsw_set_blocksize(struct fsw_volume *vol, fsw_u32 phys_blocksize, fsw_u32 l
 fsw_status_t fsw_block_get(struct VOLSTRUCTNAME *vol, fsw_u32 phys_bno, fsw_u32 cache_level, void **buffer_out)
 {
     fsw_status_t    status;
-    fsw_u32         i;
-    struct fsw_blockcache *new_bcache = NULL;
+    struct fsw_blockcache *entry;
+    struct fsw_blockcache **new_bcache = NULL;
 
     // TODO: allow the host driver to do its own caching; just call through if
     //  the appropriate function pointers are set
@@ -192,76 +196,67 @@ fsw_status_t fsw_block_get(struct VOLSTRUCTNAME *vol, fsw_u32 phys_bno, fsw_u32
         cache_level = MAX_CACHE_LEVEL;
 
     // check block cache
-    for (i = 0; i < vol->bcache_size; i++) {
-        if (vol->bcache[i].phys_bno == phys_bno) {
-            // cache hit!
-            if (vol->bcache[i].cache_level < cache_level)
-                vol->bcache[i].cache_level = cache_level;  // promote the entry
-            vol->bcache[i].refcount++;
-            *buffer_out = vol->bcache[i].data;
-            return FSW_SUCCESS;
-        }
+    entry = fsw_blockcache_lookup(vol, phys_bno);
+    if (entry != NULL) {
+        // cache hit!
+        if (entry->cache_level < cache_level)
+            entry->cache_level = cache_level;  // promote the entry
+        entry->chances = entry->cache_level + 1;
+        entry->refcount++;
+        *buffer_out = entry->data;
+        return FSW_SUCCESS;
     }
 
-    // find a free entry in the cache table
-    for (i = 0; i < vol->bcache_size; i++) {
-        if (vol->bcache[i].phys_bno == FSW_INVALID_BNO)
-            break;
-    }
-    if (i >= vol->bcache_size) {
-        fsw_u32 discard_level;
+    // reuse an entry once the cache is big enough
+    entry = NULL;
+    if (vol->bcache_size >= FSW_BCACHE_MAX_SIZE)
+        entry = fsw_blockcache_evict(vol);
 
-        for (discard_level = 0; discard_level <= MAX_CACHE_LEVEL; discard_level++) {
-            for (i = 0; i < vol->bcache_size; i++) {
-                if (vol->bcache[i].refcount == 0 && vol->bcache[i].cache_level <= discard_level)
-                    break;
-            }
-            if (i < vol->bcache_size)
-                break;
+    if (entry == NULL) {
+        // enlarge / create the cache, only entry pointers are copied
+        if (vol->bcache_size == vol->bcache_capacity) {
+            fsw_u32 new_bcache_capacity;
+
+            if (vol->bcache_capacity < 16)
+                new_bcache_capacity = 16;
+            else
+                new_bcache_capacity = vol->bcache_capacity << 1;
+            status = fsw_alloc(new_bcache_capacity * sizeof(struct fsw_blockcache *), &new_bcache);
+            if (status != FSW_SUCCESS)
+                return status;
+            if (vol->bcache_size > 0)
+                fsw_memcpy(new_bcache, vol->bcache, vol->bcache_size * sizeof(struct fsw_blockcache *));
+
+            // switch caches
+            fsw_free(vol->bcache);
+            vol->bcache = new_bcache;
+            vol->bcache_capacity = new_bcache_capacity;
         }
-    }
-    if (i >= vol->bcache_size) {
-	fsw_u32 new_bcache_size;
-
-        // enlarge / create the cache
-        if (vol->bcache_size < 16)
-            new_bcache_size = 16;
-        else
-            new_bcache_size = vol->bcache_size << 1;
-        status = fsw_alloc(new_bcache_size * sizeof(struct fsw_blockcache), &new_bcache);
+
+        // block data directly follows the entry
+        status = fsw_alloc(sizeof(struct fsw_blockcache) + vol->phys_blocksize, &entry);
         if (status != FSW_SUCCESS)
             return status;
-        if (vol->bcache_size > 0)
-            fsw_memcpy(new_bcache, vol->bcache, vol->bcache_size * sizeof(struct fsw_blockcache));
-        for (i = vol->bcache_size; i < new_bcache_size; i++) {
-            new_bcache[i].refcount = 0;
-            new_bcache[i].cache_level = 0;
-            new_bcache[i].phys_bno = FSW_INVALID_BNO;
-            new_bcache[i].data = NULL;
-        }
-        i = vol->bcache_size;
-
-        // switch caches
-        fsw_free(vol->bcache);
-        vol->bcache = new_bcache;
-        vol->bcache_size = new_bcache_size;
+        entry->refcount = 0;
+        entry->cache_level = 0;
+        entry->phys_bno = FSW_INVALID_BNO;
+        entry->chances = 0;
+        entry->data = entry + 1;
+        entry->hash_next = NULL;
+        vol->bcache[vol->bcache_size++] = entry;
     }
-    vol->bcache[i].phys_bno = FSW_INVALID_BNO;
 
     // read the data
-    if (vol->bcache[i].data == NULL) {
-        status = fsw_alloc(vol->phys_blocksize, &vol->bcache[i].data);
-        if (status != FSW_SUCCESS)
-            return status;
-    }
-    status = vol->host_table->read_block(vol, phys_bno, vol->bcache[i].data);
+    status = vol->host_table->read_block(vol, phys_bno, entry->data);
     if (status != FSW_SUCCESS)
         return status;
 
-    vol->bcache[i].phys_bno = phys_bno;
-    vol->bcache[i].cache_level = cache_level;
-    vol->bcache[i].refcount = 1;
-    *buffer_out = vol->bcache[i].data;
+    entry->phys_bno = phys_bno;
+    entry->cache_level = cache_level;
+    entry->chances = cache_level + 1;
+    entry->refcount = 1;
+    fsw_blockcache_insert(vol, entry);
+    *buffer_out = entry->data;
     return FSW_SUCCESS;
 }
 
@@ -272,16 +267,125 @@ fsw_status_t fsw_block_get(struct VOLSTRUCTNAME *vol, fsw_u32 phys_bno, fsw_u32
 
 void fsw_block_release(struct VOLSTRUCTNAME *vol, fsw_u32 phys_bno, void *buffer)
 {
-    fsw_u32 i;
+    struct fsw_blockcache *entry;
 
     // TODO: allow the host driver to do its own caching; just call through if
     //  the appropriate function pointers are set
 
     // update block cache
-    for (i = 0; i < vol->bcache_size; i++) {
-        if (vol->bcache[i].phys_bno == phys_bno && vol->bcache[i].refcount > 0)
-            vol->bcache[i].refcount--;
+    entry = fsw_blockcache_lookup(vol, phys_bno);
+    if (entry != NULL && entry->refcount > 0)
+        entry->refcount--;
+}
+
+/**
+ * Read consecutive disk blocks directly into the caller's buffer. This function is
+ * called by the file system driver or by core functions for bulk data that is not
+ * worth caching. It calls through to the host driver's multi-block read routine, so
+ * that the whole range is read with a single device request. Hosts without one are
+ * served block by block through the block cache.
+ */
+
+fsw_status_t fsw_block_read_direct(struct VOLSTRUCTNAME *vol, fsw_u32 phys_bno, fsw_u32 count, void *buffer)
+{
+    fsw_status_t    status;
+    fsw_u8          *block_buffer;
+    fsw_u32         i;
+
+    if (vol->host_table->read_blocks != NULL)
+        return vol->host_table->read_blocks(vol, phys_bno, count, buffer);
+
+    for (i = 0; i < count; i++) {
+        status = fsw_block_get(vol, phys_bno + i, 0, (void **)&block_buffer);
+        if (status != FSW_SUCCESS)
+            return status;
+        fsw_memcpy((fsw_u8 *)buffer + i * vol->phys_blocksize, block_buffer, vol->phys_blocksize);
+        fsw_block_release(vol, phys_bno + i, block_buffer);
+    }
+
+    return FSW_SUCCESS;
+}
+
+/**
+ * Hash a block number or a dnode id into a table of 2^bits buckets.
+ */
+
+static fsw_u32 fsw_hash_u32(fsw_u32 value, fsw_u32 bits)
+{
+    return (value * 0x9E3779B1U) >> (32 - bits);
+}
+
+/**
+ * Find a block cache entry holding the given physical block.
+ */
+
+static struct fsw_blockcache *fsw_blockcache_lookup(struct fsw_volume *vol, fsw_u32 phys_bno)
+{
+    struct fsw_blockcache *entry;
+
+    for (entry = vol->bcache_hash[fsw_hash_u32(phys_bno, FSW_BCACHE_HASH_BITS)]; entry != NULL; entry = entry->hash_next) {
+        if (entry->phys_bno == phys_bno)
+            return entry;
+    }
+
+    return NULL;
+}
+
+static void fsw_blockcache_insert(struct fsw_volume *vol, struct fsw_blockcache *entry)
+{
+    struct fsw_blockcache **bucket = &vol->bcache_hash[fsw_hash_u32(entry->phys_bno, FSW_BCACHE_HASH_BITS)];
+
+    entry->hash_next = *bucket;
+    *bucket = entry;
+}
+
+static void fsw_blockcache_remove(struct fsw_volume *vol, struct fsw_blockcache *entry)
+{
+    struct fsw_blockcache **link = &vol->bcache_hash[fsw_hash_u32(entry->phys_bno, FSW_BCACHE_HASH_BITS)];
+
+    while (*link != NULL) {
+        if (*link == entry) {
+            *link = entry->hash_next;
+            break;
+        }
+        link = &(*link)->hash_next;
     }
+
+    entry->hash_next = NULL;
+    entry->phys_bno = FSW_INVALID_BNO;
+}
+
+/**
+ * Pick an unused block cache entry for reuse. Entries are swept in clock order.
+ * Every access gives an entry cache_level + 1 sweeps before it can be evicted,
+ * so blocks with a higher level are kept longer. Returns NULL if all entries
+ * are in use.
+ */
+
+static struct fsw_blockcache *fsw_blockcache_evict(struct fsw_volume *vol)
+{
+    struct fsw_blockcache *entry;
+    fsw_u32 steps;
+
+    for (steps = vol->bcache_size * (MAX_CACHE_LEVEL + 2); steps > 0; steps--) {
+        entry = vol->bcache[vol->bcache_hand];
+        if (++vol->bcache_hand >= vol->bcache_size)
+            vol->bcache_hand = 0;
+
+        if (entry->refcount > 0)
+            continue;
+        if (entry->phys_bno == FSW_INVALID_BNO)
+            return entry;
+        if (entry->chances > 0) {
+            entry->chances--;
+            continue;
+        }
+
+        fsw_blockcache_remove(vol, entry);
+        return entry;
+    }
+
+    return NULL;
 }
 
 /**
@@ -294,32 +398,51 @@ static void fsw_blockcache_free(struct fsw_volume *vol)
     fsw_u32 i;
 
     for (i = 0; i < vol->bcache_size; i++) {
-        fsw_free(vol->bcache[i].data);
+        fsw_free(vol->bcache[i]);
     }
     fsw_free(vol->bcache);
     vol->bcache = NULL;
     vol->bcache_size = 0;
+    vol->bcache_capacity = 0;
+    vol->bcache_hand = 0;
+    fsw_memzero(vol->bcache_hash, sizeof(vol->bcache_hash));
 }
 
 /**
- * Add a new dnode to the list of known dnodes. This internal function is used when a
- * dnode is created to add it to the dnode list that is used to search for existing
- * dnodes by id.
+ * Add a new dnode to the hash table of known dnodes. This internal function is used
+ * when a dnode is created to add it to the hash table that is used to search for
+ * existing dnodes by id.
  */
 
 static void fsw_dnode_register(struct fsw_volume *vol, struct fsw_dnode *dno)
 {
-    dno->next = vol->dnode_head;
-    if (vol->dnode_head != NULL)
-        vol->dnode_head->prev = dno;
+    struct fsw_dnode **bucket = &vol->dnode_hash[fsw_hash_u32(dno->dnode_id, FSW_DNODE_HASH_BITS)];
+
+    dno->next = *bucket;
+    if (*bucket != NULL)
+        (*bucket)->prev = dno;
     dno->prev = NULL;
-    vol->dnode_head = dno;
+    *bucket = dno;
+}
+
+static void fsw_dnode_unregister(struct fsw_volume *vol, struct fsw_dnode *dno)
+{
+    struct fsw_dnode **bucket = &vol->dnode_hash[fsw_hash_u32(dno->dnode_id, FSW_DNODE_HASH_BITS)];
+
+    if (dno->next != NULL)
+        dno->next->prev = dno->prev;
+
+    if (dno->prev != NULL)
+        dno->prev->next = dno->next;
+
+    if (*bucket == dno)
+        *bucket = dno->next;
 }
 
 static struct fsw_dnode *fsw_vol_lookup_dnode_id(struct fsw_volume *vol, fsw_u32 dnode_id) {
     struct fsw_dnode *dno;
 
-    for (dno = vol->dnode_head; dno != NULL; dno = dno->next) {
+    for (dno = vol->dnode_hash[fsw_hash_u32(dnode_id, FSW_DNODE_HASH_BITS)]; dno != NULL; dno = dno->next) {
         if (dno->dnode_id == dnode_id) {
             return dno;
         }
@@ -462,15 +585,8 @@ void fsw_dnode_release(struct fsw_dnode *dno)
 
     parent_dno = dno->parent;
 
-    // de-register from volume's list
-    if (dno->next != NULL)
-        dno->next->prev = dno->prev;
-
-    if (dno->prev != NULL)
-        dno->prev->next = dno->next;
-
-    if (vol->dnode_head == dno)
-        vol->dnode_head = dno->next;
+    // de-register from volume's hash table
+    fsw_dnode_unregister(vol, dno);
 
 #if defined(FSW_DNODE_CACHE_SIZE) && FSW_DNODE_CACHE_SIZE > 0
     if (dno->dkind == FSW_DNODE_KIND_DIR) {
@@ -1087,7 +1203,7 @@ fsw_status_t fsw_shandle_read(struct fsw_shandle *shand, fsw_u32 *buffer_size_in
         buflen = (fsw_u32)(dno->size - pos);
 
     while (buflen > 0) {
-	    fsw_u32 log_bno, pos_in_extent;
+	    fsw_u32 log_bno, pos_in_extent, log_left, phys_left;
         // get extent for the current logical block
 
         log_bno = pos / vol->log_blocksize;
@@ -1119,22 +1235,44 @@ fsw_status_t fsw_shandle_read(struct fsw_shandle *shand, fsw_u32 *buffer_size_in
 	    //
             phys_bno = shand->extent.phys_start + pos_in_extent / vol->phys_blocksize;
             pos_in_physblock = pos_in_extent & (vol->phys_blocksize - 1);
-            copylen = vol->phys_blocksize - pos_in_physblock;
 
-            if (copylen > buflen)
-                copylen = buflen;
+            // count whole physical blocks left in both the extent and the buffer
 
-            // get one physical block
+            log_left = shand->extent.log_count - pos_in_extent / vol->log_blocksize;
+            if (log_left > buflen / vol->log_blocksize + 1)
+                log_left = buflen / vol->log_blocksize + 1;
+            phys_left = log_left * (vol->log_blocksize / vol->phys_blocksize)
+                - (pos_in_extent & (vol->log_blocksize - 1)) / vol->phys_blocksize;
+            if (phys_left > buflen / vol->phys_blocksize)
+                phys_left = buflen / vol->phys_blocksize;
 
-            status = fsw_block_get(vol, phys_bno, cache_level, (void **)&block_buffer);
+            if (pos_in_physblock == 0 && phys_left > 1) {
+                // read the extent run directly into the caller's buffer
 
-            if (status != FSW_SUCCESS)
-                return status;
+                copylen = phys_left * vol->phys_blocksize;
+                status = fsw_block_read_direct(vol, phys_bno, phys_left, buffer);
+
+                if (status != FSW_SUCCESS)
+                    return status;
 
-            // copy data from it
+            } else {
+                copylen = vol->phys_blocksize - pos_in_physblock;
 
-            fsw_memcpy(buffer, block_buffer + pos_in_physblock, copylen);
-            fsw_block_release(vol, phys_bno, block_buffer);
+                if (copylen > buflen)
+                    copylen = buflen;
+
+                // get one physical block
+
+                status = fsw_block_get(vol, phys_bno, cache_level, (void **)&block_buffer);
+
+                if (status != FSW_SUCCESS)
+                    return status;
+
+                // copy data from it
+
+                fsw_memcpy(buffer, block_buffer + pos_in_physblock, copylen);
+                fsw_block_release(vol, phys_bno, block_buffer);
+            }
 
         } else if (shand->extent.exkind == FSW_EXTENT_KIND_BUFFER) {
             copylen = shand->extent.log_count * vol->log_blocksize - pos_in_extent;
@@ -68,6 +68,15 @@
 /** Indicates that the block cache entry is empty. */
 #define FSW_INVALID_BNO (~0U)
 
+/** Number of block cache hash buckets as a power of 2. */
+#define FSW_BCACHE_HASH_BITS (8)
+/** Number of cached blocks kept before the block cache starts evicting. */
+#ifndef FSW_BCACHE_MAX_SIZE
+#define FSW_BCACHE_MAX_SIZE (128)
+#endif
+/** Number of dnode id hash buckets as a power of 2. */
+#define FSW_DNODE_HASH_BITS (6)
+
 //
 // Byte-swapping macros
 //
@@ -193,7 +202,9 @@ struct fsw_blockcache {
     fsw_u32     refcount;           //!< Reference count
     fsw_u32     cache_level;        //!< Level of importance of this block
     fsw_u32     phys_bno;           //!< Physical block number
+    fsw_u32     chances;            //!< Clock sweeps left before eviction, refilled on access
     void        *data;              //!< Block data buffer
+    struct fsw_blockcache *hash_next; //!< Next entry in the same hash bucket
 };
 
 /**
@@ -207,10 +218,13 @@ struct fsw_volume {
     struct DNODESTRUCTNAME *root;   //!< Root directory dnode
     struct fsw_string label;        //!< Volume label
 
-    struct fsw_dnode *dnode_head;   //!< List of all dnodes allocated for this volume
+    struct fsw_dnode *dnode_hash[1 << FSW_DNODE_HASH_BITS]; //!< Hash table of all dnodes allocated for this volume
 
-    struct fsw_blockcache *bcache;  //!< Array of block cache entries
+    struct fsw_blockcache **bcache; //!< Array of block cache entries
     fsw_u32     bcache_size;        //!< Number of entries in the block cache array
+    fsw_u32     bcache_capacity;    //!< Number of allocated slots in the block cache array
+    fsw_u32     bcache_hand;        //!< Clock hand for block cache eviction
+    struct fsw_blockcache *bcache_hash[1 << FSW_BCACHE_HASH_BITS]; //!< Block cache entries by block number
 
     void        *host_data;         //!< Hook for a host-specific data structure
     struct fsw_host_table *host_table;      //!< Dispatch table for host-specific functions
@@ -247,8 +261,8 @@ struct fsw_dnode {
     fsw_dnode_kind_t dkind;         //!< Type of the dnode - file, dir, symlink, special
     fsw_u64     size;               //!< Data size in bytes
 
-    struct fsw_dnode *next;         //!< Doubly-linked list of all dnodes: previous dnode
-    struct fsw_dnode *prev;         //!< Doubly-linked list of all dnodes: next dnode
+    struct fsw_dnode *next;         //!< Doubly-linked dnode id hash chain: next dnode
+    struct fsw_dnode *prev;         //!< Doubly-linked dnode id hash chain: previous dnode
 
 #if defined(FSW_DNODE_CACHE_SIZE) && FSW_DNODE_CACHE_SIZE > 0
     fsw_u32    numcslots;                          //!< Number of slots occupied
@@ -332,6 +346,7 @@ struct fsw_host_table
                                      fsw_u32 old_phys_blocksize, fsw_u32 old_log_blocksize,
                                      fsw_u32 new_phys_blocksize, fsw_u32 new_log_blocksize);
     fsw_status_t (*read_block)(struct fsw_volume *vol, fsw_u32 phys_bno, void *buffer);
+    fsw_status_t (*read_blocks)(struct fsw_volume *vol, fsw_u32 phys_bno, fsw_u32 count, void *buffer);
 };
 
 /**
@@ -379,6 +394,7 @@ fsw_status_t fsw_volume_stat(struct fsw_volume *vol, struct fsw_volume_stat *sb)
 void         fsw_set_blocksize(struct VOLSTRUCTNAME *vol, fsw_u32 phys_blocksize, fsw_u32 log_blocksize);
 fsw_status_t fsw_block_get(struct VOLSTRUCTNAME *vol, fsw_u32 phys_bno, fsw_u32 cache_level, void **buffer_out);
 void         fsw_block_release(struct VOLSTRUCTNAME *vol, fsw_u32 phys_bno, void *buffer);
+fsw_status_t fsw_block_read_direct(struct VOLSTRUCTNAME *vol, fsw_u32 phys_bno, fsw_u32 count, void *buffer);
 
 /*@}*/
 
@@ -133,6 +133,10 @@ static fsw_status_t fsw_hfs_btree_read_node (
 	btnode_datum_t** outbuf
 );
 
+static void fsw_hfs_btree_free_cache (
+	struct fsw_hfs_btree *btree
+);
+
 static BTreeKey *fsw_hfs_btnode_key (
 	struct fsw_hfs_btree *btree,
 	btnode_datum_t* node,
@@ -259,32 +263,6 @@ fsw_hfs_make_catkey(fsw_u32 pid, struct fsw_string *str) {
 	return ck;
 }
 
-static fsw_s32
-fsw_hfs_read_block (struct fsw_hfs_dnode *dno, fsw_u32 log_bno, fsw_u32 off, fsw_s32 len, fsw_u8 *buf)
-{
-	fsw_status_t status;
-	struct fsw_extent extent;
-	fsw_u8 *buffer;
-
-	fsw_memzero(&extent, sizeof(extent));
-	extent.log_start = log_bno;
-	status = fsw_hfs_get_extent (dno->g.vol, dno, &extent);
-
-	if (status == FSW_SUCCESS) {
-		fsw_u32 phys_bno;
-
-		phys_bno = extent.phys_start;
-		status = fsw_block_get (dno->g.vol, phys_bno, 0, (void **) &buffer);
-
-		if (status == FSW_SUCCESS) {
-			fsw_memcpy (buf, buffer + off, len);
-			fsw_block_release (dno->g.vol, phys_bno, buffer);
-		}
-	}
-
-	return status;
-}
-
 /* Read data from HFS file. */
 
 static fsw_s32
@@ -295,28 +273,56 @@ fsw_hfs_read_file (struct fsw_hfs_dnode *dno, fsw_u64 pos, fsw_s32 len, fsw_u8 *
 	fsw_u32 block_size_bits = dno->g.vol->block_size_shift;
 	fsw_u32 block_size = (1 << block_size_bits);
 	fsw_u32 block_size_mask = block_size - 1;
-	
+	struct fsw_extent extent;
+	fsw_u8 *buffer;
+
 	while (len > 0) {
 		fsw_u32 log_bno;
 		fsw_u32 off = (fsw_u32) (pos & block_size_mask);
-		fsw_s32 next_len = len;
-		
+		fsw_s32 next_len;
+
 		log_bno = (fsw_u32) FSW_U64_SHR (pos, block_size_bits);
-		
-		if (next_len >= 0 && (fsw_u32) next_len > block_size)
-			next_len = block_size;
-		
-		status = fsw_hfs_read_block (dno, log_bno, off, next_len, buf);
-		
+
+		fsw_memzero(&extent, sizeof(extent));
+		extent.log_start = log_bno;
+		status = fsw_hfs_get_extent (dno->g.vol, dno, &extent);
+
+		if (status != FSW_SUCCESS)
+			return -1;
+
+		if (off == 0 && (fsw_u32) len >= 2 * block_size && extent.log_count > 1) {
+			/* Read the extent run directly into the caller's buffer */
+
+			fsw_u32 count = (fsw_u32) len >> block_size_bits;
+
+			if (count > extent.log_count)
+				count = extent.log_count;
+
+			next_len = (fsw_s32) (count << block_size_bits);
+			status = fsw_block_read_direct (dno->g.vol, extent.phys_start, count, buf);
+		} else {
+			next_len = len;
+
+			if ((fsw_u32) next_len > block_size - off)
+				next_len = block_size - off;
+
+			status = fsw_block_get (dno->g.vol, extent.phys_start, 0, (void **) &buffer);
+
+			if (status == FSW_SUCCESS) {
+				fsw_memcpy (buf, buffer + off, next_len);
+				fsw_block_release (dno->g.vol, extent.phys_start, buffer);
+			}
+		}
+
 		if (status != FSW_SUCCESS)
 			return -1;
-		
+
 		buf += next_len;
 		pos += next_len;
 		len -= next_len;
 		read += next_len;
 	}
-	
+
 	return read;
 }
 
@@ -538,6 +544,9 @@ fsw_hfs_volume_free (struct fsw_hfs_volume *vol)
 		vol->primary_voldesc = NULL;
 	}
 
+	fsw_hfs_btree_free_cache (&vol->catalog_tree);
+	fsw_hfs_btree_free_cache (&vol->extents_tree);
+
 	if (vol->catalog_tree.btfile != NULL) {
 		fsw_dnode_release ((struct fsw_dnode *) (vol->catalog_tree.btfile));
 		vol->catalog_tree.btfile = NULL;
@@ -637,8 +646,14 @@ fsw_hfs_dnode_stat (struct fsw_hfs_volume *vol, struct fsw_hfs_dnode *dno, struc
 	return FSW_SUCCESS;
 }
 
+/*
+ * Find physical block for logical block in extent record. On success also returns
+ * the number of blocks in the contiguous run starting there, physically adjacent
+ * extents are merged into the run.
+ */
+
 static int
-fsw_hfs_find_block (HFSPlusExtentRecord *exts, fsw_u32 *lbno, fsw_u32 *pbno)
+fsw_hfs_find_block (HFSPlusExtentRecord *exts, fsw_u32 *lbno, fsw_u32 *pbno, fsw_u32 *run)
 {
 	int i;
 	fsw_u32 cur_lbno = *lbno;
@@ -649,6 +664,20 @@ fsw_hfs_find_block (HFSPlusExtentRecord *exts, fsw_u32 *lbno, fsw_u32 *pbno)
 
 		if (cur_lbno < count) {
 			*pbno = start + cur_lbno;
+			*run = count - cur_lbno;
+
+			for (i++; i < 8; i++) {
+				fsw_u32 next_start = be32_to_cpu ((*exts)[i].startBlock);
+				fsw_u32 next_count = be32_to_cpu ((*exts)[i].blockCount);
+
+				if (next_count == 0 || next_start != start + count)
+					break;
+
+				*run += next_count;
+				start = next_start;
+				count = next_count;
+			}
+
 			return 1;
 		}
 
@@ -707,39 +736,116 @@ fsw_hfs_btnode_record_ptr (BTreeKey *currkey)
 	return (void *) ptr;
 }
 
+/*
+ * Obtain B-tree node from the node cache, reading it from disk on a miss.
+ * The returned node is owned by the cache and stays valid until the next
+ * node read from the same B-tree.
+ */
+
 static fsw_status_t
-fsw_hfs_btree_read_node (struct fsw_hfs_btree *btree, fsw_u32 nodenum, btnode_datum_t** outnode)
+fsw_hfs_btree_get_node (struct fsw_hfs_btree *btree, fsw_u32 nodenum, btnode_datum_t **outnode)
 {
 	fsw_status_t status;
-	btnode_datum_t* btnode;
+	struct fsw_hfs_btnode_cache_entry *entry;
+	struct fsw_hfs_btnode_cache_entry *victim = NULL;
+	btnode_datum_t *btnode;
+	fsw_u64 bstart;
+	fsw_s32 rv;
+	fsw_u32 i;
+
+	btree->cache_clock++;
+
+	for (i = 0; i < FSW_HFS_BTNODE_CACHE_SIZE; i++) {
+		entry = &btree->cache[i];
+
+		if (entry->valid && entry->nodenum == nodenum) {
+			entry->last_used = btree->cache_clock;
+			btree->node_hits++;
+			*outnode = (btnode_datum_t *) entry->data;
+			return FSW_SUCCESS;
+		}
 
-	status = fsw_alloc (btree->btnode_size, &btnode);
+		/* Prefer empty slots, then the least recently used unpinned node */
 
-	if (status == FSW_SUCCESS) {
-		fsw_u64 bstart;
-		fsw_s32 rv;
+		if (entry->pinned)
+			continue;
 
-		status = FSW_VOLUME_CORRUPTED;
-		bstart = (fsw_u64) nodenum * btree->btnode_size;
-		fsw_memzero (btnode, btree->btnode_size);
-		rv = fsw_hfs_read_file(btree->btfile, bstart, btree->btnode_size, (fsw_u8 *) btnode);
+		if (victim == NULL || (victim->valid && (!entry->valid || entry->last_used < victim->last_used)))
+			victim = entry;
+	}
 
-		if ((fsw_u32) rv == btree->btnode_size) {
-			fsw_u32 roffset = fsw_hfs_btnode_keyoffset(btree, btnode, 0);
+	if (victim->data == NULL) {
+		status = fsw_alloc (btree->btnode_size, &victim->data);
 
-			if (roffset == sizeof (BTNodeDescriptor)) {
-				*outnode = btnode;
-				status = FSW_SUCCESS;
-			}
-		}
+		if (status != FSW_SUCCESS)
+			return status;
 	}
 
-	if (status != FSW_SUCCESS)
-		fsw_free(btnode);
+	victim->valid = 0;
+	btnode = (btnode_datum_t *) victim->data;
+
+	bstart = (fsw_u64) nodenum * btree->btnode_size;
+	fsw_memzero (btnode, btree->btnode_size);
+	rv = fsw_hfs_read_file(btree->btfile, bstart, btree->btnode_size, (fsw_u8 *) btnode);
+	btree->node_reads++;
+
+	if ((fsw_u32) rv != btree->btnode_size
+		|| fsw_hfs_btnode_keyoffset(btree, btnode, 0) != sizeof (BTNodeDescriptor))
+		return FSW_VOLUME_CORRUPTED;
+
+	victim->valid = 1;
+	victim->nodenum = nodenum;
+	victim->last_used = btree->cache_clock;
+
+	/*
+	 * Every lookup walks the tree from the root, so index nodes are seen first
+	 * and the ones pinned are the root and upper levels.
+	 */
+
+	if (btnode->ndesc.kind == kBTIndexNode && btree->cache_pinned < FSW_HFS_BTNODE_CACHE_PINNED) {
+		victim->pinned = 1;
+		btree->cache_pinned++;
+	}
+
+	*outnode = btnode;
+
+	return FSW_SUCCESS;
+}
+
+/* Read B-tree node into a newly allocated buffer owned by the caller */
+
+static fsw_status_t
+fsw_hfs_btree_read_node (struct fsw_hfs_btree *btree, fsw_u32 nodenum, btnode_datum_t** outnode)
+{
+	fsw_status_t status;
+	btnode_datum_t* btnode;
+
+	status = fsw_hfs_btree_get_node (btree, nodenum, &btnode);
+
+	if (status == FSW_SUCCESS)
+		status = fsw_memdup ((void **) outnode, btnode, btree->btnode_size);
 
 	return status;
 }
 
+static void
+fsw_hfs_btree_free_cache (struct fsw_hfs_btree *btree)
+{
+	fsw_u32 i;
+
+	FSW_MSG_DEBUG ((FSW_MSGSTR ("fsw_hfs_btree_free_cache: %u node reads, %u cache hits\n"),
+		btree->node_reads, btree->node_hits));
+
+	for (i = 0; i < FSW_HFS_BTNODE_CACHE_SIZE; i++) {
+		fsw_free (btree->cache[i].data);
+		btree->cache[i].data = NULL;
+		btree->cache[i].valid = 0;
+		btree->cache[i].pinned = 0;
+	}
+
+	btree->cache_pinned = 0;
+}
+
 static fsw_u32
 fsw_hfs_btree_ix_next_btnodenum (BTreeKey *btkey)
 {
@@ -754,7 +860,7 @@ static fsw_status_t
 fsw_hfs_btree_search (struct fsw_hfs_btree *btree, BTreeKey *key, int (*compare_keys) (BTreeKey *key1, BTreeKey *key2), btnode_datum_t **btnode_out, fsw_u32 *tuplenum_out)
 {
 	fsw_status_t status;
-	btnode_datum_t *btnode = NULL;
+	btnode_datum_t *btnode;
 	fsw_u32 btnodenum;
 	fsw_u32 tuplenum;
 
@@ -762,52 +868,74 @@ fsw_hfs_btree_search (struct fsw_hfs_btree *btree, BTreeKey *key, int (*compare_
 
 	for (;;) {
 		fsw_s32 cmp = 0;
+		fsw_s32 match_cmp = 0;
 		fsw_u32 count;
-		BTreeKey *currkey = NULL;
+		fsw_u32 lo;
+		fsw_u32 hi;
+		BTreeKey *currkey;
 
-		status = fsw_hfs_btree_read_node (btree, btnodenum, &btnode);
+		status = fsw_hfs_btree_get_node (btree, btnodenum, &btnode);
 
 		if (status != FSW_SUCCESS)
 			break;
 
+		if (btnode->ndesc.kind != kBTIndexNode && btnode->ndesc.kind != kBTLeafNode) {
+			status = FSW_VOLUME_CORRUPTED;
+			break;
+		}
+
+		/* Records are sorted, find the number of keys less or equal to the one searched */
+
 		count = be16_to_cpu (btnode->ndesc.numRecords);
+		lo = 0;
+		hi = count;
 
-		for (tuplenum = 0; tuplenum < count; tuplenum++) {
-			currkey = fsw_hfs_btnode_key (btree, btnode, tuplenum);
-			cmp = compare_keys (currkey, key);
+		while (lo < hi) {
+			fsw_u32 mid = lo + (hi - lo) / 2;
 
-			if (cmp <= 0 && btnode->ndesc.kind == kBTIndexNode) {
-				btnodenum = fsw_hfs_btree_ix_next_btnodenum (currkey);
-			}
+			currkey = fsw_hfs_btnode_key (btree, btnode, mid);
 
-			if (cmp >= 0)
+			if (currkey == NULL) {
+				status = FSW_VOLUME_CORRUPTED;
 				break;
-		}
+			}
 
-		if (btnode->ndesc.kind == kBTLeafNode) {
-			status = FSW_NOT_FOUND;
+			cmp = compare_keys (currkey, key);
 
-			if (cmp == 0) {
-				*btnode_out = btnode;
-				*tuplenum_out = tuplenum;
-				status = FSW_SUCCESS;
+			if (cmp <= 0) {
+				match_cmp = cmp;
+				lo = mid + 1;
+			} else {
+				hi = mid;
 			}
+		}
+
+		if (status != FSW_SUCCESS)
+			break;
 
+		if (lo == 0) {
+			status = FSW_NOT_FOUND;
 			break;
 		}
 
-		if (tuplenum == 0 && cmp > 0) {
+		tuplenum = lo - 1;
+
+		if (btnode->ndesc.kind == kBTLeafNode) {
 			status = FSW_NOT_FOUND;
+
+			if (match_cmp == 0) {
+				status = fsw_memdup ((void **) btnode_out, btnode, btree->btnode_size);
+
+				if (status == FSW_SUCCESS)
+					*tuplenum_out = tuplenum;
+			}
+
 			break;
 		}
 
-		fsw_free(btnode);
-		btnode = NULL;
+		btnodenum = fsw_hfs_btree_ix_next_btnodenum (fsw_hfs_btnode_key (btree, btnode, tuplenum));
 	}
 
-	if (status != FSW_SUCCESS)
-		fsw_free (btnode);
-
 	return status;
 }
 
@@ -1125,9 +1253,11 @@ fsw_hfs_get_extent (struct fsw_hfs_volume *vol, struct fsw_hfs_dnode *dno, struc
 		struct HFSPlusExtentKey overflowkey;
 		fsw_u32 tuplenum;
 		fsw_u32 phys_bno;
+		fsw_u32 run;
 
-		if (fsw_hfs_find_block (exts, &lbno, &phys_bno)) {
+		if (fsw_hfs_find_block (exts, &lbno, &phys_bno, &run)) {
 			extent->phys_start = phys_bno;
+			extent->log_count = run;
 			status = FSW_SUCCESS;
 			break;
 		}
@@ -120,6 +120,28 @@ struct fsw_hfs_dnode
   fsw_u32 ilink;
 };
 
+/**
+ * HFS: Number of cached B-tree nodes per B-tree.
+ */
+#define FSW_HFS_BTNODE_CACHE_SIZE   32
+
+/**
+ * HFS: Maximum number of cached index nodes exempt from eviction.
+ */
+#define FSW_HFS_BTNODE_CACHE_PINNED 16
+
+/**
+ * HFS: Cached B-tree node.
+ */
+struct fsw_hfs_btnode_cache_entry
+{
+    void                     *data;        //!< Node contents, NULL if the slot was never used
+    fsw_u32                  nodenum;      //!< Node number
+    fsw_u32                  last_used;    //!< Access stamp for LRU eviction
+    int                      valid;        //!< Nonzero if data holds nodenum
+    int                      pinned;       //!< Nonzero for upper level (index) nodes
+};
+
 /**
  * HFS: In-memory B-tree structure.
  */
@@ -128,6 +150,11 @@ struct fsw_hfs_btree
     fsw_u32                  btroot_node;
     fsw_u32                  btnode_size;
     struct fsw_hfs_dnode*    btfile;
+    struct fsw_hfs_btnode_cache_entry cache[FSW_HFS_BTNODE_CACHE_SIZE];
+    fsw_u32                  cache_clock;  //!< Last access stamp
+    fsw_u32                  cache_pinned; //!< Number of pinned nodes
+    fsw_u32                  node_reads;   //!< Nodes read from disk
+    fsw_u32                  node_hits;    //!< Nodes served from cache
 };
 
 /**
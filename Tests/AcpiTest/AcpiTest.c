@@ -88,6 +88,28 @@ HpetPatch = {
   .OemTableId = 0
 };
 
+STATIC UINT8 EcPatchFind[] = {'E', 'C', '_', '_'};
+STATIC UINT8 EcPatchReplace[] = {'E', 'C', '0', '_'};
+STATIC
+OC_ACPI_PATCH
+EcPatch = {
+  .Find    = EcPatchFind,
+  .Replace = EcPatchReplace,
+  .Mask    = NULL,
+  .ReplaceMask = NULL,
+  .Size    = sizeof (EcPatchFind),
+  .Count   = 1,
+  .Skip    = 0,
+  //
+  // Only patch EC device definition.
+  //
+  .Base     = "\\_SB.PCI0.LPCB.EC",
+  .BaseSkip = 0,
+  .TableSignature = EFI_ACPI_6_2_SECONDARY_SYSTEM_DESCRIPTION_TABLE_SIGNATURE,
+  .TableLength = 0,
+  .OemTableId = 0
+};
+
 EFI_STATUS
 EFIAPI
 TestAcpi (
@@ -113,6 +135,8 @@ TestAcpi (
 
     AcpiApplyPatch (&Context, &HpetPatch);
 
+    AcpiApplyPatch (&Context, &EcPatch);
+
     AcpiRelocateRegions (&Context);
 
     AcpiNormalizeHeaders (&Context);
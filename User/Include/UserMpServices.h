@@ -0,0 +1,25 @@
+/** @file
+  Copyright (c) 2020, vit9696. All rights reserved.
+  SPDX-License-Identifier: BSD-3-Clause
+**/
+
+#ifndef OC_USER_MP_SERVICES_H
+#define OC_USER_MP_SERVICES_H
+
+#include <Uefi.h>
+#include <Protocol/MpService.h>
+
+/**
+  Install pthread-backed EFI_MP_SERVICES_PROTOCOL emulation.
+  This overrides LocateProtocol, CreateEvent, CheckEvent, and CloseEvent
+  in the dummy boot services table.
+
+  @param[in]  ProcessorCount  Number of emulated processors including the BSP.
+                              Passing 0 or 1 makes MP services unavailable.
+**/
+VOID
+UserMpServicesInstall (
+  IN UINTN  ProcessorCount
+  );
+
+#endif // OC_USER_MP_SERVICES_H
@@ -100,6 +100,15 @@ AsmIncrementUint32 (
   return 0;
 }
 
+UINT32
+EFIAPI
+InterlockedIncrement (
+  IN volatile UINT32  *Value
+  )
+{
+  return __atomic_add_fetch (Value, 1, __ATOMIC_SEQ_CST);
+}
+
 UINT32
 EFIAPI
 AsmReadIntelMicrocodeRevision (
@@ -0,0 +1,199 @@
+/** @file
+  Copyright (c) 2020, vit9696. All rights reserved.
+  SPDX-License-Identifier: BSD-3-Clause
+**/
+
+#include <BootServices.h>
+#include <UserMpServices.h>
+
+#include <pthread.h>
+
+typedef struct {
+  volatile UINT32   Signaled;
+} USER_EVENT;
+
+typedef struct {
+  EFI_AP_PROCEDURE  Procedure;
+  VOID              *Argument;
+  USER_EVENT        *WaitEvent;
+  pthread_t         Threads[64];
+  UINTN             ThreadCount;
+} USER_MP_JOB;
+
+STATIC UINTN       mUserProcessorCount;
+STATIC USER_MP_JOB mUserMpJob;
+
+STATIC
+VOID *
+UserMpApThread (
+  VOID  *Argument
+  )
+{
+  USER_MP_JOB  *Job;
+
+  Job = Argument;
+  Job->Procedure (Job->Argument);
+  return NULL;
+}
+
+STATIC
+VOID *
+UserMpWaitThread (
+  VOID  *Argument
+  )
+{
+  USER_MP_JOB  *Job;
+  UINTN        Index;
+
+  Job = Argument;
+  for (Index = 0; Index < Job->ThreadCount; ++Index) {
+    pthread_join (Job->Threads[Index], NULL);
+  }
+
+  __atomic_store_n (&Job->WaitEvent->Signaled, 1, __ATOMIC_RELEASE);
+  return NULL;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+UserMpGetNumberOfProcessors (
+  IN  EFI_MP_SERVICES_PROTOCOL  *This,
+  OUT UINTN                     *NumberOfProcessors,
+  OUT UINTN                     *NumberOfEnabledProcessors
+  )
+{
+  *NumberOfProcessors        = mUserProcessorCount;
+  *NumberOfEnabledProcessors = mUserProcessorCount;
+  return EFI_SUCCESS;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+UserMpStartupAllAPs (
+  IN  EFI_MP_SERVICES_PROTOCOL  *This,
+  IN  EFI_AP_PROCEDURE          Procedure,
+  IN  BOOLEAN                   SingleThread,
+  IN  EFI_EVENT                 WaitEvent               OPTIONAL,
+  IN  UINTN                     TimeoutInMicroSeconds,
+  IN  VOID                      *ProcedureArgument      OPTIONAL,
+  OUT UINTN                     **FailedCpuList         OPTIONAL
+  )
+{
+  pthread_t  WaitThread;
+  UINTN      Index;
+
+  if (SingleThread || FailedCpuList != NULL) {
+    return EFI_UNSUPPORTED;
+  }
+
+  mUserMpJob.Procedure   = Procedure;
+  mUserMpJob.Argument    = ProcedureArgument;
+  mUserMpJob.WaitEvent   = WaitEvent;
+  mUserMpJob.ThreadCount = mUserProcessorCount - 1;
+
+  for (Index = 0; Index < mUserMpJob.ThreadCount; ++Index) {
+    if (pthread_create (&mUserMpJob.Threads[Index], NULL, UserMpApThread, &mUserMpJob) != 0) {
+      abort ();
+    }
+  }
+
+  if (WaitEvent != NULL) {
+    if (pthread_create (&WaitThread, NULL, UserMpWaitThread, &mUserMpJob) != 0) {
+      abort ();
+    }
+
+    pthread_detach (WaitThread);
+    return EFI_SUCCESS;
+  }
+
+  for (Index = 0; Index < mUserMpJob.ThreadCount; ++Index) {
+    pthread_join (mUserMpJob.Threads[Index], NULL);
+  }
+
+  return EFI_SUCCESS;
+}
+
+STATIC EFI_MP_SERVICES_PROTOCOL mUserMpServices = {
+  .GetNumberOfProcessors = UserMpGetNumberOfProcessors,
+  .StartupAllAPs         = UserMpStartupAllAPs
+};
+
+STATIC
+EFI_STATUS
+EFIAPI
+UserMpLocateProtocol (
+  IN  EFI_GUID  *Protocol,
+  IN  VOID      *Registration  OPTIONAL,
+  OUT VOID      **Interface
+  )
+{
+  if (mUserProcessorCount > 1 && CompareGuid (Protocol, &gEfiMpServiceProtocolGuid)) {
+    *Interface = &mUserMpServices;
+    return EFI_SUCCESS;
+  }
+
+  return DummyLocateProtocol (Protocol, Registration, Interface);
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+UserMpCreateEvent (
+  IN  UINT32            Type,
+  IN  EFI_TPL           NotifyTpl,
+  IN  EFI_EVENT_NOTIFY  NotifyFunction  OPTIONAL,
+  IN  VOID              *NotifyContext  OPTIONAL,
+  OUT EFI_EVENT         *Event
+  )
+{
+  if (Type != 0 || NotifyFunction != NULL) {
+    return EFI_UNSUPPORTED;
+  }
+
+  *Event = AllocateZeroPool (sizeof (USER_EVENT));
+  return *Event != NULL ? EFI_SUCCESS : EFI_OUT_OF_RESOURCES;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+UserMpCheckEvent (
+  IN EFI_EVENT  Event
+  )
+{
+  USER_EVENT  *UserEvent;
+
+  UserEvent = Event;
+  if (__atomic_exchange_n (&UserEvent->Signaled, 0, __ATOMIC_ACQUIRE) != 0) {
+    return EFI_SUCCESS;
+  }
+
+  return EFI_NOT_READY;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+UserMpCloseEvent (
+  IN EFI_EVENT  Event
+  )
+{
+  FreePool (Event);
+  return EFI_SUCCESS;
+}
+
+VOID
+UserMpServicesInstall (
+  IN UINTN  ProcessorCount
+  )
+{
+  ASSERT (ProcessorCount <= ARRAY_SIZE (mUserMpJob.Threads) + 1);
+
+  mUserProcessorCount          = ProcessorCount;
+  mBootServices.LocateProtocol = UserMpLocateProtocol;
+  mBootServices.CreateEvent    = UserMpCreateEvent;
+  mBootServices.CheckEvent     = UserMpCheckEvent;
+  mBootServices.CloseEvent     = UserMpCloseEvent;
+}
@@ -0,0 +1,307 @@
+/** @file
+  Copyright (C) 2020, vit9696. All rights reserved.
+
+  All rights reserved.
+
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+**/
+
+#include <File.h>
+#include <GlobalVar.h>
+#include <BootServices.h>
+#include <Pcd.h>
+
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/OcAcpiLib.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ Index dumped DSDT and SSDT tables and verify that every indexed path resolves back:
+
+ ./Acpi DSDT.aml SSDT-1.aml SSDT-2.aml
+
+ Additional paths can be looked up with -f:
+
+ ./Acpi DSDT.aml -f \\_SB.PCI0.LPCB.EC0._Q11
+
+ for fuzzing (TODO):
+ clang -g -fsanitize=undefined,address,fuzzer -Dmain=__main ... Acpi.c ../../Library/OcAcpiLib/AcpiNameIndex.c ...
+*/
+
+STATIC
+VOID
+FormatNamePath (
+  IN  CONST OC_ACPI_NAME_INDEX  *Index,
+  IN  CONST OC_ACPI_NAME        *Name,
+  OUT CHAR8                     *Path
+  )
+{
+  UINT32  Segment;
+
+  *Path++ = '\\';
+  for (Segment = 0; Segment < Name->Depth; ++Segment) {
+    if (Segment > 0) {
+      *Path++ = '.';
+    }
+
+    CopyMem (Path, &Index->Segments[Name->Path + Segment], OC_ACPI_NAME_SIZE);
+    Path += OC_ACPI_NAME_SIZE;
+  }
+
+  *Path = '\0';
+}
+
+STATIC
+UINT32
+VerifyNameIndex (
+  IN CONST OC_ACPI_CONTEXT  *Context,
+  IN BOOLEAN                Print
+  )
+{
+  CONST OC_ACPI_NAME_INDEX  *Index;
+  CONST OC_ACPI_NAME        *Name;
+  CONST OC_ACPI_NAME        *Found;
+  UINT32                    Current;
+  UINT32                    Previous;
+  UINT32                    Skip;
+  UINT32                    Failures;
+  CHAR8                     Path[OC_ACPI_NAME_MAX_DEPTH * (OC_ACPI_NAME_SIZE + 1) + 2];
+
+  Index    = Context->NameIndex;
+  Failures = 0;
+
+  for (Current = 0; Current < Index->NumberOfNames; ++Current) {
+    Name = &Index->Names[Current];
+    FormatNamePath (Index, Name, Path);
+
+    if (Print) {
+      printf (
+        "%.4s %6u %6u %04X %s\n",
+        (const char *) &Name->Table->Signature,
+        Name->Offset,
+        Name->Length,
+        Name->Opcode,
+        Path
+        );
+    }
+
+    if (Name->Length == 0 || Name->Offset + Name->Length > Name->Table->Length) {
+      printf ("Invalid definition bounds of %s\n", Path);
+      ++Failures;
+    }
+
+    //
+    // Earlier definitions of the same path in the same table come first.
+    //
+    Skip = 0;
+    for (Previous = 0; Previous < Current; ++Previous) {
+      if (Index->Names[Previous].Table == Name->Table
+        && Index->Names[Previous].Depth == Name->Depth
+        && CompareMem (
+          &Index->Segments[Index->Names[Previous].Path],
+          &Index->Segments[Name->Path],
+          Name->Depth * sizeof (Index->Segments[0])
+          ) == 0) {
+        ++Skip;
+      }
+    }
+
+    Found = AcpiFindNamePath (Context, Name->Table, Path, Skip);
+    if (Found != Name) {
+      printf ("Lookup mismatch for %s skip %u\n", Path, Skip);
+      ++Failures;
+    }
+  }
+
+  return Failures;
+}
+
+STATIC
+UINT32
+VerifyNameIndexRefresh (
+  IN OUT OC_ACPI_CONTEXT  *Context
+  )
+{
+  OC_ACPI_NAME_INDEX  *Index;
+  OC_ACPI_NAME        *Names;
+  UINT32              *Segments;
+  UINT32              NumberOfNames;
+  UINT32              NumberOfSegments;
+  UINT32              Table;
+  UINT32              Failures;
+
+  Index            = Context->NameIndex;
+  NumberOfNames    = Index->NumberOfNames;
+  NumberOfSegments = Index->NumberOfSegments;
+  Names            = AllocateCopyPool (NumberOfNames * sizeof (Names[0]) + 1, Index->Names);
+  Segments         = AllocateCopyPool (NumberOfSegments * sizeof (Segments[0]) + 1, Index->Segments);
+  if (Names == NULL || Segments == NULL) {
+    return 1;
+  }
+
+  //
+  // Refreshing unchanged tables must produce the very same index.
+  //
+  if (Context->Dsdt != NULL) {
+    AcpiRefreshNameIndex (Context, (EFI_ACPI_COMMON_HEADER *) Context->Dsdt);
+  }
+
+  for (Table = 0; Table < Context->NumberOfTables; ++Table) {
+    AcpiRefreshNameIndex (Context, Context->Tables[Table]);
+  }
+
+  Failures = 0;
+  Index    = Context->NameIndex;
+  if (Index == NULL
+    || Index->NumberOfNames != NumberOfNames
+    || Index->NumberOfSegments != NumberOfSegments
+    || CompareMem (Index->Names, Names, NumberOfNames * sizeof (Names[0])) != 0
+    || CompareMem (Index->Segments, Segments, NumberOfSegments * sizeof (Segments[0])) != 0) {
+    printf ("Refreshed name index mismatch\n");
+    ++Failures;
+  } else {
+    Failures += VerifyNameIndex (Context, FALSE);
+  }
+
+  FreePool (Names);
+  FreePool (Segments);
+  return Failures;
+}
+
+int main(int argc, char** argv) {
+  EFI_STATUS          Status;
+  OC_ACPI_CONTEXT     Context;
+  CONST OC_ACPI_NAME  *Found;
+  uint8_t             *Buffer;
+  uint32_t            Size;
+  int                 Index;
+  UINT32              Failures;
+
+  if (argc < 2) {
+    printf ("Usage: %s DSDT.aml [SSDT.aml ...] [-f path ...]\n", argv[0]);
+    return -1;
+  }
+
+  PcdGet32 (PcdFixedDebugPrintErrorLevel) |= DEBUG_INFO;
+  PcdGet32 (PcdDebugPrintErrorLevel)      |= DEBUG_INFO;
+
+  ZeroMem (&Context, sizeof (Context));
+  Context.Tables = AllocateZeroPool (argc * sizeof (Context.Tables[0]));
+  if (Context.Tables == NULL) {
+    return -1;
+  }
+
+  Context.AllocatedTables = (UINT32) argc;
+
+  for (Index = 1; Index < argc; ++Index) {
+    if (strcmp (argv[Index], "-f") == 0) {
+      ++Index;
+      continue;
+    }
+
+    if ((Buffer = readFile (argv[Index], &Size)) == NULL) {
+      printf ("Read fail %s\n", argv[Index]);
+      return -1;
+    }
+
+    if (Size < sizeof (EFI_ACPI_DESCRIPTION_HEADER)
+      || ((EFI_ACPI_COMMON_HEADER *) Buffer)->Length > Size) {
+      printf ("Invalid table %s\n", argv[Index]);
+      return -1;
+    }
+
+    if (((EFI_ACPI_COMMON_HEADER *) Buffer)->Signature == EFI_ACPI_6_2_DIFFERENTIATED_SYSTEM_DESCRIPTION_TABLE_SIGNATURE
+      && Context.Dsdt == NULL) {
+      Context.Dsdt = (EFI_ACPI_DESCRIPTION_HEADER *) Buffer;
+    } else {
+      Context.Tables[Context.NumberOfTables++] = (EFI_ACPI_COMMON_HEADER *) Buffer;
+    }
+  }
+
+  Status = AcpiLoadNameIndex (&Context);
+  if (EFI_ERROR (Status)) {
+    printf ("Failed to index names - %r\n", Status);
+    return -1;
+  }
+
+  Failures  = VerifyNameIndex (&Context, TRUE);
+  Failures += VerifyNameIndexRefresh (&Context);
+
+  for (Index = 1; Index + 1 < argc; ++Index) {
+    if (strcmp (argv[Index], "-f") == 0) {
+      ++Index;
+      Found = AcpiFindNamePath (&Context, NULL, argv[Index], 0);
+      if (Found != NULL) {
+        printf (
+          "Found %s in %.4s at %u with %u bytes\n",
+          argv[Index],
+          (const char *) &Found->Table->Signature,
+          Found->Offset,
+          Found->Length
+          );
+      } else {
+        printf ("Not found %s\n", argv[Index]);
+        ++Failures;
+      }
+    }
+  }
+
+  printf (
+    "Indexed %u names in %u tables, %u failures\n",
+    Context.NameIndex->NumberOfNames,
+    Context.NumberOfTables + (Context.Dsdt != NULL ? 1 : 0),
+    Failures
+    );
+
+  for (Index = 0; Index < (int) Context.NumberOfTables; ++Index) {
+    FreePool (Context.Tables[Index]);
+  }
+
+  if (Context.Dsdt != NULL) {
+    FreePool (Context.Dsdt);
+  }
+
+  AcpiFreeContext (&Context);
+
+  return Failures == 0 ? 0 : -1;
+}
+
+INT32 LLVMFuzzerTestOneInput(CONST UINT8 *Data, UINTN Size) {
+  OC_ACPI_CONTEXT  Context;
+  UINT8            *NewData;
+
+  if (Size < sizeof (EFI_ACPI_DESCRIPTION_HEADER) || Size > MAX_UINT32) {
+    return 0;
+  }
+
+  NewData = AllocatePool (Size);
+  if (NewData == NULL) {
+    return 0;
+  }
+
+  CopyMem (NewData, Data, Size);
+  ((EFI_ACPI_COMMON_HEADER *) NewData)->Length = (UINT32) Size;
+
+  ZeroMem (&Context, sizeof (Context));
+  Context.Dsdt = (EFI_ACPI_DESCRIPTION_HEADER *) NewData;
+
+  if (!EFI_ERROR (AcpiLoadNameIndex (&Context))) {
+    VerifyNameIndex (&Context, FALSE);
+    VerifyNameIndexRefresh (&Context);
+  }
+
+  AcpiFreeContext (&Context);
+  FreePool (NewData);
+  return 0;
+}
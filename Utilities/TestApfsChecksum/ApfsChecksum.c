@@ -0,0 +1,205 @@
+/** @file
+  Copyright (c) 2020, vit9696. All rights reserved.
+  SPDX-License-Identifier: BSD-3-Clause
+**/
+
+#include <Uefi.h>
+
+#include <Library/BaseLib.h>
+#include <Library/DebugLib.h>
+
+#include "OcApfsInternal.h"
+
+#include <sys/time.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define TEST_PATTERN_ZERO    0
+#define TEST_PATTERN_ONES    1
+#define TEST_PATTERN_FE      2
+#define TEST_PATTERN_INDEX   3
+#define TEST_PATTERN_RANDOM  4
+
+typedef struct {
+  UINT32  Pattern;
+  UINT32  Size;
+  UINT64  Checksum;
+} TEST_VECTOR;
+
+//
+// Expected values are calculated with the original serial implementation.
+//
+STATIC TEST_VECTOR  mTestVectors[] = {
+  { TEST_PATTERN_ZERO,   4096 - 8,  0xFFFFFFFFFFFFFFFFULL },
+  { TEST_PATTERN_ONES,   65536 - 8, 0xFFFFFFFFFFFFFFFFULL },
+  { TEST_PATTERN_FE,     65536 - 8, 0xF8005FFE07FFDFFFULL },
+  { TEST_PATTERN_INDEX,  16384 - 8, 0xA9AAC80155D55FFBULL },
+  { TEST_PATTERN_RANDOM, 4096 - 8,  0x170B056C4A8F1C78ULL },
+  { TEST_PATTERN_RANDOM, 8192 - 8,  0xB24E01C340A4B022ULL },
+  { TEST_PATTERN_RANDOM, 32768 - 8, 0x2E79160B623CFBD0ULL },
+  { TEST_PATTERN_RANDOM, 65536 - 8, 0x6AF3721A87471FBCULL }
+};
+
+STATIC
+VOID
+FillPattern (
+  OUT UINT32  *Data,
+  IN  UINT32  Count,
+  IN  UINT32  Pattern
+  )
+{
+  UINT32  Index;
+  UINT32  Value;
+
+  Value = 1;
+
+  for (Index = 0; Index < Count; ++Index) {
+    switch (Pattern) {
+      case TEST_PATTERN_ZERO:
+        Data[Index] = 0;
+        break;
+      case TEST_PATTERN_ONES:
+        Data[Index] = MAX_UINT32;
+        break;
+      case TEST_PATTERN_FE:
+        Data[Index] = MAX_UINT32 - 1;
+        break;
+      case TEST_PATTERN_INDEX:
+        Data[Index] = Index;
+        break;
+      default:
+        Value       = Value * 1103515245U + 12345U;
+        Data[Index] = Value;
+        break;
+    }
+  }
+}
+
+//
+// Original implementation with one serial Fletcher-64 round per value.
+//
+STATIC
+UINT64
+ReferenceFletcher64 (
+  IN CONST VOID  *Data,
+  IN UINTN       DataSize
+  )
+{
+  CONST UINT32  *Walker;
+  CONST UINT32  *WalkerEnd;
+  UINT64        Sum1;
+  UINT64        Sum2;
+
+  Sum1 = 0;
+  Sum2 = 0;
+
+  Walker     = Data;
+  WalkerEnd  = Walker + DataSize / sizeof (UINT32);
+
+  while (Walker < WalkerEnd) {
+    Sum1 += *Walker;
+    Sum2 += Sum1;
+    ++Walker;
+  }
+
+  Sum2 += Sum1;
+  Sum2  = (UINT32) ~(Sum2 % MAX_UINT32);
+  Sum1 += Sum2;
+  Sum1  = (UINT32) ~(Sum1 % MAX_UINT32);
+
+  return (Sum1 << 32U) | Sum2;
+}
+
+STATIC
+UINT64
+BenchmarkFletcher64 (
+  IN UINT64  (*Fletcher64) (CONST VOID *Data, UINTN DataSize),
+  IN UINT32  *Data,
+  IN UINT32  BlockSize,
+  IN UINT32  Iterations
+  )
+{
+  struct timeval  Start;
+  struct timeval  End;
+  UINT32          Index;
+  volatile UINT64 Checksum;
+
+  gettimeofday (&Start, NULL);
+  for (Index = 0; Index < Iterations; ++Index) {
+    Checksum = Fletcher64 (Data, BlockSize - sizeof (UINT64));
+  }
+  gettimeofday (&End, NULL);
+
+  (VOID) Checksum;
+
+  return (UINT64) (End.tv_sec - Start.tv_sec) * 1000000 + (End.tv_usec - Start.tv_usec);
+}
+
+int main (int argc, char *argv[]) {
+  UINT32   *Data;
+  UINT32   Index;
+  UINT32   Size;
+  UINT32   Iterations;
+  UINT64   Checksum;
+  UINT64   Reference;
+  UINT64   Optimised;
+  BOOLEAN  Result;
+
+  Data = malloc (APFS_NX_MAXIMUM_BLOCK_SIZE);
+  if (Data == NULL) {
+    return -1;
+  }
+
+  Result = TRUE;
+
+  for (Index = 0; Index < ARRAY_SIZE (mTestVectors); ++Index) {
+    FillPattern (Data, mTestVectors[Index].Size / sizeof (UINT32), mTestVectors[Index].Pattern);
+    Checksum = InternalApfsFletcher64 (Data, mTestVectors[Index].Size);
+    if (Checksum != mTestVectors[Index].Checksum
+      || ReferenceFletcher64 (Data, mTestVectors[Index].Size) != mTestVectors[Index].Checksum) {
+      printf (
+        "Vector %u (pattern %u size %u) failed - %016llX vs %016llX\n",
+        Index,
+        mTestVectors[Index].Pattern,
+        mTestVectors[Index].Size,
+        (unsigned long long) Checksum,
+        (unsigned long long) mTestVectors[Index].Checksum
+        );
+      Result = FALSE;
+    }
+  }
+
+  //
+  // Cover every supported size, including ones not divisible by the lane count.
+  //
+  FillPattern (Data, APFS_NX_MAXIMUM_BLOCK_SIZE / sizeof (UINT32), TEST_PATTERN_RANDOM);
+  for (Size = APFS_NX_MINIMUM_BLOCK_SIZE - sizeof (UINT64);
+    Size <= APFS_NX_MAXIMUM_BLOCK_SIZE - sizeof (UINT64);
+    Size += sizeof (UINT32)) {
+    if (InternalApfsFletcher64 (Data, Size) != ReferenceFletcher64 (Data, Size)) {
+      printf ("Size %u failed\n", Size);
+      Result = FALSE;
+    }
+  }
+
+  printf ("Test vectors - %s\n", Result ? "OK" : "FAIL");
+
+  Iterations = argc > 1 ? (UINT32) strtoul (argv[1], NULL, 0) : 100000;
+
+  for (Size = APFS_NX_MINIMUM_BLOCK_SIZE; Size <= APFS_NX_MAXIMUM_BLOCK_SIZE; Size *= 4) {
+    Reference = BenchmarkFletcher64 (ReferenceFletcher64, Data, Size, Iterations);
+    Optimised = BenchmarkFletcher64 (InternalApfsFletcher64, Data, Size, Iterations);
+    printf (
+      "Block %u x %u - reference %llu us, optimised %llu us\n",
+      Size,
+      Iterations,
+      (unsigned long long) Reference,
+      (unsigned long long) Optimised
+      );
+  }
+
+  free (Data);
+
+  return Result ? 0 : -1;
+}
@@ -8,11 +8,24 @@
 #include <File.h>
 
 #include <Base.h>
+#include <Library/BaseMemoryLib.h>
 #include <Library/MemoryAllocationLib.h>
 #include <Library/DebugLib.h>
 #include <Library/BmpSupportLib.h>
 
 #include "BmfLib.h"
+#include "GuiIo.h"
+
+VOID
+EFIAPI
+GuiOutputStreamPixels (
+  OUT VOID        *Destination,
+  IN  CONST VOID  *Source,
+  IN  UINTN       PixelCount
+  )
+{
+  CopyMem (Destination, Source, PixelCount * sizeof (UINT32));
+}
 
 EFI_STATUS
 GuiBmpToImage (
@@ -67,17 +80,37 @@ int main (int argc, char** argv)
   UINT32           BmpImageSize;
   FILE *write_ptr;
 
+  if (argc < 3) {
+    DEBUG ((DEBUG_WARN, "Usage: %a <font.png> <font.bin>\n", argv[0]));
+    return -1;
+  }
+
   FontImage   = readFile (argv[1], &FontImageSize);
   FontMetrics = readFile (argv[2], &FontMetricsSize);
-  Result      = GuiFontConstruct (&Context, FontImage, FontImageSize, FontMetrics, FontMetricsSize);
+  if (FontImage == NULL || FontMetrics == NULL) {
+    //
+    // The font context only takes ownership of the files once constructed.
+    //
+    DEBUG ((DEBUG_WARN, "BMF: Failed to read font files\n"));
+    if (FontImage != NULL) {
+      FreePool (FontImage);
+    }
+    if (FontMetrics != NULL) {
+      FreePool (FontMetrics);
+    }
+    return -1;
+  }
+
+  Result = GuiFontConstruct (&Context, FontImage, FontImageSize, FontMetrics, FontMetricsSize, 1, 1);
   if (!Result) {
     DEBUG ((DEBUG_WARN, "BMF: Helvetica failed\n"));
     return -1;
   }
-  
+
   Result = GuiGetLabel (&Label, &Context, L"Time Machine HD", sizeof ("Time Machine HD") - 1, FALSE);
   if (!Result) {
     DEBUG ((DEBUG_WARN, "BMF: label failed\n"));
+    GuiFontDestruct (&Context);
     return -1;
   }
 
@@ -93,18 +126,24 @@ int main (int argc, char** argv)
              &BmpImageSize
              );
   if (EFI_ERROR (Status)) {
+    FreePool (Label.Buffer);
+    GuiFontDestruct (&Context);
     return -1;
   }
 
   write_ptr = fopen ("Label.bmp", "wb");
   if (write_ptr != NULL) {
     fwrite (BmpImage, BmpImageSize, 1, write_ptr);
+    fclose (write_ptr);
   }
-  fclose (write_ptr);
 
   FreePool (BmpImage);
 
-  FreePool (Context.FontImage.Buffer);
+  //
+  // Font image and metrics files are owned and freed by the font context
+  // together with the glyph atlas and label cache.
+  //
+  GuiFontDestruct (&Context);
   FreePool (Label.Buffer);
 
   return 0;
@@ -0,0 +1,517 @@
+/** @file
+  Copyright (c) 2020, vit9696. All rights reserved.
+  SPDX-License-Identifier: BSD-3-Clause
+**/
+
+#include <Uefi.h>
+
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/OcMemoryLib.h>
+
+#include <sys/time.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+  UINT32  Type;
+  UINT64  PhysicalStart;
+  UINT64  NumberOfPages;
+  UINT64  Attribute;
+} TEST_DESCRIPTOR;
+
+#define TEST_WB       (EFI_MEMORY_UC | EFI_MEMORY_WC | EFI_MEMORY_WT | EFI_MEMORY_WB)
+#define TEST_RT       (TEST_WB | EFI_MEMORY_RUNTIME)
+#define TEST_MMIO_RT  (EFI_MEMORY_UC | EFI_MEMORY_RUNTIME)
+
+//
+// Memory map layout of a desktop board with AMI firmware (Z390) before ExitBootServices.
+//
+STATIC TEST_DESCRIPTOR  mDesktopMap[] = {
+  { EfiBootServicesCode,       0x0,          0x1,     TEST_WB      },
+  { EfiConventionalMemory,     0x1000,       0x57,    TEST_WB      },
+  { EfiReservedMemoryType,     0x58000,      0x1,     TEST_WB      },
+  { EfiConventionalMemory,     0x59000,      0x3F,    TEST_WB      },
+  { EfiBootServicesData,       0x98000,      0x1,     TEST_WB      },
+  { EfiReservedMemoryType,     0x99000,      0x7,     TEST_WB      },
+  { EfiConventionalMemory,     0x100000,     0x2E00,  TEST_WB      },
+  { EfiLoaderCode,             0x2F00000,    0x1E,    TEST_WB      },
+  { EfiLoaderData,             0x2F1E000,    0x2C2,   TEST_WB      },
+  { EfiConventionalMemory,     0x31E0000,    0x1C20,  TEST_WB      },
+  { EfiBootServicesData,       0x4E00000,    0x2000,  TEST_WB      },
+  { EfiConventionalMemory,     0x6E00000,    0x30E4B, TEST_WB      },
+  { EfiBootServicesData,       0x37C4B000,   0x20,    TEST_WB      },
+  { EfiLoaderData,             0x37C6B000,   0x82,    TEST_WB      },
+  { EfiBootServicesData,       0x37CED000,   0x1AD,   TEST_WB      },
+  { EfiConventionalMemory,     0x37E9A000,   0x3,     TEST_WB      },
+  { EfiBootServicesCode,       0x37E9D000,   0x4A,    TEST_WB      },
+  { EfiBootServicesData,       0x37EE7000,   0x29C,   TEST_WB      },
+  { EfiBootServicesCode,       0x38183000,   0x159,   TEST_WB      },
+  { EfiBootServicesData,       0x382DC000,   0x53,    TEST_WB      },
+  { EfiLoaderCode,             0x3832F000,   0x86,    TEST_WB      },
+  { EfiBootServicesData,       0x383B5000,   0xB47,   TEST_WB      },
+  { EfiBootServicesCode,       0x38EFC000,   0x74,    TEST_WB      },
+  { EfiBootServicesData,       0x38F70000,   0x1D5,   TEST_WB      },
+  { EfiBootServicesCode,       0x39145000,   0x1BE,   TEST_WB      },
+  { EfiRuntimeServicesData,    0x39303000,   0x93,    TEST_RT      },
+  { EfiRuntimeServicesData,    0x39396000,   0x1A,    TEST_RT      },
+  { EfiRuntimeServicesCode,    0x393B0000,   0x26,    TEST_RT      },
+  { EfiRuntimeServicesCode,    0x393D6000,   0x8,     TEST_RT      },
+  { EfiRuntimeServicesData,    0x393DE000,   0x47,    TEST_RT      },
+  { EfiReservedMemoryType,     0x39425000,   0x113,   TEST_WB      },
+  { EfiRuntimeServicesData,    0x39538000,   0x29A,   TEST_RT      },
+  { EfiACPIReclaimMemory,      0x397D2000,   0x11,    TEST_WB      },
+  { EfiACPIMemoryNVS,          0x397E3000,   0x4A3,   TEST_WB      },
+  { EfiReservedMemoryType,     0x39C86000,   0x15,    TEST_WB      },
+  { EfiRuntimeServicesCode,    0x39C9B000,   0x1,     TEST_RT      },
+  { EfiRuntimeServicesCode,    0x39C9C000,   0x1,     TEST_RT      },
+  { EfiBootServicesCode,       0x39C9D000,   0xF0,    TEST_WB      },
+  { EfiBootServicesData,       0x39D8D000,   0x54,    TEST_WB      },
+  { EfiConventionalMemory,     0x39DE1000,   0x1F,    TEST_WB      },
+  { EfiBootServicesCode,       0x39E00000,   0x200,   TEST_WB      },
+  { EfiReservedMemoryType,     0x3A000000,   0x6000,  TEST_WB      },
+  { EfiMemoryMappedIO,         0xE0000000,   0x10000, TEST_MMIO_RT },
+  { EfiMemoryMappedIO,         0xFE000000,   0x11,    TEST_MMIO_RT },
+  { EfiMemoryMappedIO,         0xFEC00000,   0x1,     TEST_MMIO_RT },
+  { EfiMemoryMappedIO,         0xFED00000,   0x1,     TEST_MMIO_RT },
+  { EfiMemoryMappedIO,         0xFEE00000,   0x1,     TEST_MMIO_RT },
+  { EfiMemoryMappedIO,         0xFF000000,   0x1000,  TEST_MMIO_RT },
+  { EfiConventionalMemory,     0x100000000,  0x3BE000, TEST_WB      },
+  { EfiBootServicesData,       0x4BE000000,  0x2000,  TEST_WB      }
+};
+
+STATIC UINT32  mRandomSeed;
+
+STATIC
+UINT32
+TestRandom (
+  VOID
+  )
+{
+  mRandomSeed = mRandomSeed * 1103515245U + 12345U;
+  return mRandomSeed >> 8U;
+}
+
+//
+// Server boards produce hundreds of small boot services, loader and runtime
+// descriptors, generate a map of that kind from the seed.
+//
+STATIC
+UINTN
+GenerateServerMap (
+  OUT TEST_DESCRIPTOR  *Entries,
+  IN  UINTN            Count
+  )
+{
+  STATIC CONST UINT32  Types[] = {
+    EfiConventionalMemory,
+    EfiBootServicesCode,
+    EfiBootServicesData,
+    EfiBootServicesData,
+    EfiLoaderCode,
+    EfiLoaderData,
+    EfiRuntimeServicesCode,
+    EfiRuntimeServicesData,
+    EfiReservedMemoryType,
+    EfiACPIReclaimMemory,
+    EfiACPIMemoryNVS
+  };
+
+  UINTN   Index;
+  UINT64  Address;
+
+  mRandomSeed = 0x1234;
+  Address     = BASE_1MB;
+
+  for (Index = 0; Index < Count; ++Index) {
+    Entries[Index].Type          = Types[TestRandom () % ARRAY_SIZE (Types)];
+    Entries[Index].PhysicalStart = Address;
+    Entries[Index].NumberOfPages = 1 + TestRandom () % 0x200;
+    if (Entries[Index].Type == EfiRuntimeServicesCode || Entries[Index].Type == EfiRuntimeServicesData) {
+      Entries[Index].Attribute = TEST_RT;
+    } else {
+      Entries[Index].Attribute = TEST_WB;
+    }
+
+    Address += EFI_PAGES_TO_SIZE (Entries[Index].NumberOfPages);
+    //
+    // Leave occasional holes, which must not be joined.
+    //
+    if (TestRandom () % 8 == 0) {
+      Address += EFI_PAGE_SIZE;
+    }
+  }
+
+  return Count;
+}
+
+STATIC
+VOID
+BuildMemoryMap (
+  IN  TEST_DESCRIPTOR        *Entries,
+  IN  UINTN                  Count,
+  IN  UINTN                  DescriptorSize,
+  OUT EFI_MEMORY_DESCRIPTOR  *MemoryMap
+  )
+{
+  UINTN                  Index;
+  EFI_MEMORY_DESCRIPTOR  *Desc;
+
+  //
+  // Tag every descriptor including the extra space to ensure it moves as a whole.
+  //
+  Desc = MemoryMap;
+  for (Index = 0; Index < Count; ++Index) {
+    SetMem (Desc, DescriptorSize, (UINT8) Index);
+    Desc->Type          = Entries[Index].Type;
+    Desc->PhysicalStart = Entries[Index].PhysicalStart;
+    Desc->VirtualStart  = Index;
+    Desc->NumberOfPages = Entries[Index].NumberOfPages;
+    Desc->Attribute     = Entries[Index].Attribute;
+    Desc = NEXT_MEMORY_DESCRIPTOR (Desc, DescriptorSize);
+  }
+}
+
+STATIC
+VOID
+ShuffleMemoryMap (
+  IN OUT EFI_MEMORY_DESCRIPTOR  *MemoryMap,
+  IN     UINTN                  Count,
+  IN     UINTN                  DescriptorSize,
+  IN     UINT32                 Seed
+  )
+{
+  UINT8  Temp[128];
+  UINT8  *Map;
+  UINTN  Index;
+  UINTN  Other;
+
+  ASSERT (DescriptorSize <= sizeof (Temp));
+
+  Map         = (UINT8 *) MemoryMap;
+  mRandomSeed = Seed;
+
+  for (Index = Count; Index > 1; --Index) {
+    Other = TestRandom () % Index;
+    CopyMem (Temp, Map + (Index - 1) * DescriptorSize, DescriptorSize);
+    CopyMem (Map + (Index - 1) * DescriptorSize, Map + Other * DescriptorSize, DescriptorSize);
+    CopyMem (Map + Other * DescriptorSize, Temp, DescriptorSize);
+  }
+}
+
+//
+// Original exchange sort, adapted to move the whole descriptor.
+//
+STATIC
+VOID
+ReferenceSortMemoryMap (
+  IN UINTN                      MemoryMapSize,
+  IN OUT EFI_MEMORY_DESCRIPTOR  *MemoryMap,
+  IN UINTN                      DescriptorSize
+  )
+{
+  EFI_MEMORY_DESCRIPTOR  *MemoryMapEntry;
+  EFI_MEMORY_DESCRIPTOR  *NextMemoryMapEntry;
+  EFI_MEMORY_DESCRIPTOR  *MemoryMapEnd;
+  UINT8                  TempMemoryMap[128];
+
+  MemoryMapEntry = MemoryMap;
+  NextMemoryMapEntry = NEXT_MEMORY_DESCRIPTOR (MemoryMapEntry, DescriptorSize);
+  MemoryMapEnd = (EFI_MEMORY_DESCRIPTOR *) ((UINT8 *) MemoryMap + MemoryMapSize);
+  while (MemoryMapEntry < MemoryMapEnd) {
+    while (NextMemoryMapEntry < MemoryMapEnd) {
+      if (MemoryMapEntry->PhysicalStart > NextMemoryMapEntry->PhysicalStart) {
+        CopyMem (TempMemoryMap, MemoryMapEntry, DescriptorSize);
+        CopyMem (MemoryMapEntry, NextMemoryMapEntry, DescriptorSize);
+        CopyMem (NextMemoryMapEntry, TempMemoryMap, DescriptorSize);
+      }
+
+      NextMemoryMapEntry = NEXT_MEMORY_DESCRIPTOR (NextMemoryMapEntry, DescriptorSize);
+    }
+
+    MemoryMapEntry      = NEXT_MEMORY_DESCRIPTOR (MemoryMapEntry, DescriptorSize);
+    NextMemoryMapEntry  = NEXT_MEMORY_DESCRIPTOR (MemoryMapEntry, DescriptorSize);
+  }
+}
+
+STATIC
+BOOLEAN
+ReferenceIsFreeType (
+  IN UINT32  Type
+  )
+{
+  return Type == EfiBootServicesCode
+    || Type == EfiBootServicesData
+    || Type == EfiConventionalMemory
+    || Type == EfiLoaderCode
+    || Type == EfiLoaderData;
+}
+
+//
+// Original shrink implementation moving the remaining map after each joined sequence.
+//
+STATIC
+VOID
+ReferenceShrinkMemoryMap (
+  IN OUT UINTN                  *MemoryMapSize,
+  IN OUT EFI_MEMORY_DESCRIPTOR  *MemoryMap,
+  IN     UINTN                  DescriptorSize
+  )
+{
+  UINTN                   SizeFromDescToEnd;
+  UINT64                  Bytes;
+  EFI_MEMORY_DESCRIPTOR   *PrevDesc;
+  EFI_MEMORY_DESCRIPTOR   *Desc;
+  BOOLEAN                 CanBeJoinedFree;
+  BOOLEAN                 CanBeJoinedRt;
+  BOOLEAN                 HasEntriesToRemove;
+
+  if (*MemoryMapSize <= DescriptorSize) {
+    return;
+  }
+
+  PrevDesc           = MemoryMap;
+  Desc               = NEXT_MEMORY_DESCRIPTOR (PrevDesc, DescriptorSize);
+  SizeFromDescToEnd  = *MemoryMapSize - DescriptorSize;
+  *MemoryMapSize     = DescriptorSize;
+  HasEntriesToRemove = FALSE;
+
+  while (SizeFromDescToEnd > 0) {
+    Bytes = EFI_PAGES_TO_SIZE (PrevDesc->NumberOfPages);
+    CanBeJoinedFree = FALSE;
+    CanBeJoinedRt   = FALSE;
+    if (Desc->Attribute == PrevDesc->Attribute
+      && PrevDesc->PhysicalStart + Bytes == Desc->PhysicalStart) {
+      CanBeJoinedFree = ReferenceIsFreeType (Desc->Type) && ReferenceIsFreeType (PrevDesc->Type);
+      CanBeJoinedRt = (
+          Desc->Type == EfiRuntimeServicesCode
+          && PrevDesc->Type == EfiRuntimeServicesCode
+        ) || (
+          Desc->Type == EfiRuntimeServicesData
+          && PrevDesc->Type == EfiRuntimeServicesData
+        );
+    }
+
+    if (CanBeJoinedFree) {
+      PrevDesc->Type           = EfiConventionalMemory;
+      PrevDesc->NumberOfPages += Desc->NumberOfPages;
+      HasEntriesToRemove       = TRUE;
+    } else if (CanBeJoinedRt) {
+      PrevDesc->NumberOfPages += Desc->NumberOfPages;
+      HasEntriesToRemove       = TRUE;
+    } else {
+      *MemoryMapSize += DescriptorSize;
+      PrevDesc        = NEXT_MEMORY_DESCRIPTOR (PrevDesc, DescriptorSize);
+      if (HasEntriesToRemove) {
+        CopyMem (PrevDesc, Desc, SizeFromDescToEnd);
+        Desc = PrevDesc;
+        HasEntriesToRemove = FALSE;
+      }
+    }
+
+    Desc = NEXT_MEMORY_DESCRIPTOR (Desc, DescriptorSize);
+    SizeFromDescToEnd -= DescriptorSize;
+  }
+
+  //
+  // The original implementation also added one more descriptor here when the map
+  // ended with joined entries, leaving a stale copy of a joined descriptor.
+  //
+}
+
+STATIC
+BOOLEAN
+CheckMemoryMap (
+  IN CONST CHAR8            *Name,
+  IN UINTN                  DescriptorSize,
+  IN UINT32                 Seed,
+  IN EFI_MEMORY_DESCRIPTOR  *Source,
+  IN UINTN                  SourceSize
+  )
+{
+  EFI_MEMORY_DESCRIPTOR  *Expected;
+  EFI_MEMORY_DESCRIPTOR  *Actual;
+  UINTN                  ExpectedSize;
+  UINTN                  ActualSize;
+  BOOLEAN                Result;
+
+  Expected = malloc (SourceSize);
+  Actual   = malloc (SourceSize);
+  if (Expected == NULL || Actual == NULL) {
+    abort ();
+  }
+
+  Result = TRUE;
+
+  CopyMem (Expected, Source, SourceSize);
+  ReferenceSortMemoryMap (SourceSize, Expected, DescriptorSize);
+
+  CopyMem (Actual, Source, SourceSize);
+  OcSortMemoryMap (SourceSize, Actual, DescriptorSize);
+  if (CompareMem (Actual, Expected, SourceSize) != 0) {
+    printf ("%s (%u/%u) sort mismatch\n", Name, (UINT32) DescriptorSize, Seed);
+    Result = FALSE;
+  }
+
+  ExpectedSize = SourceSize;
+  ReferenceShrinkMemoryMap (&ExpectedSize, Expected, DescriptorSize);
+
+  ActualSize = SourceSize;
+  OcShrinkMemoryMap (&ActualSize, Actual, DescriptorSize);
+  if (ActualSize != ExpectedSize || CompareMem (Actual, Expected, ExpectedSize) != 0) {
+    printf ("%s (%u/%u) shrink mismatch\n", Name, (UINT32) DescriptorSize, Seed);
+    Result = FALSE;
+  }
+
+  CopyMem (Actual, Source, SourceSize);
+  ActualSize = SourceSize;
+  OcSortAndShrinkMemoryMap (&ActualSize, Actual, DescriptorSize);
+  if (ActualSize != ExpectedSize || CompareMem (Actual, Expected, ExpectedSize) != 0) {
+    printf ("%s (%u/%u) sort and shrink mismatch\n", Name, (UINT32) DescriptorSize, Seed);
+    Result = FALSE;
+  }
+
+  free (Expected);
+  free (Actual);
+
+  return Result;
+}
+
+STATIC
+BOOLEAN
+TestMemoryMap (
+  IN CONST CHAR8      *Name,
+  IN TEST_DESCRIPTOR  *Entries,
+  IN UINTN            Count
+  )
+{
+  STATIC CONST UINTN  DescriptorSizes[] = {
+    sizeof (EFI_MEMORY_DESCRIPTOR),
+    sizeof (EFI_MEMORY_DESCRIPTOR) + sizeof (UINT64)
+  };
+
+  EFI_MEMORY_DESCRIPTOR  *MemoryMap;
+  UINTN                  MemoryMapSize;
+  UINTN                  SizeIndex;
+  UINT32                 Seed;
+  BOOLEAN                Result;
+
+  Result = TRUE;
+
+  for (SizeIndex = 0; SizeIndex < ARRAY_SIZE (DescriptorSizes); ++SizeIndex) {
+    MemoryMapSize = Count * DescriptorSizes[SizeIndex];
+    MemoryMap     = malloc (MemoryMapSize);
+    if (MemoryMap == NULL) {
+      abort ();
+    }
+
+    //
+    // Seed 0 keeps the map sorted, as most firmwares report it.
+    //
+    for (Seed = 0; Seed < 16; ++Seed) {
+      BuildMemoryMap (Entries, Count, DescriptorSizes[SizeIndex], MemoryMap);
+      if (Seed > 0) {
+        ShuffleMemoryMap (MemoryMap, Count, DescriptorSizes[SizeIndex], Seed);
+      }
+
+      Result &= CheckMemoryMap (Name, DescriptorSizes[SizeIndex], Seed, MemoryMap, MemoryMapSize);
+    }
+
+    free (MemoryMap);
+  }
+
+  return Result;
+}
+
+STATIC
+UINT64
+BenchmarkMemoryMap (
+  IN EFI_MEMORY_DESCRIPTOR  *Source,
+  IN UINTN                  SourceSize,
+  IN UINTN                  DescriptorSize,
+  IN UINT32                 Iterations,
+  IN BOOLEAN                Reference
+  )
+{
+  struct timeval         Start;
+  struct timeval         End;
+  EFI_MEMORY_DESCRIPTOR  *MemoryMap;
+  UINTN                  MemoryMapSize;
+  UINT32                 Index;
+
+  MemoryMap = malloc (SourceSize);
+  if (MemoryMap == NULL) {
+    abort ();
+  }
+
+  gettimeofday (&Start, NULL);
+  for (Index = 0; Index < Iterations; ++Index) {
+    CopyMem (MemoryMap, Source, SourceSize);
+    MemoryMapSize = SourceSize;
+    if (Reference) {
+      ReferenceSortMemoryMap (MemoryMapSize, MemoryMap, DescriptorSize);
+      ReferenceShrinkMemoryMap (&MemoryMapSize, MemoryMap, DescriptorSize);
+    } else {
+      OcSortAndShrinkMemoryMap (&MemoryMapSize, MemoryMap, DescriptorSize);
+    }
+  }
+  gettimeofday (&End, NULL);
+
+  free (MemoryMap);
+
+  return (UINT64) (End.tv_sec - Start.tv_sec) * 1000000 + (End.tv_usec - Start.tv_usec);
+}
+
+int main (int argc, char *argv[]) {
+  TEST_DESCRIPTOR        *ServerMap;
+  EFI_MEMORY_DESCRIPTOR  *MemoryMap;
+  UINTN                  DescriptorSize;
+  UINTN                  Count;
+  UINT32                 Iterations;
+  UINT64                 Reference;
+  UINT64                 Optimised;
+  BOOLEAN                Result;
+
+  ServerMap = malloc (1024 * sizeof (TEST_DESCRIPTOR));
+  if (ServerMap == NULL) {
+    return -1;
+  }
+
+  Result = TestMemoryMap ("Desktop", mDesktopMap, ARRAY_SIZE (mDesktopMap));
+
+  for (Count = 1; Count <= 1024; Count *= 2) {
+    GenerateServerMap (ServerMap, Count);
+    Result &= TestMemoryMap ("Server", ServerMap, Count);
+  }
+
+  printf ("Memory map tests - %s\n", Result ? "OK" : "FAIL");
+
+  Iterations     = argc > 1 ? (UINT32) strtoul (argv[1], NULL, 0) : 1000;
+  DescriptorSize = sizeof (EFI_MEMORY_DESCRIPTOR) + sizeof (UINT64);
+  Count          = GenerateServerMap (ServerMap, 1024);
+  MemoryMap      = malloc (Count * DescriptorSize);
+  if (MemoryMap == NULL) {
+    return -1;
+  }
+
+  BuildMemoryMap (ServerMap, Count, DescriptorSize, MemoryMap);
+  ShuffleMemoryMap (MemoryMap, Count, DescriptorSize, 1);
+
+  Reference = BenchmarkMemoryMap (MemoryMap, Count * DescriptorSize, DescriptorSize, Iterations, TRUE);
+  Optimised = BenchmarkMemoryMap (MemoryMap, Count * DescriptorSize, DescriptorSize, Iterations, FALSE);
+  printf (
+    "Map %u x %u - reference %llu us, optimised %llu us\n",
+    (UINT32) Count,
+    Iterations,
+    (unsigned long long) Reference,
+    (unsigned long long) Optimised
+    );
+
+  free (MemoryMap);
+  free (ServerMap);
+
+  return Result ? 0 : -1;
+}
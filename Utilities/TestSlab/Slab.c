@@ -0,0 +1,407 @@
+/** @file
+  Copyright (c) 2020, vit9696. All rights reserved.
+  SPDX-License-Identifier: BSD-3-Clause
+**/
+
+#include <Uefi.h>
+
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/OcMemoryAllocationLib.h>
+#include <Library/OcMemoryLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+//
+// Enough 2048 byte blocks to span three arenas.
+//
+#define TEST_BLOCK_COUNT  (3 * OC_SLAB_ARENA_PAGES * (EFI_PAGE_SIZE / OC_SLAB_MAX_BLOCK_SIZE))
+
+#define TEST_CHECK(Condition)                                      \
+  do {                                                             \
+    if (!(Condition)) {                                            \
+      printf ("Line %d: %s failed\n", __LINE__, #Condition);      \
+      return FALSE;                                                \
+    }                                                              \
+  } while (0)
+
+STATIC EFI_TPL  mTpl = TPL_APPLICATION;
+STATIC UINT32   mFirmwareAllocations;
+STATIC UINT32   mFirmwareFrees;
+STATIC UINT32   mArenaLimit = OC_SLAB_MAX_ARENAS;
+STATIC UINT32   mArenaCount;
+//
+// Exhaustion test needs room for free blocks left in existing arenas.
+//
+STATIC UINT8    *mBlocks[TEST_BLOCK_COUNT * 2];
+
+STATIC
+EFI_TPL
+EFIAPI
+TestRaiseTpl (
+  IN EFI_TPL  NewTpl
+  )
+{
+  EFI_TPL  OldTpl;
+
+  if (NewTpl < mTpl) {
+    abort ();
+  }
+
+  OldTpl = mTpl;
+  mTpl   = NewTpl;
+  return OldTpl;
+}
+
+STATIC
+VOID
+EFIAPI
+TestRestoreTpl (
+  IN EFI_TPL  OldTpl
+  )
+{
+  mTpl = OldTpl;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+TestAllocatePool (
+  IN  EFI_MEMORY_TYPE  PoolType,
+  IN  UINTN            Size,
+  OUT VOID             **Buffer
+  )
+{
+  *Buffer = malloc (Size > 0 ? Size : 1);
+  if (*Buffer == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  ++mFirmwareAllocations;
+  return EFI_SUCCESS;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+TestFreePool (
+  IN VOID  *Buffer
+  )
+{
+  ++mFirmwareFrees;
+  free (Buffer);
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+OcAllocatePagesFromTop (
+  IN     EFI_MEMORY_TYPE         MemoryType,
+  IN     UINTN                   Pages,
+  IN OUT EFI_PHYSICAL_ADDRESS    *Memory,
+  IN     EFI_GET_MEMORY_MAP      GetMemoryMap  OPTIONAL,
+  IN     CHECK_ALLOCATION_RANGE  CheckRange  OPTIONAL
+  )
+{
+  VOID  *MemoryMap;
+
+  //
+  // Obtaining the memory map allocates pool, which must be served by firmware.
+  //
+  MemoryMap = AllocatePool (EFI_PAGE_SIZE);
+  if (MemoryMap == NULL) {
+    abort ();
+  }
+
+  FreePool (MemoryMap);
+
+  if (mArenaCount == mArenaLimit) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  ++mArenaCount;
+  return gBS->AllocatePages (AllocateAnyPages, MemoryType, Pages, Memory);
+}
+
+STATIC
+BOOLEAN
+TestSizeClasses (
+  VOID
+  )
+{
+  OC_MEMORY_ALLOCATION_STATS  Before;
+  OC_MEMORY_ALLOCATION_STATS  After;
+  UINT32                      Class;
+  UINTN                       BlockSize;
+  UINTN                       Sizes[2];
+  UINTN                       Size;
+  UINT32                      Index;
+  UINT8                       *Buffer;
+  UINT32                      Allocations;
+
+  for (Class = 0; Class < OC_SLAB_CLASS_COUNT; ++Class) {
+    BlockSize = 1U << (Class + OC_SLAB_MIN_BLOCK_SHIFT);
+    //
+    // Both smallest and largest sizes of each class must land in it.
+    //
+    Sizes[0] = Class > 0 ? BlockSize / 2 + 1 : 1;
+    Sizes[1] = BlockSize;
+
+    for (Index = 0; Index < ARRAY_SIZE (Sizes); ++Index) {
+      Size = Sizes[Index];
+      OcGetMemoryAllocationStats (&Before);
+      Buffer = AllocatePool (Size);
+      OcGetMemoryAllocationStats (&After);
+
+      TEST_CHECK (Buffer != NULL);
+      TEST_CHECK (((UINTN) Buffer & (BlockSize - 1)) == 0);
+      TEST_CHECK (After.UsedBlocks[Class] == Before.UsedBlocks[Class] + 1);
+      TEST_CHECK (After.RequestedBytes == Before.RequestedBytes + Size);
+      TEST_CHECK (After.BlockBytes == Before.BlockBytes + BlockSize);
+
+      SetMem (Buffer, Size, 0xA5);
+      FreePool (Buffer);
+      OcGetMemoryAllocationStats (&After);
+      TEST_CHECK (After.UsedBlocks[Class] == Before.UsedBlocks[Class]);
+      TEST_CHECK (After.Frees == Before.Frees + 1);
+    }
+  }
+
+  //
+  // Larger allocations go to firmware.
+  //
+  OcGetMemoryAllocationStats (&Before);
+  Allocations = mFirmwareAllocations;
+  Buffer = AllocatePool (OC_SLAB_MAX_BLOCK_SIZE + 1);
+  OcGetMemoryAllocationStats (&After);
+  TEST_CHECK (Buffer != NULL);
+  TEST_CHECK (mFirmwareAllocations == Allocations + 1);
+  TEST_CHECK (After.FirmwareAllocations == Before.FirmwareAllocations + 1);
+  TEST_CHECK (After.Allocations == Before.Allocations);
+  FreePool (Buffer);
+
+  return TRUE;
+}
+
+STATIC
+BOOLEAN
+TestFreeAcrossArenas (
+  VOID
+  )
+{
+  OC_MEMORY_ALLOCATION_STATS  Before;
+  OC_MEMORY_ALLOCATION_STATS  After;
+  UINT32                      Index;
+  UINT32                      FirmwareFrees;
+  UINT8                       *Buffer;
+
+  OcGetMemoryAllocationStats (&Before);
+
+  for (Index = 0; Index < TEST_BLOCK_COUNT; ++Index) {
+    mBlocks[Index] = AllocatePool (OC_SLAB_MAX_BLOCK_SIZE);
+    TEST_CHECK (mBlocks[Index] != NULL);
+    SetMem (mBlocks[Index], OC_SLAB_MAX_BLOCK_SIZE, (UINT8) Index);
+  }
+
+  OcGetMemoryAllocationStats (&After);
+  TEST_CHECK (After.Arenas >= Before.Arenas + 2);
+  TEST_CHECK (After.Arenas == mArenaCount);
+  TEST_CHECK (After.Allocations == Before.Allocations + TEST_BLOCK_COUNT);
+
+  //
+  // Half of the blocks are freed as if by another module.
+  //
+  FirmwareFrees = mFirmwareFrees;
+  for (Index = 0; Index < TEST_BLOCK_COUNT; ++Index) {
+    TEST_CHECK (mBlocks[Index][OC_SLAB_MAX_BLOCK_SIZE - 1] == (UINT8) Index);
+    if ((Index & 1U) != 0) {
+      TEST_CHECK (gBS->FreePool (mBlocks[Index]) == EFI_SUCCESS);
+    } else {
+      FreePool (mBlocks[Index]);
+    }
+  }
+
+  OcGetMemoryAllocationStats (&After);
+  TEST_CHECK (mFirmwareFrees == FirmwareFrees);
+  TEST_CHECK (After.Frees == Before.Frees + TEST_BLOCK_COUNT);
+  TEST_CHECK (After.UsedBytes == Before.UsedBytes);
+  TEST_CHECK (CompareMem (After.UsedBlocks, Before.UsedBlocks, sizeof (After.UsedBlocks)) == 0);
+
+  //
+  // Freed blocks are reused before new arenas are allocated.
+  //
+  for (Index = 0; Index < TEST_BLOCK_COUNT; ++Index) {
+    mBlocks[Index] = AllocatePool (OC_SLAB_MAX_BLOCK_SIZE);
+    TEST_CHECK (mBlocks[Index] != NULL);
+  }
+
+  OcGetMemoryAllocationStats (&Before);
+  TEST_CHECK (Before.Arenas == After.Arenas);
+
+  for (Index = 0; Index < TEST_BLOCK_COUNT; ++Index) {
+    FreePool (mBlocks[Index]);
+  }
+
+  //
+  // Firmware pool passes through the override.
+  //
+  Buffer = malloc (1U << OC_SLAB_MIN_BLOCK_SHIFT);
+  TEST_CHECK (Buffer != NULL);
+  TEST_CHECK (gBS->FreePool (Buffer) == EFI_SUCCESS);
+  TEST_CHECK (mFirmwareFrees == FirmwareFrees + 1);
+
+  Buffer = AllocatePool (OC_SLAB_MAX_BLOCK_SIZE * 2);
+  TEST_CHECK (Buffer != NULL);
+  TEST_CHECK (gBS->FreePool (Buffer) == EFI_SUCCESS);
+  TEST_CHECK (mFirmwareFrees == FirmwareFrees + 2);
+
+  return TRUE;
+}
+
+STATIC
+BOOLEAN
+TestReallocateAcrossArenas (
+  VOID
+  )
+{
+  OC_MEMORY_ALLOCATION_STATS  Before;
+  OC_MEMORY_ALLOCATION_STATS  After;
+  UINT32                      Index;
+  UINT8                       *Buffer;
+
+  //
+  // Fill the arenas with small blocks, so that moved blocks land in later ones.
+  //
+  for (Index = 0; Index < TEST_BLOCK_COUNT; ++Index) {
+    mBlocks[Index] = AllocatePool (100);
+    TEST_CHECK (mBlocks[Index] != NULL);
+    SetMem (mBlocks[Index], 100, (UINT8) Index);
+  }
+
+  for (Index = 0; Index < TEST_BLOCK_COUNT; ++Index) {
+    //
+    // Growing within the block is done in place.
+    //
+    OcGetMemoryAllocationStats (&Before);
+    Buffer = ReallocatePool (100, 120, mBlocks[Index]);
+    OcGetMemoryAllocationStats (&After);
+    TEST_CHECK (Buffer == mBlocks[Index]);
+    TEST_CHECK (Buffer[99] == (UINT8) Index && Buffer[119] == 0);
+    TEST_CHECK (After.InPlaceReallocations == Before.InPlaceReallocations + 1);
+    TEST_CHECK (After.RequestedBytes == Before.RequestedBytes + 20);
+    TEST_CHECK (After.BlockBytes == Before.BlockBytes);
+
+    //
+    // Shrinking is done in place as well.
+    //
+    Buffer = ReallocatePool (120, 50, Buffer);
+    OcGetMemoryAllocationStats (&Before);
+    TEST_CHECK (Buffer == mBlocks[Index]);
+    TEST_CHECK (Before.RequestedBytes == After.RequestedBytes - 70);
+
+    //
+    // Growing past the block moves it to another class.
+    //
+    Buffer = ReallocatePool (50, 1500, Buffer);
+    OcGetMemoryAllocationStats (&After);
+    TEST_CHECK (Buffer != NULL && Buffer != mBlocks[Index]);
+    TEST_CHECK (Buffer[49] == (UINT8) Index && Buffer[50] == 0 && Buffer[1499] == 0);
+    TEST_CHECK (After.Frees == Before.Frees + 1);
+    TEST_CHECK (After.RequestedBytes == Before.RequestedBytes + 1500);
+    SetMem (Buffer, 1500, (UINT8) Index);
+    mBlocks[Index] = Buffer;
+  }
+
+  for (Index = 0; Index < TEST_BLOCK_COUNT; ++Index) {
+    //
+    // Growing past the largest class moves it to firmware.
+    //
+    OcGetMemoryAllocationStats (&Before);
+    Buffer = ReallocatePool (1500, OC_SLAB_MAX_BLOCK_SIZE * 2, mBlocks[Index]);
+    OcGetMemoryAllocationStats (&After);
+    TEST_CHECK (Buffer != NULL);
+    TEST_CHECK (Buffer[1499] == (UINT8) Index && Buffer[1500] == 0);
+    TEST_CHECK (After.Frees == Before.Frees + 1);
+    TEST_CHECK (After.FirmwareAllocations == Before.FirmwareAllocations + 1);
+    FreePool (Buffer);
+  }
+
+  OcGetMemoryAllocationStats (&After);
+  for (Index = 0; Index < OC_SLAB_CLASS_COUNT; ++Index) {
+    TEST_CHECK (After.UsedBlocks[Index] == 0);
+  }
+
+  TEST_CHECK (After.UsedBytes == 0);
+  TEST_CHECK (After.Allocations == After.Frees);
+
+  return TRUE;
+}
+
+STATIC
+BOOLEAN
+TestExhaustion (
+  VOID
+  )
+{
+  OC_MEMORY_ALLOCATION_STATS  Before;
+  OC_MEMORY_ALLOCATION_STATS  After;
+  UINT32                      Index;
+
+  //
+  // Once no arenas can be added, firmware serves the allocations.
+  //
+  OcGetMemoryAllocationStats (&Before);
+  mArenaLimit = mArenaCount;
+
+  for (Index = 0; Index < ARRAY_SIZE (mBlocks); ++Index) {
+    mBlocks[Index] = AllocatePool (OC_SLAB_MAX_BLOCK_SIZE);
+    TEST_CHECK (mBlocks[Index] != NULL);
+  }
+
+  OcGetMemoryAllocationStats (&After);
+  TEST_CHECK (After.Arenas == Before.Arenas);
+  TEST_CHECK (After.FirmwareAllocations > Before.FirmwareAllocations);
+
+  for (Index = 0; Index < ARRAY_SIZE (mBlocks); ++Index) {
+    FreePool (mBlocks[Index]);
+  }
+
+  OcGetMemoryAllocationStats (&After);
+  TEST_CHECK (After.UsedBytes == 0);
+
+  return TRUE;
+}
+
+int main (int argc, char *argv[]) {
+  BOOLEAN  Result;
+  UINT32   Crc32;
+
+  gBS->RaiseTPL       = TestRaiseTpl;
+  gBS->RestoreTPL     = TestRestoreTpl;
+  gBS->AllocatePool   = TestAllocatePool;
+  gBS->FreePool       = TestFreePool;
+  gBS->Hdr.HeaderSize = sizeof (*gBS);
+
+  Result = TestSizeClasses ();
+
+  //
+  // FreePool override must be installed with the first arena.
+  //
+  Crc32          = gBS->Hdr.CRC32;
+  gBS->Hdr.CRC32 = 0;
+  Result &= gBS->FreePool != TestFreePool && Crc32 == CalculateCrc32 (gBS, gBS->Hdr.HeaderSize);
+  gBS->Hdr.CRC32 = Crc32;
+
+  Result &= TestFreeAcrossArenas ();
+  Result &= TestReallocateAcrossArenas ();
+  Result &= TestExhaustion ();
+
+  OcLogMemoryAllocationStats ();
+
+  printf ("Slab allocator - %s\n", Result ? "OK" : "FAIL");
+
+  return Result ? 0 : -1;
+}
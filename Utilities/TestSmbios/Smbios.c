@@ -28,6 +28,7 @@
 #include <stdio.h>
 #include <stdbool.h>
 #include <stdlib.h>
+#include <string.h>
 
 /*
  for fuzzing (TODO):
@@ -78,7 +79,239 @@ bool doDump = false;
 SMBIOS_TABLE_ENTRY_POINT        gSmbios;
 SMBIOS_TABLE_3_0_ENTRY_POINT    gSmbios3;
 
+/*
+ Benchmark table creation with a synthetic multi-DIMM server table:
+
+ ./Smbios -b [memory devices] [iterations]
+*/
+
+STATIC
+SMBIOS_STRUCTURE *
+AppendStructure (
+  UINT8        *Buffer,
+  uint32_t     *Offset,
+  SMBIOS_TYPE  Type,
+  UINT8        Length,
+  UINT16       Handle,
+  const char   **Strings,
+  uint32_t     StringCount
+  )
+{
+  SMBIOS_STRUCTURE  *Hdr;
+  uint32_t          Index;
+  size_t            StringSize;
+
+  Hdr = (SMBIOS_STRUCTURE *) (Buffer + *Offset);
+  memset (Hdr, 0, Length);
+  Hdr->Type   = Type;
+  Hdr->Length = Length;
+  Hdr->Handle = Handle;
+  *Offset += Length;
+
+  for (Index = 0; Index < StringCount; ++Index) {
+    StringSize = strlen (Strings[Index]) + 1;
+    memcpy (Buffer + *Offset, Strings[Index], StringSize);
+    *Offset += (uint32_t) StringSize;
+  }
+
+  if (StringCount == 0) {
+    Buffer[(*Offset)++] = 0;
+  }
+
+  Buffer[(*Offset)++] = 0;
+  return Hdr;
+}
+
+STATIC
+UINT8 *
+GenerateServerTable (
+  uint32_t  MemoryDevices,
+  uint32_t  *Size
+  )
+{
+  UINT8                 *Buffer;
+  uint32_t              Offset;
+  uint32_t              Index;
+  UINT16                Handle;
+  SMBIOS_TABLE_TYPE7    *Cache;
+  SMBIOS_TABLE_TYPE17   *Device;
+  SMBIOS_TABLE_TYPE19   *Mapped;
+  SMBIOS_TABLE_TYPE20   *DeviceMapped;
+  char                  Locator[16];
+  char                  Bank[16];
+  char                  Serial[16];
+  const char            *Strings[6];
+
+  Buffer = calloc (1, EFI_PAGE_SIZE + MemoryDevices * 2 * EFI_PAGE_SIZE / 16);
+  if (Buffer == NULL) {
+    return NULL;
+  }
+
+  Offset = 0;
+  Handle = 0x100;
+
+  Strings[0] = "Vendor";
+  Strings[1] = "1.0";
+  Strings[2] = "01/01/2020";
+  AppendStructure (Buffer, &Offset, SMBIOS_TYPE_BIOS_INFORMATION, sizeof (SMBIOS_TABLE_TYPE0), Handle++, Strings, 3);
+  AppendStructure (Buffer, &Offset, SMBIOS_TYPE_SYSTEM_INFORMATION, sizeof (SMBIOS_TABLE_TYPE1), Handle++, Strings, 2);
+  AppendStructure (Buffer, &Offset, SMBIOS_TYPE_BASEBOARD_INFORMATION, sizeof (SMBIOS_TABLE_TYPE2), Handle++, Strings, 2);
+  AppendStructure (Buffer, &Offset, SMBIOS_TYPE_SYSTEM_ENCLOSURE, sizeof (SMBIOS_TABLE_TYPE3), Handle++, Strings, 2);
+
+  for (Index = 0; Index < 4; ++Index) {
+    AppendStructure (Buffer, &Offset, SMBIOS_TYPE_PROCESSOR_INFORMATION, sizeof (SMBIOS_TABLE_TYPE4), Handle++, Strings, 2);
+  }
+
+  for (Index = 0; Index < 12; ++Index) {
+    Cache = (SMBIOS_TABLE_TYPE7 *) AppendStructure (
+      Buffer, &Offset, SMBIOS_TYPE_CACHE_INFORMATION, sizeof (SMBIOS_TABLE_TYPE7), Handle++, Strings, 1
+      );
+    Cache->SocketDesignation  = 1;
+    Cache->CacheConfiguration = (UINT16) (Index % 3);
+  }
+
+  AppendStructure (Buffer, &Offset, SMBIOS_TYPE_PHYSICAL_MEMORY_ARRAY, sizeof (SMBIOS_TABLE_TYPE16), Handle++, NULL, 0);
+
+  Mapped = (SMBIOS_TABLE_TYPE19 *) AppendStructure (
+    Buffer, &Offset, SMBIOS_TYPE_MEMORY_ARRAY_MAPPED_ADDRESS, sizeof (SMBIOS_TABLE_TYPE19), Handle++, NULL, 0
+    );
+  Mapped->StartingAddress = 0;
+  Mapped->EndingAddress   = MAX_UINT32;
+
+  for (Index = 0; Index < MemoryDevices; ++Index) {
+    snprintf (Locator, sizeof (Locator), "DIMM_%c%u", 'A' + (char) (Index / 16 % 26), Index % 16);
+    snprintf (Bank, sizeof (Bank), "NODE %u", Index / 16);
+    snprintf (Serial, sizeof (Serial), "%08X", 0x1000 + Index);
+    Strings[0] = Locator;
+    Strings[1] = Bank;
+    Strings[2] = "Samsung";
+    Strings[3] = Serial;
+    Strings[4] = "Asset";
+    Strings[5] = "M393A4K40CB2-CTD";
+
+    Device = (SMBIOS_TABLE_TYPE17 *) AppendStructure (
+      Buffer, &Offset, SMBIOS_TYPE_MEMORY_DEVICE, sizeof (SMBIOS_TABLE_TYPE17), Handle++, Strings, 6
+      );
+    Device->TotalWidth    = 72;
+    Device->DataWidth     = 64;
+    Device->Size          = 16384;
+    Device->FormFactor    = MemoryFormFactorDimm;
+    Device->DeviceLocator = 1;
+    Device->BankLocator   = 2;
+    Device->MemoryType    = MemoryTypeDdr4;
+    Device->Speed         = 2666;
+    Device->Manufacturer  = 3;
+    Device->SerialNumber  = 4;
+    Device->AssetTag      = 5;
+    Device->PartNumber    = 6;
+  }
+
+  //
+  // Firmwares often list mapped addresses after all memory devices.
+  //
+  for (Index = 0; Index < MemoryDevices; ++Index) {
+    DeviceMapped = (SMBIOS_TABLE_TYPE20 *) AppendStructure (
+      Buffer, &Offset, SMBIOS_TYPE_MEMORY_DEVICE_MAPPED_ADDRESS, sizeof (SMBIOS_TABLE_TYPE20), Handle++, NULL, 0
+      );
+    DeviceMapped->StartingAddress                = Index * 0x2000000;
+    DeviceMapped->EndingAddress                  = (Index + 1) * 0x2000000 - 1;
+    DeviceMapped->MemoryDeviceHandle             = (UINT16) (Handle - MemoryDevices - 1);
+    DeviceMapped->MemoryArrayMappedAddressHandle = Mapped->Hdr.Handle;
+  }
+
+  AppendStructure (Buffer, &Offset, SMBIOS_TYPE_END_OF_TABLE, sizeof (SMBIOS_TABLE_TYPE127), Handle++, NULL, 0);
+
+  *Size = Offset;
+  return Buffer;
+}
+
+STATIC
+int
+BenchmarkServerTable (
+  uint32_t  MemoryDevices,
+  uint32_t  Iterations
+  )
+{
+  EFI_STATUS                    Status;
+  OC_CPU_INFO                   CpuInfo;
+  OC_SMBIOS_TABLE               SmbiosTable;
+  SMBIOS_TABLE_ENTRY_POINT      *Patched;
+  SMBIOS_TABLE_3_0_ENTRY_POINT  *Patched3;
+  UINT8                         *Table;
+  uint32_t                      Size;
+  uint32_t                      Index;
+  struct timeval                Start;
+  struct timeval                End;
+  uint64_t                      Elapsed;
+
+  Table = GenerateServerTable (MemoryDevices, &Size);
+  if (Table == NULL) {
+    printf ("Generation fail\n");
+    return -1;
+  }
+
+  OcCpuScanProcessor (&CpuInfo);
+
+  gSmbios3.TableMaximumSize = Size;
+  gSmbios3.TableAddress     = (uintptr_t) Table;
+  gSmbios3.EntryPointLength = sizeof (SMBIOS_TABLE_3_0_ENTRY_POINT);
+
+  Elapsed = 0;
+  for (Index = 0; Index < Iterations; ++Index) {
+    gBS->InstallConfigurationTable (&gEfiSmbiosTableGuid, NULL);
+    gBS->InstallConfigurationTable (&gEfiSmbios3TableGuid, &gSmbios3);
+
+    gettimeofday (&Start, NULL);
+    Status = OcSmbiosTablePrepare (&SmbiosTable);
+    if (!EFI_ERROR (Status)) {
+      Status = OcSmbiosCreate (&SmbiosTable, &SmbiosData, OcSmbiosUpdateCreate, &CpuInfo);
+      OcSmbiosTableFree (&SmbiosTable);
+    }
+    gettimeofday (&End, NULL);
+
+    if (EFI_ERROR (Status)) {
+      printf ("Create fail - %d\n", (int) Status);
+      free (Table);
+      return -1;
+    }
+
+    Elapsed += (uint64_t) (End.tv_sec - Start.tv_sec) * 1000000 + (End.tv_usec - Start.tv_usec);
+
+    //
+    // Release the previous table, so that it is not picked up as the original one.
+    //
+    if (!EFI_ERROR (EfiGetSystemConfigurationTable (&gEfiSmbiosTableGuid, (VOID **) &Patched))) {
+      FreePages ((VOID *) (uintptr_t) Patched->TableAddress, EFI_SIZE_TO_PAGES (Patched->TableLength));
+      FreePages (Patched, 1);
+    }
+
+    if (!EFI_ERROR (EfiGetSystemConfigurationTable (&gEfiSmbios3TableGuid, (VOID **) &Patched3))
+      && Patched3 != &gSmbios3) {
+      FreePages (Patched3, 1);
+    }
+  }
+
+  printf (
+    "Created %u tables from %u bytes with %u memory devices in %llu us, %llu us per table\n",
+    Iterations,
+    Size,
+    MemoryDevices,
+    (unsigned long long) Elapsed,
+    (unsigned long long) (Iterations > 0 ? Elapsed / Iterations : 0)
+    );
+
+  free (Table);
+  return 0;
+}
+
 int main(int argc, char** argv) {
+  if (argc > 1 && strcmp (argv[1], "-b") == 0) {
+    return BenchmarkServerTable (
+      argc > 2 ? (uint32_t) strtoul (argv[2], NULL, 0) : 96,
+      argc > 3 ? (uint32_t) strtoul (argv[3], NULL, 0) : 1000
+      );
+  }
+
   PcdGet32 (PcdFixedDebugPrintErrorLevel) |= DEBUG_INFO;
   PcdGet32 (PcdDebugPrintErrorLevel)      |= DEBUG_INFO;
 
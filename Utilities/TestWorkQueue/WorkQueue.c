@@ -0,0 +1,155 @@
+/** @file
+  Copyright (c) 2020, vit9696. All rights reserved.
+  SPDX-License-Identifier: BSD-3-Clause
+**/
+
+#include <Uefi.h>
+
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/OcWorkQueueLib.h>
+
+#include <UserMpServices.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define TEST_JOB_COUNT   257
+#define TEST_JOB_SIZE    4096
+
+typedef struct {
+  UINT32  Seed;
+  UINT32  RunCount;
+  UINT32  Checksum;
+  UINT8   *Data;
+} TEST_JOB;
+
+STATIC
+VOID
+EFIAPI
+TestJobProcedure (
+  IN OUT VOID  *Context
+  )
+{
+  TEST_JOB  *Job;
+  UINT32    Index;
+  UINT32    Value;
+
+  Job   = Context;
+  Value = Job->Seed;
+
+  for (Index = 0; Index < TEST_JOB_SIZE; ++Index) {
+    Value = Value * 1103515245U + 12345U;
+    Job->Data[Index] = (UINT8) (Value >> 16U);
+  }
+
+  Job->Checksum = Value;
+  ++Job->RunCount;
+}
+
+STATIC
+UINT32
+TestJobExpected (
+  IN UINT32  Seed
+  )
+{
+  UINT32    Index;
+
+  for (Index = 0; Index < TEST_JOB_SIZE; ++Index) {
+    Seed = Seed * 1103515245U + 12345U;
+  }
+
+  return Seed;
+}
+
+STATIC
+BOOLEAN
+TestWorkQueue (
+  IN UINTN   ProcessorCount,
+  IN UINT32  JobCount
+  )
+{
+  EFI_STATUS     Status;
+  OC_WORK_QUEUE  Queue;
+  TEST_JOB       *Jobs;
+  UINT32         Index;
+  UINT32         Half;
+  BOOLEAN        Result;
+
+  UserMpServicesInstall (ProcessorCount);
+
+  Jobs = AllocateZeroPool (sizeof (*Jobs) * (JobCount + 1));
+  if (Jobs == NULL) {
+    return FALSE;
+  }
+
+  for (Index = 0; Index < JobCount; ++Index) {
+    Jobs[Index].Seed = Index * 7919U;
+    Jobs[Index].Data = AllocatePool (TEST_JOB_SIZE);
+    if (Jobs[Index].Data == NULL) {
+      abort ();
+    }
+  }
+
+  Status = OcWorkQueueInit (&Queue, JobCount > 0 ? JobCount : 1);
+  if (EFI_ERROR (Status)) {
+    abort ();
+  }
+
+  //
+  // Run in two batches to ensure completed jobs are not repeated.
+  //
+  Half = JobCount / 2;
+  for (Index = 0; Index < Half; ++Index) {
+    OcWorkQueueAdd (&Queue, TestJobProcedure, &Jobs[Index]);
+  }
+
+  OcWorkQueueRun (&Queue);
+
+  for (Index = Half; Index < JobCount; ++Index) {
+    OcWorkQueueAdd (&Queue, TestJobProcedure, &Jobs[Index]);
+  }
+
+  OcWorkQueueRun (&Queue);
+
+  Result = OcWorkQueueAdd (&Queue, TestJobProcedure, &Jobs[JobCount]) == EFI_OUT_OF_RESOURCES
+    || JobCount == 0;
+
+  for (Index = 0; Index < JobCount; ++Index) {
+    if (Jobs[Index].RunCount != 1 || Jobs[Index].Checksum != TestJobExpected (Jobs[Index].Seed)) {
+      printf ("Job %u failed - %u runs\n", Index, Jobs[Index].RunCount);
+      Result = FALSE;
+    }
+
+    FreePool (Jobs[Index].Data);
+  }
+
+  printf (
+    "%u processors, %u jobs (%u on APs) - %s\n",
+    (UINT32) ProcessorCount,
+    JobCount,
+    Queue.ApJobs,
+    Result ? "OK" : "FAIL"
+    );
+
+  OcWorkQueueFree (&Queue);
+  FreePool (Jobs);
+
+  return Result;
+}
+
+int main (int argc, char *argv[]) {
+  UINTN    Processors;
+  BOOLEAN  Result;
+
+  Result = TRUE;
+
+  for (Processors = 0; Processors <= 8; ++Processors) {
+    Result &= TestWorkQueue (Processors, 0);
+    Result &= TestWorkQueue (Processors, 1);
+    Result &= TestWorkQueue (Processors, TEST_JOB_COUNT);
+  }
+
+  return Result ? 0 : -1;
+}
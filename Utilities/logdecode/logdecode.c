@@ -0,0 +1,746 @@
+/** @file
+
+Decode OpenCore binary trace log.
+
+Copyright (c) 2020, vit9696
+
+All rights reserved.
+
+This program and the accompanying materials
+are licensed and made available under the terms and conditions of the BSD License
+which accompanies this distribution.  The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+//
+// Trace format, must be kept in sync with Library/OcDebugLogLib/OcLogInternal.h.
+//
+#define TRACE_SIGNATURE      0x5254434FU // 'OCTR'
+#define TRACE_VERSION        1
+#define TRACE_HEADER_SIZE    24
+#define TRACE_RECORD_SIZE    24
+
+#define TRACE_RECORD_ENTRY   0
+#define TRACE_RECORD_MODULE  1
+#define TRACE_RECORD_LOST    2
+
+#define TRACE_FLAG_TRUNCATED 1U
+
+#define MAX_IMAGES           64
+#define MAX_MODULES          256
+#define MAX_SECTIONS         64
+
+typedef struct {
+  uint64_t address;
+  uint64_t size;
+  uint64_t offset;
+} section_t;
+
+typedef struct {
+  const char *path;
+  uint8_t    *buffer;
+  size_t     size;
+  section_t  sections[MAX_SECTIONS];
+  uint32_t   section_count;
+} image_t;
+
+typedef struct {
+  uint64_t base;
+  uint64_t size;
+  char     name[256];
+  image_t  *image;
+} module_t;
+
+typedef struct {
+  const uint8_t *data;
+  size_t        size;
+  size_t        offset;
+  bool          exhausted;
+} args_t;
+
+static image_t  images[MAX_IMAGES];
+static uint32_t image_count;
+static module_t modules[MAX_MODULES];
+static uint32_t module_count;
+static uint32_t pointer_size;
+
+static const char *status_success[] = {
+  "Success",
+  "Warning Unknown Glyph",
+  "Warning Delete Failure",
+  "Warning Write Failure",
+  "Warning Buffer Too Small",
+  "Warning Stale Data",
+  "Warning File System",
+  "Warning Reset Required"
+};
+
+static const char *status_error[] = {
+  NULL,
+  "Load Error",
+  "Invalid Parameter",
+  "Unsupported",
+  "Bad Buffer Size",
+  "Buffer Too Small",
+  "Not Ready",
+  "Device Error",
+  "Write Protected",
+  "Out of Resources",
+  "Volume Corrupt",
+  "Volume Full",
+  "No Media",
+  "Media changed",
+  "Not Found",
+  "Access Denied",
+  "No Response",
+  "No mapping",
+  "Time out",
+  "Not started",
+  "Already started",
+  "Aborted",
+  "ICMP Error",
+  "TFTP Error",
+  "Protocol Error",
+  "Incompatible Version",
+  "Security Violation",
+  "CRC Error",
+  "End of Media",
+  "Reserved (29)",
+  "Reserved (30)",
+  "End of File",
+  "Invalid Language",
+  "Compromised Data",
+  "IP Address Conflict",
+  "HTTP Error"
+};
+
+static int read_file(const char *filename, uint8_t **buffer, size_t *size) {
+  FILE *fh = fopen(filename, "rb");
+  if (!fh) {
+    fprintf(stderr, "Missing file %s!\n", filename);
+    return -1;
+  }
+
+  if (fseek(fh, 0, SEEK_END)) {
+    fprintf(stderr, "Failed to find end of %s!\n", filename);
+    fclose(fh);
+    return -1;
+  }
+
+  long pos = ftell(fh);
+
+  if (pos <= 0) {
+    fprintf(stderr, "Invalid file size (%ld) of %s!\n", pos, filename);
+    fclose(fh);
+    return -1;
+  }
+
+  if (fseek(fh, 0, SEEK_SET)) {
+    fprintf(stderr, "Failed to rewind %s!\n", filename);
+    fclose(fh);
+    return -1;
+  }
+
+  *size = (size_t)pos;
+  *buffer = (uint8_t *)malloc(*size);
+
+  if (!*buffer) {
+    fprintf(stderr, "Failed to allocate %zu bytes for %s!\n", *size, filename);
+    fclose(fh);
+    return -1;
+  }
+
+  if (fread(*buffer, *size, 1, fh) != 1) {
+    fprintf(stderr, "Failed to read %zu bytes from %s!\n", *size, filename);
+    fclose(fh);
+    free(*buffer);
+    return -1;
+  }
+
+  fclose(fh);
+  return 0;
+}
+
+static uint64_t read_le(const uint8_t *data, size_t size) {
+  uint64_t value = 0;
+  for (size_t i = 0; i < size; ++i) {
+    value |= (uint64_t)data[i] << (i * 8);
+  }
+  return value;
+}
+
+static bool in_bounds(const image_t *image, uint64_t offset, uint64_t size) {
+  return offset <= image->size && size <= image->size - offset;
+}
+
+static void add_section(image_t *image, uint64_t address, uint64_t size, uint64_t offset) {
+  if (size == 0 || image->section_count == MAX_SECTIONS || !in_bounds(image, offset, size)) {
+    return;
+  }
+
+  section_t *section = &image->sections[image->section_count++];
+  section->address = address;
+  section->size    = size;
+  section->offset  = offset;
+}
+
+//
+// ELF images are linked at the PE/COFF image addresses by EDK II GCC toolchains,
+// so allocated section addresses are image relative.
+//
+static int parse_elf(image_t *image) {
+  bool is64 = image->buffer[4] == 2;
+  if (image->size < (is64 ? 64 : 52)) {
+    return -1;
+  }
+
+  uint64_t shoff     = is64 ? read_le(image->buffer + 0x28, 8) : read_le(image->buffer + 0x20, 4);
+  uint32_t shentsize = (uint32_t)read_le(image->buffer + (is64 ? 0x3A : 0x2E), 2);
+  uint32_t shnum     = (uint32_t)read_le(image->buffer + (is64 ? 0x3C : 0x30), 2);
+
+  if (shentsize < (is64 ? 64U : 40U) || !in_bounds(image, shoff, (uint64_t)shentsize * shnum)) {
+    return -1;
+  }
+
+  for (uint32_t i = 0; i < shnum; ++i) {
+    const uint8_t *sh = image->buffer + shoff + (uint64_t)shentsize * i;
+    uint32_t type  = (uint32_t)read_le(sh + 4, 4);
+    uint64_t flags = is64 ? read_le(sh + 8, 8) : read_le(sh + 8, 4);
+    //
+    // Skip SHT_NOBITS and sections without SHF_ALLOC.
+    //
+    if (type == 8 || (flags & 2) == 0) {
+      continue;
+    }
+
+    if (is64) {
+      add_section(image, read_le(sh + 0x10, 8), read_le(sh + 0x20, 8), read_le(sh + 0x18, 8));
+    } else {
+      add_section(image, read_le(sh + 0x0C, 4), read_le(sh + 0x14, 4), read_le(sh + 0x10, 4));
+    }
+  }
+
+  return 0;
+}
+
+static int parse_pe(image_t *image) {
+  if (image->size < 0x40) {
+    return -1;
+  }
+
+  uint64_t pe = read_le(image->buffer + 0x3C, 4);
+  if (!in_bounds(image, pe, 24) || memcmp(image->buffer + pe, "PE\0\0", 4) != 0) {
+    return -1;
+  }
+
+  uint32_t count   = (uint32_t)read_le(image->buffer + pe + 6, 2);
+  uint64_t table   = pe + 24 + read_le(image->buffer + pe + 20, 2);
+  if (!in_bounds(image, table, (uint64_t)count * 40)) {
+    return -1;
+  }
+
+  for (uint32_t i = 0; i < count; ++i) {
+    const uint8_t *sh = image->buffer + table + 40 * i;
+    uint64_t virtual_size = read_le(sh + 8, 4);
+    uint64_t raw_size     = read_le(sh + 16, 4);
+    add_section(
+      image,
+      read_le(sh + 12, 4),
+      virtual_size < raw_size ? virtual_size : raw_size,
+      read_le(sh + 20, 4)
+      );
+  }
+
+  return 0;
+}
+
+//
+// Mach-O images produced by EDK II XCODE toolchains keep image relative addresses.
+//
+static int parse_macho(image_t *image) {
+  bool is64 = read_le(image->buffer, 4) == 0xFEEDFACFU;
+  uint64_t offset = is64 ? 32 : 28;
+  if (!in_bounds(image, 0, offset)) {
+    return -1;
+  }
+
+  uint32_t ncmds = (uint32_t)read_le(image->buffer + 16, 4);
+
+  for (uint32_t i = 0; i < ncmds; ++i) {
+    if (!in_bounds(image, offset, 8)) {
+      return -1;
+    }
+
+    const uint8_t *cmd = image->buffer + offset;
+    uint32_t type    = (uint32_t)read_le(cmd, 4);
+    uint32_t cmdsize = (uint32_t)read_le(cmd + 4, 4);
+    if (cmdsize < 8 || !in_bounds(image, offset, cmdsize)) {
+      return -1;
+    }
+
+    //
+    // LC_SEGMENT_64 and LC_SEGMENT.
+    //
+    if ((is64 && type == 0x19) || (!is64 && type == 0x1)) {
+      uint32_t header_size  = is64 ? 72 : 56;
+      uint32_t section_size = is64 ? 80 : 68;
+      uint32_t nsects       = cmdsize >= header_size ? (uint32_t)read_le(cmd + header_size - 8, 4) : 0;
+      if (header_size + (uint64_t)nsects * section_size > cmdsize) {
+        return -1;
+      }
+
+      for (uint32_t j = 0; j < nsects; ++j) {
+        const uint8_t *sect = cmd + header_size + section_size * j;
+        uint32_t flags = (uint32_t)read_le(sect + (is64 ? 64 : 56), 4);
+        //
+        // Skip S_ZEROFILL sections.
+        //
+        if ((flags & 0xFF) == 1) {
+          continue;
+        }
+
+        if (is64) {
+          add_section(image, read_le(sect + 32, 8), read_le(sect + 40, 8), read_le(sect + 48, 4));
+        } else {
+          add_section(image, read_le(sect + 32, 4), read_le(sect + 36, 4), read_le(sect + 40, 4));
+        }
+      }
+    }
+
+    offset += cmdsize;
+  }
+
+  return 0;
+}
+
+static int load_image(image_t *image, const char *path) {
+  image->path = path;
+  if (read_file(path, &image->buffer, &image->size) != 0) {
+    return -1;
+  }
+
+  int r = -1;
+  if (image->size >= 16 && memcmp(image->buffer, "\x7F" "ELF", 4) == 0) {
+    r = parse_elf(image);
+  } else if (image->size >= 2 && memcmp(image->buffer, "MZ", 2) == 0) {
+    r = parse_pe(image);
+  } else if (image->size >= 4 && (read_le(image->buffer, 4) == 0xFEEDFACFU || read_le(image->buffer, 4) == 0xFEEDFACEU)) {
+    r = parse_macho(image);
+  }
+
+  if (r != 0) {
+    fprintf(stderr, "Unsupported image format %s!\n", path);
+  }
+
+  return r;
+}
+
+//
+// Compare path stems, e.g. /Build/.../OpenCore.dll and OpenCore.debug.
+//
+static bool same_stem(const char *a, const char *b) {
+  const char *sa = strrchr(a, '/');
+  const char *sb = strrchr(b, '/');
+  const char *wa = strrchr(a, '\\');
+  const char *wb = strrchr(b, '\\');
+  if (wa != NULL && (sa == NULL || wa > sa)) sa = wa;
+  if (wb != NULL && (sb == NULL || wb > sb)) sb = wb;
+  a = sa != NULL ? sa + 1 : a;
+  b = sb != NULL ? sb + 1 : b;
+
+  size_t la = strcspn(a, ".");
+  size_t lb = strcspn(b, ".");
+  return la == lb && la > 0 && memcmp(a, b, la) == 0;
+}
+
+static const char *resolve_string(uint64_t address) {
+  for (uint32_t i = 0; i < module_count; ++i) {
+    module_t *module = &modules[i];
+    if (module->image == NULL || address < module->base || address - module->base >= module->size) {
+      continue;
+    }
+
+    uint64_t rva = address - module->base;
+    image_t *image = module->image;
+    for (uint32_t j = 0; j < image->section_count; ++j) {
+      section_t *section = &image->sections[j];
+      if (rva >= section->address && rva - section->address < section->size) {
+        const char *str = (const char *)image->buffer + section->offset + (rva - section->address);
+        size_t max = section->size - (rva - section->address);
+        return memchr(str, '\0', max) != NULL ? str : NULL;
+      }
+    }
+  }
+
+  return NULL;
+}
+
+static bool take_arg(args_t *args, void *value, size_t size) {
+  if (args->exhausted || args->size - args->offset < size) {
+    args->exhausted = true;
+    return false;
+  }
+
+  memcpy(value, args->data + args->offset, size);
+  args->offset += size;
+  return true;
+}
+
+static uint64_t take_u64(args_t *args) {
+  uint8_t value[8];
+  if (!take_arg(args, value, sizeof(value))) {
+    return 0;
+  }
+  return read_le(value, sizeof(value));
+}
+
+static void print_status(uint64_t status) {
+  uint64_t error_bit = 1ULL << (pointer_size * 8 - 1);
+  uint64_t code      = status & ~error_bit;
+  if ((status & error_bit) != 0) {
+    if (code > 0 && code < sizeof(status_error) / sizeof(status_error[0])) {
+      fputs(status_error[code], stdout);
+      return;
+    }
+  } else if (code < sizeof(status_success) / sizeof(status_success[0])) {
+    fputs(status_success[code], stdout);
+    return;
+  }
+
+  printf("%" PRIX64, status);
+}
+
+//
+// Print a message in the same way as EDK II PrintLib does.
+// Arguments are consumed exactly as recorded by OcDebugLogLib.
+//
+static void print_entry(const char *format, args_t *args) {
+  while (*format != '\0' && !args->exhausted) {
+    if (*format != '%') {
+      putchar(*format++);
+      continue;
+    }
+
+    ++format;
+
+    char     flags[8];
+    size_t   flag_count = 0;
+    bool     is_long = false;
+    bool     has_width = false;
+    bool     has_precision = false;
+    uint64_t width = 0;
+    uint64_t precision = 0;
+
+    for (; *format != '\0'; ++format) {
+      char c = *format;
+      if (c == '.') {
+        has_precision = true;
+      } else if (c == 'l' || c == 'L') {
+        is_long = true;
+      } else if (c == '*') {
+        if (has_precision) {
+          precision = take_u64(args);
+        } else {
+          has_width = true;
+          width = take_u64(args);
+        }
+      } else if (c >= '0' && c <= '9') {
+        if (has_precision) {
+          precision = precision * 10 + (uint64_t)(c - '0');
+        } else {
+          if (c == '0' && !has_width && flag_count < sizeof(flags) - 1) {
+            flags[flag_count++] = '0';
+          }
+          if (c != '0' || has_width) {
+            has_width = true;
+            width = width * 10 + (uint64_t)(c - '0');
+          }
+        }
+      } else if (c == '-' || c == '+' || c == ' ') {
+        if (flag_count < sizeof(flags) - 1) {
+          flags[flag_count++] = c;
+        }
+      } else if (c != ',') {
+        break;
+      }
+    }
+
+    flags[flag_count] = '\0';
+    int w = has_width ? (int)width : 0;
+    if (args->exhausted) {
+      break;
+    }
+
+    char spec[32];
+    char c = *format;
+    switch (c) {
+      case 'p': {
+        uint64_t value = take_u64(args);
+        if (args->exhausted) {
+          break;
+        }
+        printf("%0*" PRIX64, (int)pointer_size * 2, value);
+        break;
+      }
+      case 'X':
+      case 'x':
+      case 'u':
+      case 'd': {
+        uint64_t value = take_u64(args);
+        if (args->exhausted) {
+          break;
+        }
+        if (c == 'd') {
+          int64_t svalue = is_long ? (int64_t)value : (int64_t)(int32_t)value;
+          snprintf(spec, sizeof(spec), "%%%s*%s", flags, PRId64);
+          printf(spec, w, svalue);
+        } else {
+          if (!is_long) {
+            value = (uint32_t)value;
+          }
+          snprintf(
+            spec,
+            sizeof(spec),
+            "%%%s%s*%s",
+            flags,
+            c == 'X' ? "0" : "",
+            c == 'u' ? PRIu64 : PRIX64
+            );
+          printf(spec, w, value);
+        }
+        break;
+      }
+      case 'c':
+      case 'r': {
+        uint64_t value = take_u64(args);
+        if (args->exhausted) {
+          break;
+        }
+        if (c == 'c') {
+          putchar((int)(value & 0xFF));
+        } else {
+          print_status(value);
+        }
+        break;
+      }
+      case 'a':
+      case 's':
+      case 'S': {
+        uint8_t length[2];
+        if (!take_arg(args, length, sizeof(length))) {
+          break;
+        }
+        uint16_t len = (uint16_t)read_le(length, sizeof(length));
+        if (len == UINT16_MAX) {
+          fputs("<null string>", stdout);
+          break;
+        }
+        if (args->size - args->offset < len) {
+          len = (uint16_t)(args->size - args->offset);
+        }
+        snprintf(spec, sizeof(spec), "%%%s*.*s", flags);
+        printf(spec, w, (int)len, (const char *)args->data + args->offset);
+        args->offset += len;
+        break;
+      }
+      case 'g': {
+        uint8_t present;
+        uint8_t guid[16];
+        if (!take_arg(args, &present, sizeof(present))) {
+          break;
+        }
+        if (!present) {
+          fputs("<null guid>", stdout);
+          break;
+        }
+        if (take_arg(args, guid, sizeof(guid))) {
+          printf(
+            "%08x-%04x-%04x-%02x%02x-%02x%02x%02x%02x%02x%02x",
+            (uint32_t)read_le(guid, 4),
+            (uint32_t)read_le(guid + 4, 2),
+            (uint32_t)read_le(guid + 6, 2),
+            guid[8], guid[9], guid[10], guid[11], guid[12], guid[13], guid[14], guid[15]
+            );
+        }
+        break;
+      }
+      case 't': {
+        uint8_t present;
+        uint8_t time[16];
+        if (!take_arg(args, &present, sizeof(present))) {
+          break;
+        }
+        if (!present) {
+          fputs("<null time>", stdout);
+          break;
+        }
+        if (take_arg(args, time, sizeof(time))) {
+          printf(
+            "%02u/%02u/%04u  %02u:%02u",
+            time[2],
+            time[3],
+            (uint32_t)read_le(time, 2),
+            time[4],
+            time[5]
+            );
+        }
+        break;
+      }
+      case '\0':
+        continue;
+      default:
+        putchar(c);
+        break;
+    }
+
+    ++format;
+  }
+
+  if (args->exhausted) {
+    fputs("<truncated>\n", stdout);
+  }
+}
+
+static void print_timing(uint64_t tsc, uint64_t *last, uint64_t start, uint64_t frequency) {
+  if (frequency == 0) {
+    printf("%016" PRIX64 " ", tsc);
+    return;
+  }
+
+  uint64_t start_ms = (tsc - start) * 1000 / frequency;
+  uint64_t last_ms  = (tsc - *last) * 1000 / frequency;
+  *last = tsc;
+
+  printf(
+    "%02" PRIu64 ":%03" PRIu64 " %02" PRIu64 ":%03" PRIu64 " ",
+    start_ms / 1000,
+    start_ms % 1000,
+    last_ms / 1000,
+    last_ms % 1000
+    );
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 2) {
+    fprintf(stderr,
+      "Usage:\n"
+      " logdecode opencore-YYYY-MM-DD-HHMMSS.bin [image.debug | image.efi]...\n");
+    return -1;
+  }
+
+  uint8_t *trace;
+  size_t  trace_size;
+  if (read_file(argv[1], &trace, &trace_size) != 0) {
+    return -1;
+  }
+
+  if (trace_size < TRACE_HEADER_SIZE
+    || read_le(trace, 4) != TRACE_SIGNATURE
+    || read_le(trace + 4, 2) != TRACE_VERSION) {
+    fprintf(stderr, "Invalid trace file %s!\n", argv[1]);
+    free(trace);
+    return -1;
+  }
+
+  pointer_size = (uint32_t)read_le(trace + 6, 2);
+  if (pointer_size != 4 && pointer_size != 8) {
+    pointer_size = 8;
+  }
+
+  uint64_t frequency = read_le(trace + 8, 8);
+  uint64_t start     = read_le(trace + 16, 8);
+
+  for (int i = 2; i < argc && image_count < MAX_IMAGES; ++i) {
+    if (load_image(&images[image_count], argv[i]) == 0) {
+      ++image_count;
+    }
+  }
+
+  //
+  // Module records are written when flushing, so they may follow the
+  // entries referencing them. Collect them in the first pass.
+  //
+  size_t offset = TRACE_HEADER_SIZE;
+  while (trace_size - offset >= TRACE_RECORD_SIZE) {
+    const uint8_t *record = trace + offset;
+    uint16_t size = (uint16_t)read_le(record, 2);
+    if (size < TRACE_RECORD_SIZE || size > trace_size - offset) {
+      break;
+    }
+
+    if (record[2] == TRACE_RECORD_MODULE && module_count < MAX_MODULES) {
+      module_t *module = &modules[module_count++];
+      size_t name_size = size - TRACE_RECORD_SIZE;
+      if (name_size >= sizeof(module->name)) {
+        name_size = sizeof(module->name) - 1;
+      }
+      memcpy(module->name, record + TRACE_RECORD_SIZE, name_size);
+      module->name[name_size] = '\0';
+      module->base  = read_le(record + 16, 8);
+      module->size  = read_le(record + 8, 8);
+      module->image = NULL;
+      for (uint32_t i = 0; i < image_count; ++i) {
+        if (same_stem(module->name, images[i].path)) {
+          module->image = &images[i];
+          break;
+        }
+      }
+      if (module->image == NULL && module->name[0] != '\0') {
+        fprintf(stderr, "No image for module %s at 0x%" PRIX64 "\n", module->name, module->base);
+      }
+    }
+
+    offset += size;
+  }
+
+  uint64_t last = start;
+  offset = TRACE_HEADER_SIZE;
+  while (trace_size - offset >= TRACE_RECORD_SIZE) {
+    const uint8_t *record = trace + offset;
+    uint16_t size = (uint16_t)read_le(record, 2);
+    if (size < TRACE_RECORD_SIZE || size > trace_size - offset) {
+      fprintf(stderr, "Trace is damaged at offset 0x%zX!\n", offset);
+      break;
+    }
+
+    uint64_t tsc     = read_le(record + 8, 8);
+    uint64_t address = read_le(record + 16, 8);
+
+    if (record[2] == TRACE_RECORD_ENTRY) {
+      print_timing(tsc, &last, start, frequency);
+      const char *format = resolve_string(address);
+      if (format != NULL) {
+        args_t args = {record + TRACE_RECORD_SIZE, size - TRACE_RECORD_SIZE, 0, false};
+        print_entry(format, &args);
+        if (!args.exhausted && (record[3] & TRACE_FLAG_TRUNCATED) != 0) {
+          fputs("<truncated>\n", stdout);
+        }
+      } else {
+        printf("<unresolved format 0x%" PRIX64 ", level 0x%08X>\n", address, (uint32_t)read_le(record + 4, 4));
+      }
+    } else if (record[2] == TRACE_RECORD_LOST) {
+      print_timing(tsc, &last, start, frequency);
+      printf("<lost %u entries>\n", (uint32_t)read_le(record + 4, 4));
+    }
+
+    offset += size;
+  }
+
+  for (uint32_t i = 0; i < image_count; ++i) {
+    free(images[i].buffer);
+  }
+  free(trace);
+
+  return 0;
+}